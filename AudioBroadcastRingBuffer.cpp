@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include "AudioBroadcastRingBuffer.h"
+#include "RingBufferUtilities.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#pragma mark Creation and Destruction
+
+SFB::Audio::BroadcastRingBuffer::BroadcastRingBuffer()
+	: mBuffers(nullptr), mCapacityFrames(0), mCapacityFramesMask(0), mReaderCount(0), mWritePosition(0), mWriteReservation(0)
+{
+	for(auto& reader : mReaders) {
+		reader.mReadPosition.store(0, std::memory_order_relaxed);
+		reader.mFramesDropped.store(0, std::memory_order_relaxed);
+		reader.mPolicy = OverrunPolicy::Drop;
+		reader.mInUse.store(false, std::memory_order_relaxed);
+		reader.mActive.store(false, std::memory_order_relaxed);
+	}
+}
+
+SFB::Audio::BroadcastRingBuffer::~BroadcastRingBuffer()
+{
+	Deallocate();
+}
+
+void * SFB::Audio::BroadcastRingBuffer::operator new(size_t size)
+{
+	return AllocateAligned(size, alignof(SFB::Audio::BroadcastRingBuffer));
+}
+
+void SFB::Audio::BroadcastRingBuffer::operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+#pragma mark Buffer Management
+
+bool SFB::Audio::BroadcastRingBuffer::Allocate(const AudioFormat& format, size_t capacityFrames)
+{
+	// Only non-interleaved formats are supported
+	if(format.IsInterleaved())
+		return false;
+
+	if(2 > capacityFrames || capacityFrames > (SIZE_MAX / 2) + 1)
+		return false;
+
+	Deallocate();
+
+	// Round up to the next power of two
+	capacityFrames = (size_t)NextPowerOfTwo(capacityFrames);
+
+	mFormat = format;
+
+	mCapacityFrames = capacityFrames;
+	mCapacityFramesMask = capacityFrames - 1;
+
+	size_t capacityBytes = format.FrameCountToByteCount(capacityFrames);
+
+	// One memory allocation holds everything- first the pointers followed by the deinterleaved channels
+	size_t allocationSize = (capacityBytes + sizeof(uint8_t *)) * format.mChannelsPerFrame;
+	uint8_t *memoryChunk = (uint8_t *)malloc(allocationSize);
+	if(nullptr == memoryChunk)
+		return false;
+
+	// Zero the entire allocation
+	memset(memoryChunk, 0, allocationSize);
+
+	// Assign the pointers and channel buffers
+	mBuffers = (uint8_t **)memoryChunk;
+	memoryChunk += format.mChannelsPerFrame * sizeof(uint8_t *);
+	for(UInt32 i = 0; i < format.mChannelsPerFrame; ++i) {
+		mBuffers[i] = memoryChunk;
+		memoryChunk += capacityBytes;
+	}
+
+	mWritePosition.store(0, std::memory_order_relaxed);
+	mWriteReservation.store(0, std::memory_order_relaxed);
+
+	for(auto& reader : mReaders) {
+		reader.mReadPosition.store(0, std::memory_order_relaxed);
+		reader.mFramesDropped.store(0, std::memory_order_relaxed);
+	}
+
+	return true;
+}
+
+void SFB::Audio::BroadcastRingBuffer::Deallocate()
+{
+	if(mBuffers) {
+		free(mBuffers);
+		mBuffers = nullptr;
+
+		mCapacityFrames = 0;
+		mCapacityFramesMask = 0;
+	}
+}
+
+#pragma mark Reader Management
+
+int SFB::Audio::BroadcastRingBuffer::AddReader(OverrunPolicy policy)
+{
+	for(int i = 0; i < kMaximumReaders; ++i) {
+		auto& reader = mReaders[i];
+
+		bool inUse = false;
+		if(!reader.mInUse.compare_exchange_strong(inUse, true))
+			continue;
+
+		reader.mPolicy = policy;
+		reader.mFramesDropped.store(0, std::memory_order_relaxed);
+		reader.mReadPosition.store(mWritePosition.load(std::memory_order_acquire), std::memory_order_relaxed);
+
+		// Publish the reader's state to the writer
+		reader.mActive.store(true, std::memory_order_release);
+		mReaderCount.fetch_add(1, std::memory_order_relaxed);
+
+		return i;
+	}
+
+	return -1;
+}
+
+bool SFB::Audio::BroadcastRingBuffer::RemoveReader(int reader)
+{
+	if(0 > reader || reader >= kMaximumReaders || !mReaders[reader].mActive.load(std::memory_order_acquire))
+		return false;
+
+	mReaders[reader].mActive.store(false, std::memory_order_release);
+	mReaderCount.fetch_sub(1, std::memory_order_relaxed);
+	mReaders[reader].mInUse.store(false, std::memory_order_release);
+
+	return true;
+}
+
+uint64_t SFB::Audio::BroadcastRingBuffer::GetFramesDropped(int reader) const
+{
+	if(0 > reader || reader >= kMaximumReaders)
+		return 0;
+
+	return mReaders[reader].mFramesDropped.load(std::memory_order_relaxed);
+}
+
+#pragma mark Reading and Writing Audio
+
+size_t SFB::Audio::BroadcastRingBuffer::GetFramesAvailableToRead(int reader) const
+{
+	if(0 > reader || reader >= kMaximumReaders)
+		return 0;
+
+	uint64_t readPosition = mReaders[reader].mReadPosition.load(std::memory_order_acquire);
+	uint64_t writePosition = mWritePosition.load(std::memory_order_acquire);
+
+	// A lapped reader may read at most one buffer's worth
+	return (size_t)std::min(writePosition - readPosition, (uint64_t)mCapacityFrames);
+}
+
+size_t SFB::Audio::BroadcastRingBuffer::GetFramesAvailableToWrite() const
+{
+	// Only blocking readers hold back the writer
+	// Their read positions are loaded before the write position so neither can exceed it
+	uint64_t oldestReadPosition = UINT64_MAX;
+	for(const auto& reader : mReaders) {
+		if(reader.mActive.load(std::memory_order_acquire) && OverrunPolicy::Block == reader.mPolicy)
+			oldestReadPosition = std::min(oldestReadPosition, reader.mReadPosition.load(std::memory_order_acquire));
+	}
+
+	if(UINT64_MAX == oldestReadPosition)
+		return mCapacityFrames;
+
+	uint64_t writePosition = mWritePosition.load(std::memory_order_acquire);
+	uint64_t framesInUse = writePosition - oldestReadPosition;
+
+	return framesInUse >= mCapacityFrames ? 0 : (size_t)(mCapacityFrames - framesInUse);
+}
+
+size_t SFB::Audio::BroadcastRingBuffer::ReadAudio(int reader, AudioBufferList *bufferList, size_t frameCount, bool *overrun)
+{
+	if(0 > reader || reader >= kMaximumReaders || 0 == frameCount)
+		return 0;
+
+	auto& state = mReaders[reader];
+	if(!state.mActive.load(std::memory_order_acquire))
+		return 0;
+
+	// Only this reader modifies its read position
+	uint64_t readPosition = state.mReadPosition.load(std::memory_order_relaxed);
+
+	for(;;) {
+		// The acquire load of the write position ensures the audio and the reservation are visible
+		uint64_t writePosition = mWritePosition.load(std::memory_order_acquire);
+		uint64_t writeReservation = mWriteReservation.load(std::memory_order_relaxed);
+
+		// The writer has lapped this reader, so skip to the oldest audio that won't be overwritten
+		if(writeReservation - readPosition > mCapacityFrames) {
+			uint64_t framesLost = writeReservation - mCapacityFrames - readPosition;
+			readPosition += framesLost;
+			state.mFramesDropped.fetch_add(framesLost, std::memory_order_relaxed);
+
+			if(OverrunPolicy::Report == state.mPolicy) {
+				state.mReadPosition.store(readPosition, std::memory_order_release);
+				if(overrun)
+					*overrun = true;
+				return 0;
+			}
+		}
+
+		size_t framesToRead = (size_t)std::min(writePosition - readPosition, (uint64_t)frameCount);
+		if(0 == framesToRead) {
+			state.mReadPosition.store(readPosition, std::memory_order_release);
+			return 0;
+		}
+
+		size_t offset = (size_t)(readPosition & mCapacityFramesMask);
+		size_t n1 = std::min(framesToRead, mCapacityFrames - offset);
+		size_t n2 = framesToRead - n1;
+
+		FetchABL(bufferList, 0, (const uint8_t **)mBuffers, mFormat.FrameCountToByteCount(offset), mFormat.FrameCountToByteCount(n1));
+		if(n2)
+			FetchABL(bufferList, mFormat.FrameCountToByteCount(n1), (const uint8_t **)mBuffers, 0, mFormat.FrameCountToByteCount(n2));
+
+		// If the writer reserved any of the copied audio in the meantime the copy may be torn, so try again
+		// Blocking readers are only affected if they were lapped before the writer saw them
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(mWriteReservation.load(std::memory_order_relaxed) - readPosition > mCapacityFrames)
+			continue;
+
+		// Publish the new position only after the audio has been consumed
+		state.mReadPosition.store(readPosition + framesToRead, std::memory_order_release);
+
+		// Set the buffer sizes
+		for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex)
+			bufferList->mBuffers[bufferIndex].mDataByteSize = (UInt32)mFormat.FrameCountToByteCount(framesToRead);
+
+		return framesToRead;
+	}
+}
+
+size_t SFB::Audio::BroadcastRingBuffer::WriteAudio(const AudioBufferList *bufferList, size_t frameCount)
+{
+	if(0 == frameCount)
+		return 0;
+
+	size_t framesToWrite = std::min(GetFramesAvailableToWrite(), frameCount);
+	if(0 == framesToWrite)
+		return 0;
+
+	// Only the writer modifies the write position
+	uint64_t writePosition = mWritePosition.load(std::memory_order_relaxed);
+
+	// Announce the region about to be overwritten before touching it so readers can detect torn copies
+	mWriteReservation.store(writePosition + framesToWrite, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	size_t offset = (size_t)(writePosition & mCapacityFramesMask);
+	size_t n1 = std::min(framesToWrite, mCapacityFrames - offset);
+	size_t n2 = framesToWrite - n1;
+
+	StoreABL(mBuffers, mFormat.FrameCountToByteCount(offset), bufferList, 0, mFormat.FrameCountToByteCount(n1));
+	if(n2)
+		StoreABL(mBuffers, 0, bufferList, mFormat.FrameCountToByteCount(n1), mFormat.FrameCountToByteCount(n2));
+
+	// Publish the audio only after it has been copied
+	mWritePosition.store(writePosition + framesToWrite, std::memory_order_release);
+
+	return framesToWrite;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#pragma once
+
+#include <CoreAudio/CoreAudioTypes.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "AudioFormat.h"
+
+/*! @file AudioBroadcastRingBuffer.h @brief An audio ring buffer with multiple readers */
+
+/*! @brief \c SFBAudioEngine's encompassing namespace */
+namespace SFB {
+
+	/*! @brief %Audio functionality */
+	namespace Audio {
+
+		/*!
+		 * @brief A ring buffer implementation supporting non-interleaved audio with one writer and multiple readers.
+		 *
+		 * Every reader sees every frame written after it was added, at its own pace.  Each reader has
+		 * an independent read cursor and an OverrunPolicy determining what happens when the writer
+		 * laps it.
+		 *
+		 * This class is thread safe when used from one writer thread and one thread per reader.
+		 * Neither reading nor writing blocks, allocates memory, or takes locks.
+		 *
+		 * Positions are 64-bit frame counts that never wrap.  Readers that don't hold back the writer
+		 * validate their reads after copying, so audio overwritten during a read is never returned.
+		 */
+		class BroadcastRingBuffer
+		{
+		public:
+			// ========================================
+			/*! @name Creation and Destruction */
+			//@{
+
+			/*! @brief A \c std::unique_ptr for \c BroadcastRingBuffer objects */
+			using unique_ptr = std::unique_ptr<BroadcastRingBuffer>;
+
+			/*! @brief The maximum number of simultaneous readers */
+			static constexpr int kMaximumReaders = 8;
+
+			/*! @brief What happens when the writer laps a reader */
+			enum class OverrunPolicy {
+				Drop,		/*!< The oldest audio is discarded and the reader continues with the oldest audio still available */
+				Block,		/*!< The writer will not overwrite audio the reader hasn't read; writes are truncated instead */
+				Report		/*!< As \c Drop, but the first read after an overrun returns no audio and reports the discontinuity */
+			};
+
+			/*!
+			 * @brief Create a new \c BroadcastRingBuffer
+			 * @note Allocate() must be called before the object may be used.
+			 */
+			BroadcastRingBuffer();
+
+			/*! @brief Destroy the \c BroadcastRingBuffer and release all associated resources. */
+			~BroadcastRingBuffer();
+
+			/*! @cond */
+
+			/*! @internal This class is non-copyable */
+			BroadcastRingBuffer(const BroadcastRingBuffer& rhs) = delete;
+
+			/*! @internal This class is non-assignable */
+			BroadcastRingBuffer& operator=(const BroadcastRingBuffer& rhs) = delete;
+
+			/*! @internal Allocate with the alignment of the cache-line aligned members, which operator new only guarantees from C++17 */
+			static void * operator new(size_t size);
+
+			/*! @internal Release memory allocated with this class's operator new */
+			static void operator delete(void *ptr) noexcept;
+
+			/*! @endcond */
+
+			//@}
+
+
+			// ========================================
+			/*! @name Buffer management */
+			//@{
+
+			/*!
+			 * @brief Allocate space for audio data.
+			 * @note Only non-interleaved formats are supported.
+			 * @note This method is not thread safe.
+			 * @note Registered readers are retained and repositioned at the start of the buffer
+			 * @param format The format of the audio that will be written to and read from this buffer.
+			 * @param capacityFrames The desired capacity, in frames, in the range [2..2^63]
+			 * @return \c true on success, \c false on error
+			 */
+			bool Allocate(const AudioFormat& format, size_t capacityFrames);
+
+			/*!
+			 * @brief Free the resources used by this \c BroadcastRingBuffer
+			 * @note This method is not thread safe.
+			 */
+			void Deallocate();
+
+
+			/*! @brief Get the capacity of this \c BroadcastRingBuffer in frames */
+			inline size_t GetCapacityFrames() const						{ return mCapacityFrames; }
+
+			/*! @brief Get the format of this \c BroadcastRingBuffer */
+			inline const AudioFormat& GetFormat() const					{ return mFormat; }
+
+			//@}
+
+
+			// ========================================
+			/*! @name Reader management */
+			//@{
+
+			/*!
+			 * @brief Add a reader
+			 *
+			 * The reader's cursor is placed at the current write position, so it will
+			 * see only audio written after this call.
+			 * @note This method may be called from any thread, but not concurrently with Allocate() or Deallocate()
+			 * @param policy How the reader handles being lapped by the writer
+			 * @return The reader's identifier, or \c -1 if \c kMaximumReaders readers already exist
+			 */
+			int AddReader(OverrunPolicy policy = OverrunPolicy::Drop);
+
+			/*!
+			 * @brief Remove a reader
+			 * @note This method must not be called concurrently with reads by \c reader
+			 * @param reader The reader's identifier
+			 * @return \c true on success, \c false otherwise
+			 */
+			bool RemoveReader(int reader);
+
+			/*! @brief Get the number of registered readers */
+			inline int GetReaderCount() const							{ return mReaderCount.load(std::memory_order_relaxed); }
+
+			/*! @brief Get the number of frames \c reader has lost to overruns */
+			uint64_t GetFramesDropped(int reader) const;
+
+			//@}
+
+
+			// ========================================
+			/*! @name Reading and writing audio */
+			//@{
+
+			/*! @brief Get the number of frames available for reading by \c reader */
+			size_t GetFramesAvailableToRead(int reader) const;
+
+			/*!
+			 * @brief Get the free space available for writing in frames
+			 * @note Only readers using \c OverrunPolicy::Block limit the free space
+			 */
+			size_t GetFramesAvailableToWrite() const;
+
+			/*!
+			 * @brief Read audio from the \c BroadcastRingBuffer, advancing \c reader's cursor.
+			 * @param reader The reader's identifier
+			 * @param bufferList An \c AudioBufferList to receive the audio
+			 * @param frameCount The desired number of frames to read
+			 * @param overrun An optional pointer to a \c bool set to \c true if a \c Report reader was lapped
+			 * @return The number of frames actually read
+			 */
+			size_t ReadAudio(int reader, AudioBufferList *bufferList, size_t frameCount, bool *overrun = nullptr);
+
+			/*!
+			 * @brief Write audio to the \c BroadcastRingBuffer, advancing the write position.
+			 * @param bufferList An \c AudioBufferList containing the audio to copy
+			 * @param frameCount The desired number of frames to write
+			 * @return The number of frames actually written
+			 */
+			size_t WriteAudio(const AudioBufferList *bufferList, size_t frameCount);
+
+			//@}
+
+		private:
+
+			// The assumed size of a cache line, in bytes
+			static constexpr size_t kCacheLineSize = 64;
+
+			// Per-reader state, kept on its own cache line
+			struct alignas(kCacheLineSize) Reader {
+				std::atomic<uint64_t>	mReadPosition;		// In frames, never wraps
+				std::atomic<uint64_t>	mFramesDropped;
+				OverrunPolicy			mPolicy;
+				std::atomic_bool		mInUse;				// Whether the slot is claimed
+				std::atomic_bool		mActive;			// Whether the writer should consider this reader
+			};
+
+			AudioFormat				mFormat;				// The format of the audio
+
+			unsigned char			**mBuffers;				// The channel pointers and buffers, allocated in one chunk of memory
+
+			size_t					mCapacityFrames;		// Frame capacity per channel
+			size_t					mCapacityFramesMask;
+
+			std::atomic_int			mReaderCount;
+
+			alignas(kCacheLineSize) std::atomic<uint64_t>	mWritePosition;		// In frames, never wraps; audio before this position is readable
+			std::atomic<uint64_t>	mWriteReservation;		// Audio before this position minus the capacity may be overwritten
+			Reader					mReaders [kMaximumReaders];
+		};
+
+	}
+}
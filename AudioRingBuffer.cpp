@@ -4,54 +4,28 @@
  */
 
 #include "AudioRingBuffer.h"
+#include "RingBufferUtilities.h"
+#include "VirtualMemory.h"
 
+#include <cstdint>
 #include <cstdlib>
 #include <algorithm>
 
 namespace {
 
 	/*!
-	 * Copy non-interleaved audio from \c bufferList to \c buffers
-	 * @param buffers The destination buffers
-	 * @param destOffset The byte offset in \c buffers to begin writing
-	 * @param bufferList The source buffers
-	 * @param srcOffset The byte offset in \c bufferList to begin reading
-	 * @param byteCount The number of bytes per non-interleaved buffer to read and write
+	 * Point the buffers in \c bufferList at a region of \c buffers
+	 * @param bufferList The view to set
+	 * @param buffers The channel buffers
+	 * @param byteOffset The byte offset in \c buffers of the region
+	 * @param byteCount The number of bytes per non-interleaved buffer in the region
 	 */
-	inline void StoreABL(uint8_t **buffers, size_t destOffset, const AudioBufferList *bufferList, size_t srcOffset, size_t byteCount)
+	inline void SetABLView(AudioBufferList *bufferList, uint8_t **buffers, size_t byteOffset, size_t byteCount)
 	{
-		for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex)
-			memcpy(buffers[bufferIndex] + destOffset, (uint8_t *)bufferList->mBuffers[bufferIndex].mData + srcOffset, byteCount);
-	}
-
-	/*!
-	 * Copy non-interleaved audio from \c buffers to \c bufferList
-	 * @param bufferList The destination buffers
-	 * @param destOffset The byte offset in \c bufferList to begin writing
-	 * @param buffers The source buffers
-	 * @param srcOffset The byte offset in \c bufferList to begin reading
-	 * @param byteCount The number of bytes per non-interleaved buffer to read and write
-	 */
-	inline void FetchABL(AudioBufferList *bufferList, size_t destOffset, const uint8_t **buffers, size_t srcOffset, size_t byteCount)
-	{
-		for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex)
-			memcpy((uint8_t *)bufferList->mBuffers[bufferIndex].mData + destOffset, buffers[bufferIndex] + srcOffset, byteCount);
-	}
-
-	/*!
-	 * Return the smallest power of two value greater than \c x
-	 * @param x A value in the range [2..2147483648]
-	 * @return The smallest power of two greater than \c x
-	 *
-	 */
-	__attribute__ ((const)) inline uint32_t NextPowerOfTwo(uint32_t x)
-	{
-#if 0
-		assert(x > 1);
-		assert(x <= ((UINT32_MAX / 2) + 1));
-#endif
-
-		return 1 << (32 - __builtin_clz(x - 1));
+		for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex) {
+			bufferList->mBuffers[bufferIndex].mData = buffers[bufferIndex] + byteOffset;
+			bufferList->mBuffers[bufferIndex].mDataByteSize = (UInt32)byteCount;
+		}
 	}
 
 }
@@ -59,7 +33,7 @@ namespace {
 #pragma mark Creation and Destruction
 
 SFB::Audio::RingBuffer::RingBuffer()
-	: mBuffers(nullptr), mCapacityFrames(0), mCapacityFramesMask(0), mWritePointer(0), mReadPointer(0)
+	: mBuffers(nullptr), mReadVector{nullptr, nullptr}, mWriteVector{nullptr, nullptr}, mAllocationSize(0), mCapacityFrames(0), mCapacityFramesMask(0), mIsMirrored(false), mIsPageAllocated(false), mIsLocked(false), mWritePointer(0), mReadPointer(0)
 {}
 
 SFB::Audio::RingBuffer::~RingBuffer()
@@ -67,18 +41,39 @@ SFB::Audio::RingBuffer::~RingBuffer()
 	Deallocate();
 }
 
+void * SFB::Audio::RingBuffer::operator new(size_t size)
+{
+	return AllocateAligned(size, alignof(SFB::Audio::RingBuffer));
+}
+
+void SFB::Audio::RingBuffer::operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
 #pragma mark Buffer Management
 
-bool SFB::Audio::RingBuffer::Allocate(const AudioFormat& format, size_t capacityFrames)
+bool SFB::Audio::RingBuffer::Allocate(const AudioFormat& format, size_t capacityFrames, int flags)
 {
 	// Only non-interleaved formats are supported
 	if(format.IsInterleaved())
 		return false;
 
+	if(2 > capacityFrames || capacityFrames > (SIZE_MAX / 2) + 1)
+		return false;
+
 	Deallocate();
 
 	// Round up to the next power of two
-	capacityFrames = NextPowerOfTwo((uint32_t)capacityFrames);
+	capacityFrames = (size_t)NextPowerOfTwo(capacityFrames);
+
+	// Mirrored memory is mapped in whole pages, so each channel must occupy a whole number of pages
+	if(MirrorMemory & flags) {
+		while(format.FrameCountToByteCount(capacityFrames) < GetPageSize())
+			capacityFrames *= 2;
+		if(format.FrameCountToByteCount(capacityFrames) % GetPageSize())
+			return false;
+	}
 
 	mFormat = format;
 
@@ -87,25 +82,82 @@ bool SFB::Audio::RingBuffer::Allocate(const AudioFormat& format, size_t capacity
 
 	size_t capacityBytes = format.FrameCountToByteCount(capacityFrames);
 
-	// One memory allocation holds everything- first the pointers followed by the deinterleaved channels
-	size_t allocationSize = (capacityBytes + sizeof(uint8_t *)) * format.mChannelsPerFrame;
-	uint8_t *memoryChunk = (uint8_t *)malloc(allocationSize);
+	// Each read and write vector view holds one AudioBuffer per channel
+	size_t viewSize = offsetof(AudioBufferList, mBuffers) + (sizeof(AudioBuffer) * format.mChannelsPerFrame);
+
+	// One memory allocation holds everything- first the pointers, then the four views, followed by the deinterleaved channels
+	// Mirrored channels are mapped separately
+	size_t allocationSize = (sizeof(uint8_t *) * format.mChannelsPerFrame) + (4 * viewSize);
+	if(!(MirrorMemory & flags))
+		allocationSize += capacityBytes * format.mChannelsPerFrame;
+
+	// Huge or locked pages are mapped in whole pages
+	bool pageAllocated = !(MirrorMemory & flags) && ((PreferHugePages | LockInMemory) & flags);
+	if(pageAllocated) {
+		if((PreferHugePages & flags) && allocationSize >= kHugePageSize)
+			allocationSize = ((allocationSize + kHugePageSize - 1) / kHugePageSize) * kHugePageSize;
+		else
+			allocationSize = RoundUpToPageSize(allocationSize);
+	}
+
+	uint8_t *memoryChunk = nullptr;
+	if(pageAllocated)
+		memoryChunk = (uint8_t *)AllocatePages(allocationSize, PreferHugePages & flags);
+	else
+		memoryChunk = (uint8_t *)malloc(allocationSize);
+
 	if(nullptr == memoryChunk)
 		return false;
 
-	// Zero the entire allocation
-	memset(memoryChunk, 0, allocationSize);
+	mAllocationSize = allocationSize;
+	mIsPageAllocated = pageAllocated;
+
+	// Zero the entire allocation (pages are already zeroed)
+	if(!pageAllocated)
+		memset(memoryChunk, 0, allocationSize);
 
 	// Assign the pointers and channel buffers
 	mBuffers = (uint8_t **)memoryChunk;
 	memoryChunk += format.mChannelsPerFrame * sizeof(uint8_t *);
-	for(UInt32 i = 0; i < format.mChannelsPerFrame; ++i) {
-		mBuffers[i] = memoryChunk;
-		memoryChunk += capacityBytes;
+
+	for(AudioBufferList **view : { &mReadVector[0], &mReadVector[1], &mWriteVector[0], &mWriteVector[1] }) {
+		*view = (AudioBufferList *)memoryChunk;
+		(*view)->mNumberBuffers = format.mChannelsPerFrame;
+		for(UInt32 i = 0; i < format.mChannelsPerFrame; ++i)
+			(*view)->mBuffers[i].mNumberChannels = 1;
+		memoryChunk += viewSize;
 	}
 
-	mReadPointer = 0;
-	mWritePointer = 0;
+	if(MirrorMemory & flags) {
+		mIsMirrored = true;
+		for(UInt32 i = 0; i < format.mChannelsPerFrame; ++i) {
+			mBuffers[i] = (uint8_t *)AllocateMirroredMemory(capacityBytes);
+			if(nullptr == mBuffers[i]) {
+				Deallocate();
+				return false;
+			}
+		}
+	}
+	else {
+		for(UInt32 i = 0; i < format.mChannelsPerFrame; ++i) {
+			mBuffers[i] = memoryChunk;
+			memoryChunk += capacityBytes;
+		}
+	}
+
+	// Locking is best effort; mirrored pages only need to be locked once
+	if(LockInMemory & flags) {
+		if(mIsMirrored) {
+			mIsLocked = true;
+			for(UInt32 i = 0; i < format.mChannelsPerFrame; ++i)
+				mIsLocked = SFB::LockMemory(mBuffers[i], capacityBytes) && mIsLocked;
+		}
+		else
+			mIsLocked = SFB::LockMemory(mBuffers, mAllocationSize);
+	}
+
+	mReadPointer.store(0, std::memory_order_relaxed);
+	mWritePointer.store(0, std::memory_order_relaxed);
 
 	return true;
 }
@@ -113,16 +165,38 @@ bool SFB::Audio::RingBuffer::Allocate(const AudioFormat& format, size_t capacity
 void SFB::Audio::RingBuffer::Deallocate()
 {
 	if(mBuffers) {
-		free(mBuffers);
+		if(mIsMirrored) {
+			size_t capacityBytes = mFormat.FrameCountToByteCount(mCapacityFrames);
+			for(UInt32 i = 0; i < mFormat.mChannelsPerFrame; ++i) {
+				if(mIsLocked)
+					UnlockMemory(mBuffers[i], capacityBytes);
+				DeallocateMirroredMemory(mBuffers[i], capacityBytes);
+			}
+			mIsMirrored = false;
+		}
+		else if(mIsLocked)
+			UnlockMemory(mBuffers, mAllocationSize);
+
+		if(mIsPageAllocated)
+			DeallocatePages(mBuffers, mAllocationSize);
+		else
+			free(mBuffers);
 		mBuffers = nullptr;
+
+		mReadVector[0] = mReadVector[1] = nullptr;
+		mWriteVector[0] = mWriteVector[1] = nullptr;
+
+		mAllocationSize = 0;
+		mIsPageAllocated = false;
+		mIsLocked = false;
 	}
 }
 
 
 void SFB::Audio::RingBuffer::Reset()
 {
-	mReadPointer = 0;
-	mWritePointer = 0;
+	mReadPointer.store(0, std::memory_order_relaxed);
+	mWritePointer.store(0, std::memory_order_relaxed);
 
 	for(UInt32 i = 0; i < mFormat.mChannelsPerFrame; ++i)
 		memset(mBuffers[i], 0, mFormat.FrameCountToByteCount(mCapacityFrames));
@@ -130,8 +204,8 @@ void SFB::Audio::RingBuffer::Reset()
 
 size_t SFB::Audio::RingBuffer::GetFramesAvailableToRead() const
 {
-	size_t w = mWritePointer;
-	size_t r = mReadPointer;
+	size_t w = mWritePointer.load(std::memory_order_acquire);
+	size_t r = mReadPointer.load(std::memory_order_acquire);
 
 	if(w > r)
 		return w - r;
@@ -141,8 +215,8 @@ size_t SFB::Audio::RingBuffer::GetFramesAvailableToRead() const
 
 size_t SFB::Audio::RingBuffer::GetFramesAvailableToWrite() const
 {
-	size_t w = mWritePointer;
-	size_t r = mReadPointer;
+	size_t w = mWritePointer.load(std::memory_order_acquire);
+	size_t r = mReadPointer.load(std::memory_order_acquire);
 
 	if(w > r)
 		return ((r - w + mCapacityFrames) & mCapacityFramesMask) - 1;
@@ -157,16 +231,21 @@ size_t SFB::Audio::RingBuffer::ReadAudio(AudioBufferList *bufferList, size_t fra
 	if(0 == frameCount)
 		return 0;
 
+	// The acquire load of the write pointer in GetFramesAvailableToRead() ensures the audio is visible
 	size_t framesAvailable = GetFramesAvailableToRead();
 	if(0 == framesAvailable)
 		return 0;
 
+	// Only the reader modifies the read pointer
+	size_t readPointer = mReadPointer.load(std::memory_order_relaxed);
+
 	size_t framesToRead = std::min(framesAvailable, frameCount);
-	size_t cnt2 = mReadPointer + framesToRead;
+	size_t cnt2 = readPointer + framesToRead;
 
+	// Mirrored memory is contiguous past the end of the buffer
 	size_t n1, n2;
-	if(cnt2 > mCapacityFrames) {
-		n1 = mCapacityFrames - mReadPointer;
+	if(cnt2 > mCapacityFrames && !mIsMirrored) {
+		n1 = mCapacityFrames - readPointer;
 		n2 = cnt2 & mCapacityFramesMask;
 	}
 	else {
@@ -174,14 +253,17 @@ size_t SFB::Audio::RingBuffer::ReadAudio(AudioBufferList *bufferList, size_t fra
 		n2 = 0;
 	}
 
-	FetchABL(bufferList, 0, (const uint8_t **)mBuffers, mFormat.FrameCountToByteCount(mReadPointer), mFormat.FrameCountToByteCount(n1));
-	mReadPointer = (mReadPointer + n1) & mCapacityFramesMask;
+	FetchABL(bufferList, 0, (const uint8_t **)mBuffers, mFormat.FrameCountToByteCount(readPointer), mFormat.FrameCountToByteCount(n1));
+	readPointer = (readPointer + n1) & mCapacityFramesMask;
 
 	if(n2) {
-		FetchABL(bufferList, mFormat.FrameCountToByteCount(n1), (const uint8_t **)mBuffers, mFormat.FrameCountToByteCount(mReadPointer), mFormat.FrameCountToByteCount(n2));
-		mReadPointer = (mReadPointer + n2) & mCapacityFramesMask;
+		FetchABL(bufferList, mFormat.FrameCountToByteCount(n1), (const uint8_t **)mBuffers, mFormat.FrameCountToByteCount(readPointer), mFormat.FrameCountToByteCount(n2));
+		readPointer = (readPointer + n2) & mCapacityFramesMask;
 	}
 
+	// Publish the space only after the audio has been consumed
+	mReadPointer.store(readPointer, std::memory_order_release);
+
 	// Set the buffer sizes
 	for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex)
 		bufferList->mBuffers[bufferIndex].mDataByteSize = (UInt32)mFormat.FrameCountToByteCount(framesToRead);
@@ -194,16 +276,21 @@ size_t SFB::Audio::RingBuffer::WriteAudio(const AudioBufferList *bufferList, siz
 	if(0 == frameCount)
 		return 0;
 
+	// The acquire load of the read pointer in GetFramesAvailableToWrite() ensures the reader is finished with the space
 	size_t framesAvailable = GetFramesAvailableToWrite();
 	if(0 == framesAvailable)
 		return 0;
 
+	// Only the writer modifies the write pointer
+	size_t writePointer = mWritePointer.load(std::memory_order_relaxed);
+
 	size_t framesToWrite = std::min(framesAvailable, frameCount);
-	size_t cnt2 = mWritePointer + framesToWrite;
+	size_t cnt2 = writePointer + framesToWrite;
 
+	// Mirrored memory is contiguous past the end of the buffer
 	size_t n1, n2;
-	if(cnt2 > mCapacityFrames) {
-		n1 = mCapacityFrames - mWritePointer;
+	if(cnt2 > mCapacityFrames && !mIsMirrored) {
+		n1 = mCapacityFrames - writePointer;
 		n2 = cnt2 & mCapacityFramesMask;
 	}
 	else {
@@ -211,13 +298,104 @@ size_t SFB::Audio::RingBuffer::WriteAudio(const AudioBufferList *bufferList, siz
 		n2 = 0;
 	}
 
-	StoreABL(mBuffers, mFormat.FrameCountToByteCount(mWritePointer), bufferList, 0, mFormat.FrameCountToByteCount(n1));
-	mWritePointer = (mWritePointer + n1) & mCapacityFramesMask;
+	StoreABL(mBuffers, mFormat.FrameCountToByteCount(writePointer), bufferList, 0, mFormat.FrameCountToByteCount(n1));
+	writePointer = (writePointer + n1) & mCapacityFramesMask;
 
 	if(n2) {
-		StoreABL(mBuffers, mFormat.FrameCountToByteCount(mWritePointer), bufferList, mFormat.FrameCountToByteCount(n1), mFormat.FrameCountToByteCount(n2));
-		mWritePointer = (mWritePointer + n2) & mCapacityFramesMask;
+		StoreABL(mBuffers, mFormat.FrameCountToByteCount(writePointer), bufferList, mFormat.FrameCountToByteCount(n1), mFormat.FrameCountToByteCount(n2));
+		writePointer = (writePointer + n2) & mCapacityFramesMask;
 	}
 
+	// Publish the audio only after it has been copied
+	mWritePointer.store(writePointer, std::memory_order_release);
+
 	return framesToWrite;
 }
+
+void SFB::Audio::RingBuffer::ClampViewFrameCounts(size_t& n1, size_t& n2) const
+{
+	// AudioBuffer sizes are 32 bits so views into very large buffers are truncated
+	size_t maximumFrames = mFormat.ByteCountToFrameCount(UINT32_MAX);
+	if(n1 >= maximumFrames) {
+		n1 = maximumFrames;
+		n2 = 0;
+	}
+	else
+		n2 = std::min(n2, maximumFrames);
+}
+
+void SFB::Audio::RingBuffer::ReadAdvance(size_t frameCount)
+{
+	size_t readPointer = mReadPointer.load(std::memory_order_relaxed);
+	mReadPointer.store((readPointer + frameCount) & mCapacityFramesMask, std::memory_order_release);
+}
+
+void SFB::Audio::RingBuffer::WriteAdvance(size_t frameCount)
+{
+	size_t writePointer = mWritePointer.load(std::memory_order_relaxed);
+	mWritePointer.store((writePointer + frameCount) & mCapacityFramesMask, std::memory_order_release);
+}
+
+SFB::Audio::RingBuffer::BufferListPair SFB::Audio::RingBuffer::GetReadVector()
+{
+	size_t w = mWritePointer.load(std::memory_order_acquire);
+	size_t r = mReadPointer.load(std::memory_order_relaxed);
+
+	size_t framesAvailable;
+	if(w > r)
+		framesAvailable = w - r;
+	else
+		framesAvailable = (w - r + mCapacityFrames) & mCapacityFramesMask;
+
+	size_t cnt2 = r + framesAvailable;
+
+	size_t n1, n2;
+	if(cnt2 > mCapacityFrames && !mIsMirrored) {
+		n1 = mCapacityFrames - r;
+		n2 = cnt2 & mCapacityFramesMask;
+	}
+	else {
+		n1 = framesAvailable;
+		n2 = 0;
+	}
+
+	ClampViewFrameCounts(n1, n2);
+
+	SetABLView(mReadVector[0], mBuffers, mFormat.FrameCountToByteCount(r), mFormat.FrameCountToByteCount(n1));
+	SetABLView(mReadVector[1], mBuffers, 0, mFormat.FrameCountToByteCount(n2));
+
+	return { mReadVector[0], mReadVector[1] };
+}
+
+SFB::Audio::RingBuffer::BufferListPair SFB::Audio::RingBuffer::GetWriteVector()
+{
+	size_t w = mWritePointer.load(std::memory_order_relaxed);
+	size_t r = mReadPointer.load(std::memory_order_acquire);
+
+	size_t framesAvailable;
+	if(w > r)
+		framesAvailable = ((r - w + mCapacityFrames) & mCapacityFramesMask) - 1;
+	else if(w < r)
+		framesAvailable = (r - w) - 1;
+	else
+		framesAvailable = mCapacityFrames - 1;
+
+	size_t cnt2 = w + framesAvailable;
+
+	size_t n1, n2;
+	if(cnt2 > mCapacityFrames && !mIsMirrored) {
+		n1 = mCapacityFrames - w;
+		n2 = cnt2 & mCapacityFramesMask;
+	}
+	else {
+		n1 = framesAvailable;
+		n2 = 0;
+	}
+
+	ClampViewFrameCounts(n1, n2);
+
+	SetABLView(mWriteVector[0], mBuffers, mFormat.FrameCountToByteCount(w), mFormat.FrameCountToByteCount(n1));
+	SetABLView(mWriteVector[1], mBuffers, 0, mFormat.FrameCountToByteCount(n2));
+
+	return { mWriteVector[0], mWriteVector[1] };
+}
@@ -6,7 +6,9 @@
 #pragma once
 
 #include <CoreAudio/CoreAudioTypes.h>
+#include <atomic>
 #include <memory>
+#include <utility>
 
 #include "AudioFormat.h"
 
@@ -23,6 +25,8 @@ namespace SFB {
 		 *
 		 * This class is thread safe when used from one reader thread
 		 * and one writer thread (single producer, single consumer model).
+		 * The read and write pointers use acquire/release ordering and are
+		 * kept on separate cache lines.
 		 *
 		 * The read and write routines are based on JACK's ringbuffer implementation
 		 * but are modified for non-interleaved audio.
@@ -37,6 +41,13 @@ namespace SFB {
 			/*! @brief A \c std::unique_ptr for \c RingBuffer objects */
 			using unique_ptr = std::unique_ptr<RingBuffer>;
 
+			/*! @brief Flags used in \c RingBuffer::Allocate */
+			enum AllocationFlags {
+				MirrorMemory		= 1 << 0,	/*!< Map each channel twice back to back so reads and writes never wrap */
+				PreferHugePages		= 1 << 1,	/*!< Back the buffers with huge pages if possible (ignored for mirrored buffers) */
+				LockInMemory		= 1 << 2	/*!< Lock the buffers in physical memory so accesses never page fault */
+			};
+
 			/*!
 			 * @brief Create a new \c RingBuffer
 			 * @note Allocate() must be called before the object may be used.
@@ -54,6 +65,12 @@ namespace SFB {
 			/*! @internal This class is non-assignable */
 			RingBuffer& operator=(const RingBuffer& rhs) = delete;
 
+			/*! @internal Allocate with the alignment of the cache-line aligned members, which operator new only guarantees from C++17 */
+			static void * operator new(size_t size);
+
+			/*! @internal Release memory allocated with this class's operator new */
+			static void operator delete(void *ptr) noexcept;
+
 			/*! @endcond */
 
 			//@}
@@ -67,11 +84,15 @@ namespace SFB {
 			 * @brief Allocate space for audio data.
 			 * @note Only interleaved formats are supported.
 			 * @note This method is not thread safe.
+			 * @note When \c MirrorMemory is specified the capacity is rounded up so each channel fills whole pages
+			 * @note \c LockInMemory is best effort; use IsLocked() to determine whether it succeeded
 			 * @param format The format of the audio that will be written to and read from this buffer.
-			 * @param capacityFrames The desired capacity, in frames
+			 * @param capacityFrames The desired capacity, in frames, in the range [2..2^63]
+			 * @param flags Optional flags affecting how the memory is allocated
 			 * @return \c true on success, \c false on error
+			 * @see AllocationFlags
 			 */
-			bool Allocate(const AudioFormat& format, size_t capacityFrames);
+			bool Allocate(const AudioFormat& format, size_t capacityFrames, int flags = 0);
 
 			/*!
 			 * @brief Free the resources used by this \c RingBuffer
@@ -93,6 +114,15 @@ namespace SFB {
 			/*! @brief Get the format of this \c BufferList */
 			inline const AudioFormat& GetFormat() const					{ return mFormat; }
 
+			/*!
+			 * @brief Query whether this \c RingBuffer uses mirrored memory
+			 * @note When mirrored, the second view in the read and write vectors is always empty
+			 */
+			inline bool IsMirrored() const								{ return mIsMirrored; }
+
+			/*! @brief Query whether this \c RingBuffer is locked in physical memory */
+			inline bool IsLocked() const								{ return mIsLocked; }
+
 			/*! @brief  Get the number of frames available for reading */
 			size_t GetFramesAvailableToRead() const;
 
@@ -122,19 +152,63 @@ namespace SFB {
 			 */
 			size_t WriteAudio(const AudioBufferList *bufferList, size_t frameCount);
 
+
+			/*! @brief Advance the read pointer by the specified number of frames */
+			void ReadAdvance(size_t frameCount);
+
+			/*! @brief Advance the write pointer by the specified number of frames */
+			void WriteAdvance(size_t frameCount);
+
+
+			/*!
+			 * @brief A pair of \c AudioBufferList views into the ring buffer's memory
+			 *
+			 * Each \c AudioBufferList contains one buffer per channel with \c mDataByteSize
+			 * set to the size of the region.  The second view is empty (\c mDataByteSize of \c 0)
+			 * unless the region wraps around the end of the ring buffer.  Because \c mDataByteSize is
+			 * 32 bits, each view covers at most \c UINT32_MAX bytes per channel.
+			 */
+			using BufferListPair = std::pair<AudioBufferList *, AudioBufferList *>;
+
+			/*!
+			 * @brief Retrieve the read vector containing the current readable audio
+			 * @note The returned views are owned by the \c RingBuffer and are valid until the next call
+			 * to this method or to Allocate().  This method may only be called from the reader thread.
+			 */
+			BufferListPair GetReadVector();
+
+			/*!
+			 * @brief Retrieve the write vector containing the current writeable space
+			 * @note The returned views are owned by the \c RingBuffer and are valid until the next call
+			 * to this method or to Allocate().  This method may only be called from the writer thread.
+			 */
+			BufferListPair GetWriteVector();
+
 			//@}
 
 		private:
 
+			void ClampViewFrameCounts(size_t& n1, size_t& n2) const;
+
+			// The assumed size of a cache line, in bytes
+			static constexpr size_t kCacheLineSize = 64;
+
 			AudioFormat			mFormat;				// The format of the audio
 
 			unsigned char		**mBuffers;				// The channel pointers and buffers, allocated in one chunk of memory
+			AudioBufferList		*mReadVector [2];		// Views returned by GetReadVector(), in the same chunk as mBuffers
+			AudioBufferList		*mWriteVector [2];		// Views returned by GetWriteVector(), in the same chunk as mBuffers
+			size_t				mAllocationSize;		// The size of the chunk containing mBuffers
 
 			size_t				mCapacityFrames;		// Frame capacity per channel
 			size_t				mCapacityFramesMask;
 
-			volatile size_t		mWritePointer;			// In frames
-			volatile size_t		mReadPointer;
+			bool				mIsMirrored;			// Whether each channel buffer is followed by a mirror of itself
+			bool				mIsPageAllocated;		// Whether the chunk was allocated with AllocatePages()
+			bool				mIsLocked;				// Whether the channel buffers are locked in physical memory
+
+			alignas(kCacheLineSize) std::atomic_size_t	mWritePointer;		// In frames
+			alignas(kCacheLineSize) std::atomic_size_t	mReadPointer;
 		};
 
 	}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <algorithm>
+
+#include "AudioBufferList.h"
+#include "AudioRingBuffer.h"
+#include "Benchmark.h"
+
+// ========================================
+// Split versus mirrored Audio::RingBuffer throughput
+// The ring buffer holds four chunks and starts at an odd offset so regularly spaced accesses straddle the end of the buffer
+// ========================================
+
+namespace {
+
+	const size_t kChunkFrames [] = { 64, 256, 1024, 4096, 16384 };
+	constexpr size_t kInitialOffsetFrames = 37;
+
+	SFB::Audio::AudioFormat GetFormat()
+	{
+		AudioStreamBasicDescription format = {
+			.mSampleRate			= 44100,
+			.mFormatID				= kAudioFormatLinearPCM,
+			.mFormatFlags			= kAudioFormatFlagsNativeFloatPacked | kAudioFormatFlagIsNonInterleaved,
+			.mBytesPerPacket		= 4,
+			.mFramesPerPacket		= 1,
+			.mBytesPerFrame			= 4,
+			.mChannelsPerFrame		= 2,
+			.mBitsPerChannel		= 32,
+			.mReserved				= 0
+		};
+		return format;
+	}
+
+	bool Prepare(SFB::Audio::RingBuffer& ringBuffer, size_t chunkFrames, int flags, SFB::Audio::BufferList& scratch)
+	{
+		if(!ringBuffer.Allocate(GetFormat(), 4 * chunkFrames, flags))
+			return false;
+
+		// Move the read and write pointers off the chunk boundaries
+		return kInitialOffsetFrames == ringBuffer.WriteAudio(scratch, kInitialOffsetFrames) && kInitialOffsetFrames == ringBuffer.ReadAudio(scratch, kInitialOffsetFrames);
+	}
+
+	// Fill or consume the first frameCount frames of the regions, as a decoder or the render callback would
+	float ProcessRegions(SFB::Audio::RingBuffer::BufferListPair regions, size_t frameCount, bool write, float value)
+	{
+		for(auto region : { regions.first, regions.second }) {
+			size_t regionFrames = std::min(frameCount, (size_t)region->mBuffers[0].mDataByteSize / sizeof(float));
+			for(UInt32 i = 0; i < region->mNumberBuffers; ++i) {
+				auto samples = static_cast<float *>(region->mBuffers[i].mData);
+				for(size_t j = 0; j < regionFrames; ++j) {
+					if(write)
+						samples[j] = value;
+					else
+						value += samples[j];
+				}
+			}
+			frameCount -= regionFrames;
+		}
+		return value;
+	}
+
+	void Measure(SFB::Benchmark::Context& context, int flags, bool vectors, const char *label)
+	{
+		for(auto chunkFrames : kChunkFrames) {
+			SFB::Audio::BufferList scratch(GetFormat(), (UInt32)chunkFrames);
+			SFB::Audio::RingBuffer ringBuffer;
+			if(!Prepare(ringBuffer, chunkFrames, flags, scratch)) {
+				context.Note(std::string("Unable to allocate ") + label + " ring buffer");
+				SFB_CHECK(context, !(flags & SFB::Audio::RingBuffer::MirrorMemory));
+				return;
+			}
+
+			size_t iterations = context.Iterations((256 * 1024 * 1024) / chunkFrames);
+			float sum = 0;
+
+			SFB::Benchmark::Stopwatch stopwatch;
+			for(size_t i = 0; i < iterations; ++i) {
+				if(vectors) {
+					ProcessRegions(ringBuffer.GetWriteVector(), chunkFrames, true, (float)i);
+					ringBuffer.WriteAdvance(chunkFrames);
+
+					sum = ProcessRegions(ringBuffer.GetReadVector(), chunkFrames, false, sum);
+					ringBuffer.ReadAdvance(chunkFrames);
+				}
+				else {
+					scratch.Reset();
+					static_cast<float *>(scratch->mBuffers[0].mData)[chunkFrames - 1] = (float)i;
+					ringBuffer.WriteAudio(scratch, chunkFrames);
+
+					scratch.Reset();
+					if(chunkFrames != ringBuffer.ReadAudio(scratch, chunkFrames) || (float)i != static_cast<float *>(scratch->mBuffers[0].mData)[chunkFrames - 1]) {
+						context.Fail(std::string(label) + " ring buffer returned the wrong audio", __FILE__, __LINE__);
+						return;
+					}
+				}
+			}
+			double seconds = stopwatch.GetElapsedSeconds();
+
+			// Keep the summation from being optimized away
+			if(sum < 0)
+				context.Note("");
+
+			context.Report(std::string(label) + ", " + (vectors ? "vectors" : "copies") + ", " + std::to_string(chunkFrames) + " frame chunks", (double)(iterations * chunkFrames) / seconds / 1e6, "Mframes/s");
+		}
+	}
+
+}
+
+SFB_BENCHMARK(AudioRingBufferSplitVersusMirrored)
+{
+	Measure(context, 0, false, "Split");
+	Measure(context, SFB::Audio::RingBuffer::MirrorMemory, false, "Mirrored");
+	Measure(context, 0, true, "Split");
+	Measure(context, SFB::Audio::RingBuffer::MirrorMemory, true, "Mirrored");
+}
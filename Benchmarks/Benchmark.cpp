@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+
+#include <sys/resource.h>
+
+#include "Benchmark.h"
+
+namespace {
+
+	std::vector<SFB::Benchmark::Registration::Entry>& GetRegistry()
+	{
+		static std::vector<SFB::Benchmark::Registration::Entry> sRegistry;
+		return sRegistry;
+	}
+
+}
+
+#pragma mark Context
+
+SFB::Benchmark::Context::Context(std::vector<std::string> fixtures, bool quick)
+	: mFixtures(std::move(fixtures)), mQuick(quick), mFailureCount(0)
+{}
+
+void SFB::Benchmark::Context::Report(const std::string& metric, double value, const std::string& unit)
+{
+	printf("  %-56s %14.3f %s\n", metric.c_str(), value, unit.c_str());
+	fflush(stdout);
+
+	mResults.push_back({mCurrentBenchmark, metric, value, unit});
+}
+
+void SFB::Benchmark::Context::Fail(const std::string& message, const char *file, int line)
+{
+	fprintf(stderr, "  FAILED %s:%d: %s\n", file, line, message.c_str());
+	++mFailureCount;
+}
+
+void SFB::Benchmark::Context::Note(const std::string& message)
+{
+	printf("  %s\n", message.c_str());
+	fflush(stdout);
+}
+
+#pragma mark Registration
+
+SFB::Benchmark::Registration::Registration(const char *name, Function function)
+{
+	GetRegistry().push_back({name, function});
+}
+
+std::vector<SFB::Benchmark::Registration::Entry> SFB::Benchmark::Registration::GetEntries()
+{
+	auto entries = GetRegistry();
+	std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+		return std::string(lhs.mName) < rhs.mName;
+	});
+	return entries;
+}
+
+#pragma mark Utilities
+
+double SFB::Benchmark::GetPercentile(std::vector<double> samples, double percentile)
+{
+	if(samples.empty())
+		return 0;
+
+	auto index = (size_t)std::lround((percentile / 100) * (samples.size() - 1));
+	std::nth_element(samples.begin(), samples.begin() + (ptrdiff_t)index, samples.end());
+	return samples[index];
+}
+
+size_t SFB::Benchmark::GetPeakResidentBytes()
+{
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage))
+		return 0;
+
+#if __APPLE__
+	return (size_t)usage.ru_maxrss;
+#else
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+double SFB::Benchmark::GetProcessCPUSeconds()
+{
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage))
+		return 0;
+
+	return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
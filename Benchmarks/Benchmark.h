@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/*! @file Benchmark.h @brief A minimal harness for benchmarks and regression checks */
+
+/*! @brief \c SFBAudioEngine's encompassing namespace */
+namespace SFB {
+
+	/*! @brief Benchmarks and regression checks run by the \c Benchmarks tool */
+	namespace Benchmark {
+
+		/*!
+		 * @brief The state of a benchmark run
+		 *
+		 * Benchmarks record measurements with Report() and failed expectations with Fail().
+		 * Measurements are printed as they are recorded and optionally written as JSON when the run ends.
+		 */
+		class Context
+		{
+		public:
+			/*! @brief A single measurement */
+			struct Result {
+				std::string		mBenchmark;		/*!< The name of the benchmark recording the measurement */
+				std::string		mMetric;		/*!< What was measured */
+				double			mValue;			/*!< The measured value */
+				std::string		mUnit;			/*!< The unit of \c mValue */
+			};
+
+			/*!
+			 * @brief Create a new \c Context
+			 * @param fixtures Paths to audio files used by benchmarks that decode
+			 * @param quick Whether benchmarks should use fewer iterations
+			 */
+			Context(std::vector<std::string> fixtures, bool quick);
+
+			/*! @brief Get the paths of the audio files supplied for the run */
+			inline const std::vector<std::string>& GetFixtures() const		{ return mFixtures; }
+
+			/*! @brief Query whether benchmarks should use fewer iterations */
+			inline bool IsQuick() const										{ return mQuick; }
+
+			/*! @brief Scale an iteration count, reducing it for quick runs */
+			inline size_t Iterations(size_t count) const					{ return mQuick ? (count + 9) / 10 : count; }
+
+			/*! @brief Record a measurement for the current benchmark */
+			void Report(const std::string& metric, double value, const std::string& unit);
+
+			/*! @brief Record a failed expectation for the current benchmark */
+			void Fail(const std::string& message, const char *file, int line);
+
+			/*! @brief Print a note for the current benchmark, such as why it was skipped */
+			void Note(const std::string& message);
+
+			/*! @brief Get the number of failed expectations */
+			inline size_t GetFailureCount() const							{ return mFailureCount; }
+
+			/*! @brief Get all measurements recorded so far */
+			inline const std::vector<Result>& GetResults() const			{ return mResults; }
+
+			/*! @cond */
+			// For use by the harness
+			inline void SetCurrentBenchmark(const std::string& name)		{ mCurrentBenchmark = name; }
+			/*! @endcond */
+
+		private:
+			std::vector<std::string>	mFixtures;
+			bool						mQuick;
+			std::string					mCurrentBenchmark;
+			std::vector<Result>			mResults;
+			size_t						mFailureCount;
+		};
+
+		/*! @brief A benchmark or regression check */
+		using Function = void (*)(Context& context);
+
+		/*! @brief Registers a benchmark when constructed; use \c SFB_BENCHMARK instead of this class directly */
+		class Registration
+		{
+		public:
+			/*! @brief A registered benchmark */
+			struct Entry {
+				const char		*mName;
+				Function		mFunction;
+			};
+
+			/*! @brief Register \c function under \c name */
+			Registration(const char *name, Function function);
+
+			/*! @brief Get all registered benchmarks, sorted by name */
+			static std::vector<Entry> GetEntries();
+		};
+
+		/*! @brief A monotonic stopwatch */
+		class Stopwatch
+		{
+		public:
+			/*! @brief Create a new \c Stopwatch and start it */
+			inline Stopwatch()												{ Restart(); }
+
+			/*! @brief Restart the stopwatch */
+			inline void Restart()											{ mStart = std::chrono::steady_clock::now(); }
+
+			/*! @brief Get the number of seconds elapsed since the stopwatch was started */
+			inline double GetElapsedSeconds() const							{ return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count(); }
+
+		private:
+			std::chrono::steady_clock::time_point mStart;
+		};
+
+		/*!
+		 * @brief Get a percentile of a set of samples
+		 * @param samples The samples, which need not be sorted
+		 * @param percentile The desired percentile in the range [0, 100]
+		 * @return The sample at \c percentile, or \c 0 if \c samples is empty
+		 */
+		double GetPercentile(std::vector<double> samples, double percentile);
+
+		/*! @brief Get the peak resident set size of the process in bytes */
+		size_t GetPeakResidentBytes();
+
+		/*! @brief Get the CPU time consumed by the process in seconds */
+		double GetProcessCPUSeconds();
+
+	}
+}
+
+/*!
+ * @brief Define and register a benchmark
+ * @param name The benchmark's identifier, which is also its name
+ */
+#define SFB_BENCHMARK(name) \
+	static void name(::SFB::Benchmark::Context& context); \
+	static ::SFB::Benchmark::Registration name##Registration(#name, name); \
+	static void name(::SFB::Benchmark::Context& context)
+
+/*! @brief Record a failure in \c context if \c condition is false */
+#define SFB_CHECK(context, condition) \
+	do { if(!(condition)) (context).Fail(#condition, __FILE__, __LINE__); } while(0)
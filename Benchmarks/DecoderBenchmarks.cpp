@@ -0,0 +1,917 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <set>
+#include <typeinfo>
+#include <vector>
+
+#include <dirent.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "AudioBufferList.h"
+#include "AudioDecoder.h"
+#include "Benchmark.h"
+#include "CFWrapper.h"
+#include "SeekIndexCache.h"
+
+// ========================================
+// Decoder benchmarks
+// Fixtures are loaded in memory before decoding so only decoding is measured
+// ========================================
+
+namespace {
+
+	const UInt32 kReadSizes [] = { 64, 512, 4096 };
+	constexpr UInt32 kSeekWindowFrames = 1024;
+
+	// Exposes the protected staging component
+	struct StagingAccess : public SFB::Audio::Decoder
+	{
+		using SFB::Audio::Decoder::StagingBuffer;
+	};
+
+	SFB::Audio::AudioFormat GetFloatFormat()
+	{
+		AudioStreamBasicDescription format = {
+			.mSampleRate			= 44100,
+			.mFormatID				= kAudioFormatLinearPCM,
+			.mFormatFlags			= kAudioFormatFlagsNativeFloatPacked | kAudioFormatFlagIsNonInterleaved,
+			.mBytesPerPacket		= 4,
+			.mFramesPerPacket		= 1,
+			.mBytesPerFrame			= 4,
+			.mChannelsPerFrame		= 2,
+			.mBitsPerChannel		= 32,
+			.mReserved				= 0
+		};
+		return format;
+	}
+
+	std::string GetFileName(const std::string& path)
+	{
+		return path.substr(path.find_last_of('/') + 1);
+	}
+
+	SFB::Audio::Decoder::unique_ptr OpenDecoder(const std::string& path)
+	{
+		SFB::CFURL url(CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault, (const UInt8 *)path.c_str(), (CFIndex)path.size(), false));
+		if(!url)
+			return nullptr;
+
+		auto inputSource = SFB::InputSource::CreateForURL(url, SFB::InputSource::LoadFilesInMemory);
+		if(!inputSource)
+			return nullptr;
+
+		auto decoder = SFB::Audio::Decoder::CreateForInputSource(std::move(inputSource));
+		if(!decoder || !decoder->Open())
+			return nullptr;
+
+		return decoder;
+	}
+
+	// FNV-1a, used to verify that reads of different sizes produce the same audio
+	void UpdateDigest(uint64_t& digest, const AudioBufferList *bufferList)
+	{
+		for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex) {
+			auto bytes = static_cast<const uint8_t *>(bufferList->mBuffers[bufferIndex].mData);
+			for(UInt32 i = 0; i < bufferList->mBuffers[bufferIndex].mDataByteSize; ++i)
+				digest = (digest ^ bytes[i]) * 0x100000001b3ull;
+		}
+	}
+
+	/*!
+	 * Decode to the end in reads of \c frameCount frames
+	 * @param digest If not \c nullptr, receives a digest of the decoded audio
+	 * @return The number of frames decoded
+	 */
+	UInt64 DecodeAll(SFB::Audio::Decoder& decoder, UInt32 frameCount, uint64_t *digest = nullptr)
+	{
+		SFB::Audio::BufferList bufferList(decoder.GetFormat(), frameCount);
+
+		UInt64 framesDecoded = 0;
+		for(;;) {
+			bufferList.Reset();
+			UInt32 framesRead = decoder.ReadAudio(bufferList, frameCount);
+			if(0 == framesRead)
+				break;
+			if(digest)
+				UpdateDigest(*digest, bufferList);
+			framesDecoded += framesRead;
+		}
+
+		return framesDecoded;
+	}
+
+	/*!
+	 * Decode to the end in batches of \c batchSize reads of \c frameCount frames
+	 * @param digest If not \c nullptr, receives a digest of the decoded audio
+	 * @return The number of frames decoded
+	 */
+	UInt64 DecodeAllBatched(SFB::Audio::Decoder& decoder, UInt32 frameCount, size_t batchSize, uint64_t *digest = nullptr)
+	{
+		std::vector<std::unique_ptr<SFB::Audio::BufferList>> buffers;
+		std::vector<AudioBufferList *> bufferLists;
+		for(size_t i = 0; i < batchSize; ++i) {
+			buffers.push_back(std::unique_ptr<SFB::Audio::BufferList>(new SFB::Audio::BufferList(decoder.GetFormat(), frameCount)));
+			bufferLists.push_back(*buffers.back());
+		}
+		std::vector<UInt32> frameCounts(batchSize, frameCount);
+
+		UInt64 framesDecoded = 0;
+		for(;;) {
+			for(auto& buffer : buffers)
+				buffer->Reset();
+			UInt64 framesRead = decoder.ReadAudioBatch(bufferLists.data(), frameCounts.data(), batchSize);
+			if(0 == framesRead)
+				break;
+
+			// Buffers following a short read are untouched
+			if(digest) {
+				for(size_t i = 0; i < batchSize && i * frameCount < framesRead; ++i)
+					UpdateDigest(*digest, bufferLists[i]);
+			}
+
+			framesDecoded += framesRead;
+			if(framesRead < frameCount * batchSize)
+				break;
+		}
+
+		return framesDecoded;
+	}
+
+	// Consume audio pushed in codecFrames-frame blocks with readFrames-frame reads, as a push-model decoder does
+	// With memmove the leftover audio is moved to the front after every read, as decoders did before StagingBuffer
+	bool Stage(UInt32 codecFrames, UInt32 readFrames, UInt64 frameCount, bool memmove, double& seconds)
+	{
+		auto format = GetFloatFormat();
+
+		StagingAccess::StagingBuffer staging;
+		SFB::Audio::BufferList legacy;
+		SFB::Audio::BufferList destination;
+		if(!staging.Allocate(format, codecFrames) || !legacy.Allocate(format, codecFrames) || !destination.Allocate(format, readFrames))
+			return false;
+
+		UInt32 legacyFrames = 0;
+		float nextSample = 0, expectedSample = 0;
+		bool intact = true;
+
+		SFB::Benchmark::Stopwatch stopwatch;
+		for(UInt64 framesRead = 0; framesRead < frameCount; ) {
+			// Push a codec frame once the staged audio is exhausted
+			if(0 == (memmove ? legacyFrames : staging.GetFramesAvailable())) {
+				AudioBufferList *buffers = legacy;
+				if(!memmove)
+					buffers = staging.GetWriteBuffers(codecFrames);
+				for(UInt32 bufferIndex = 0; bufferIndex < buffers->mNumberBuffers; ++bufferIndex) {
+					auto samples = static_cast<float *>(buffers->mBuffers[bufferIndex].mData);
+					for(UInt32 i = 0; i < codecFrames; ++i)
+						samples[i] = nextSample + i;
+				}
+				nextSample += codecFrames;
+				if(memmove)
+					legacyFrames = codecFrames;
+				else
+					staging.CommitWrite(codecFrames);
+			}
+
+			destination.Reset();
+			UInt32 framesCopied;
+			if(memmove) {
+				framesCopied = std::min(readFrames, legacyFrames);
+				size_t byteCount = format.FrameCountToByteCount(framesCopied);
+				size_t byteCountRemaining = format.FrameCountToByteCount(legacyFrames - framesCopied);
+				for(UInt32 bufferIndex = 0; bufferIndex < legacy->mNumberBuffers; ++bufferIndex) {
+					auto data = static_cast<uint8_t *>(legacy->mBuffers[bufferIndex].mData);
+					memcpy(destination->mBuffers[bufferIndex].mData, data, byteCount);
+					::memmove(data, data + byteCount, byteCountRemaining);
+				}
+				legacyFrames -= framesCopied;
+			}
+			else
+				framesCopied = staging.ReadAudio(destination, 0, readFrames);
+
+			// Spot check the first and last frames copied
+			auto samples = static_cast<const float *>(destination->mBuffers[1].mData);
+			if(samples[0] != expectedSample || samples[framesCopied - 1] != expectedSample + framesCopied - 1)
+				intact = false;
+			expectedSample += framesCopied;
+
+			framesRead += framesCopied;
+		}
+		seconds = stopwatch.GetElapsedSeconds();
+
+		return intact;
+	}
+
+	// Decode path from the start, saving the kSeekWindowFrames frames following each target
+	// Each window holds the audio for each buffer in turn
+	bool DecodeWindows(const std::string& path, const std::vector<SInt64>& targets, std::vector<std::vector<uint8_t>>& windows)
+	{
+		auto decoder = OpenDecoder(path);
+		if(!decoder)
+			return false;
+
+		size_t bytesPerFrame = decoder->GetFormat().FrameCountToByteCount(1);
+		SFB::Audio::BufferList bufferList(decoder->GetFormat(), 4096);
+		windows.assign(targets.size(), std::vector<uint8_t>(bufferList->mNumberBuffers * kSeekWindowFrames * bytesPerFrame));
+
+		SInt64 frame = 0;
+		for(;;) {
+			bufferList.Reset();
+			UInt32 framesRead = decoder->ReadAudio(bufferList, 4096);
+			if(0 == framesRead)
+				break;
+
+			for(size_t i = 0; i < targets.size(); ++i) {
+				SInt64 begin = std::max(frame, targets[i]);
+				SInt64 end = std::min(frame + framesRead, targets[i] + kSeekWindowFrames);
+				if(begin >= end)
+					continue;
+
+				for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex)
+					memcpy(windows[i].data() + (bufferIndex * kSeekWindowFrames + (size_t)(begin - targets[i])) * bytesPerFrame,
+						   static_cast<const uint8_t *>(bufferList->mBuffers[bufferIndex].mData) + (size_t)(begin - frame) * bytesPerFrame,
+						   (size_t)(end - begin) * bytesPerFrame);
+			}
+
+			frame += framesRead;
+		}
+
+		return true;
+	}
+
+	// Seek to each target and return the number of seeks whose audio matches windows exactly
+	size_t CountAccurateSeeks(SFB::Audio::Decoder& decoder, const std::vector<SInt64>& targets, const std::vector<std::vector<uint8_t>>& windows, std::vector<double>& latencies)
+	{
+		size_t bytesPerFrame = decoder.GetFormat().FrameCountToByteCount(1);
+		SFB::Audio::BufferList bufferList(decoder.GetFormat(), kSeekWindowFrames);
+
+		size_t accurateSeeks = 0;
+		for(size_t i = 0; i < targets.size(); ++i) {
+			SFB::Benchmark::Stopwatch stopwatch;
+			SInt64 frame = decoder.SeekToFrame(targets[i]);
+			latencies.push_back(1e3 * stopwatch.GetElapsedSeconds());
+
+			bufferList.Reset();
+			if(frame != targets[i] || kSeekWindowFrames != decoder.ReadAudio(bufferList, kSeekWindowFrames))
+				continue;
+
+			bool accurate = true;
+			for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex) {
+				if(memcmp(bufferList->mBuffers[bufferIndex].mData, windows[i].data() + bufferIndex * kSeekWindowFrames * bytesPerFrame, kSeekWindowFrames * bytesPerFrame))
+					accurate = false;
+			}
+			if(accurate)
+				++accurateSeeks;
+		}
+
+		return accurateSeeks;
+	}
+
+	// Directs the seek index cache to an empty temporary directory while in scope
+	class TemporarySeekIndexCache
+	{
+	public:
+		TemporarySeekIndexCache()
+			: mWasEnabled(SFB::Audio::SeekIndexCache::IsEnabled()), mIsValid(false)
+		{
+			strcpy(mDirectory, "/tmp/SFBSeekIndexCache.XXXXXX");
+			if(!mkdtemp(mDirectory))
+				return;
+
+			SFB::CFURL url(CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault, (const UInt8 *)mDirectory, (CFIndex)strlen(mDirectory), true));
+			mIsValid = SFB::Audio::SeekIndexCache::SetDirectory(url);
+		}
+
+		~TemporarySeekIndexCache()
+		{
+			SFB::Audio::SeekIndexCache::SetEnabled(mWasEnabled);
+			SFB::Audio::SeekIndexCache::SetDirectory(nullptr);
+
+			if(DIR *dir = opendir(mDirectory)) {
+				while(struct dirent *dirent = readdir(dir)) {
+					if(strcmp(dirent->d_name, ".") && strcmp(dirent->d_name, ".."))
+						unlink((std::string(mDirectory) + "/" + dirent->d_name).c_str());
+				}
+				closedir(dir);
+			}
+			rmdir(mDirectory);
+		}
+
+		inline bool IsValid() const		{ return mIsValid; }
+
+	private:
+		char mDirectory [32];
+		bool mWasEnabled;
+		bool mIsValid;
+	};
+
+	struct AccessCounts
+	{
+		uint64_t mSeekCount = 0;
+		uint64_t mReadCount = 0;
+	};
+
+	// Forwards to another input source, counting seeks and reads
+	// If url is not nullptr it is reported instead of the other input source's, to mislabel it
+	class CountingInputSource : public SFB::InputSource
+	{
+	public:
+		explicit CountingInputSource(SFB::InputSource::unique_ptr inputSource, CFURLRef url = nullptr)
+			: SFB::InputSource(url ? url : inputSource->GetURL()), mInputSource(std::move(inputSource)), mCounts(std::make_shared<AccessCounts>())
+		{}
+
+		inline uint64_t GetSeekCount() const		{ return mCounts->mSeekCount; }
+		inline uint64_t GetReadCount() const		{ return mCounts->mReadCount; }
+		inline void ResetCounts()					{ *mCounts = AccessCounts(); }
+
+		// The counts outlive the input source, which a decoder factory destroys when no decoder handles it
+		inline std::shared_ptr<const AccessCounts> GetCounts() const	{ return mCounts; }
+
+	private:
+		virtual bool _Open(CFErrorRef *error)					{ return mInputSource->Open(error); }
+		virtual bool _Close(CFErrorRef *error)					{ return mInputSource->Close(error); }
+		virtual SInt64 _Read(void *buffer, SInt64 byteCount)	{ ++mCounts->mReadCount; return mInputSource->Read(buffer, byteCount); }
+		virtual bool _AtEOF() const								{ return mInputSource->AtEOF(); }
+		virtual SInt64 _GetOffset() const						{ return mInputSource->GetOffset(); }
+		virtual SInt64 _GetLength() const						{ return mInputSource->GetLength(); }
+		virtual bool _SupportsSeeking() const					{ return mInputSource->SupportsSeeking(); }
+		virtual bool _SeekToOffset(SInt64 offset)				{ ++mCounts->mSeekCount; return mInputSource->SeekToOffset(offset); }
+
+		SFB::InputSource::unique_ptr mInputSource;
+		std::shared_ptr<AccessCounts> mCounts;
+	};
+
+	std::string GetExtension(const std::string& path)
+	{
+		auto extension = path.substr(path.find_last_of("./") + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		return extension;
+	}
+
+	// Load path in memory so opening the decoder doesn't include file I/O
+	SFB::InputSource::unique_ptr OpenInMemoryInputSource(const std::string& path)
+	{
+		SFB::CFURL url(CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault, (const UInt8 *)path.c_str(), (CFIndex)path.size(), false));
+		if(!url)
+			return nullptr;
+
+		auto inputSource = SFB::InputSource::CreateForURL(url, SFB::InputSource::LoadFilesInMemory);
+		if(!inputSource || !inputSource->Open())
+			return nullptr;
+
+		return inputSource;
+	}
+
+	bool HasExtension(const std::string& path, std::initializer_list<const char *> extensions)
+	{
+		auto extension = path.substr(path.find_last_of("./") + 1);
+		for(auto candidate : extensions) {
+			if(0 == strcasecmp(extension.c_str(), candidate))
+				return true;
+		}
+		return false;
+	}
+
+}
+
+SFB_BENCHMARK(DecoderStagingBuffer)
+{
+	// The largest MP3 frame and the largest FLAC block
+	for(UInt32 codecFrames : { 1152u, 65535u }) {
+		for(auto readFrames : kReadSizes) {
+			UInt64 frameCount = context.Iterations(50 * 1024 * 1024);
+			for(bool memmove : { true, false }) {
+				double seconds;
+				SFB_CHECK(context, Stage(codecFrames, readFrames, frameCount, memmove, seconds));
+				context.Report(std::to_string(codecFrames) + " frame blocks, " + std::to_string(readFrames) + " frame reads, " + (memmove ? "memmove" : "StagingBuffer"), (double)frameCount / seconds / 1e6, "Mframes/s");
+			}
+		}
+	}
+}
+
+SFB_BENCHMARK(DecoderReadSizeThroughput)
+{
+	if(context.GetFixtures().empty()) {
+		context.Note("No fixtures; skipped");
+		return;
+	}
+
+	for(const auto& path : context.GetFixtures()) {
+		UInt64 expectedFrames = 0;
+		uint64_t expectedDigest = 0;
+
+		for(auto readFrames : kReadSizes) {
+			auto decoder = OpenDecoder(path);
+			if(!decoder) {
+				context.Note("Unable to open " + path + "; skipped");
+				break;
+			}
+
+			SFB::Benchmark::Stopwatch stopwatch;
+			UInt64 framesDecoded = DecodeAll(*decoder, readFrames);
+			double seconds = stopwatch.GetElapsedSeconds();
+
+			context.Report(GetFileName(path) + ", " + std::to_string(readFrames) + " frame reads", (double)framesDecoded / seconds / 1e6, "Mframes/s");
+
+			// The staged audio must not depend on the read size
+			decoder = OpenDecoder(path);
+			uint64_t digest = 0xcbf29ce484222325ull;
+			SFB_CHECK(context, decoder && framesDecoded == DecodeAll(*decoder, readFrames, &digest));
+			if(readFrames == kReadSizes[0]) {
+				expectedFrames = framesDecoded;
+				expectedDigest = digest;
+			}
+			else
+				SFB_CHECK(context, expectedFrames == framesDecoded && expectedDigest == digest);
+		}
+	}
+}
+
+SFB_BENCHMARK(DecoderReadAudioBatch)
+{
+	if(context.GetFixtures().empty()) {
+		context.Note("No fixtures; skipped");
+		return;
+	}
+
+	constexpr size_t batchSize = 16;
+
+	for(const auto& path : context.GetFixtures()) {
+		for(auto readFrames : kReadSizes) {
+			auto decoder = OpenDecoder(path);
+			auto batchDecoder = OpenDecoder(path);
+			if(!decoder || !batchDecoder) {
+				context.Note("Unable to open " + path + "; skipped");
+				break;
+			}
+
+			SFB::Benchmark::Stopwatch stopwatch;
+			UInt64 framesDecoded = DecodeAll(*decoder, readFrames);
+			double seconds = stopwatch.GetElapsedSeconds();
+
+			stopwatch.Restart();
+			UInt64 batchFramesDecoded = DecodeAllBatched(*batchDecoder, readFrames, batchSize);
+			double batchSeconds = stopwatch.GetElapsedSeconds();
+
+			auto label = GetFileName(path) + ", " + std::to_string(readFrames) + " frame reads";
+			context.Report(label + ", ReadAudio", (double)framesDecoded / seconds / 1e6, "Mframes/s");
+			context.Report(label + ", ReadAudioBatch of " + std::to_string(batchSize), (double)batchFramesDecoded / batchSeconds / 1e6, "Mframes/s");
+			context.Report(label + ", batch speedup", seconds / batchSeconds, "x");
+
+			// Batching must not change the decoded audio
+			decoder = OpenDecoder(path);
+			batchDecoder = OpenDecoder(path);
+			uint64_t digest = 0xcbf29ce484222325ull, batchDigest = digest;
+			SFB_CHECK(context, decoder && batchDecoder);
+			if(decoder && batchDecoder)
+				SFB_CHECK(context, DecodeAll(*decoder, readFrames, &digest) == DecodeAllBatched(*batchDecoder, readFrames, batchSize, &batchDigest) && digest == batchDigest);
+		}
+	}
+}
+
+SFB_BENCHMARK(DecoderSeekIndexCache)
+{
+	if(context.GetFixtures().empty()) {
+		context.Note("No fixtures; skipped");
+		return;
+	}
+
+	// Use an empty cache so the first open of each fixture scans
+	TemporarySeekIndexCache cache;
+	if(!cache.IsValid()) {
+		context.Fail("Unable to create cache directory", __FILE__, __LINE__);
+		return;
+	}
+
+	std::mt19937 generator(1);
+
+	for(const auto& path : context.GetFixtures()) {
+		auto label = GetFileName(path);
+
+		SFB::Audio::SeekIndexCache::SetEnabled(false);
+
+		SFB::Benchmark::Stopwatch stopwatch;
+		auto decoder = OpenDecoder(path);
+		double uncachedOpen = stopwatch.GetElapsedSeconds();
+
+		if(!decoder) {
+			context.Note("Unable to open " + path + "; skipped");
+			continue;
+		}
+
+		SInt64 totalFrames = decoder->GetTotalFrames();
+		if(!decoder->SupportsSeeking() || !decoder->GetFormat().IsPCM() || kSeekWindowFrames >= totalFrames) {
+			context.Note(path + " is not seekable PCM; skipped");
+			continue;
+		}
+
+		std::uniform_int_distribution<SInt64> distribution(0, totalFrames - kSeekWindowFrames);
+		std::vector<SInt64> targets(context.Iterations(50));
+		for(auto& target : targets)
+			target = distribution(generator);
+
+		std::vector<std::vector<uint8_t>> windows;
+		if(!DecodeWindows(path, targets, windows)) {
+			context.Note("Unable to decode " + path + "; skipped");
+			continue;
+		}
+
+		std::vector<double> uncachedLatencies;
+		size_t uncachedAccurateSeeks = CountAccurateSeeks(*decoder, targets, windows, uncachedLatencies);
+
+		// Decoders that index while decoding store the index on close
+		SFB::Audio::SeekIndexCache::SetEnabled(true);
+		decoder = OpenDecoder(path);
+		if(decoder) {
+			DecodeAll(*decoder, 4096);
+			decoder->Close();
+		}
+
+		stopwatch.Restart();
+		decoder = OpenDecoder(path);
+		double cachedOpen = stopwatch.GetElapsedSeconds();
+
+		if(!decoder) {
+			context.Fail("Unable to reopen " + path, __FILE__, __LINE__);
+			continue;
+		}
+
+		std::vector<double> cachedLatencies;
+		size_t cachedAccurateSeeks = CountAccurateSeeks(*decoder, targets, windows, cachedLatencies);
+
+		context.Report(label + ", open without cache", 1e3 * uncachedOpen, "ms");
+		context.Report(label + ", open with cache", 1e3 * cachedOpen, "ms");
+		context.Report(label + ", seek p50 without cache", SFB::Benchmark::GetPercentile(uncachedLatencies, 50), "ms");
+		context.Report(label + ", seek p50 with cache", SFB::Benchmark::GetPercentile(cachedLatencies, 50), "ms");
+		context.Report(label + ", accurate seeks without cache", 100.0 * uncachedAccurateSeeks / targets.size(), "%");
+		context.Report(label + ", accurate seeks with cache", 100.0 * cachedAccurateSeeks / targets.size(), "%");
+
+		// A cached index must be as good as a fresh scan
+		SFB_CHECK(context, cachedAccurateSeeks >= uncachedAccurateSeeks);
+	}
+}
+
+SFB_BENCHMARK(FLACSeekInputSourceAccesses)
+{
+	if(context.GetFixtures().empty()) {
+		context.Note("No fixtures; skipped");
+		return;
+	}
+
+	TemporarySeekIndexCache cache;
+	if(!cache.IsValid()) {
+		context.Fail("Unable to create cache directory", __FILE__, __LINE__);
+		return;
+	}
+
+	std::mt19937 generator(1);
+
+	for(const auto& path : context.GetFixtures()) {
+		if(!HasExtension(path, { "flac" }))
+			continue;
+
+		auto label = GetFileName(path);
+
+		// Build the index with a full decode so the second pass seeks with a complete index
+		SFB::Audio::SeekIndexCache::SetEnabled(true);
+		auto decoder = OpenDecoder(path);
+		if(!decoder || !decoder->SupportsSeeking() || 0 >= decoder->GetTotalFrames()) {
+			context.Note("Unable to seek in " + path + "; skipped");
+			continue;
+		}
+
+		std::uniform_int_distribution<SInt64> distribution(0, decoder->GetTotalFrames() - 1);
+		DecodeAll(*decoder, 4096);
+		decoder->Close();
+
+		std::vector<SInt64> targets(context.Iterations(50));
+		for(auto& target : targets)
+			target = distribution(generator);
+
+		double meanSeeks [2];
+		for(bool useIndex : { false, true }) {
+			// Without the cache a new decoder knows only the offset of the first frame and bisects
+			SFB::Audio::SeekIndexCache::SetEnabled(useIndex);
+
+			SFB::CFURL url(CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault, (const UInt8 *)path.c_str(), (CFIndex)path.size(), false));
+			auto inputSource = SFB::InputSource::CreateForURL(url, SFB::InputSource::LoadFilesInMemory);
+			if(!inputSource)
+				break;
+
+			auto countingInputSource = new CountingInputSource(std::move(inputSource));
+			decoder = SFB::Audio::Decoder::CreateForInputSource(SFB::InputSource::unique_ptr(countingInputSource));
+			if(!decoder || !decoder->Open()) {
+				context.Fail("Unable to reopen " + path, __FILE__, __LINE__);
+				break;
+			}
+
+			std::vector<double> seeks, reads, latencies;
+			for(auto target : targets) {
+				countingInputSource->ResetCounts();
+
+				SFB::Benchmark::Stopwatch stopwatch;
+				SFB_CHECK(context, target == decoder->SeekToFrame(target));
+				latencies.push_back(1e3 * stopwatch.GetElapsedSeconds());
+
+				seeks.push_back((double)countingInputSource->GetSeekCount());
+				reads.push_back((double)countingInputSource->GetReadCount());
+			}
+
+			meanSeeks[useIndex] = 0;
+			for(auto count : seeks)
+				meanSeeks[useIndex] += count / seeks.size();
+
+			std::string suffix = useIndex ? " with index" : " without index";
+			context.Report(label + ", SeekToOffset calls per seek" + suffix, meanSeeks[useIndex], "calls");
+			context.Report(label + ", SeekToOffset calls per seek p99" + suffix, SFB::Benchmark::GetPercentile(seeks, 99), "calls");
+			context.Report(label + ", reads per seek p50" + suffix, SFB::Benchmark::GetPercentile(reads, 50), "calls");
+			context.Report(label + ", seek p50" + suffix, SFB::Benchmark::GetPercentile(latencies, 50), "ms");
+
+			if(useIndex)
+				SFB_CHECK(context, meanSeeks[1] <= meanSeeks[0]);
+		}
+	}
+}
+
+SFB_BENCHMARK(MODSeekLatency)
+{
+	if(context.GetFixtures().empty()) {
+		context.Note("No fixtures; skipped");
+		return;
+	}
+
+	for(const auto& path : context.GetFixtures()) {
+		if(!HasExtension(path, { "it", "xm", "s3m", "mod" }))
+			continue;
+
+		auto label = GetFileName(path);
+
+		auto decoder = OpenDecoder(path);
+		if(!decoder || !decoder->SupportsSeeking()) {
+			context.Note("Unable to seek in " + path + "; skipped");
+			continue;
+		}
+
+		// DUMB saves a renderer checkpoint every 30 seconds when loading a module, and a seek renders
+		// from the nearest preceding checkpoint, so seek time grows with the distance past a checkpoint
+		// and the interval bounds the worst case
+		SInt64 totalFrames = decoder->GetTotalFrames();
+		SInt64 checkpointInterval = 30 * (SInt64)decoder->GetFormat().mSampleRate;
+		if(checkpointInterval >= totalFrames) {
+			context.Note(path + " is shorter than the checkpoint interval; skipped");
+			continue;
+		}
+
+		// The last checkpoint followed by a complete interval
+		SInt64 checkpoint = ((totalFrames - checkpointInterval) / checkpointInterval) * checkpointInterval;
+
+		for(auto fraction : { 0.0, 0.25, 0.5, 0.75, 0.99 }) {
+			SInt64 target = checkpoint + (SInt64)(fraction * checkpointInterval);
+
+			std::vector<double> latencies;
+			for(size_t i = 0; i < context.Iterations(10); ++i) {
+				// Seek away from the target so each timed seek starts a new renderer
+				SFB_CHECK(context, 0 == decoder->SeekToFrame(0));
+
+				SFB::Benchmark::Stopwatch stopwatch;
+				SInt64 frame = decoder->SeekToFrame(target);
+				latencies.push_back(1e3 * stopwatch.GetElapsedSeconds());
+
+				SFB_CHECK(context, target == frame);
+			}
+
+			char offset [32];
+			snprintf(offset, sizeof(offset), "%.1f", fraction * 30);
+			context.Report(label + ", seek " + offset + " s past checkpoint at " + std::to_string(checkpoint / checkpointInterval * 30) + " s p50", SFB::Benchmark::GetPercentile(latencies, 50), "ms");
+		}
+
+		// Rendering from the start of the module, as seeking did before checkpoints were used
+		decoder = OpenDecoder(path);
+		if(!decoder)
+			continue;
+
+		SInt64 target = checkpoint + checkpointInterval / 2;
+		SFB::Audio::BufferList bufferList(decoder->GetFormat(), 4096);
+
+		SFB::Benchmark::Stopwatch stopwatch;
+		for(SInt64 frame = 0; frame < target; ) {
+			bufferList.Reset();
+			UInt32 framesRead = decoder->ReadAudio(bufferList, (UInt32)std::min((SInt64)4096, target - frame));
+			if(0 == framesRead)
+				break;
+			frame += framesRead;
+		}
+		context.Report(label + ", render from start to " + std::to_string(target / (SInt64)decoder->GetFormat().mSampleRate) + " s", 1e3 * stopwatch.GetElapsedSeconds(), "ms");
+	}
+}
+
+SFB_BENCHMARK(DecoderPerformance)
+{
+	if(context.GetFixtures().empty()) {
+		context.Note("No fixtures; skipped");
+		return;
+	}
+
+	// List the formats the registered decoders handle that have no fixture
+	SFB::CFArray supportedExtensions(SFB::Audio::Decoder::CreateSupportedFileExtensions());
+	if(supportedExtensions) {
+		std::string missing;
+		for(CFIndex i = 0; i < CFArrayGetCount(supportedExtensions); ++i) {
+			char extension [32];
+			if(!CFStringGetCString((CFStringRef)CFArrayGetValueAtIndex(supportedExtensions, i), extension, sizeof(extension), kCFStringEncodingUTF8))
+				continue;
+
+			std::string lowercase = GetExtension(std::string(".") + extension);
+			if(std::none_of(context.GetFixtures().begin(), context.GetFixtures().end(), [&lowercase](const std::string& path) { return GetExtension(path) == lowercase; }))
+				missing += " " + lowercase;
+		}
+
+		if(!missing.empty())
+			context.Note("No fixtures for:" + missing);
+	}
+
+	std::mt19937 generator(1);
+
+	for(const auto& path : context.GetFixtures()) {
+		// Fixtures are labeled by format, which is taken from the extension
+		auto label = GetExtension(path) + " (" + GetFileName(path) + ")";
+
+		// Open latency excludes loading the file, which is done once per iteration beforehand
+		std::vector<double> openLatencies;
+		for(size_t i = 0; i < context.Iterations(20); ++i) {
+			auto inputSource = OpenInMemoryInputSource(path);
+			if(!inputSource)
+				break;
+
+			SFB::Benchmark::Stopwatch stopwatch;
+			auto decoder = SFB::Audio::Decoder::CreateForInputSource(std::move(inputSource));
+			bool opened = decoder && decoder->Open();
+			double seconds = stopwatch.GetElapsedSeconds();
+			if(!opened)
+				break;
+
+			openLatencies.push_back(1e3 * seconds);
+		}
+
+		if(openLatencies.empty()) {
+			context.Note("Unable to open " + path + "; skipped");
+			continue;
+		}
+
+		context.Report(label + " open p50", SFB::Benchmark::GetPercentile(openLatencies, 50), "ms");
+		context.Report(label + " open p99", SFB::Benchmark::GetPercentile(openLatencies, 99), "ms");
+
+		// Throughput and CPU cost of decoding the whole file
+		auto decoder = OpenDecoder(path);
+		SFB_CHECK(context, decoder);
+		if(!decoder)
+			continue;
+
+		double sampleRate = decoder->GetFormat().mSampleRate;
+
+		double cpuSeconds = SFB::Benchmark::GetProcessCPUSeconds();
+		SFB::Benchmark::Stopwatch stopwatch;
+		UInt64 framesDecoded = DecodeAll(*decoder, 4096);
+		double seconds = stopwatch.GetElapsedSeconds();
+		cpuSeconds = SFB::Benchmark::GetProcessCPUSeconds() - cpuSeconds;
+
+		if(0 == framesDecoded || 0 >= sampleRate) {
+			context.Fail(path + " decoded no audio", __FILE__, __LINE__);
+			continue;
+		}
+
+		context.Report(label + " throughput", (double)framesDecoded / seconds / 1e6, "Mframes/s");
+		context.Report(label + " CPU per second of audio", 1e3 * cpuSeconds / ((double)framesDecoded / sampleRate), "ms");
+
+		// The peak is for the process, so it only grows; fixtures are decoded in the order given
+		context.Report(label + " peak RSS", (double)SFB::Benchmark::GetPeakResidentBytes() / (1024 * 1024), "MiB");
+
+		// Seek latency includes decoding the first audio at the new position
+		if(!decoder->SupportsSeeking()) {
+			context.Note(path + " is not seekable; seek latency skipped");
+			continue;
+		}
+
+		std::uniform_int_distribution<SInt64> distribution(0, (SInt64)framesDecoded - 1);
+		SFB::Audio::BufferList bufferList(decoder->GetFormat(), kSeekWindowFrames);
+		std::vector<double> seekLatencies;
+		for(size_t i = 0; i < context.Iterations(100); ++i) {
+			SInt64 frame = distribution(generator);
+
+			stopwatch.Restart();
+			bufferList.Reset();
+			bool seeked = frame == decoder->SeekToFrame(frame) && 0 < decoder->ReadAudio(bufferList, kSeekWindowFrames);
+			double seekSeconds = stopwatch.GetElapsedSeconds();
+
+			if(!seeked) {
+				context.Fail("Seek in " + path + " failed", __FILE__, __LINE__);
+				break;
+			}
+
+			seekLatencies.push_back(1e3 * seekSeconds);
+		}
+
+		if(!seekLatencies.empty()) {
+			context.Report(label + " seek p50", SFB::Benchmark::GetPercentile(seekLatencies, 50), "ms");
+			context.Report(label + " seek p99", SFB::Benchmark::GetPercentile(seekLatencies, 99), "ms");
+		}
+	}
+}
+
+SFB_BENCHMARK(DecoderProbeMislabelled)
+{
+	if(context.GetFixtures().empty()) {
+		context.Note("No fixtures; skipped");
+		return;
+	}
+
+	// Label every fixture with its own extension, every other fixture's and one no decoder handles,
+	// as a library scan would encounter them
+	std::set<std::string> extensions = { "bin" };
+	for(const auto& path : context.GetFixtures())
+		extensions.insert(GetExtension(path));
+
+	struct Statistics
+	{
+		std::vector<double> mLatencies;
+		uint64_t mSeekCount = 0;
+		uint64_t mReadCount = 0;
+		size_t mOpened = 0;
+	};
+
+	Statistics correct, mislabelled;
+
+	for(size_t iteration = 0; iteration < context.Iterations(5); ++iteration) {
+		for(const auto& path : context.GetFixtures()) {
+			auto stem = path.substr(0, path.find_last_of('.'));
+			const std::type_info *expectedType = nullptr;
+
+			// The correctly labeled file is scanned first to learn which decoder handles it
+			std::vector<std::string> labels = { GetExtension(path) };
+			for(const auto& extension : extensions) {
+				if(extension != labels.front())
+					labels.push_back(extension);
+			}
+
+			for(const auto& extension : labels) {
+				auto inputSource = OpenInMemoryInputSource(path);
+				if(!inputSource)
+					break;
+
+				auto label = stem + "." + extension;
+				SFB::CFURL url(CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault, (const UInt8 *)label.c_str(), (CFIndex)label.size(), false));
+				auto countingInputSource = new CountingInputSource(std::move(inputSource), url);
+				auto counts = countingInputSource->GetCounts();
+				SFB::InputSource::unique_ptr countedInputSource(countingInputSource);
+
+				SFB::CFError error;
+				SFB::Benchmark::Stopwatch stopwatch;
+				auto decoder = SFB::Audio::Decoder::CreateForInputSource(std::move(countedInputSource), &error);
+				double seconds = stopwatch.GetElapsedSeconds();
+
+				bool isCorrect = extension == labels.front();
+				auto& statistics = isCorrect ? correct : mislabelled;
+				statistics.mLatencies.push_back(1e3 * seconds);
+				statistics.mSeekCount += counts->mSeekCount;
+				statistics.mReadCount += counts->mReadCount;
+
+				if(!decoder) {
+					// A failure must be explained
+					SFB_CHECK(context, error);
+					if(isCorrect)
+						break;
+					continue;
+				}
+
+				++statistics.mOpened;
+				if(isCorrect)
+					expectedType = &typeid(*decoder);
+				else if(expectedType && *expectedType != typeid(*decoder))
+					context.Fail(path + " labeled ." + extension + " opened with a different decoder", __FILE__, __LINE__);
+			}
+		}
+	}
+
+	for(auto group : { std::make_pair("correctly labeled", &correct), std::make_pair("mislabeled", &mislabelled) }) {
+		const auto& statistics = *group.second;
+		if(statistics.mLatencies.empty())
+			continue;
+
+		std::string name = group.first;
+		double count = (double)statistics.mLatencies.size();
+		context.Report(name + " create p50", SFB::Benchmark::GetPercentile(statistics.mLatencies, 50), "ms");
+		context.Report(name + " create p99", SFB::Benchmark::GetPercentile(statistics.mLatencies, 99), "ms");
+		context.Report(name + " seeks per file", (double)statistics.mSeekCount / count, "seeks");
+		context.Report(name + " reads per file", (double)statistics.mReadCount / count, "reads");
+		context.Report(name + " opened", 100 * (double)statistics.mOpened / count, "%");
+	}
+}
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cctype>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Benchmark.h"
+#include "CFWrapper.h"
+#include "HTTPInputSource.h"
+
+// ========================================
+// HTTPInputSource range handling and request counts against a local HTTP server
+// ========================================
+
+namespace {
+
+	// Not a multiple of the block size, so the last block is partial
+	constexpr size_t kResourceSize = 4 * 1024 * 1024 + 1234;
+
+	inline uint8_t GetResourceByte(size_t offset)
+	{
+		return (uint8_t)((offset ^ (offset >> 8) ^ (offset >> 16)) & 0xff);
+	}
+
+	// Serves a generated resource over HTTP/1.1 with keep-alive and byte ranges, one thread per connection
+	class LocalHTTPServer
+	{
+	public:
+		// How range requests are answered
+		enum class RangeMode {
+			Exact,			// The requested range
+			Short,			// At most 64 KiB of the requested range, as servers limiting response sizes do
+			Shifted			// A range starting before the one requested, except at offset 0
+		};
+
+		explicit LocalHTTPServer(RangeMode mode)
+			: mMode(mode), mSocket(-1), mPort(0), mStopping(false), mConnectionCount(0), mRequestCount(0)
+		{
+			int fd = socket(AF_INET, SOCK_STREAM, 0);
+			if(-1 == fd)
+				return;
+
+			struct sockaddr_in address = {};
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			socklen_t addressLength = sizeof(address);
+
+			if(-1 == bind(fd, (struct sockaddr *)&address, sizeof(address)) || -1 == listen(fd, 16) || -1 == getsockname(fd, (struct sockaddr *)&address, &addressLength)) {
+				close(fd);
+				return;
+			}
+
+			mSocket = fd;
+			mPort = ntohs(address.sin_port);
+			mAcceptThread = std::thread(&LocalHTTPServer::AcceptConnections, this);
+		}
+
+		~LocalHTTPServer()
+		{
+			mStopping = true;
+
+			if(mAcceptThread.joinable())
+				mAcceptThread.join();
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			for(auto& thread : mConnectionThreads)
+				thread.join();
+
+			if(-1 != mSocket)
+				close(mSocket);
+		}
+
+		inline bool IsRunning() const					{ return -1 != mSocket; }
+		inline std::string GetURL() const				{ return "http://127.0.0.1:" + std::to_string(mPort) + "/resource.bin"; }
+
+		inline size_t GetConnectionCount() const		{ return mConnectionCount; }
+		inline size_t GetRequestCount() const			{ return mRequestCount; }
+
+	private:
+
+		// Wait until fd is readable, returning false when the server is stopping
+		bool WaitUntilReadable(int fd) const
+		{
+			struct pollfd descriptor = { fd, POLLIN, 0 };
+			while(!mStopping) {
+				int result = poll(&descriptor, 1, 100);
+				if(0 < result)
+					return true;
+				else if(-1 == result && EINTR != errno)
+					return false;
+			}
+			return false;
+		}
+
+		void AcceptConnections()
+		{
+			while(WaitUntilReadable(mSocket)) {
+				int fd = accept(mSocket, nullptr, nullptr);
+				if(-1 == fd)
+					continue;
+
+#if __APPLE__
+				int noSIGPIPE = 1;
+				setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSIGPIPE, sizeof(noSIGPIPE));
+#endif
+
+				++mConnectionCount;
+
+				std::lock_guard<std::mutex> lock(mMutex);
+				mConnectionThreads.push_back(std::thread(&LocalHTTPServer::ServeConnection, this, fd));
+			}
+		}
+
+		bool Send(int fd, const void *bytes, size_t count) const
+		{
+#if __APPLE__
+			const int flags = 0;
+#else
+			const int flags = MSG_NOSIGNAL;
+#endif
+			auto buf = static_cast<const uint8_t *>(bytes);
+			while(0 < count) {
+				ssize_t result = send(fd, buf, count, flags);
+				if(-1 == result && EINTR == errno)
+					continue;
+				else if(0 >= result)
+					return false;
+				buf += result;
+				count -= (size_t)result;
+			}
+			return true;
+		}
+
+		void ServeConnection(int fd)
+		{
+			std::string pending;
+			for(;;) {
+				// Read the request headers; the request has no body
+				size_t headerEnd;
+				while(std::string::npos == (headerEnd = pending.find("\r\n\r\n"))) {
+					char buf [4096];
+					ssize_t result = WaitUntilReadable(fd) ? recv(fd, buf, sizeof(buf), 0) : 0;
+					if(0 >= result) {
+						close(fd);
+						return;
+					}
+					pending.append(buf, (size_t)result);
+				}
+
+				std::string request = pending.substr(0, headerEnd);
+				pending.erase(0, headerEnd + 4);
+				std::transform(request.begin(), request.end(), request.begin(), ::tolower);
+
+				++mRequestCount;
+
+				long long first = -1, last = -1;
+				auto range = request.find("\r\nrange:");
+				if(std::string::npos != range && 1 <= sscanf(request.c_str() + range, "\r\nrange: bytes=%lld-%lld", &first, &last) && (-1 == last || last >= (long long)kResourceSize))
+					last = (long long)kResourceSize - 1;
+
+				std::string status = "200 OK", contentRange;
+				size_t bodyOffset = 0, bodyLength = kResourceSize;
+				if(-1 != first && first >= (long long)kResourceSize) {
+					status = "416 Range Not Satisfiable";
+					contentRange = "Content-Range: bytes */" + std::to_string(kResourceSize) + "\r\n";
+					bodyLength = 0;
+				}
+				else if(-1 != first) {
+					if(RangeMode::Short == mMode)
+						last = std::min(last, first + 64 * 1024 - 1);
+					else if(RangeMode::Shifted == mMode && 0 < first)
+						first = std::max(first - 100, 0ll);
+
+					status = "206 Partial Content";
+					contentRange = "Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(kResourceSize) + "\r\n";
+					bodyOffset = (size_t)first;
+					bodyLength = (size_t)(last - first + 1);
+				}
+
+				std::string headers = "HTTP/1.1 " + status + "\r\n" + contentRange + "Content-Length: " + std::to_string(bodyLength) + "\r\nContent-Type: application/octet-stream\r\nConnection: keep-alive\r\n\r\n";
+				std::vector<uint8_t> body(bodyLength);
+				for(size_t i = 0; i < bodyLength; ++i)
+					body[i] = GetResourceByte(bodyOffset + i);
+
+				// The client closes the connection when it abandons a response
+				if(!Send(fd, headers.data(), headers.size()) || !Send(fd, body.data(), body.size())) {
+					close(fd);
+					return;
+				}
+			}
+		}
+
+		RangeMode					mMode;
+		int							mSocket;
+		uint16_t					mPort;
+		std::atomic_bool			mStopping;
+		std::atomic_size_t			mConnectionCount;
+		std::atomic_size_t			mRequestCount;
+		std::thread					mAcceptThread;
+		std::mutex					mMutex;
+		std::vector<std::thread>	mConnectionThreads;
+	};
+
+	std::unique_ptr<SFB::HTTPInputSource> CreateInputSource(const LocalHTTPServer& server)
+	{
+		SFB::CFString string(CFStringCreateWithCString(kCFAllocatorDefault, server.GetURL().c_str(), kCFStringEncodingUTF8));
+		SFB::CFURL url(CFURLCreateWithString(kCFAllocatorDefault, string, nullptr));
+		if(!url)
+			return nullptr;
+
+		return std::unique_ptr<SFB::HTTPInputSource>(new SFB::HTTPInputSource(url));
+	}
+
+	// Read byteCount bytes at offset, returning the number read if they all match the resource or -1 otherwise
+	SInt64 ReadAndVerify(SFB::InputSource& inputSource, SInt64 offset, SInt64 byteCount)
+	{
+		if(!inputSource.SeekToOffset(offset))
+			return 0;
+
+		std::vector<uint8_t> buf((size_t)byteCount);
+		SInt64 bytesRead = inputSource.Read(buf.data(), byteCount);
+		for(SInt64 i = 0; i < bytesRead; ++i) {
+			if(buf[(size_t)i] != GetResourceByte((size_t)(offset + i)))
+				return -1;
+		}
+
+		return bytesRead;
+	}
+
+}
+
+SFB_BENCHMARK(HTTPInputSourceRanges)
+{
+	const std::pair<LocalHTTPServer::RangeMode, const char *> modes [] = {
+		{ LocalHTTPServer::RangeMode::Exact, "Exact ranges" },
+		{ LocalHTTPServer::RangeMode::Short, "Short ranges" },
+		{ LocalHTTPServer::RangeMode::Shifted, "Shifted ranges" },
+	};
+
+	for(const auto& mode : modes) {
+		std::string label = mode.second;
+
+		LocalHTTPServer server(mode.first);
+		if(!server.IsRunning()) {
+			context.Note("Unable to start a local HTTP server; skipped");
+			return;
+		}
+
+		auto inputSource = CreateInputSource(server);
+		if(!inputSource || !inputSource->Open()) {
+			context.Fail(label + ": unable to open " + server.GetURL(), __FILE__, __LINE__);
+			continue;
+		}
+
+		SFB_CHECK(context, (SInt64)kResourceSize == inputSource->GetLength());
+
+		// Read the whole resource sequentially in small reads, as a decoder does
+		SInt64 bytesRead = 0;
+		bool matches = true;
+		for(;;) {
+			SInt64 result = ReadAndVerify(*inputSource, bytesRead, 4096);
+			if(0 >= result) {
+				matches = -1 != result;
+				break;
+			}
+			bytesRead += result;
+		}
+
+		// A range that doesn't match the request must be rejected rather than cached at the wrong offset
+		if(LocalHTTPServer::RangeMode::Shifted == mode.first) {
+			SFB_CHECK(context, matches && bytesRead < (SInt64)kResourceSize);
+			continue;
+		}
+
+		SFB_CHECK(context, matches && (SInt64)kResourceSize == bytesRead && inputSource->AtEOF());
+
+		context.Report(label + ", sequential read requests", (double)inputSource->GetRequestCount(), "requests");
+		context.Report(label + ", sequential read connections", (double)server.GetConnectionCount(), "connections");
+
+		// Seeking back within the cached blocks requires no requests
+		uint64_t requestCount = inputSource->GetRequestCount();
+		SFB_CHECK(context, 64 * 1024 == ReadAndVerify(*inputSource, (SInt64)kResourceSize - 1024 * 1024, 64 * 1024));
+		SFB_CHECK(context, requestCount == inputSource->GetRequestCount());
+
+		// Random seeks, as decoders make while probing, over the persistent connections
+		std::mt19937 generator(1);
+		std::uniform_int_distribution<SInt64> distribution(0, (SInt64)kResourceSize - 1);
+		size_t seekCount = context.Iterations(200);
+		size_t connectionCount = server.GetConnectionCount();
+		requestCount = inputSource->GetRequestCount();
+
+		SFB::Benchmark::Stopwatch stopwatch;
+		for(size_t i = 0; i < seekCount; ++i) {
+			SInt64 offset = distribution(generator);
+			SInt64 expected = std::min((SInt64)1024, (SInt64)kResourceSize - offset);
+			if(expected != ReadAndVerify(*inputSource, offset, 1024)) {
+				context.Fail(label + ": read at offset " + std::to_string(offset) + " returned the wrong bytes", __FILE__, __LINE__);
+				break;
+			}
+		}
+		double seconds = stopwatch.GetElapsedSeconds();
+
+		context.Report(label + ", random seek requests per seek", (double)(inputSource->GetRequestCount() - requestCount) / seekCount, "requests");
+		context.Report(label + ", random seek connections per seek", (double)(server.GetConnectionCount() - connectionCount) / seekCount, "connections");
+		context.Report(label + ", random seek latency", 1e3 * seconds / seekCount, "ms");
+
+		// Every request made by the input source reached the server
+		SFB_CHECK(context, inputSource->GetRequestCount() == server.GetRequestCount());
+	}
+}
@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "AudioBufferList.h"
+#include "AudioDecoder.h"
+#include "Benchmark.h"
+#include "CFWrapper.h"
+#include "InputSource.h"
+
+// ========================================
+// Input source benchmarks
+// The memory-mapped benchmarks evict fixtures from the kernel's file cache where the system allows it;
+// the file benchmarks read them warm so the cost of each call dominates
+// ========================================
+
+namespace {
+
+	constexpr UInt32 kReadFrames = 4096;
+
+	SFB::CFURL CreateURL(const std::string& path)
+	{
+		return SFB::CFURL(CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault, (const UInt8 *)path.c_str(), (CFIndex)path.size(), false));
+	}
+
+	std::string GetFileName(const std::string& path)
+	{
+		return path.substr(path.find_last_of('/') + 1);
+	}
+
+	// Drop the cached pages of path so the next access reads from the device
+	bool EvictFromCache(const std::string& path)
+	{
+		int fd = open(path.c_str(), O_RDONLY);
+		if(-1 == fd)
+			return false;
+
+		bool evicted = false;
+#if defined(POSIX_FADV_DONTNEED)
+		evicted = 0 == posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#else
+		struct stat s;
+		if(0 == fstat(fd, &s) && 0 < s.st_size) {
+			void *memory = mmap(nullptr, (size_t)s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			if(MAP_FAILED != memory) {
+				evicted = 0 == msync(memory, (size_t)s.st_size, MS_INVALIDATE);
+				munmap(memory, (size_t)s.st_size);
+			}
+		}
+#endif
+
+		close(fd);
+		return evicted;
+	}
+
+	// Serves bytes through stdio's default buffer, as FileInputSource did before reading in blocks
+	class StdioInputSource : public SFB::InputSource
+	{
+	public:
+		explicit StdioInputSource(CFURLRef url)
+			: SFB::InputSource(url), mFile(nullptr, std::fclose), mLength(0)
+		{}
+
+	private:
+		virtual bool _Open(CFErrorRef *error)
+		{
+			UInt8 buf [PATH_MAX];
+			if(!CFURLGetFileSystemRepresentation(GetURL(), FALSE, buf, PATH_MAX))
+				return false;
+
+			mFile = unique_FILE_ptr(std::fopen((const char *)buf, "r"), std::fclose);
+			struct stat s;
+			if(!mFile || -1 == fstat(::fileno(mFile.get()), &s)) {
+				if(error)
+					*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, errno, nullptr);
+				mFile.reset();
+				return false;
+			}
+
+			mLength = s.st_size;
+			return true;
+		}
+
+		virtual bool _Close(CFErrorRef */*error*/)				{ mFile.reset(); return true; }
+		virtual SInt64 _Read(void *buffer, SInt64 byteCount)	{ return (SInt64)std::fread(buffer, 1, (size_t)byteCount, mFile.get()); }
+		virtual bool _AtEOF() const								{ return std::feof(mFile.get()); }
+		virtual SInt64 _GetOffset() const						{ return ftello(mFile.get()); }
+		virtual SInt64 _GetLength() const						{ return mLength; }
+		virtual bool _SupportsSeeking() const					{ return true; }
+		virtual bool _SeekToOffset(SInt64 offset)				{ return 0 == fseeko(mFile.get(), offset, SEEK_SET); }
+
+		using unique_FILE_ptr = std::unique_ptr<std::FILE, int (*)(std::FILE *)>;
+
+		unique_FILE_ptr mFile;
+		SInt64 mLength;
+	};
+
+	// The number of read system calls made by the process, or -1 if unavailable
+	long long GetReadSyscallCount()
+	{
+#if __linux__
+		std::unique_ptr<std::FILE, int (*)(std::FILE *)> file(std::fopen("/proc/self/io", "r"), std::fclose);
+		if(!file)
+			return -1;
+
+		char line [128];
+		long long count;
+		while(std::fgets(line, sizeof(line), file.get())) {
+			if(1 == sscanf(line, "syscr: %lld", &count))
+				return count;
+		}
+#endif
+		return -1;
+	}
+
+	struct FileInputSourceConfiguration
+	{
+		const char *mName;
+		std::function<SFB::InputSource::unique_ptr(CFURLRef)> mCreate;
+	};
+
+	std::vector<FileInputSourceConfiguration> GetFileInputSourceConfigurations()
+	{
+		return {
+			{ "stdio", [](CFURLRef url) { return SFB::InputSource::unique_ptr(new StdioInputSource(url)); } },
+			{ "block reads", [](CFURLRef url) { return SFB::InputSource::CreateForURL(url); } },
+			{ "block reads bypassing the cache", [](CFURLRef url) { return SFB::InputSource::CreateForURL(url, SFB::InputSource::BypassFileCache); } },
+		};
+	}
+
+	// Page faults taken by the process, including those on the prefault queue
+	struct PageFaults
+	{
+		long mMajor;
+		long mMinor;
+	};
+
+	PageFaults GetPageFaults()
+	{
+		struct rusage usage;
+		if(-1 == getrusage(RUSAGE_SELF, &usage))
+			return { 0, 0 };
+		return { usage.ru_majflt, usage.ru_minflt };
+	}
+
+	struct HintsConfiguration
+	{
+		const char *mName;
+		SFB::InputSource::MemoryMapAccessHints mHints;
+	};
+
+	std::vector<HintsConfiguration> GetHintsConfigurations()
+	{
+		SFB::InputSource::MemoryMapAccessHints none;
+		none.mAccessPattern = SFB::InputSource::MemoryAccessPattern::Normal;
+		none.mReadAheadBytes = 0;
+		none.mPrefetchBytes = 0;
+
+		SFB::InputSource::MemoryMapAccessHints sequential = none;
+		sequential.mAccessPattern = SFB::InputSource::MemoryAccessPattern::Sequential;
+
+		SFB::InputSource::MemoryMapAccessHints readAhead;
+		readAhead.mPrefetchBytes = 0;
+
+		SFB::InputSource::MemoryMapAccessHints releaseBehind;
+		releaseBehind.mReleaseBehindBytes = 4 * 1024 * 1024;
+
+		return {
+			{ "No hints", none },
+			{ "Sequential", sequential },
+			{ "Sequential with read-ahead", readAhead },
+			{ "Defaults with prefault", SFB::InputSource::MemoryMapAccessHints() },
+			{ "Defaults with release behind", releaseBehind },
+		};
+	}
+
+}
+
+SFB_BENCHMARK(MemoryMappedFirstAudioLatency)
+{
+	if(context.GetFixtures().empty()) {
+		context.Note("No fixtures; skipped");
+		return;
+	}
+
+	for(const auto& path : context.GetFixtures()) {
+		if(!EvictFromCache(path))
+			context.Note("Unable to evict " + path + " from the file cache; results are for a warm cache");
+
+		for(const auto& configuration : GetHintsConfigurations()) {
+			std::vector<double> latencies;
+			double firstAudioMajorFaults = 0, firstAudioMinorFaults = 0, totalMajorFaults = 0;
+			size_t iterations = context.Iterations(10);
+
+			for(size_t i = 0; i < iterations; ++i) {
+				EvictFromCache(path);
+
+				PageFaults before = GetPageFaults();
+				SFB::Benchmark::Stopwatch stopwatch;
+
+				auto url = CreateURL(path);
+				auto inputSource = SFB::InputSource::CreateForURL(url, SFB::InputSource::MemoryMapFiles, configuration.mHints);
+				auto decoder = inputSource ? SFB::Audio::Decoder::CreateForInputSource(std::move(inputSource)) : nullptr;
+				if(!decoder || !decoder->IsOpen()) {
+					context.Note("Unable to open " + path + "; skipped");
+					break;
+				}
+
+				SFB::Audio::BufferList bufferList(decoder->GetFormat(), kReadFrames);
+				UInt32 framesRead = decoder->ReadAudio(bufferList, kReadFrames);
+				double seconds = stopwatch.GetElapsedSeconds();
+				PageFaults firstAudio = GetPageFaults();
+				SFB_CHECK(context, 0 < framesRead);
+
+				// Decode the rest to count the faults taken during playback
+				while(0 < framesRead) {
+					bufferList.Reset();
+					framesRead = decoder->ReadAudio(bufferList, kReadFrames);
+				}
+				PageFaults total = GetPageFaults();
+
+				latencies.push_back(1e3 * seconds);
+				firstAudioMajorFaults += firstAudio.mMajor - before.mMajor;
+				firstAudioMinorFaults += firstAudio.mMinor - before.mMinor;
+				totalMajorFaults += total.mMajor - before.mMajor;
+			}
+
+			if(latencies.empty())
+				break;
+
+			auto label = GetFileName(path) + ", " + configuration.mName;
+			double count = (double)latencies.size();
+			context.Report(label + ", first audio p50", SFB::Benchmark::GetPercentile(latencies, 50), "ms");
+			context.Report(label + ", first audio p99", SFB::Benchmark::GetPercentile(latencies, 99), "ms");
+			context.Report(label + ", major faults to first audio", firstAudioMajorFaults / count, "faults");
+			context.Report(label + ", minor faults to first audio", firstAudioMinorFaults / count, "faults");
+			context.Report(label + ", major faults decoding", totalMajorFaults / count, "faults");
+		}
+	}
+}
+
+SFB_BENCHMARK(FileInputSourceBlockReads)
+{
+	if(context.GetFixtures().empty()) {
+		context.Note("No fixtures; skipped");
+		return;
+	}
+
+	if(-1 == GetReadSyscallCount())
+		context.Note("Read system call counts are unavailable on this system");
+
+	for(const auto& path : context.GetFixtures()) {
+		auto url = CreateURL(path);
+
+		for(const auto& configuration : GetFileInputSourceConfigurations()) {
+			auto label = GetFileName(path) + ", " + configuration.mName;
+
+			// Small reads, as made by header parsing and the ReadLE/ReadBE helpers
+			auto inputSource = configuration.mCreate(url);
+			if(!inputSource || !inputSource->Open()) {
+				context.Note("Unable to open " + path + "; skipped");
+				break;
+			}
+
+			long long syscalls = GetReadSyscallCount();
+			SFB::Benchmark::Stopwatch stopwatch;
+			uint32_t value;
+			SInt64 bytesRead = 0;
+			while(sizeof(value) == inputSource->Read(&value, sizeof(value)))
+				bytesRead += sizeof(value);
+			double seconds = stopwatch.GetElapsedSeconds();
+			syscalls = GetReadSyscallCount() - syscalls;
+
+			SFB_CHECK(context, inputSource->AtEOF());
+			context.Report(label + ", 4 byte reads", (double)bytesRead / seconds / (1024 * 1024), "MiB/s");
+			if(0 <= syscalls)
+				context.Report(label + ", 4 byte reads system calls", (double)syscalls / seconds, "calls/s");
+
+			// Decoding, which mixes codec callbacks of varying sizes with seeks
+			std::vector<double> throughputs;
+			syscalls = GetReadSyscallCount();
+			double totalSeconds = 0;
+			for(size_t i = 0; i < context.Iterations(5); ++i) {
+				inputSource = configuration.mCreate(url);
+				auto decoder = inputSource ? SFB::Audio::Decoder::CreateForInputSource(std::move(inputSource)) : nullptr;
+				if(!decoder || !decoder->IsOpen()) {
+					context.Note("Unable to decode " + path + "; skipped");
+					break;
+				}
+
+				SFB::Audio::BufferList bufferList(decoder->GetFormat(), kReadFrames);
+				UInt64 framesDecoded = 0;
+
+				stopwatch.Restart();
+				for(;;) {
+					bufferList.Reset();
+					UInt32 framesRead = decoder->ReadAudio(bufferList, kReadFrames);
+					if(0 == framesRead)
+						break;
+					framesDecoded += framesRead;
+				}
+				seconds = stopwatch.GetElapsedSeconds();
+
+				totalSeconds += seconds;
+				throughputs.push_back((double)framesDecoded / seconds / 1e6);
+			}
+			syscalls = GetReadSyscallCount() - syscalls;
+
+			if(throughputs.empty())
+				continue;
+
+			context.Report(label + ", decode p50", SFB::Benchmark::GetPercentile(throughputs, 50), "Mframes/s");
+			if(0 <= syscalls)
+				context.Report(label + ", decode system calls", (double)syscalls / totalSeconds, "calls/s");
+		}
+	}
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <functional>
+#include <random>
+#include <thread>
+
+#include "AudioPlayer.h"
+#include "Benchmark.h"
+#include "CFWrapper.h"
+
+// ========================================
+// Player latency benchmarks
+// These play the fixtures through the default output device, so they are skipped when output can't start
+// ========================================
+
+namespace {
+
+	constexpr double kTimeoutSeconds = 5;
+
+	SFB::CFURL CreateURL(const std::string& path)
+	{
+		return SFB::CFURL(CFURLCreateFromFileSystemRepresentation(kCFAllocatorDefault, (const UInt8 *)path.c_str(), (CFIndex)path.size(), false));
+	}
+
+	// Poll until condition is true or the timeout elapses
+	bool WaitUntil(const std::function<bool()>& condition)
+	{
+		SFB::Benchmark::Stopwatch stopwatch;
+		while(!condition()) {
+			if(kTimeoutSeconds < stopwatch.GetElapsedSeconds())
+				return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+
+	// Start playing path and wait for audio to be rendered
+	bool StartPlaying(SFB::Audio::Player& player, const std::string& path)
+	{
+		auto url = CreateURL(path);
+		if(!url || !player.Play(url))
+			return false;
+
+		return WaitUntil([&player] {
+			SInt64 currentFrame;
+			return player.IsPlaying() && player.GetCurrentFrame(currentFrame) && 0 < currentFrame;
+		});
+	}
+
+	// Seek to frame and wait for the first audio from the new position to be rendered
+	bool Seek(SFB::Audio::Player& player, SInt64 frame, SFB::Audio::Player::SeekStatistics& statistics)
+	{
+		SFB::Audio::Player::SeekStatistics previous = {};
+		player.GetSeekStatistics(previous);
+
+		if(!player.SeekToFrame(frame))
+			return false;
+
+		return WaitUntil([&] {
+			return player.GetSeekStatistics(statistics) && statistics.mSeekCount > previous.mSeekCount;
+		});
+	}
+
+}
+
+SFB_BENCHMARK(PlayerHandshakeLatency)
+{
+	if(context.GetFixtures().empty()) {
+		context.Note("No fixtures; skipped");
+		return;
+	}
+
+	std::mt19937 generator(1);
+	std::vector<double> muteLatencies, seekLatencies, skipLatencies;
+
+	for(const auto& path : context.GetFixtures()) {
+		SFB::Audio::Player player;
+		if(!StartPlaying(player, path)) {
+			context.Note("Unable to play " + path + "; skipped");
+			continue;
+		}
+
+		SInt64 totalFrames;
+		if(player.SupportsSeeking() && player.GetTotalFrames(totalFrames) && 0 < totalFrames) {
+			std::uniform_int_distribution<SInt64> distribution(0, totalFrames / 2);
+			for(size_t i = 0; i < context.Iterations(50); ++i) {
+				SFB::Audio::Player::SeekStatistics statistics;
+				if(!Seek(player, distribution(generator), statistics)) {
+					context.Fail("Seek in " + path + " did not complete", __FILE__, __LINE__);
+					break;
+				}
+
+				muteLatencies.push_back(1e3 * statistics.mMuteAcknowledged);
+				seekLatencies.push_back(1e3 * statistics.mFirstRender);
+			}
+		}
+
+		// SkipToNextTrack() blocks until the rendering and decoding threads have both responded
+		for(size_t i = 0; i < context.Iterations(10); ++i) {
+			auto url = CreateURL(path);
+			SFB_CHECK(context, player.Enqueue(url));
+
+			SFB::Benchmark::Stopwatch stopwatch;
+			bool skipped = player.SkipToNextTrack();
+			skipLatencies.push_back(1e3 * stopwatch.GetElapsedSeconds());
+			SFB_CHECK(context, skipped);
+
+			SFB_CHECK(context, WaitUntil([&player] {
+				SInt64 currentFrame;
+				return player.GetCurrentFrame(currentFrame) && 0 < currentFrame;
+			}));
+		}
+
+		player.Stop();
+	}
+
+	if(!muteLatencies.empty()) {
+		context.Report("Mute acknowledged p50", SFB::Benchmark::GetPercentile(muteLatencies, 50), "ms");
+		context.Report("Mute acknowledged p99", SFB::Benchmark::GetPercentile(muteLatencies, 99), "ms");
+		context.Report("Seek to audible p50", SFB::Benchmark::GetPercentile(seekLatencies, 50), "ms");
+		context.Report("Seek to audible p99", SFB::Benchmark::GetPercentile(seekLatencies, 99), "ms");
+	}
+
+	if(!skipLatencies.empty()) {
+		context.Report("SkipToNextTrack p50", SFB::Benchmark::GetPercentile(skipLatencies, 50), "ms");
+		context.Report("SkipToNextTrack p99", SFB::Benchmark::GetPercentile(skipLatencies, 99), "ms");
+	}
+}
+
+SFB_BENCHMARK(PlayerSeekLatency)
+{
+	if(context.GetFixtures().empty()) {
+		context.Note("No fixtures; skipped");
+		return;
+	}
+
+	std::mt19937 generator(1);
+
+	for(const auto& path : context.GetFixtures()) {
+		// Fixtures are labeled by format, which is taken from the extension
+		auto extension = path.substr(path.find_last_of("./") + 1);
+		auto label = extension + " (" + path.substr(path.find_last_of('/') + 1) + ")";
+
+		SFB::Audio::Player player;
+		if(!StartPlaying(player, path)) {
+			context.Note("Unable to play " + path + "; skipped");
+			continue;
+		}
+
+		SInt64 totalFrames;
+		if(!player.SupportsSeeking() || !player.GetTotalFrames(totalFrames) || 0 >= totalFrames) {
+			context.Note(path + " is not seekable; skipped");
+			continue;
+		}
+
+		// Seek anywhere up to 90% of the way through, where decoders that scan are slowest,
+		// leaving enough audio that playback doesn't end between seeks
+		std::uniform_int_distribution<SInt64> distribution(0, (totalFrames * 9) / 10);
+		std::vector<double> phases [4];
+		for(size_t i = 0; i < context.Iterations(100); ++i) {
+			SFB::Audio::Player::SeekStatistics statistics;
+			if(!Seek(player, distribution(generator), statistics)) {
+				context.Fail("Seek in " + path + " did not complete", __FILE__, __LINE__);
+				break;
+			}
+
+			phases[0].push_back(1e3 * statistics.mMuteAcknowledged);
+			phases[1].push_back(1e3 * statistics.mDecoderSeekCompleted);
+			phases[2].push_back(1e3 * statistics.mFirstWrite);
+			phases[3].push_back(1e3 * statistics.mFirstRender);
+		}
+
+		player.Stop();
+
+		const char *names [] = { "mute acknowledged", "decoder seek completed", "first write", "first render" };
+		for(size_t phase = 0; phase < 4; ++phase) {
+			if(phases[phase].empty())
+				continue;
+			context.Report(label + " " + names[phase] + " p50", SFB::Benchmark::GetPercentile(phases[phase], 50), "ms");
+			context.Report(label + " " + names[phase] + " p99", SFB::Benchmark::GetPercentile(phases[phase], 99), "ms");
+		}
+	}
+}
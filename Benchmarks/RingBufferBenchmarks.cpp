@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include "Benchmark.h"
+#include "RingBuffer.h"
+
+// ========================================
+// Single producer, single consumer stress tests for RingBuffer
+// Every chunk carries a sequence number and a fill pattern so torn or reordered reads are detected
+// ========================================
+
+namespace {
+
+	constexpr size_t kCapacityBytes = 1024 * 1024;
+	const size_t kChunkSizes [] = { 64, 256, 1024, 4096, 16384 };
+
+	inline uint64_t GetTimestamp()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// A chunk starts with its sequence number and a timestamp and is filled with the low byte of the sequence number
+	void FillChunk(uint8_t *chunk, size_t chunkSize, uint64_t sequence)
+	{
+		memset(chunk, (int)(sequence & 0xff), chunkSize);
+		uint64_t timestamp = GetTimestamp();
+		memcpy(chunk, &sequence, sizeof(sequence));
+		memcpy(chunk + sizeof(sequence), &timestamp, sizeof(timestamp));
+	}
+
+	bool VerifyChunk(const uint8_t *chunk, size_t chunkSize, uint64_t expectedSequence)
+	{
+		uint64_t sequence;
+		memcpy(&sequence, chunk, sizeof(sequence));
+		return sequence == expectedSequence && chunk[2 * sizeof(uint64_t)] == (uint8_t)(sequence & 0xff) && chunk[chunkSize - 1] == (uint8_t)(sequence & 0xff);
+	}
+
+	uint64_t GetChunkTimestamp(const uint8_t *chunk)
+	{
+		uint64_t timestamp;
+		memcpy(&timestamp, chunk + sizeof(uint64_t), sizeof(timestamp));
+		return timestamp;
+	}
+
+	/*!
+	 * Stream \c chunkCount chunks through \c ringBuffer from a producer thread to the calling thread
+	 * @param lockstep If \c true the producer waits for each chunk to be consumed before writing the next,
+	 * so the measured latency is the cross-thread handoff and not time spent queued
+	 * @return \c false if any chunk was torn or out of order
+	 */
+	bool Stream(SFB::RingBuffer& ringBuffer, size_t chunkSize, uint64_t chunkCount, bool lockstep, double& seconds, std::vector<double>& latencies)
+	{
+		std::atomic<uint64_t> consumed(0);
+
+		SFB::Benchmark::Stopwatch stopwatch;
+
+		std::thread producer([&] {
+			std::vector<uint8_t> chunk(chunkSize);
+			for(uint64_t sequence = 0; sequence < chunkCount; ++sequence) {
+				while(ringBuffer.GetBytesAvailableToWrite() < chunkSize || (lockstep && consumed.load(std::memory_order_acquire) < sequence))
+					std::this_thread::yield();
+				FillChunk(chunk.data(), chunkSize, sequence);
+				ringBuffer.Write(chunk.data(), chunkSize);
+			}
+		});
+
+		bool intact = true;
+		std::vector<uint8_t> chunk(chunkSize);
+		for(uint64_t sequence = 0; sequence < chunkCount; ++sequence) {
+			while(ringBuffer.GetBytesAvailableToRead() < chunkSize)
+				std::this_thread::yield();
+			ringBuffer.Read(chunk.data(), chunkSize);
+
+			if(lockstep)
+				latencies.push_back((double)(GetTimestamp() - GetChunkTimestamp(chunk.data())) / 1e3);
+			if(!VerifyChunk(chunk.data(), chunkSize, sequence))
+				intact = false;
+
+			consumed.store(sequence + 1, std::memory_order_release);
+		}
+
+		producer.join();
+		seconds = stopwatch.GetElapsedSeconds();
+
+		return intact;
+	}
+
+}
+
+SFB_BENCHMARK(RingBufferThroughput)
+{
+	SFB::RingBuffer ringBuffer;
+	SFB_CHECK(context, ringBuffer.Allocate(kCapacityBytes));
+
+	for(auto chunkSize : kChunkSizes) {
+		ringBuffer.Reset();
+
+		uint64_t chunkCount = context.Iterations(512 * 1024 * 1024) / chunkSize;
+		double seconds;
+		std::vector<double> latencies;
+		SFB_CHECK(context, Stream(ringBuffer, chunkSize, chunkCount, false, seconds, latencies));
+
+		context.Report(std::to_string(chunkSize) + " byte chunks", (double)(chunkCount * chunkSize) / seconds / (1024 * 1024), "MiB/s");
+	}
+}
+
+SFB_BENCHMARK(RingBufferLatency)
+{
+	SFB::RingBuffer ringBuffer;
+	SFB_CHECK(context, ringBuffer.Allocate(kCapacityBytes));
+
+	for(auto chunkSize : kChunkSizes) {
+		ringBuffer.Reset();
+
+		double seconds;
+		std::vector<double> latencies;
+		SFB_CHECK(context, Stream(ringBuffer, chunkSize, context.Iterations(20000), true, seconds, latencies));
+
+		context.Report(std::to_string(chunkSize) + " byte chunks p50", SFB::Benchmark::GetPercentile(latencies, 50), "us");
+		context.Report(std::to_string(chunkSize) + " byte chunks p99", SFB::Benchmark::GetPercentile(latencies, 99), "us");
+	}
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <cmath>
+#include <limits>
+
+#include "Benchmark.h"
+#include "SampleKernels.h"
+
+// ========================================
+// Sample kernel correctness and throughput for every instruction set the processor supports
+// ========================================
+
+namespace {
+
+	using SFB::Audio::SampleKernelInstructionSet;
+
+	constexpr size_t kSampleCount = 4096;
+
+	struct InstructionSet
+	{
+		SampleKernelInstructionSet mInstructionSet;
+		const char *mName;
+	};
+
+	const InstructionSet kInstructionSets [] = {
+		{ SampleKernelInstructionSet::Scalar, "Scalar" },
+		{ SampleKernelInstructionSet::SSE2, "SSE2" },
+		{ SampleKernelInstructionSet::AVX2, "AVX2" },
+		{ SampleKernelInstructionSet::AVX512, "AVX-512" },
+		{ SampleKernelInstructionSet::NEON, "NEON" },
+	};
+
+	// Restores the instruction set in use when constructed
+	class InstructionSetRestorer
+	{
+	public:
+		InstructionSetRestorer() : mInstructionSet(SFB::Audio::GetSampleKernelInstructionSet()) {}
+		~InstructionSetRestorer() { SFB::Audio::SetSampleKernelInstructionSet(mInstructionSet); }
+	private:
+		SampleKernelInstructionSet mInstructionSet;
+	};
+
+	// Edge cases and their expected results, as { sample, 16-bit result, 32-bit result, clipped to [-1, 1] }
+	struct EdgeCase
+	{
+		float mSample;
+		int16_t mInt16;
+		int32_t mInt32;
+		float mClipped;
+	};
+
+	const EdgeCase kEdgeCases [] = {
+		{ std::numeric_limits<float>::quiet_NaN(), 0, 0, 0.f },
+		{ -std::numeric_limits<float>::quiet_NaN(), 0, 0, 0.f },
+		{ std::numeric_limits<float>::infinity(), INT16_MAX, 2147483520, 1.f },
+		{ -std::numeric_limits<float>::infinity(), INT16_MIN, INT32_MIN, -1.f },
+		{ 1.f, INT16_MAX, 2147483520, 1.f },
+		{ -1.f, INT16_MIN, INT32_MIN, -1.f },
+		{ 2.f, INT16_MAX, 2147483520, 1.f },
+		{ -2.f, INT16_MIN, INT32_MIN, -1.f },
+		{ 0.f, 0, 0, 0.f },
+		{ 0.5f, 16384, 1073741824, 0.5f },
+	};
+
+	constexpr size_t kEdgeCaseCount = sizeof(kEdgeCases) / sizeof(kEdgeCases[0]);
+
+	// Convert and clip the edge cases at every position of a buffer long enough to use both the vector loop and the scalar tail
+	void CheckEdgeCases(SFB::Benchmark::Context& context, const char *name)
+	{
+		constexpr size_t count = 37;
+
+		for(size_t edgeCase = 0; edgeCase < kEdgeCaseCount; ++edgeCase) {
+			float src [count];
+			for(size_t i = 0; i < count; ++i)
+				src[i] = kEdgeCases[(edgeCase + i) % kEdgeCaseCount].mSample;
+
+			int16_t int16 [count];
+			SFB::Audio::ConvertFloatToInt16(src, int16, count, 32768.f);
+			int32_t int32 [count];
+			SFB::Audio::ConvertFloatToInt32(src, int32, count, 2147483648.f);
+			float clipped [count];
+			SFB::Audio::ClipFloatSamples(src, clipped, count, -1.f, 1.f);
+
+			for(size_t i = 0; i < count; ++i) {
+				const auto& expected = kEdgeCases[(edgeCase + i) % kEdgeCaseCount];
+				if(int16[i] != expected.mInt16 || int32[i] != expected.mInt32 || clipped[i] != expected.mClipped) {
+					context.Fail(std::string(name) + " converted " + std::to_string(expected.mSample) + " to " + std::to_string(int16[i]) + " and " + std::to_string(int32[i]) + " and clipped it to " + std::to_string(clipped[i]), __FILE__, __LINE__);
+					return;
+				}
+			}
+		}
+	}
+
+	// Time count calls of kernel and report the throughput in samples
+	template <typename Kernel>
+	void Measure(SFB::Benchmark::Context& context, const std::string& label, size_t samplesPerCall, Kernel kernel)
+	{
+		size_t iterations = context.Iterations((256 * 1024 * 1024) / samplesPerCall);
+
+		SFB::Benchmark::Stopwatch stopwatch;
+		for(size_t i = 0; i < iterations; ++i)
+			kernel();
+		double seconds = stopwatch.GetElapsedSeconds();
+
+		context.Report(label, (double)(iterations * samplesPerCall) / seconds / 1e6, "Msamples/s");
+	}
+
+}
+
+SFB_BENCHMARK(SampleKernelFloatToIntEdgeCases)
+{
+	InstructionSetRestorer restorer;
+
+	for(const auto& instructionSet : kInstructionSets) {
+		if(!SFB::Audio::SetSampleKernelInstructionSet(instructionSet.mInstructionSet)) {
+			context.Note(std::string(instructionSet.mName) + " unsupported; skipped");
+			continue;
+		}
+
+		CheckEdgeCases(context, instructionSet.mName);
+	}
+}
+
+SFB_BENCHMARK(SampleKernelThroughput)
+{
+	InstructionSetRestorer restorer;
+
+	std::vector<float> floats(8 * kSampleCount);
+	for(size_t i = 0; i < floats.size(); ++i)
+		floats[i] = std::sin((float)i);
+	std::vector<float> floatsOut(floats.size());
+	std::vector<int16_t> int16s(floats.size());
+	std::vector<int32_t> int32s(floats.size());
+
+	for(const auto& instructionSet : kInstructionSets) {
+		if(!SFB::Audio::SetSampleKernelInstructionSet(instructionSet.mInstructionSet)) {
+			context.Note(std::string(instructionSet.mName) + " unsupported; skipped");
+			continue;
+		}
+
+		std::string name = instructionSet.mName;
+
+		for(uint32_t channelCount : { 2u, 6u, 8u }) {
+			float *channels [8];
+			const float *constChannels [8];
+			for(uint32_t channel = 0; channel < channelCount; ++channel) {
+				channels[channel] = floatsOut.data() + channel * kSampleCount;
+				constChannels[channel] = channels[channel];
+			}
+
+			size_t sampleCount = channelCount * kSampleCount;
+			Measure(context, name + ", deinterleave " + std::to_string(channelCount) + " channels", sampleCount, [&] {
+				SFB::Audio::DeinterleaveSamples(floats.data(), channels, channelCount, kSampleCount);
+			});
+			Measure(context, name + ", interleave " + std::to_string(channelCount) + " channels", sampleCount, [&] {
+				SFB::Audio::InterleaveSamples(constChannels, floats.data(), channelCount, kSampleCount);
+			});
+		}
+
+		Measure(context, name + ", float to int16", kSampleCount, [&] {
+			SFB::Audio::ConvertFloatToInt16(floats.data(), int16s.data(), kSampleCount, 32768.f);
+		});
+		Measure(context, name + ", float to int32", kSampleCount, [&] {
+			SFB::Audio::ConvertFloatToInt32(floats.data(), int32s.data(), kSampleCount, 2147483648.f);
+		});
+		Measure(context, name + ", int16 to float", kSampleCount, [&] {
+			SFB::Audio::ConvertInt16ToFloat(int16s.data(), floatsOut.data(), kSampleCount, 1.f / 32768.f);
+		});
+		Measure(context, name + ", int32 to float", kSampleCount, [&] {
+			SFB::Audio::ConvertInt32ToFloat(int32s.data(), floatsOut.data(), kSampleCount, 1.f / 2147483648.f);
+		});
+		Measure(context, name + ", int32 to int16", kSampleCount, [&] {
+			SFB::Audio::ConvertInt32ToInt16(int32s.data(), int16s.data(), kSampleCount, 0);
+		});
+		Measure(context, name + ", scale", kSampleCount, [&] {
+			SFB::Audio::ScaleFloatSamples(floats.data(), floatsOut.data(), kSampleCount, 0.5f);
+		});
+	}
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "Benchmark.h"
+
+// ========================================
+// Runs the registered benchmarks and regression checks
+//
+// usage: Benchmarks [-l] [-q] [-f filter] [-j output.json] [fixture ...]
+//
+// Fixtures are audio files used by the benchmarks that decode; those benchmarks are skipped when none are given.
+// The exit status is nonzero if any check failed.
+// ========================================
+
+namespace {
+
+	std::string EscapeJSON(const std::string& s)
+	{
+		std::string result;
+		for(auto c : s) {
+			switch(c) {
+				case '"':	result += "\\\"";	break;
+				case '\\':	result += "\\\\";	break;
+				case '\n':	result += "\\n";	break;
+				case '\t':	result += "\\t";	break;
+				default:
+					if((unsigned char)c < 0x20) {
+						char buf [8];
+						snprintf(buf, sizeof(buf), "\\u%04x", c);
+						result += buf;
+					}
+					else
+						result += c;
+					break;
+			}
+		}
+		return result;
+	}
+
+	bool WriteJSON(const SFB::Benchmark::Context& context, const char *path)
+	{
+		FILE *file = fopen(path, "w");
+		if(!file)
+			return false;
+
+		fprintf(file, "{\n\t\"failures\": %zu,\n\t\"results\": [", context.GetFailureCount());
+		bool first = true;
+		for(const auto& result : context.GetResults()) {
+			fprintf(file, "%s\n\t\t{\"benchmark\": \"%s\", \"metric\": \"%s\", \"value\": %.17g, \"unit\": \"%s\"}", first ? "" : ",", EscapeJSON(result.mBenchmark).c_str(), EscapeJSON(result.mMetric).c_str(), result.mValue, EscapeJSON(result.mUnit).c_str());
+			first = false;
+		}
+		fputs("\n\t]\n}\n", file);
+
+		return 0 == fclose(file);
+	}
+
+}
+
+int main(int argc, char *argv [])
+{
+	const char *filter = nullptr;
+	const char *jsonPath = nullptr;
+	bool list = false;
+	bool quick = false;
+
+	int ch;
+	while(-1 != (ch = getopt(argc, argv, "f:j:lq"))) {
+		switch(ch) {
+			case 'f':	filter = optarg;	break;
+			case 'j':	jsonPath = optarg;	break;
+			case 'l':	list = true;		break;
+			case 'q':	quick = true;		break;
+			default:
+				fprintf(stderr, "usage: %s [-l] [-q] [-f filter] [-j output.json] [fixture ...]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	std::vector<std::string> fixtures(argv + optind, argv + argc);
+	SFB::Benchmark::Context context(fixtures, quick);
+
+	for(const auto& entry : SFB::Benchmark::Registration::GetEntries()) {
+		if(filter && !strstr(entry.mName, filter))
+			continue;
+
+		if(list) {
+			puts(entry.mName);
+			continue;
+		}
+
+		printf("%s\n", entry.mName);
+		fflush(stdout);
+
+		context.SetCurrentBenchmark(entry.mName);
+		entry.mFunction(context);
+	}
+
+	if(jsonPath && !WriteJSON(context, jsonPath)) {
+		fprintf(stderr, "Unable to write %s\n", jsonPath);
+		return EXIT_FAILURE;
+	}
+
+	if(context.GetFailureCount()) {
+		fprintf(stderr, "%zu check(s) failed\n", context.GetFailureCount());
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -5,6 +5,10 @@
 
 #include <AudioToolbox/AudioFormat.h>
 #include <CoreFoundation/CoreFoundation.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 
 #include "HTTPInputSource.h"
 #include "AudioDecoder.h"
@@ -110,20 +114,51 @@ SFB::Audio::Decoder::unique_ptr SFB::Audio::Decoder::CreateForInputSource(InputS
 	}
 #endif
 
+	// Read the start of the input once so subclasses can rule themselves out before a full open
+	std::vector<uint8_t> header;
+	bool probed = ReadFileHeader(*inputSource, header);
+
+	auto probe = [&](const SubclassInfo& subclassInfo) {
+		return probed ? subclassInfo.mProbeFileHeader(header.data(), header.size()) : ProbeResult::Unknown;
+	};
+
+	// Subclasses are created at most once
+	std::vector<bool> tried(sRegisteredSubclasses.size(), false);
+
+	// Only the error from the first subclass handling the MIME type or extension is reported,
+	// since failures of the others just mean they don't handle the file
+	SFB::CFError preferredError;
+
+	auto createDecoder = [&](size_t index, bool preferred) -> unique_ptr {
+		tried[index] = true;
+
+		unique_ptr decoder(sRegisteredSubclasses[index].mCreateDecoder(std::move(inputSource)));
+		if(!AutomaticallyOpenDecoders())
+			return decoder;
+
+		SFB::CFError openError;
+		if(decoder->Open(error ? &openError : nullptr))
+			return decoder;
+
+		if(preferred && !preferredError)
+			preferredError = std::move(openError);
+
+		// Take back the input source for reuse if opening fails
+		inputSource = std::move(decoder->mInputSource);
+		if(inputSource->SupportsSeeking() && !inputSource->SeekToOffset(0))
+			LOGGER_NOTICE("org.sbooth.AudioEngine.Decoder", "Unable to rewind input source after failed open");
+
+		return nullptr;
+	};
+
 	// The MIME type takes precedence over the file extension
 	if(mimeType) {
-		for(auto subclassInfo : sRegisteredSubclasses) {
-			if(subclassInfo.mHandlesMIMEType(mimeType)) {
-				unique_ptr decoder(subclassInfo.mCreateDecoder(std::move(inputSource)));
-				if(!AutomaticallyOpenDecoders())
+		for(size_t i = 0; i < sRegisteredSubclasses.size(); ++i) {
+			const auto& subclassInfo = sRegisteredSubclasses[i];
+			if(subclassInfo.mHandlesMIMEType(mimeType) && ProbeResult::NoMatch != probe(subclassInfo)) {
+				auto decoder = createDecoder(i, true);
+				if(decoder)
 					return decoder;
-				else {
-					 if(decoder->Open(error))
-						 return decoder;
-					// Take back the input source for reuse if opening fails
-					else
-						 inputSource = std::move(decoder->mInputSource);
-				}
 			}
 		}
 
@@ -140,51 +175,116 @@ SFB::Audio::Decoder::unique_ptr SFB::Audio::Decoder::CreateForInputSource(InputS
 		return nullptr;
 
 	SFB::CFString pathExtension(CFURLCopyPathExtension(inputURL));
-	if(!pathExtension) {
-		if(error) {
-			SFB::CFString description(CFCopyLocalizedString(CFSTR("The type of the file “%@” could not be determined."), ""));
-			SFB::CFString failureReason(CFCopyLocalizedString(CFSTR("Unknown file type"), ""));
-			SFB::CFString recoverySuggestion(CFCopyLocalizedString(CFSTR("The file's extension may be missing or may not match the file's type."), ""));
-
-			*error = CreateErrorForURL(InputSource::ErrorDomain, InputSource::FileNotFoundError, description, inputURL, failureReason, recoverySuggestion);
-		}
-
-		return nullptr;
-	}
 
 	// TODO: Some extensions (.oga for example) support multiple audio codecs (Vorbis, FLAC, Speex)
 	// and if openDecoder is false the wrong decoder type may be returned, since the file isn't analyzed
 	// until Open() is called
 
-	for(auto subclassInfo : sRegisteredSubclasses) {
-		if(subclassInfo.mHandlesFilesWithExtension(pathExtension)) {
-			unique_ptr decoder(subclassInfo.mCreateDecoder(std::move(inputSource)));
-			if(!AutomaticallyOpenDecoders())
-				return decoder;
-			else {
-				if(decoder->Open(error))
+	auto handlesExtension = [&](const SubclassInfo& subclassInfo) {
+		return pathExtension && subclassInfo.mHandlesFilesWithExtension(pathExtension);
+	};
+
+	// Prefer subclasses whose signature matches, first those handling the extension and then the rest
+	// since the extension may be wrong
+	for(bool extensionMatches : { true, false }) {
+		for(size_t i = 0; i < sRegisteredSubclasses.size(); ++i) {
+			const auto& subclassInfo = sRegisteredSubclasses[i];
+			if(!tried[i] && extensionMatches == handlesExtension(subclassInfo) && ProbeResult::Match == probe(subclassInfo)) {
+				auto decoder = createDecoder(i, extensionMatches);
+				if(decoder)
 					return decoder;
-				// Take back the input source for reuse if opening fails
-				else
-					inputSource = std::move(decoder->mInputSource);
 			}
 		}
 	}
 
+	// Fall back to subclasses handling the extension that can't rule out the file
+	for(size_t i = 0; i < sRegisteredSubclasses.size(); ++i) {
+		const auto& subclassInfo = sRegisteredSubclasses[i];
+		if(!tried[i] && handlesExtension(subclassInfo) && ProbeResult::Unknown == probe(subclassInfo)) {
+			auto decoder = createDecoder(i, true);
+			if(decoder)
+				return decoder;
+		}
+	}
+
+	if(error && preferredError) {
+		*error = preferredError.Relinquish();
+		return nullptr;
+	}
+
+	// No subclass handling the file's type was able to try it
+	if(error) {
+		SFB::CFString description(CFCopyLocalizedString(CFSTR("The type of the file “%@” could not be determined."), ""));
+		SFB::CFString failureReason(CFCopyLocalizedString(CFSTR("Unknown file type"), ""));
+		SFB::CFString recoverySuggestion(CFCopyLocalizedString(CFSTR("The file's extension may be missing or may not match the file's type."), ""));
+
+		*error = CreateErrorForURL(InputSource::ErrorDomain, InputSource::FileNotFoundError, description, inputURL, failureReason, recoverySuggestion);
+	}
+
 	return nullptr;
 }
 
+bool SFB::Audio::Decoder::ReadFileHeader(InputSource& inputSource, std::vector<uint8_t>& header)
+{
+	// The header must be read from the start of the input and the offset restored afterwards
+	if(!inputSource.IsOpen() || !inputSource.SupportsSeeking())
+		return false;
+
+	SInt64 offset = inputSource.GetOffset();
+
+	SInt64 headerOffset = 0;
+	header.resize(kProbeByteCount);
+
+	bool success = inputSource.SeekToOffset(headerOffset);
+	SInt64 bytesRead = success ? inputSource.Read(header.data(), (SInt64)header.size()) : -1;
+
+	// Skip a leading ID3v2 tag, whose size is a 28-bit synchsafe integer excluding the 10-byte header and optional footer
+	if(10 <= bytesRead && 0 == memcmp(header.data(), "ID3", 3) && 0xff != header[3] && 0xff != header[4] && 0 == ((header[6] | header[7] | header[8] | header[9]) & 0x80)) {
+		headerOffset = 10 + (((SInt64)header[6] << 21) | ((SInt64)header[7] << 14) | ((SInt64)header[8] << 7) | (SInt64)header[9]);
+		if(0x10 & header[5])
+			headerOffset += 10;
+
+		success = inputSource.SeekToOffset(headerOffset);
+		bytesRead = success ? inputSource.Read(header.data(), (SInt64)header.size()) : -1;
+	}
+
+	if(!inputSource.SeekToOffset(offset)) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.Decoder", "Unable to restore input source offset after probing");
+		return false;
+	}
+
+	if(0 > bytesRead)
+		return false;
+
+	header.resize((size_t)bytesRead);
+	return true;
+}
+
+SFB::Audio::Decoder::ProbeResult SFB::Audio::Decoder::ProbeOggStream(const uint8_t *bytes, size_t count, const void *signature, size_t signatureLength)
+{
+	// An Ogg page header is 27 bytes followed by the segment table and the first packet
+	if(27 > count || 0 != memcmp(bytes, "OggS", 4))
+		return ProbeResult::NoMatch;
+
+	size_t packetOffset = 27 + bytes[26];
+	if(packetOffset + signatureLength <= count && 0 == memcmp(bytes + packetOffset, signature, signatureLength))
+		return ProbeResult::Match;
+
+	// The first logical stream in a multiplexed file may be something else, such as a Skeleton
+	return ProbeResult::Unknown;
+}
+
 #pragma mark Creation and Destruction
 
 SFB::Audio::Decoder::Decoder()
-	: mInputSource(nullptr), mRepresentedObject(nullptr), mRepresentedObjectCleanupBlock(nullptr), mIsOpen(false)
+	: mInputSource(nullptr), mRepresentedObject(nullptr), mRepresentedObjectCleanupBlock(nullptr), mIsOpen(false), mPrimingFrames(0), mValidFrames(-1)
 {
 	memset(&mFormat, 0, sizeof(mFormat));
 	memset(&mSourceFormat, 0, sizeof(mSourceFormat));
 }
 
 SFB::Audio::Decoder::Decoder(InputSource::unique_ptr inputSource)
-	: mInputSource(std::move(inputSource)), mRepresentedObject(nullptr), mRepresentedObjectCleanupBlock(nullptr), mIsOpen(false)
+	: mInputSource(std::move(inputSource)), mRepresentedObject(nullptr), mRepresentedObjectCleanupBlock(nullptr), mIsOpen(false), mPrimingFrames(0), mValidFrames(-1)
 {
 	assert(nullptr != mInputSource);
 
@@ -236,9 +336,19 @@ bool SFB::Audio::Decoder::Open(CFErrorRef *error)
 	if(!GetInputSource().IsOpen() && !GetInputSource().Open(error))
 		return false;
 
+	mPrimingFrames = 0;
+	mValidFrames = -1;
+
 	bool result = _Open(error);
-	if(result)
+	if(result) {
 		mIsOpen = true;
+
+		if(0 < mPrimingFrames && !SkipPrimingFrames()) {
+			LOGGER_WARNING("org.sbooth.AudioEngine.Decoder", "Unable to skip " << mPrimingFrames << " priming frames; gapless trimming disabled");
+			mPrimingFrames = 0;
+			mValidFrames = -1;
+		}
+	}
 	return result;
 }
 
@@ -325,9 +435,67 @@ UInt32 SFB::Audio::Decoder::ReadAudio(AudioBufferList *bufferList, UInt32 frameC
 		return 0;
 	}
 
+	// Don't read past the remainder frames
+	if(-1 != mValidFrames) {
+		SInt64 framesRemaining = std::max(mValidFrames - GetCurrentFrame(), (SInt64)0);
+		if(0 == framesRemaining) {
+			for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
+				bufferList->mBuffers[i].mDataByteSize = 0;
+			return 0;
+		}
+
+		frameCount = (UInt32)std::min((SInt64)frameCount, framesRemaining);
+	}
+
 	return _ReadAudio(bufferList, frameCount);
 }
 
+UInt64 SFB::Audio::Decoder::ReadAudioBatch(AudioBufferList * const *bufferLists, const UInt32 *frameCounts, size_t count)
+{
+	if(!IsOpen()) {
+		LOGGER_INFO("org.sbooth.AudioEngine.Decoder", "ReadAudioBatch() called on a Decoder that hasn't been opened");
+		return 0;
+	}
+
+	if(nullptr == bufferLists || nullptr == frameCounts || 0 == count || std::any_of(bufferLists, bufferLists + count, [](const AudioBufferList *bufferList) { return nullptr == bufferList; })) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.Decoder", "ReadAudioBatch() called with invalid parameters");
+		return 0;
+	}
+
+	if(-1 == mValidFrames)
+		return _ReadAudioBatch(bufferLists, frameCounts, count);
+
+	// Don't read past the remainder frames: the batch ends with the buffer in which they begin,
+	// which is the only one whose frame count must be reduced
+	SInt64 framesRemaining = std::max(mValidFrames - GetCurrentFrame(), (SInt64)0);
+	size_t unclampedCount = 0;
+	UInt64 unclampedFrames = 0;
+	while(unclampedCount < count && frameCounts[unclampedCount] <= framesRemaining) {
+		framesRemaining -= frameCounts[unclampedCount];
+		unclampedFrames += frameCounts[unclampedCount];
+		++unclampedCount;
+	}
+
+	if(unclampedCount == count)
+		return _ReadAudioBatch(bufferLists, frameCounts, count);
+
+	UInt64 framesRead = 0;
+	if(0 < unclampedCount) {
+		framesRead = _ReadAudioBatch(bufferLists, frameCounts, unclampedCount);
+		if(framesRead < unclampedFrames)
+			return framesRead;
+	}
+
+	UInt32 frameCount = (UInt32)framesRemaining;
+	if(0 == frameCount) {
+		for(UInt32 i = 0; i < bufferLists[unclampedCount]->mNumberBuffers; ++i)
+			bufferLists[unclampedCount]->mBuffers[i].mDataByteSize = 0;
+		return framesRead;
+	}
+
+	return framesRead + _ReadAudioBatch(bufferLists + unclampedCount, &frameCount, 1);
+}
+
 SInt64 SFB::Audio::Decoder::GetTotalFrames() const
 {
 	if(!IsOpen()) {
@@ -335,7 +503,14 @@ SInt64 SFB::Audio::Decoder::GetTotalFrames() const
 		return -1;
 	}
 
-	return _GetTotalFrames();
+	if(-1 != mValidFrames)
+		return mValidFrames;
+
+	SInt64 totalFrames = _GetTotalFrames();
+	if(-1 == totalFrames)
+		return -1;
+
+	return std::max(totalFrames - mPrimingFrames, (SInt64)0);
 }
 
 SInt64 SFB::Audio::Decoder::GetCurrentFrame() const
@@ -345,7 +520,11 @@ SInt64 SFB::Audio::Decoder::GetCurrentFrame() const
 		return -1;
 	}
 
-	return _GetCurrentFrame();
+	SInt64 currentFrame = _GetCurrentFrame();
+	if(-1 == currentFrame)
+		return -1;
+
+	return std::max(currentFrame - mPrimingFrames, (SInt64)0);
 }
 
 bool SFB::Audio::Decoder::SupportsSeeking() const
@@ -370,5 +549,292 @@ SInt64 SFB::Audio::Decoder::SeekToFrame(SInt64 frame)
 		return -1;
 	}
 
-	return _SeekToFrame(frame);
+	SInt64 currentFrame = _SeekToFrame(frame + mPrimingFrames);
+	if(-1 == currentFrame)
+		return -1;
+
+	return std::max(currentFrame - mPrimingFrames, (SInt64)0);
+}
+
+#pragma mark Gapless Trimming
+
+void SFB::Audio::Decoder::SetPrimingAndValidFrames(SInt64 primingFrames, SInt64 validFrames)
+{
+	mPrimingFrames = std::max(primingFrames, (SInt64)0);
+	mValidFrames = std::max(validFrames, (SInt64)-1);
+}
+
+bool SFB::Audio::Decoder::SkipPrimingFrames()
+{
+	if(_SupportsSeeking() && mPrimingFrames == _SeekToFrame(mPrimingFrames))
+		return true;
+
+	// Decode and discard the priming frames if seeking isn't possible
+	SInt64 currentFrame = _GetCurrentFrame();
+	if(-1 == currentFrame || currentFrame > mPrimingFrames)
+		return false;
+
+	BufferList discardBuffer;
+	if(!discardBuffer.Allocate(mFormat, 4096))
+		return false;
+
+	while(currentFrame < mPrimingFrames) {
+		discardBuffer.Reset();
+		UInt32 framesToRead = (UInt32)std::min(mPrimingFrames - currentFrame, (SInt64)discardBuffer.GetCapacityFrames());
+		UInt32 framesRead = _ReadAudio(discardBuffer, framesToRead);
+		if(0 == framesRead)
+			return false;
+		currentFrame += framesRead;
+	}
+
+	return true;
+}
+
+#pragma mark Batch Decoding
+
+UInt64 SFB::Audio::Decoder::_ReadAudioBatch(AudioBufferList * const *bufferLists, const UInt32 *frameCounts, size_t count)
+{
+	UInt64 framesRead = 0;
+
+	for(size_t i = 0; i < count; ++i) {
+		// Skip empty requests, which ReadAudio() treats as errors
+		if(0 == frameCounts[i]) {
+			for(UInt32 bufferIndex = 0; bufferIndex < bufferLists[i]->mNumberBuffers; ++bufferIndex)
+				bufferLists[i]->mBuffers[bufferIndex].mDataByteSize = 0;
+			continue;
+		}
+
+		UInt32 framesReadIntoBuffer = _ReadAudio(bufferLists[i], frameCounts[i]);
+		framesRead += framesReadIntoBuffer;
+
+		// A short read means the end of the audio or an error
+		if(framesReadIntoBuffer < frameCounts[i])
+			break;
+	}
+
+	return framesRead;
+}
+
+#pragma mark Staging Buffer
+
+SFB::Audio::Decoder::StagingBuffer::StagingBuffer()
+	: mWriteBuffers(nullptr, free), mReadOffset(0), mWriteOffset(0), mOutputLists(nullptr), mOutputFrameCounts(nullptr), mOutputCount(0), mOutputIndex(0), mOutput(nullptr), mOutputBuffers(nullptr, free), mOutputOffset(0), mOutputEnd(0), mOutputFramesWritten(0)
+{}
+
+bool SFB::Audio::Decoder::StagingBuffer::Allocate(const AudioFormat& format, UInt32 capacityFrames)
+{
+	Deallocate();
+
+	if(!mBufferList.Allocate(format, capacityFrames))
+		return false;
+
+	size_t headerSize = offsetof(AudioBufferList, mBuffers) + (sizeof(AudioBuffer) * mBufferList->mNumberBuffers);
+	void *writeAllocation = calloc(1, headerSize);
+	void *outputAllocation = calloc(1, headerSize);
+	if(nullptr == writeAllocation || nullptr == outputAllocation) {
+		free(writeAllocation);
+		free(outputAllocation);
+		mBufferList.Deallocate();
+		return false;
+	}
+
+	mWriteBuffers.reset((AudioBufferList *)writeAllocation);
+	mOutputBuffers.reset((AudioBufferList *)outputAllocation);
+	mWriteBuffers->mNumberBuffers = mOutputBuffers->mNumberBuffers = mBufferList->mNumberBuffers;
+	for(UInt32 bufferIndex = 0; bufferIndex < mBufferList->mNumberBuffers; ++bufferIndex)
+		mWriteBuffers->mBuffers[bufferIndex].mNumberChannels = mOutputBuffers->mBuffers[bufferIndex].mNumberChannels = mBufferList->mBuffers[bufferIndex].mNumberChannels;
+
+	return true;
+}
+
+void SFB::Audio::Decoder::StagingBuffer::Deallocate()
+{
+	ClearOutput();
+	mOutputBuffers.reset();
+	mWriteBuffers.reset();
+	mBufferList.Deallocate();
+	Reset();
+}
+
+AudioBufferList * SFB::Audio::Decoder::StagingBuffer::GetWriteBuffers(UInt32 frameCount)
+{
+	if(!mBufferList || frameCount > GetCapacityFrames() - GetFramesAvailable())
+		return nullptr;
+
+	const auto& format = mBufferList.GetFormat();
+
+	// Compact the leftover audio only if the append won't fit after it
+	if(frameCount > GetCapacityFrames() - mWriteOffset) {
+		size_t byteOffset = format.FrameCountToByteCount(mReadOffset);
+		size_t byteCount = format.FrameCountToByteCount(GetFramesAvailable());
+		for(UInt32 bufferIndex = 0; bufferIndex < mBufferList->mNumberBuffers; ++bufferIndex) {
+			uint8_t *data = (uint8_t *)mBufferList->mBuffers[bufferIndex].mData;
+			memmove(data, data + byteOffset, byteCount);
+		}
+
+		mWriteOffset -= mReadOffset;
+		mReadOffset = 0;
+	}
+
+	size_t byteOffset = format.FrameCountToByteCount(mWriteOffset);
+	for(UInt32 bufferIndex = 0; bufferIndex < mBufferList->mNumberBuffers; ++bufferIndex) {
+		mWriteBuffers->mBuffers[bufferIndex].mData = (uint8_t *)mBufferList->mBuffers[bufferIndex].mData + byteOffset;
+		mWriteBuffers->mBuffers[bufferIndex].mDataByteSize = (UInt32)format.FrameCountToByteCount(frameCount);
+	}
+
+	return mWriteBuffers.get();
+}
+
+void SFB::Audio::Decoder::StagingBuffer::CommitWrite(UInt32 frameCount)
+{
+	mWriteOffset += std::min(frameCount, GetCapacityFrames() - mWriteOffset);
+}
+
+UInt32 SFB::Audio::Decoder::StagingBuffer::ReadAudio(AudioBufferList *bufferList, UInt32 frameOffset, UInt32 frameCount)
+{
+	if(!mBufferList || bufferList->mNumberBuffers != mBufferList->mNumberBuffers)
+		return 0;
+
+	UInt32 framesToCopy = std::min(frameCount, GetFramesAvailable());
+
+	const auto& format = mBufferList.GetFormat();
+	size_t srcOffset = format.FrameCountToByteCount(mReadOffset);
+	size_t destOffset = format.FrameCountToByteCount(frameOffset);
+	size_t byteCount = format.FrameCountToByteCount(framesToCopy);
+	for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex) {
+		memcpy((uint8_t *)bufferList->mBuffers[bufferIndex].mData + destOffset, (const uint8_t *)mBufferList->mBuffers[bufferIndex].mData + srcOffset, byteCount);
+		bufferList->mBuffers[bufferIndex].mDataByteSize = (UInt32)(destOffset + byteCount);
+	}
+
+	Skip(framesToCopy);
+
+	return framesToCopy;
+}
+
+UInt32 SFB::Audio::Decoder::StagingBuffer::Skip(UInt32 frameCount)
+{
+	UInt32 framesToSkip = std::min(frameCount, GetFramesAvailable());
+	mReadOffset += framesToSkip;
+
+	// Rewind once empty so the next codec frame is written at the start of the buffer
+	if(mReadOffset == mWriteOffset)
+		Reset();
+
+	return framesToSkip;
+}
+
+void SFB::Audio::Decoder::StagingBuffer::SetOutput(AudioBufferList * const *bufferLists, const UInt32 *frameCounts, size_t count)
+{
+	ClearOutput();
+
+	if(!mBufferList || nullptr == bufferLists || nullptr == frameCounts)
+		return;
+
+	mOutputLists = bufferLists;
+	mOutputFrameCounts = frameCounts;
+	mOutputCount = count;
+
+	SelectOutput(0);
+}
+
+UInt64 SFB::Audio::Decoder::StagingBuffer::ClearOutput()
+{
+	UInt64 framesWritten = mOutputFramesWritten;
+
+	mOutputLists = nullptr;
+	mOutputFrameCounts = nullptr;
+	mOutputCount = mOutputIndex = 0;
+	mOutput = nullptr;
+	mOutputOffset = mOutputEnd = 0;
+	mOutputFramesWritten = 0;
+
+	return framesWritten;
+}
+
+UInt64 SFB::Audio::Decoder::StagingBuffer::CopyToOutput()
+{
+	const auto& format = mBufferList.GetFormat();
+
+	UInt64 framesCopied = 0;
+	while(nullptr != mOutput && GetFramesAvailable()) {
+		UInt32 framesToCopy = std::min(GetFramesAvailable(), mOutputEnd - mOutputOffset);
+
+		size_t srcOffset = format.FrameCountToByteCount(mReadOffset);
+		size_t destOffset = format.FrameCountToByteCount(mOutputOffset);
+		size_t byteCount = format.FrameCountToByteCount(framesToCopy);
+		for(UInt32 bufferIndex = 0; bufferIndex < mOutput->mNumberBuffers; ++bufferIndex)
+			memcpy((uint8_t *)mOutput->mBuffers[bufferIndex].mData + destOffset, (const uint8_t *)mBufferList->mBuffers[bufferIndex].mData + srcOffset, byteCount);
+
+		Skip(framesToCopy);
+		CommitOutput(framesToCopy);
+
+		framesCopied += framesToCopy;
+	}
+
+	return framesCopied;
+}
+
+UInt32 SFB::Audio::Decoder::StagingBuffer::GetOutputFramesAvailable() const
+{
+	if(nullptr == mOutput || GetFramesAvailable())
+		return 0;
+
+	return mOutputEnd - mOutputOffset;
+}
+
+AudioBufferList * SFB::Audio::Decoder::StagingBuffer::GetOutputBuffers(UInt32 frameCount)
+{
+	if(frameCount > GetOutputFramesAvailable())
+		return nullptr;
+
+	const auto& format = mBufferList.GetFormat();
+	size_t byteOffset = format.FrameCountToByteCount(mOutputOffset);
+	for(UInt32 bufferIndex = 0; bufferIndex < mOutput->mNumberBuffers; ++bufferIndex) {
+		mOutputBuffers->mBuffers[bufferIndex].mData = (uint8_t *)mOutput->mBuffers[bufferIndex].mData + byteOffset;
+		mOutputBuffers->mBuffers[bufferIndex].mDataByteSize = (UInt32)format.FrameCountToByteCount(frameCount);
+	}
+
+	return mOutputBuffers.get();
+}
+
+void SFB::Audio::Decoder::StagingBuffer::CommitOutput(UInt32 frameCount)
+{
+	if(nullptr == mOutput)
+		return;
+
+	frameCount = std::min(frameCount, mOutputEnd - mOutputOffset);
+	mOutputOffset += frameCount;
+	mOutputFramesWritten += frameCount;
+
+	UInt32 byteSize = (UInt32)mBufferList.GetFormat().FrameCountToByteCount(mOutputOffset);
+	for(UInt32 bufferIndex = 0; bufferIndex < mOutput->mNumberBuffers; ++bufferIndex)
+		mOutput->mBuffers[bufferIndex].mDataByteSize = byteSize;
+
+	// Continue in the next buffer
+	if(mOutputOffset == mOutputEnd)
+		SelectOutput(mOutputIndex + 1);
+}
+
+void SFB::Audio::Decoder::StagingBuffer::SelectOutput(size_t index)
+{
+	mOutput = nullptr;
+	mOutputOffset = mOutputEnd = 0;
+
+	// Skip buffers with no room, which are treated as empty reads
+	for(mOutputIndex = index; mOutputIndex < mOutputCount; ++mOutputIndex) {
+		AudioBufferList *bufferList = mOutputLists[mOutputIndex];
+
+		// The output must match the staged audio's layout
+		if(nullptr == bufferList || bufferList->mNumberBuffers != mBufferList->mNumberBuffers)
+			return;
+
+		for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex)
+			bufferList->mBuffers[bufferIndex].mDataByteSize = 0;
+
+		if(0 < mOutputFrameCounts[mOutputIndex]) {
+			mOutput = bufferList;
+			mOutputEnd = mOutputFrameCounts[mOutputIndex];
+			return;
+		}
+	}
 }
@@ -15,6 +15,7 @@
 #include "InputSource.h"
 #include "AudioFormat.h"
 #include "AudioChannelLayout.h"
+#include "AudioBufferList.h"
 
 /*! @file AudioDecoder.h @brief Support for decoding audio to PCM */
 
@@ -70,6 +71,30 @@ namespace SFB {
 			/*! @brief Test whether a MIME type is supported */
 			static bool HandlesMIMEType(CFStringRef mimeType);
 
+
+			/*! @brief The number of bytes at the start of a file passed to \c ProbeFileHeader() */
+			static constexpr size_t kProbeByteCount = 4096;
+
+			/*! @brief The result of examining the start of a file for a format's signature */
+			enum class ProbeResult {
+				NoMatch,	/*!< The file is not in the format */
+				Unknown,	/*!< The format has no reliable signature, so the file must be opened to tell */
+				Match		/*!< The file's signature matches the format */
+			};
+
+			/*!
+			 * @brief Examine the start of a file for a format's signature
+			 *
+			 * The factory methods read the start of the input once and pass it to each subclass's probe,
+			 * so a decoder is only opened if the file could be in its format.  Subclasses whose formats have
+			 * signatures should hide this method with their own.
+			 * @note A leading ID3v2 tag is skipped before probing
+			 * @param bytes The first bytes of the file
+			 * @param count The number of bytes in \c bytes, at most \c kProbeByteCount
+			 * @return The result of the probe
+			 */
+			static inline ProbeResult ProbeFileHeader(const uint8_t */*bytes*/, size_t /*count*/)	{ return ProbeResult::Unknown; }
+
 			//@}
 
 
@@ -272,6 +297,21 @@ namespace SFB {
 			 */
 			UInt32 ReadAudio(AudioBufferList *bufferList, UInt32 frameCount);
 
+			/*!
+			 * @brief Decode audio into a sequence of buffers
+			 *
+			 * This is equivalent to calling \c ReadAudio() for each buffer in turn until one isn't filled,
+			 * but the decoder's state and the parameters are checked once per batch instead of once per
+			 * buffer.  Decoders that stage audio write each codec frame directly to as many consecutive
+			 * buffers as it spans, staging only what doesn't fit in the last buffer, so small buffers
+			 * don't cause a codec frame to be staged and copied repeatedly.
+			 * @param bufferLists The buffers to receive the decoded audio; \c mDataByteSize is set as in \c ReadAudio(), except for buffers following a short read which are left untouched
+			 * @param frameCounts The requested number of audio frames for each buffer
+			 * @param count The number of buffers
+			 * @return The total number of frames read, or \c 0 on error
+			 */
+			UInt64 ReadAudioBatch(AudioBufferList * const *bufferLists, const UInt32 *frameCounts, size_t count);
+
 
 			/*! @brief Get the total number of audio frames */
 			SInt64 GetTotalFrames() const ;
@@ -311,6 +351,199 @@ namespace SFB {
 			/*! @brief Create a new \c Decoder and initialize \c Decoder::mInputSource to \c inputSource */
 			explicit Decoder(InputSource::unique_ptr inputSource);
 
+
+			/*!
+			 * @brief Probe for an Ogg stream whose first packet starts with \c signature
+			 * @note This is intended for use by \c ProbeFileHeader() in subclasses
+			 * @return \c ProbeResult::Match if the first packet matches, \c ProbeResult::Unknown for other
+			 * Ogg streams since the first logical stream may not be audio, and \c ProbeResult::NoMatch otherwise
+			 */
+			static ProbeResult ProbeOggStream(const uint8_t *bytes, size_t count, const void *signature, size_t signatureLength);
+
+			/*!
+			 * @brief Read the first \c kProbeByteCount bytes of \c inputSource following any ID3v2 tag, preserving its offset
+			 * @note This is intended for use by subclasses whose container can't be determined from the extension
+			 * @param inputSource The input source, which must be open and support seeking
+			 * @param header A \c std::vector to receive the bytes
+			 * @return \c true on success, \c false otherwise
+			 */
+			static bool ReadFileHeader(InputSource& inputSource, std::vector<uint8_t>& header);
+
+
+			/*!
+			 * @brief Trim encoder delay and padding from the decoded audio
+			 *
+			 * Subclasses whose codec library doesn't remove the priming and remainder frames added by the
+			 * encoder call this from \c _Open() with the values from the file's metadata.  Frames
+			 * [\c primingFrames, \c primingFrames + \c validFrames) of the subclass's audio are then
+			 * presented as frames [0, \c validFrames) by \c ReadAudio(), \c GetTotalFrames(),
+			 * \c GetCurrentFrame() and \c SeekToFrame(), so gapless playback is sample accurate.
+			 *
+			 * \c _GetTotalFrames(), \c _GetCurrentFrame() and \c _SeekToFrame() continue to use untrimmed frames.
+			 * @param primingFrames The number of frames of encoder delay at the start of the audio
+			 * @param validFrames The number of frames of audio following the priming frames, or \c -1 if unknown
+			 */
+			void SetPrimingAndValidFrames(SInt64 primingFrames, SInt64 validFrames);
+
+
+			/*!
+			 * @brief Audio staged between a push-model codec and the pull-model \c ReadAudio()
+			 *
+			 * Staged audio is tracked with read and write cursors so consuming part of it never moves
+			 * the remainder.  The cursors rewind whenever the buffer empties, and leftover audio is only
+			 * compacted when an append would not otherwise fit.
+			 *
+			 * While a read is in progress the caller's buffers may be registered with \c SetOutput() so
+			 * decoded audio can be written to them directly, with only the remainder of a codec frame
+			 * that doesn't fit in the last buffer being staged.
+			 */
+			class StagingBuffer
+			{
+			public:
+				/*! @brief Create a new, empty \c StagingBuffer */
+				StagingBuffer();
+
+				/*! @cond */
+
+				/*! @internal This class is non-copyable */
+				StagingBuffer(const StagingBuffer& rhs) = delete;
+
+				/*! @internal This class is non-assignable */
+				StagingBuffer& operator=(const StagingBuffer& rhs) = delete;
+
+				/*! @endcond */
+
+				/*!
+				 * @brief Allocate space for audio
+				 * @param format The format of the audio
+				 * @param capacityFrames The capacity in frames, normally the largest codec frame
+				 * @return \c true on success, \c false otherwise
+				 */
+				bool Allocate(const AudioFormat& format, UInt32 capacityFrames);
+
+				/*! @brief Free the memory used by this \c StagingBuffer */
+				void Deallocate();
+
+				/*! @brief Query whether this \c StagingBuffer is allocated */
+				inline explicit operator bool() const				{ return (bool)mBufferList; }
+
+				/*! @brief Get the format of the staged audio */
+				inline const AudioFormat& GetFormat() const			{ return mBufferList.GetFormat(); }
+
+				/*! @brief Get the capacity of this \c StagingBuffer in frames */
+				inline UInt32 GetCapacityFrames() const				{ return mBufferList.GetCapacityFrames(); }
+
+				/*! @brief Get the number of staged frames */
+				inline UInt32 GetFramesAvailable() const			{ return mWriteOffset - mReadOffset; }
+
+				/*! @brief Discard all staged audio */
+				inline void Reset()									{ mReadOffset = mWriteOffset = 0; }
+
+
+				/*!
+				 * @brief Get buffers for appending audio
+				 *
+				 * Each returned buffer points at the write position with \c mDataByteSize set to \c frameCount frames.
+				 * The buffers remain valid until the next call to a non-const method.
+				 * @param frameCount The number of frames to be written
+				 * @return The buffers, or \c nullptr if \c frameCount frames won't fit
+				 */
+				AudioBufferList * GetWriteBuffers(UInt32 frameCount);
+
+				/*!
+				 * @brief Make audio written to the buffers from \c GetWriteBuffers() available for reading
+				 * @param frameCount The number of frames written
+				 */
+				void CommitWrite(UInt32 frameCount);
+
+
+				/*!
+				 * @brief Copy staged audio to \c bufferList and consume it
+				 * @param bufferList The destination; its \c mDataByteSize is set to the end of the copied audio
+				 * @param frameOffset The frame offset in \c bufferList at which to begin writing
+				 * @param frameCount The maximum number of frames to copy
+				 * @return The number of frames copied
+				 */
+				UInt32 ReadAudio(AudioBufferList *bufferList, UInt32 frameOffset, UInt32 frameCount);
+
+				/*!
+				 * @brief Consume staged audio without copying it
+				 * @param frameCount The maximum number of frames to consume
+				 * @return The number of frames consumed
+				 */
+				UInt32 Skip(UInt32 frameCount);
+
+
+				/*!
+				 * @brief Register the caller's buffers as the destination for decoded audio
+				 *
+				 * The buffers are filled in turn, each one's \c mDataByteSize being set to the end of the audio
+				 * written to it as in \c ReadAudio().  Buffers following the one being written are untouched.
+				 * @param bufferLists The destinations passed to \c _ReadAudioBatch()
+				 * @param frameCounts The number of frames each buffer has room for
+				 * @param count The number of buffers
+				 */
+				void SetOutput(AudioBufferList * const *bufferLists, const UInt32 *frameCounts, size_t count);
+
+				/*!
+				 * @brief Unregister the buffers passed to \c SetOutput()
+				 * @return The total number of frames written to the buffers
+				 */
+				UInt64 ClearOutput();
+
+				/*! @brief Query whether the registered buffers are full, or no buffers are registered */
+				inline bool IsOutputFull() const					{ return nullptr == mOutput; }
+
+				/*!
+				 * @brief Copy staged audio to the registered buffers and consume it
+				 * @return The number of frames copied
+				 */
+				UInt64 CopyToOutput();
+
+				/*!
+				 * @brief Get the number of frames that may be written directly to the registered buffer being filled
+				 * @note This is zero while audio is staged, since staged audio must be copied first
+				 */
+				UInt32 GetOutputFramesAvailable() const;
+
+				/*!
+				 * @brief Get buffers for writing directly to the registered buffers
+				 *
+				 * Each returned buffer points at the output position with \c mDataByteSize set to \c frameCount frames.
+				 * The buffers remain valid until the next call to a non-const method.
+				 * @param frameCount The number of frames to be written
+				 * @return The buffers, or \c nullptr if \c frameCount exceeds \c GetOutputFramesAvailable()
+				 */
+				AudioBufferList * GetOutputBuffers(UInt32 frameCount);
+
+				/*!
+				 * @brief Account for audio written to the buffers from \c GetOutputBuffers()
+				 *
+				 * Once the registered buffer being filled is full, output continues in the next one.
+				 * @param frameCount The number of frames written
+				 */
+				void CommitOutput(UInt32 frameCount);
+
+			private:
+				/*! @brief Begin writing to the registered buffer at \c index, or end output if there is none */
+				void SelectOutput(size_t index);
+
+				BufferList										mBufferList;	/*!< The staged audio */
+				std::unique_ptr<AudioBufferList, void (*)(void *)>	mWriteBuffers;	/*!< Buffers pointing into \c mBufferList at the write position */
+				UInt32											mReadOffset;	/*!< The offset of the first staged frame */
+				UInt32											mWriteOffset;	/*!< The offset following the last staged frame */
+
+				AudioBufferList * const							*mOutputLists;	/*!< The caller's buffers */
+				const UInt32									*mOutputFrameCounts;	/*!< The capacity of each of the caller's buffers */
+				size_t											mOutputCount;	/*!< The number of the caller's buffers */
+				size_t											mOutputIndex;	/*!< The index of the buffer being written */
+				AudioBufferList									*mOutput;		/*!< The buffer being written, or \c nullptr */
+				std::unique_ptr<AudioBufferList, void (*)(void *)>	mOutputBuffers;	/*!< Buffers pointing into \c mOutput at the output position */
+				UInt32											mOutputOffset;	/*!< The offset in \c mOutput of the next frame to be written */
+				UInt32											mOutputEnd;		/*!< The offset in \c mOutput following the last writable frame */
+				UInt64											mOutputFramesWritten;	/*!< The total number of frames written to the caller's buffers */
+			};
+
 		private:
 
 			// Override these carefully
@@ -325,6 +558,9 @@ namespace SFB {
 
 			virtual UInt32 _ReadAudio(AudioBufferList *bufferList, UInt32 frameCount) = 0;
 
+			// Optional batch decoding support; the default implementation calls _ReadAudio() for each buffer
+			virtual UInt64 _ReadAudioBatch(AudioBufferList * const *bufferLists, const UInt32 *frameCounts, size_t count);
+
 			virtual SInt64 _GetTotalFrames() const = 0;
 			virtual SInt64 _GetCurrentFrame() const = 0;
 
@@ -338,6 +574,12 @@ namespace SFB {
 
 			bool							mIsOpen;
 
+			SInt64							mPrimingFrames;		// Frames trimmed from the start of the subclass's audio
+			SInt64							mValidFrames;		// Frames following the priming frames, or -1 if not trimmed
+
+			// Discard the priming frames after opening
+			bool SkipPrimingFrames();
+
 			// ========================================
 			// Controls whether Open() is called for decoders created in the factory methods
 			static std::atomic_bool			sAutomaticallyOpenDecoders;
@@ -352,6 +594,8 @@ namespace SFB {
 				bool (*mHandlesFilesWithExtension)(CFStringRef);
 				bool (*mHandlesMIMEType)(CFStringRef);
 
+				ProbeResult (*mProbeFileHeader)(const uint8_t *, size_t);
+
 				Decoder::unique_ptr (*mCreateDecoder)(InputSource::unique_ptr);
 
 				int mPriority;
@@ -381,6 +625,8 @@ namespace SFB {
 				.mHandlesFilesWithExtension = T::HandlesFilesWithExtension,
 				.mHandlesMIMEType = T::HandlesMIMEType,
 
+				.mProbeFileHeader = T::ProbeFileHeader,
+
 				.mCreateDecoder = T::CreateDecoder,
 
 				.mPriority = priority
@@ -364,6 +364,19 @@ bool SFB::Audio::CoreAudioDecoder::_Open(CFErrorRef *error)
 		return false;
 	}
 
+	// ExtAudioFile normally trims the priming and remainder frames in the packet table, but if its length
+	// includes them trim them here instead
+	AudioFilePacketTableInfo packetTableInfo;
+	dataSize = sizeof(packetTableInfo);
+	result = AudioFileGetProperty(audioFile, kAudioFilePropertyPacketTableInfo, &dataSize, &packetTableInfo);
+	if(noErr == result && (0 < packetTableInfo.mPrimingFrames || 0 < packetTableInfo.mRemainderFrames)) {
+		SInt64 totalFrames = _GetTotalFrames();
+		if(totalFrames == packetTableInfo.mNumberValidFrames + packetTableInfo.mPrimingFrames + packetTableInfo.mRemainderFrames) {
+			LOGGER_DEBUG("org.sbooth.AudioEngine.Decoder.CoreAudio", "Trimming " << packetTableInfo.mPrimingFrames << " priming frames and " << packetTableInfo.mRemainderFrames << " remainder frames");
+			SetPrimingAndValidFrames(packetTableInfo.mPrimingFrames, packetTableInfo.mNumberValidFrames);
+		}
+	}
+
 	return true;
 }
 
@@ -416,6 +429,35 @@ UInt32 SFB::Audio::CoreAudioDecoder::_ReadAudio(AudioBufferList *bufferList, UIn
 	return frameCount;
 }
 
+UInt64 SFB::Audio::CoreAudioDecoder::_ReadAudioBatch(AudioBufferList * const *bufferLists, const UInt32 *frameCounts, size_t count)
+{
+	UInt64 framesRead = 0;
+
+	// ExtAudioFileRead() accepts a single buffer list, but it converts directly into each one without intermediate copies
+	for(size_t i = 0; i < count; ++i) {
+		UInt32 frameCount = frameCounts[i];
+		if(0 == frameCount) {
+			for(UInt32 bufferIndex = 0; bufferIndex < bufferLists[i]->mNumberBuffers; ++bufferIndex)
+				bufferLists[i]->mBuffers[bufferIndex].mDataByteSize = 0;
+			continue;
+		}
+
+		OSStatus result = ExtAudioFileRead(mExtAudioFile, &frameCount, bufferLists[i]);
+		if(noErr != result) {
+			LOGGER_ERR("org.sbooth.AudioEngine.Decoder.CoreAudio", "ExtAudioFileRead failed: " << result);
+			break;
+		}
+
+		framesRead += frameCount;
+
+		// A short read means the end of the audio
+		if(frameCount < frameCounts[i])
+			break;
+	}
+
+	return framesRead;
+}
+
 SInt64 SFB::Audio::CoreAudioDecoder::_GetTotalFrames() const
 {
 	SInt64 totalFrames = -1;
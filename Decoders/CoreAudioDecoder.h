@@ -46,6 +46,7 @@ namespace SFB {
 
 			// Attempt to read frameCount frames of audio, returning the actual number of frames read
 			virtual UInt32 _ReadAudio(AudioBufferList *bufferList, UInt32 frameCount);
+			virtual UInt64 _ReadAudioBatch(AudioBufferList * const *bufferLists, const UInt32 *frameCounts, size_t count);
 
 			// Source audio information
 			virtual SInt64 _GetTotalFrames() const;
@@ -14,6 +14,7 @@
 #include "DSDIFFDecoder.h"
 #include "CFErrorUtilities.h"
 #include "Logger.h"
+#include "SampleKernels.h"
 
 #define BUFFER_CHANNEL_SIZE_BYTES 512u
 
@@ -606,6 +607,21 @@ namespace {
 
 		return ParseFormDSDChunk(inputSource, chunkID, chunkDataSize);
 	}
+
+	// Deinterleave clustered frames (one channel byte per channel) and append them to bufferList
+	void AppendClusteredFrames(AudioBufferList *bufferList, const uint8_t *bytes, size_t byteCount)
+	{
+		uint8_t *channels [bufferList->mNumberBuffers];
+		for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
+			channels[i] = (uint8_t *)bufferList->mBuffers[i].mData + bufferList->mBuffers[i].mDataByteSize;
+
+		SFB::Audio::DeinterleaveSamples(bytes, channels, bufferList->mNumberBuffers, byteCount / bufferList->mNumberBuffers);
+
+		for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i) {
+			bufferList->mBuffers[i].mNumberChannels	= 1;
+			bufferList->mBuffers[i].mDataByteSize	+= byteCount / bufferList->mNumberBuffers;
+		}
+	}
 }
 
 #pragma mark Static Methods
@@ -644,6 +660,15 @@ bool SFB::Audio::DSDIFFDecoder::HandlesMIMEType(CFStringRef mimeType)
 	return false;
 }
 
+SFB::Audio::Decoder::ProbeResult SFB::Audio::DSDIFFDecoder::ProbeFileHeader(const uint8_t *bytes, size_t count)
+{
+	// A DSDIFF file is an FRM8 chunk with form type 'DSD '
+	if(16 > count)
+		return ProbeResult::NoMatch;
+
+	return (0 == memcmp(bytes, "FRM8", 4) && 0 == memcmp(bytes + 12, "DSD ", 4)) ? ProbeResult::Match : ProbeResult::NoMatch;
+}
+
 SFB::Audio::Decoder::unique_ptr SFB::Audio::DSDIFFDecoder::CreateDecoder(InputSource::unique_ptr inputSource)
 {
 	return unique_ptr(new DSDIFFDecoder(std::move(inputSource)));
@@ -765,9 +790,22 @@ UInt32 SFB::Audio::DSDIFFDecoder::_ReadAudio(AudioBufferList *bufferList, UInt32
 		// Read interleaved input, grouped as 8 one bit samples per frame (a single channel byte) into
 		// a clustered frame (one channel byte per channel)
 		// From a bit perspective for stereo: LLLLLLLLRRRRRRRRLLLLLLLLRRRRRRRR
-		uint8_t buffer [BUFFER_CHANNEL_SIZE_BYTES * mFormat.mChannelsPerFrame];
 		UInt32 bytesToRead = std::min(BUFFER_CHANNEL_SIZE_BYTES * mFormat.mChannelsPerFrame, (framesToRead / 8) * mFormat.mChannelsPerFrame);
-		auto bytesRead = GetInputSource().Read(buffer, bytesToRead);
+
+		// Deinterleave directly from memory-backed inputs, and otherwise through a bounce buffer
+		SInt64 bytesRead;
+		if(GetInputSource().SupportsBorrowing()) {
+			const uint8_t *bytes = nullptr;
+			bytesRead = GetInputSource().Borrow((const void **)&bytes, bytesToRead);
+			if(bytesRead == bytesToRead)
+				AppendClusteredFrames(bufferList, bytes, (size_t)bytesRead);
+		}
+		else {
+			uint8_t buffer [BUFFER_CHANNEL_SIZE_BYTES * mFormat.mChannelsPerFrame];
+			bytesRead = GetInputSource().Read(buffer, bytesToRead);
+			if(bytesRead == bytesToRead)
+				AppendClusteredFrames(bufferList, buffer, (size_t)bytesRead);
+		}
 
 		if(bytesRead != bytesToRead) {
 			LOGGER_WARNING("org.sbooth.AudioEngine.Decoder.DSDIFF", "Error reading audio: requested " << bytesToRead << " bytes, got " << bytesRead);
@@ -778,16 +816,6 @@ UInt32 SFB::Audio::DSDIFFDecoder::_ReadAudio(AudioBufferList *bufferList, UInt32
 		if(0 == bytesRead)
 			break;
 
-		// Deinterleave the clustered frames and copy to output
-		for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i) {
-			uint8_t *dst = (uint8_t *)bufferList->mBuffers[i].mData + bufferList->mBuffers[i].mDataByteSize;
-			for(SInt64 byteIndex = i; byteIndex < bytesRead; byteIndex += mFormat.mChannelsPerFrame)
-				*dst++ = buffer[byteIndex];
-
-			bufferList->mBuffers[i].mNumberChannels	= 1;
-			bufferList->mBuffers[i].mDataByteSize	+= bytesRead / mFormat.mChannelsPerFrame;
-		}
-
 		framesRead += (bytesRead / mFormat.mChannelsPerFrame) * 8;
 
 		// All requested frames were read
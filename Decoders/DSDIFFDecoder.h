@@ -27,6 +27,8 @@ namespace SFB {
 			static bool HandlesFilesWithExtension(CFStringRef extension);
 			static bool HandlesMIMEType(CFStringRef mimeType);
 
+			static ProbeResult ProbeFileHeader(const uint8_t *bytes, size_t count);
+
 			static Decoder::unique_ptr CreateDecoder(InputSource::unique_ptr inputSource);
 
 			// Creation and destruction
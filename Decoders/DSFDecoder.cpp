@@ -70,6 +70,14 @@ bool SFB::Audio::DSFDecoder::HandlesMIMEType(CFStringRef mimeType)
 	return false;
 }
 
+SFB::Audio::Decoder::ProbeResult SFB::Audio::DSFDecoder::ProbeFileHeader(const uint8_t *bytes, size_t count)
+{
+	if(4 > count)
+		return ProbeResult::NoMatch;
+
+	return 0 == memcmp(bytes, "DSD ", 4) ? ProbeResult::Match : ProbeResult::NoMatch;
+}
+
 SFB::Audio::Decoder::unique_ptr SFB::Audio::DSFDecoder::CreateDecoder(InputSource::unique_ptr inputSource)
 {
 	return unique_ptr(new DSFDecoder(std::move(inputSource)));
@@ -227,9 +235,7 @@ bool SFB::Audio::DSFDecoder::_Open(CFErrorRef *error)
 	// Metadata chunk is ignored
 
 	// Allocate buffers
-	mBufferList.Allocate(mFormat, (UInt32)mFormat.ByteCountToFrameCount(mBlockByteSizePerChannel));
-	for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i)
-		mBufferList->mBuffers[i].mDataByteSize = 0;
+	mStagingBuffer.Allocate(mFormat, (UInt32)mFormat.ByteCountToFrameCount(mBlockByteSizePerChannel));
 
 	return true;
 }
@@ -259,32 +265,9 @@ UInt32 SFB::Audio::DSFDecoder::_ReadAudio(AudioBufferList *bufferList, UInt32 fr
 	UInt32 framesToRead = std::min(frameCount, fileFramesRemaining);
 	UInt32 framesRead = 0;
 
-	// Reset output buffer data size
-	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
-		bufferList->mBuffers[i].mDataByteSize = 0;
-
 	for(;;) {
-		UInt32	framesRemaining	= framesToRead - framesRead;
-		UInt32	framesToSkip	= (UInt32)mFormat.ByteCountToFrameCount(bufferList->mBuffers[0].mDataByteSize);
-		UInt32	framesInBuffer	= (UInt32)mFormat.ByteCountToFrameCount(mBufferList->mBuffers[0].mDataByteSize);
-		UInt32	framesToCopy	= std::min(framesInBuffer, framesRemaining);
-
-		// Copy data from the buffer to output
-		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
-			uint8_t *dst = (uint8_t *)bufferList->mBuffers[i].mData;
-			memcpy(dst + mFormat.FrameCountToByteCount(framesToSkip), mBufferList->mBuffers[i].mData, mFormat.FrameCountToByteCount(framesToCopy));
-			bufferList->mBuffers[i].mDataByteSize += mFormat.FrameCountToByteCount(framesToCopy);
-
-			// Move remaining data in buffer to beginning
-			if(framesToCopy != framesInBuffer) {
-				dst = (uint8_t *)mBufferList->mBuffers[i].mData;
-				memmove(dst, dst + mFormat.FrameCountToByteCount(framesToCopy), mFormat.FrameCountToByteCount(framesInBuffer - framesToCopy));
-			}
-
-			mBufferList->mBuffers[i].mDataByteSize -= (UInt32)mFormat.FrameCountToByteCount(framesToCopy);
-		}
-
-		framesRead += framesToCopy;
+		// Copy staged audio to output
+		framesRead += mStagingBuffer.ReadAudio(bufferList, framesRead, framesToRead - framesRead);
 
 		// All requested frames were read
 		if(framesRead == framesToRead)
@@ -315,19 +298,12 @@ SInt64 SFB::Audio::DSFDecoder::_SeekToFrame(SInt64 frame)
 		return -1;
 	}
 
+	mStagingBuffer.Reset();
 	if(!ReadAndDeinterleaveDSDBlock())
 		return -1;
 
 	// Skip to the specified frame
-	UInt32	framesToSkip	= (UInt32)frame % blockSizePerChannelInFrames;
-	UInt32	framesInBuffer	= (UInt32)mFormat.ByteCountToFrameCount(mBufferList->mBuffers[0].mDataByteSize);
-
-	// Copy data from the buffer to output
-	for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
-		uint8_t *dst = (uint8_t *)mBufferList->mBuffers[i].mData;
-		memmove(dst, dst + mFormat.FrameCountToByteCount(framesToSkip), mFormat.FrameCountToByteCount(framesInBuffer - framesToSkip));
-		mBufferList->mBuffers[i].mDataByteSize -= (UInt32)mFormat.FrameCountToByteCount(framesToSkip);
-	}
+	mStagingBuffer.Skip((UInt32)frame % blockSizePerChannelInFrames);
 
 	mCurrentFrame = frame;
 
@@ -339,23 +315,39 @@ SInt64 SFB::Audio::DSFDecoder::_SeekToFrame(SInt64 frame)
 bool SFB::Audio::DSFDecoder::ReadAndDeinterleaveDSDBlock()
 {
 	auto bufsize = mFormat.mChannelsPerFrame * mBlockByteSizePerChannel;
-	uint8_t buf [bufsize];
 
+	// Deinterleave directly from memory-backed inputs
+	if(GetInputSource().SupportsBorrowing()) {
+		const uint8_t *block = nullptr;
+		auto bytesRead = GetInputSource().Borrow((const void **)&block, bufsize);
+		return DeinterleaveDSDBlock(block, bytesRead);
+	}
+
+	uint8_t buf [bufsize];
 	auto bytesRead = GetInputSource().Read(buf, bufsize);
+	return DeinterleaveDSDBlock(buf, bytesRead);
+}
+
+bool SFB::Audio::DSFDecoder::DeinterleaveDSDBlock(const uint8_t *block, SInt64 bytesRead)
+{
+	auto bufsize = mFormat.mChannelsPerFrame * mBlockByteSizePerChannel;
 	if(bytesRead != bufsize) {
 		LOGGER_WARNING("org.sbooth.AudioEngine.Decoder.DSF", "Error reading audio block: requested " << bufsize << " bytes, got " << bytesRead);
 		return false;
 	}
 
 	auto bytesReadPerChannel = bytesRead / mFormat.mChannelsPerFrame;
+	auto framesRead = (UInt32)mFormat.ByteCountToFrameCount(bytesReadPerChannel);
+
+	AudioBufferList *bufferList = mStagingBuffer.GetWriteBuffers(framesRead);
+	if(nullptr == bufferList)
+		return false;
 
 	// Deinterleave the clustered frames and copy to the internal buffer
-	for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
-		memcpy(mBufferList->mBuffers[i].mData, buf + (bytesReadPerChannel * i), (size_t)bytesReadPerChannel);
+	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
+		memcpy(bufferList->mBuffers[i].mData, block + (bytesReadPerChannel * i), (size_t)bytesReadPerChannel);
 
-		mBufferList->mBuffers[i].mNumberChannels	= 1;
-		mBufferList->mBuffers[i].mDataByteSize		= (UInt32)bytesReadPerChannel;
-	}
+	mStagingBuffer.CommitWrite(framesRead);
 
 	return true;
 }
@@ -28,6 +28,8 @@ namespace SFB {
 			static bool HandlesFilesWithExtension(CFStringRef extension);
 			static bool HandlesMIMEType(CFStringRef mimeType);
 
+			static ProbeResult ProbeFileHeader(const uint8_t *bytes, size_t count);
+
 			static Decoder::unique_ptr CreateDecoder(InputSource::unique_ptr inputSource);
 
 			// Creation and destruction
@@ -55,6 +57,7 @@ namespace SFB {
 			virtual SInt64 _SeekToFrame(SInt64 frame);
 
 			bool ReadAndDeinterleaveDSDBlock();
+			bool DeinterleaveDSDBlock(const uint8_t *block, SInt64 bytesRead);
 
 			// Data members
 			SInt64		mTotalFrames;
@@ -62,7 +65,7 @@ namespace SFB {
 			SInt64		mAudioOffset;
 
 			uint32_t	mBlockByteSizePerChannel;
-			BufferList	mBufferList;
+			StagingBuffer	mStagingBuffer;
 		};
 
 	}
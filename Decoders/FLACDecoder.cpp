@@ -4,6 +4,7 @@
  */
 
 #include <AudioToolbox/AudioFormat.h>
+#include <algorithm>
 
 #include <FLAC/metadata.h>
 
@@ -11,15 +12,46 @@
 #include "CFWrapper.h"
 #include "CFErrorUtilities.h"
 #include "Logger.h"
+#include "SampleKernels.h"
 
 namespace {
 
+	// The source format ID of cached FLAC seek indexes, which hold frame and offset pairs
+	constexpr uint32_t kSeekIndexType = 'FLAC';
+
+	// The number of seek points recorded per second of audio
+	constexpr SInt64 kSeekPointsPerSecond = 4;
+
 	void RegisterFLACDecoder() __attribute__ ((constructor));
 	void RegisterFLACDecoder()
 	{
 		SFB::Audio::Decoder::RegisterSubclass<SFB::Audio::FLACDecoder>();
 	}
 
+	/*!
+	 * Convert a range of FLAC samples to native endian samples, high-aligned if necessary
+	 * @param buffer The FLAC samples, 32-bit signed ints with the samples low-aligned
+	 * @param sampleOffset The index of the first sample in \c buffer to convert
+	 * @param sampleCount The number of samples per channel to convert
+	 * @param bytesPerFrame The size of a converted sample in bytes
+	 * @param shift The number of bits to shift each sample left
+	 * @param bufferList The destination, one buffer per channel
+	 */
+	void ConvertFLACSamples(const FLAC__int32 * const buffer[], unsigned sampleOffset, unsigned sampleCount, UInt32 bytesPerFrame, UInt32 shift, AudioBufferList *bufferList)
+	{
+		for(UInt32 channel = 0; channel < bufferList->mNumberBuffers; ++channel) {
+			const FLAC__int32 *samples = buffer[channel] + sampleOffset;
+			void *output = bufferList->mBuffers[channel].mData;
+
+			switch(bytesPerFrame) {
+				case 1:		SFB::Audio::ConvertInt32ToInt8(samples, (int8_t *)output, sampleCount, shift);		break;
+				case 2:		SFB::Audio::ConvertInt32ToInt16(samples, (int16_t *)output, sampleCount, shift);		break;
+				case 3:		SFB::Audio::ConvertInt32ToInt24(samples, (uint8_t *)output, sampleCount, shift);		break;
+				case 4:		SFB::Audio::ShiftInt32Samples(samples, (int32_t *)output, sampleCount, shift);		break;
+			}
+		}
+	}
+
 #pragma mark Callbacks
 
 	FLAC__StreamDecoderReadStatus readCallback(const FLAC__StreamDecoder */*decoder*/, FLAC__byte buffer[], size_t *bytes, void *client_data)
@@ -155,6 +187,15 @@ bool SFB::Audio::FLACDecoder::HandlesMIMEType(CFStringRef mimeType)
 	return false;
 }
 
+SFB::Audio::Decoder::ProbeResult SFB::Audio::FLACDecoder::ProbeFileHeader(const uint8_t *bytes, size_t count)
+{
+	if(4 <= count && 0 == memcmp(bytes, "fLaC", 4))
+		return ProbeResult::Match;
+
+	// Ogg FLAC streams begin with a packet containing 0x7f followed by "FLAC"
+	return ProbeOggStream(bytes, count, "\x7f" "FLAC", 5);
+}
+
 SFB::Audio::Decoder::unique_ptr SFB::Audio::FLACDecoder::CreateDecoder(InputSource::unique_ptr inputSource)
 {
 	return unique_ptr(new FLACDecoder(std::move(inputSource)));
@@ -163,7 +204,7 @@ SFB::Audio::Decoder::unique_ptr SFB::Audio::FLACDecoder::CreateDecoder(InputSour
 #pragma mark Creation and Destruction
 
 SFB::Audio::FLACDecoder::FLACDecoder(InputSource::unique_ptr inputSource)
-	: Decoder(std::move(inputSource)), mFLAC(nullptr, nullptr), mCurrentFrame(0)
+	: Decoder(std::move(inputSource)), mFLAC(nullptr, nullptr), mCurrentFrame(0), mHasSeekTable(false), mUseSeekIndex(false), mSeekIndexChanged(false), mSeekIndexIsCacheable(false), mSeekPointInterval(0), mSeekTarget(-1)
 {
 	memset(&mStreamInfo, 0, sizeof(mStreamInfo));
 }
@@ -172,10 +213,6 @@ SFB::Audio::FLACDecoder::FLACDecoder(InputSource::unique_ptr inputSource)
 
 bool SFB::Audio::FLACDecoder::_Open(CFErrorRef *error)
 {
-	SFB::CFString extension(CFURLCopyPathExtension(GetURL()));
-	if(!extension)
-		return false;
-
 	// Create FLAC decoder
 	mFLAC = unique_FLAC_ptr(FLAC__stream_decoder_new(), [](FLAC__StreamDecoder *decoder){
 		if(decoder) {
@@ -192,11 +229,24 @@ bool SFB::Audio::FLACDecoder::_Open(CFErrorRef *error)
 		return false;
 	}
 
+	// The presence of a SEEKTABLE determines whether seek points are recorded
+	FLAC__stream_decoder_set_metadata_respond(mFLAC.get(), FLAC__METADATA_TYPE_SEEKTABLE);
+
 	// Initialize decoder
 	FLAC__StreamDecoderInitStatus status = FLAC__STREAM_DECODER_INIT_STATUS_ERROR_OPENING_FILE;
 
-	// Attempt to create a stream decoder based on the file's extension
-	if(kCFCompareEqualTo == CFStringCompare(extension, CFSTR("flac"), kCFCompareCaseInsensitive))
+	// Attempt to create a stream decoder based on the file's signature, since files chosen by signature may have any extension
+	// Input sources that don't support seeking can't be peeked so fall back to the extension
+	bool isOggFLAC;
+	std::vector<uint8_t> header;
+	if(ReadFileHeader(*mInputSource, header))
+		isOggFLAC = 4 <= header.size() && 0 == memcmp(header.data(), "OggS", 4);
+	else {
+		SFB::CFString extension(CFURLCopyPathExtension(GetURL()));
+		isOggFLAC = extension && (kCFCompareEqualTo == CFStringCompare(extension, CFSTR("oga"), kCFCompareCaseInsensitive) || kCFCompareEqualTo == CFStringCompare(extension, CFSTR("ogg"), kCFCompareCaseInsensitive));
+	}
+	bool isNativeFLAC = !isOggFLAC;
+	if(isNativeFLAC)
 		status = FLAC__stream_decoder_init_stream(mFLAC.get(),
 												  readCallback,
 												  seekCallback,
@@ -207,7 +257,7 @@ bool SFB::Audio::FLACDecoder::_Open(CFErrorRef *error)
 												  metadataCallback,
 												  errorCallback,
 												  this);
-	else if(kCFCompareEqualTo == CFStringCompare(extension, CFSTR("oga"), kCFCompareCaseInsensitive))
+	else
 		status = FLAC__stream_decoder_init_ogg_stream(mFLAC.get(),
 													  readCallback,
 													  seekCallback,
@@ -313,8 +363,35 @@ bool SFB::Audio::FLACDecoder::_Open(CFErrorRef *error)
 		case 8:		mChannelLayout = ChannelLayout::ChannelLayoutWithTag(kAudioChannelLayoutTag_MPEG_7_1_A);	break;
 	}
 
+	// Without a SEEKTABLE libFLAC bisects the stream to seek, so record frame boundaries as they are decoded
+	// The decode position is only available for native FLAC
+	mUseSeekIndex = isNativeFLAC && !mHasSeekTable && mInputSource->SupportsSeeking() && 0 < mStreamInfo.sample_rate;
+	if(mUseSeekIndex) {
+		mSeekPointInterval = std::max((SInt64)mStreamInfo.sample_rate / kSeekPointsPerSecond, (SInt64)mStreamInfo.max_blocksize);
+
+		std::vector<int64_t> index;
+		mSeekIndexIsCacheable = SeekIndexCache::CreateKey(*mInputSource, mSeekIndexKey);
+		if(mSeekIndexIsCacheable && SeekIndexCache::Load(mSeekIndexKey, kSeekIndexType, index) && 0 == index.size() % 2) {
+			for(size_t i = 0; i < index.size(); i += 2) {
+				// Discard indexes that aren't strictly increasing
+				if(!mSeekPoints.empty() && (index[i] <= mSeekPoints.back().mFrame || index[i + 1] <= mSeekPoints.back().mOffset)) {
+					LOGGER_NOTICE("org.sbooth.AudioEngine.Decoder.FLAC", "Ignoring invalid cached seek index");
+					mSeekPoints.clear();
+					break;
+				}
+
+				mSeekPoints.push_back({ index[i], index[i + 1] });
+			}
+		}
+
+		// The first frame follows the metadata
+		FLAC__uint64 offset;
+		if(mSeekPoints.empty() && FLAC__stream_decoder_get_decode_position(mFLAC.get(), &offset))
+			AddSeekPoint(0, (SInt64)offset);
+	}
+
 	// Allocate the buffer list (which will convert from FLAC's push model to Core Audio's pull model)
-	if(!mBufferList.Allocate(mFormat, mStreamInfo.max_blocksize)) {
+	if(!mStagingBuffer.Allocate(mFormat, mStreamInfo.max_blocksize)) {
 		LOGGER_CRIT("org.sbooth.AudioEngine.Decoder.FLAC", "Unable to allocate memory")
 
 		if(error)
@@ -323,18 +400,33 @@ bool SFB::Audio::FLACDecoder::_Open(CFErrorRef *error)
 		return false;
 	}
 
-	for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i)
-		mBufferList->mBuffers[i].mDataByteSize = 0;
-
 	return true;
 }
 
 bool SFB::Audio::FLACDecoder::_Close(CFErrorRef */*error*/)
 {
+	if(mSeekIndexChanged && mSeekIndexIsCacheable) {
+		std::vector<int64_t> index;
+		index.reserve(2 * mSeekPoints.size());
+		for(const auto& point : mSeekPoints) {
+			index.push_back(point.mFrame);
+			index.push_back(point.mOffset);
+		}
+
+		SeekIndexCache::Store(mSeekIndexKey, kSeekIndexType, index);
+	}
+
 	mFLAC.reset();
-	mBufferList.Deallocate();
+	mStagingBuffer.Deallocate();
 	memset(&mStreamInfo, 0, sizeof(mStreamInfo));
 
+	mHasSeekTable = false;
+	mUseSeekIndex = false;
+	mSeekIndexChanged = false;
+	mSeekIndexIsCacheable = false;
+	mSeekPoints.clear();
+	mSeekTarget = -1;
+
 	return true;
 }
 
@@ -348,42 +440,27 @@ SFB::CFString SFB::Audio::FLACDecoder::_GetSourceFormatDescription() const
 
 UInt32 SFB::Audio::FLACDecoder::_ReadAudio(AudioBufferList *bufferList, UInt32 frameCount)
 {
-	if(bufferList->mNumberBuffers != mFormat.mChannelsPerFrame) {
-		LOGGER_WARNING("org.sbooth.AudioEngine.Decoder.FLAC", "_ReadAudio() called with invalid parameters");
-		return 0;
-	}
+	return (UInt32)_ReadAudioBatch(&bufferList, &frameCount, 1);
+}
 
-	UInt32 framesRead = 0;
+UInt64 SFB::Audio::FLACDecoder::_ReadAudioBatch(AudioBufferList * const *bufferLists, const UInt32 *frameCounts, size_t count)
+{
+	for(size_t i = 0; i < count; ++i) {
+		if(bufferLists[i]->mNumberBuffers != mFormat.mChannelsPerFrame) {
+			LOGGER_WARNING("org.sbooth.AudioEngine.Decoder.FLAC", "_ReadAudio() called with invalid parameters");
+			return 0;
+		}
+	}
 
-	// Reset output buffer data size
-	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
-		bufferList->mBuffers[i].mDataByteSize = 0;
+	// Frames are decoded directly into the buffers, spanning as many as necessary
+	mStagingBuffer.SetOutput(bufferLists, frameCounts, count);
 
 	for(;;) {
-		UInt32	framesRemaining	= frameCount - framesRead;
-		UInt32	framesToSkip	= (UInt32)(bufferList->mBuffers[0].mDataByteSize / mFormat.mBytesPerFrame);
-		UInt32	framesInBuffer	= (UInt32)(mBufferList->mBuffers[0].mDataByteSize / mFormat.mBytesPerFrame);
-		UInt32	framesToCopy	= std::min(framesInBuffer, framesRemaining);
-
-		// Copy data from the buffer to output
-		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
-			unsigned char *pullBuffer = (unsigned char *)bufferList->mBuffers[i].mData;
-			memcpy(pullBuffer + (framesToSkip * mFormat.mBytesPerFrame), mBufferList->mBuffers[i].mData, framesToCopy * mFormat.mBytesPerFrame);
-			bufferList->mBuffers[i].mDataByteSize += framesToCopy * mFormat.mBytesPerFrame;
-
-			// Move remaining data in buffer to beginning
-			if(framesToCopy != framesInBuffer) {
-				pullBuffer = (unsigned char *)mBufferList->mBuffers[i].mData;
-				memmove(pullBuffer, pullBuffer + (framesToCopy * mFormat.mBytesPerFrame), (framesInBuffer - framesToCopy) * mFormat.mBytesPerFrame);
-			}
-
-			mBufferList->mBuffers[i].mDataByteSize -= (UInt32)(framesToCopy * mFormat.mBytesPerFrame);
-		}
-
-		framesRead += framesToCopy;
+		// Copy staged audio to output
+		mStagingBuffer.CopyToOutput();
 
 		// All requested frames were read
-		if(framesRead == frameCount)
+		if(mStagingBuffer.IsOutputFull())
 			break;
 
 		// EOS?
@@ -391,11 +468,11 @@ UInt32 SFB::Audio::FLACDecoder::_ReadAudio(AudioBufferList *bufferList, UInt32 f
 			break;
 
 		// Grab the next frame
-		FLAC__bool result = FLAC__stream_decoder_process_single(mFLAC.get());
-		if(!result)
+		if(!FLAC__stream_decoder_process_single(mFLAC.get()))
 			LOGGER_ERR("org.sbooth.AudioEngine.Decoder.FLAC", "FLAC__stream_decoder_process_single failed: " << FLAC__stream_decoder_get_resolved_state_string(mFLAC.get()));
 	}
 
+	UInt64 framesRead = mStagingBuffer.ClearOutput();
 	mCurrentFrame += framesRead;
 
 	return framesRead;
@@ -403,21 +480,84 @@ UInt32 SFB::Audio::FLACDecoder::_ReadAudio(AudioBufferList *bufferList, UInt32 f
 
 SInt64 SFB::Audio::FLACDecoder::_SeekToFrame(SInt64 frame)
 {
+	// libFLAC writes the audio starting at the target frame during the seek
+	mStagingBuffer.Reset();
+
+	if(SeekUsingIndex(frame)) {
+		mCurrentFrame = frame;
+		return frame;
+	}
+
 	FLAC__bool result = FLAC__stream_decoder_seek_absolute(mFLAC.get(), (FLAC__uint64)frame);
 
 	// Attempt to re-sync the stream if necessary
-	if(FLAC__STREAM_DECODER_SEEK_ERROR == FLAC__stream_decoder_get_state(mFLAC.get()))
+	if(FLAC__STREAM_DECODER_SEEK_ERROR == FLAC__stream_decoder_get_state(mFLAC.get())) {
+		mStagingBuffer.Reset();
 		result = FLAC__stream_decoder_flush(mFLAC.get());
+	}
 
-	if(result) {
+	if(result)
 		mCurrentFrame = frame;
-		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i)
-			mBufferList->mBuffers[i].mDataByteSize = 0;
-	}
 
 	return (result ? frame : -1);
 }
 
+#pragma mark Seek Index
+
+void SFB::Audio::FLACDecoder::AddSeekPoint(SInt64 frame, SInt64 offset)
+{
+	// Keep the points sorted and at least mSeekPointInterval frames apart
+	auto next = std::lower_bound(mSeekPoints.begin(), mSeekPoints.end(), frame, [](const SeekPoint& point, SInt64 value) {
+		return point.mFrame < value;
+	});
+
+	if(next != mSeekPoints.begin() && frame - std::prev(next)->mFrame < mSeekPointInterval)
+		return;
+	if(next != mSeekPoints.end() && next->mFrame - frame < mSeekPointInterval)
+		return;
+
+	mSeekPoints.insert(next, { frame, offset });
+	mSeekIndexChanged = true;
+}
+
+bool SFB::Audio::FLACDecoder::SeekUsingIndex(SInt64 frame)
+{
+	if(!mUseSeekIndex)
+		return false;
+
+	// Find the last seek point at or before frame
+	auto point = std::upper_bound(mSeekPoints.begin(), mSeekPoints.end(), frame, [](SInt64 value, const SeekPoint& point) {
+		return value < point.mFrame;
+	});
+
+	if(point == mSeekPoints.begin())
+		return false;
+	--point;
+
+	// If the gap is too large let libFLAC bisect instead of decoding the intervening audio
+	if(frame - point->mFrame >= 4 * mSeekPointInterval)
+		return false;
+
+	// Jump directly to the frame boundary and decode until the Write callback reaches frame
+	if(!mInputSource->SeekToOffset(point->mOffset) || !FLAC__stream_decoder_flush(mFLAC.get()))
+		return false;
+
+	mSeekTarget = frame;
+	while(-1 != mSeekTarget) {
+		if(!FLAC__stream_decoder_process_single(mFLAC.get()) || FLAC__STREAM_DECODER_END_OF_STREAM == FLAC__stream_decoder_get_state(mFLAC.get()))
+			break;
+	}
+
+	if(-1 != mSeekTarget) {
+		LOGGER_NOTICE("org.sbooth.AudioEngine.Decoder.FLAC", "Seek using index to frame " << frame << " failed");
+		mSeekTarget = -1;
+		mStagingBuffer.Reset();
+		return false;
+	}
+
+	return true;
+}
+
 #pragma mark Callbacks
 
 FLAC__StreamDecoderWriteStatus SFB::Audio::FLACDecoder::Write(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[])
@@ -427,86 +567,51 @@ FLAC__StreamDecoderWriteStatus SFB::Audio::FLACDecoder::Write(const FLAC__Stream
 	assert(nullptr != frame);
 
 	// Avoid segfaults
-	if(nullptr == mBufferList || mBufferList->mNumberBuffers != frame->header.channels)
+	if(!mStagingBuffer || mStagingBuffer.GetFormat().mChannelsPerFrame != frame->header.channels)
 		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 
 	// FLAC hands us 32-bit signed ints with the samples low-aligned; shift them to high alignment
 	UInt32 shift = (kAudioFormatFlagIsPacked & mFormat.mFormatFlags) ? 0 : (8 * mFormat.mBytesPerFrame) - mFormat.mBitsPerChannel;
 
-	// Convert to native endian samples, high-aligned if necessary
-	switch(mFormat.mBytesPerFrame) {
-		case 1:
-		{
-			for(unsigned channel = 0; channel < frame->header.channels; ++channel) {
-				char *pullBuffer = (char *)mBufferList->mBuffers[channel].mData;
-
-				for(unsigned sample = 0; sample < frame->header.blocksize; ++sample)
-					*pullBuffer++ = (char)(buffer[channel][sample] << shift);
-
-				mBufferList->mBuffers[channel].mNumberChannels		= 1;
-				mBufferList->mBuffers[channel].mDataByteSize		= frame->header.blocksize * sizeof(char);
-			}
+	// libFLAC always supplies sample numbers to the write callback
+	SInt64 frameStart = (SInt64)frame->header.number.sample_number;
+	SInt64 frameEnd = frameStart + frame->header.blocksize;
 
-			break;
-		}
+	// The decode position is the start of the next frame
+	FLAC__uint64 offset;
+	if(mUseSeekIndex && FLAC__stream_decoder_get_decode_position(decoder, &offset))
+		AddSeekPoint(frameEnd, (SInt64)offset);
 
-		case 2:
-		{
-			for(unsigned channel = 0; channel < frame->header.channels; ++channel) {
-				short *pullBuffer = (short *)mBufferList->mBuffers[channel].mData;
-
-				for(unsigned sample = 0; sample < frame->header.blocksize; ++sample)
-					*pullBuffer++ = (short)(buffer[channel][sample] << shift);
-
-				mBufferList->mBuffers[channel].mNumberChannels		= 1;
-				mBufferList->mBuffers[channel].mDataByteSize		= frame->header.blocksize * sizeof(short);
-			}
-
-			break;
-		}
-
-		case 3:
-		{
-			for(unsigned channel = 0; channel < frame->header.channels; ++channel) {
-				unsigned char *pullBuffer = (unsigned char *)mBufferList->mBuffers[channel].mData;
-
-				FLAC__int32 value;
-				for(unsigned sample = 0; sample < frame->header.blocksize; ++sample) {
-					value = buffer[channel][sample] << shift;
-#if __BIG_ENDIAN__
-					*pullBuffer++ = (unsigned char)((value >> 16) & 0xff);
-					*pullBuffer++ = (unsigned char)((value >> 8) & 0xff);
-					*pullBuffer++ = (unsigned char)(value & 0xff);
-#elif __LITTLE_ENDIAN__
-					*pullBuffer++ = (unsigned char)(value & 0xff);
-					*pullBuffer++ = (unsigned char)((value >> 8) & 0xff);
-					*pullBuffer++ = (unsigned char)((value >> 16) & 0xff);
-#else
-#  error Unknown OS byte order
-#endif
-				}
+	// Discard audio preceding the target of a seek using the index
+	unsigned frameOffset = 0;
+	if(-1 != mSeekTarget) {
+		if(frameEnd <= mSeekTarget)
+			return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 
-				mBufferList->mBuffers[channel].mNumberChannels		= 1;
-				mBufferList->mBuffers[channel].mDataByteSize		= frame->header.blocksize * 3 * sizeof(unsigned char);
-			}
+		frameOffset = (unsigned)std::max(mSeekTarget - frameStart, (SInt64)0);
+		mSeekTarget = -1;
+	}
 
+	// Convert as much of the frame as fits directly into the caller's buffers
+	for(;;) {
+		unsigned framesToOutput = std::min(frame->header.blocksize - frameOffset, (unsigned)mStagingBuffer.GetOutputFramesAvailable());
+		if(0 == framesToOutput)
 			break;
-		}
-
-		case 4:
-		{
-			for(unsigned channel = 0; channel < frame->header.channels; ++channel) {
-				int *pullBuffer = (int *)mBufferList->mBuffers[channel].mData;
 
-				for(unsigned sample = 0; sample < frame->header.blocksize; ++sample)
-					*pullBuffer++ = (int)(buffer[channel][sample] << shift);
+		ConvertFLACSamples(buffer, frameOffset, framesToOutput, mFormat.mBytesPerFrame, shift, mStagingBuffer.GetOutputBuffers(framesToOutput));
+		mStagingBuffer.CommitOutput(framesToOutput);
+		frameOffset += framesToOutput;
+	}
 
-				mBufferList->mBuffers[channel].mNumberChannels		= 1;
-				mBufferList->mBuffers[channel].mDataByteSize		= frame->header.blocksize * sizeof(int);
-			}
+	// Stage the remainder
+	unsigned framesToStage = frame->header.blocksize - frameOffset;
+	if(0 < framesToStage) {
+		AudioBufferList *bufferList = mStagingBuffer.GetWriteBuffers(framesToStage);
+		if(nullptr == bufferList)
+			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 
-			break;
-		}
+		ConvertFLACSamples(buffer, frameOffset, framesToStage, mFormat.mBytesPerFrame, shift, bufferList);
+		mStagingBuffer.CommitWrite(framesToStage);
 	}
 
 	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
@@ -522,6 +627,10 @@ void SFB::Audio::FLACDecoder::Metadata(const FLAC__StreamDecoder *decoder, const
 			memcpy(&mStreamInfo, &metadata->data.stream_info, sizeof(metadata->data.stream_info));
 			break;
 
+		case FLAC__METADATA_TYPE_SEEKTABLE:
+			mHasSeekTable = 0 < metadata->data.seek_table.num_points;
+			break;
+
 		default:
 			break;
 	}
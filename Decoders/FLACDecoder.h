@@ -5,10 +5,13 @@
 
 #pragma once
 
+#include <vector>
+
 #include <FLAC/stream_decoder.h>
 
 #include "AudioDecoder.h"
 #include "AudioBufferList.h"
+#include "SeekIndexCache.h"
 
 namespace SFB {
 
@@ -29,6 +32,8 @@ namespace SFB {
 			static bool HandlesFilesWithExtension(CFStringRef extension);
 			static bool HandlesMIMEType(CFStringRef mimeType);
 
+			static ProbeResult ProbeFileHeader(const uint8_t *bytes, size_t count);
+
 			static Decoder::unique_ptr CreateDecoder(InputSource::unique_ptr inputSource);
 
 			// Creation
@@ -45,6 +50,7 @@ namespace SFB {
 
 			// Attempt to read frameCount frames of audio, returning the actual number of frames read
 			virtual UInt32 _ReadAudio(AudioBufferList *bufferList, UInt32 frameCount);
+			virtual UInt64 _ReadAudioBatch(AudioBufferList * const *bufferLists, const UInt32 *frameCounts, size_t count);
 
 			// Source audio information
 			inline virtual SInt64 _GetTotalFrames() const			{ return (SInt64)mStreamInfo.total_samples; }
@@ -54,15 +60,36 @@ namespace SFB {
 			inline virtual bool _SupportsSeeking() const			{ return mInputSource->SupportsSeeking(); }
 			virtual SInt64 _SeekToFrame(SInt64 frame);
 
+			// Seek index support for streams without a SEEKTABLE
+			void AddSeekPoint(SInt64 frame, SInt64 offset);
+			bool SeekUsingIndex(SInt64 frame);
+
 			using unique_FLAC_ptr = std::unique_ptr<FLAC__StreamDecoder, void(*)(FLAC__StreamDecoder *)>;
 
+			// A frame boundary in the stream
+			struct SeekPoint
+			{
+				SInt64 mFrame;
+				SInt64 mOffset;
+			};
+
 			// Data members
 			unique_FLAC_ptr						mFLAC;
 			FLAC__StreamMetadata_StreamInfo		mStreamInfo;
 			SInt64								mCurrentFrame;
 
 			// For converting push to pull
-			BufferList							mBufferList;
+			StagingBuffer						mStagingBuffer;
+
+			// Seek points gathered while decoding, used in place of bisection when the stream lacks a SEEKTABLE
+			bool								mHasSeekTable;
+			bool								mUseSeekIndex;
+			bool								mSeekIndexChanged;
+			bool								mSeekIndexIsCacheable;
+			SeekIndexCache::Key					mSeekIndexKey;
+			std::vector<SeekPoint>				mSeekPoints;
+			SInt64								mSeekPointInterval;
+			SInt64								mSeekTarget;		// The frame to decode to, or -1
 
 		public:
 
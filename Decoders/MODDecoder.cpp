@@ -12,6 +12,9 @@
 #define DUMB_CHANNELS		2
 #define DUMB_BIT_DEPTH		16
 
+// DUMB saves renderer checkpoints at this interval when loading a module (IT_CHECKPOINT_INTERVAL)
+#define DUMB_CHECKPOINT_INTERVAL	(30 * DUMB_SAMPLE_RATE)
+
 namespace {
 
 	void RegisterMODDecoder() __attribute__ ((constructor));
@@ -103,6 +106,19 @@ bool SFB::Audio::MODDecoder::HandlesMIMEType(CFStringRef mimeType)
 	return false;
 }
 
+SFB::Audio::Decoder::ProbeResult SFB::Audio::MODDecoder::ProbeFileHeader(const uint8_t *bytes, size_t count)
+{
+	if(17 <= count && 0 == memcmp(bytes, "Extended Module: ", 17))
+		return ProbeResult::Match;
+	if(4 <= count && 0 == memcmp(bytes, "IMPM", 4))
+		return ProbeResult::Match;
+	if(48 <= count && 0 == memcmp(bytes + 44, "SCRM", 4))
+		return ProbeResult::Match;
+
+	// ProTracker modules have too many signature variants to rule a file out
+	return ProbeResult::Unknown;
+}
+
 SFB::Audio::Decoder::unique_ptr SFB::Audio::MODDecoder::CreateDecoder(InputSource::unique_ptr inputSource)
 {
 	return unique_ptr(new MODDecoder(std::move(inputSource)));
@@ -239,14 +255,20 @@ UInt32 SFB::Audio::MODDecoder::_ReadAudio(AudioBufferList *bufferList, UInt32 fr
 
 SInt64 SFB::Audio::MODDecoder::_SeekToFrame(SInt64 frame)
 {
-	// DUMB cannot seek backwards, so the decoder must be reset
-	if(frame < mCurrentFrame) {
-		if(!_Close(nullptr) || !mInputSource->SeekToOffset(0) || !_Open(nullptr)) {
-			LOGGER_ERR("org.sbooth.AudioEngine.Decoder.MOD", "Error reseting DUMB decoder");
+	// DUMB cannot seek backwards, but a new renderer starts from the nearest checkpoint saved
+	// while the module was loaded and renders only the remainder.  This is also faster than
+	// skipping forward when a checkpoint lies between the current frame and the target
+	if(frame < mCurrentFrame || frame - mCurrentFrame > DUMB_CHECKPOINT_INTERVAL) {
+		auto sigrenderer = unique_DUH_SIGRENDERER_ptr(duh_start_sigrenderer(duh.get(), 0, DUMB_CHANNELS, (long)frame), duh_end_sigrenderer);
+		if(!sigrenderer) {
+			LOGGER_ERR("org.sbooth.AudioEngine.Decoder.MOD", "Error starting DUMB renderer at frame " << frame);
 			return -1;
 		}
 
-		mCurrentFrame = 0;
+		dsr = std::move(sigrenderer);
+		mCurrentFrame = frame;
+
+		return mCurrentFrame;
 	}
 
 	long framesToSkip = frame - mCurrentFrame;
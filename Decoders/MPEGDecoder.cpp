@@ -4,17 +4,22 @@
  */
 
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
 
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
-#include <Accelerate/Accelerate.h>
-
 #include "MPEGDecoder.h"
 #include "CFWrapper.h"
 #include "CFErrorUtilities.h"
 #include "Logger.h"
+#include "SampleKernels.h"
+#include "SeekIndexCache.h"
 
 namespace {
 
@@ -24,6 +29,213 @@ namespace {
 		SFB::Audio::Decoder::RegisterSubclass<SFB::Audio::MPEGDecoder>();
 	}
 
+	/*!
+	 * Deinterleave a range of frames
+	 * @param audioData The interleaved samples
+	 * @param channelsPerFrame The number of channels in \c audioData
+	 * @param frameOffset The index of the first frame in \c audioData to deinterleave
+	 * @param frameCount The number of frames to deinterleave
+	 * @param bufferList The destination, one buffer per channel
+	 */
+	void DeinterleaveFrames(const float *audioData, UInt32 channelsPerFrame, UInt32 frameOffset, UInt32 frameCount, AudioBufferList *bufferList)
+	{
+		float *channels [channelsPerFrame];
+		for(UInt32 channel = 0; channel < channelsPerFrame; ++channel)
+			channels[channel] = (float *)bufferList->mBuffers[channel].mData;
+
+		SFB::Audio::DeinterleaveSamples(audioData + (frameOffset * channelsPerFrame), channels, channelsPerFrame, frameCount);
+	}
+
+#pragma mark Seek Index Caching
+
+	// Cached MPEG seek indexes hold the index step and total frames followed by the frame offsets
+	constexpr uint32_t kSeekIndexType = 'MPEG';
+
+	/*!
+	 * Load a cached seek index into \c mh
+	 * @param mh The mpg123 handle
+	 * @param key The cache key of the file being decoded
+	 * @param totalFrames Receives the accurate length of the file in frames
+	 * @return \c true on success, \c false otherwise
+	 */
+	bool LoadSeekIndex(mpg123_handle *mh, const SFB::Audio::SeekIndexCache::Key& key, SInt64& totalFrames)
+	{
+		std::vector<int64_t> index;
+		if(!SFB::Audio::SeekIndexCache::Load(key, kSeekIndexType, index) || 3 > index.size() || 0 >= index[0] || 0 > index[1])
+			return false;
+
+		std::vector<off_t> offsets(index.begin() + 2, index.end());
+		if(MPG123_OK != mpg123_set_index(mh, offsets.data(), (off_t)index[0], offsets.size())) {
+			LOGGER_WARNING("org.sbooth.AudioEngine.Decoder.MPEG", "mpg123_set_index failed: " << mpg123_strerror(mh));
+			return false;
+		}
+
+		totalFrames = index[1];
+		return true;
+	}
+
+	/*!
+	 * Store the seek index built by a full scan of \c mh
+	 * @param mh The mpg123 handle
+	 * @param key The cache key of the file being decoded
+	 */
+	void StoreSeekIndex(mpg123_handle *mh, const SFB::Audio::SeekIndexCache::Key& key)
+	{
+		off_t *offsets = nullptr;
+		off_t step = 0;
+		size_t fill = 0;
+		off_t totalFrames = mpg123_length(mh);
+		if(MPG123_OK != mpg123_index(mh, &offsets, &step, &fill) || 0 == fill || 0 >= step || 0 > totalFrames)
+			return;
+
+		std::vector<int64_t> index;
+		index.reserve(2 + fill);
+		index.push_back(step);
+		index.push_back(totalFrames);
+		index.insert(index.end(), offsets, offsets + fill);
+
+		SFB::Audio::SeekIndexCache::Store(key, kSeekIndexType, index);
+	}
+
+#pragma mark Gapless Playback
+
+	// The delay added by the mpg123 synthesis filter, which iTunSMPB values don't include
+	constexpr SInt64 kDecoderDelay = 529;
+
+	// Convert an ID3v2 text field to ASCII, dropping byte order marks and any other non-ASCII characters
+	std::string ConvertID3v2Text(const uint8_t *bytes, size_t count, uint8_t encoding)
+	{
+		std::string text;
+
+		// UTF-16 with or without a byte order mark
+		if(1 == encoding || 2 == encoding) {
+			for(size_t i = 0; i + 2 <= count; i += 2) {
+				if(0 == bytes[i] && 0 == bytes[i + 1])
+					break;
+				// An ASCII character has one zero byte in either byte order
+				uint8_t c = bytes[i] | bytes[i + 1];
+				if((0 == bytes[i] || 0 == bytes[i + 1]) && 0x80 > c)
+					text += (char)c;
+			}
+		}
+		// ISO-8859-1 or UTF-8
+		else {
+			for(size_t i = 0; i < count && 0 != bytes[i]; ++i) {
+				if(0x80 > bytes[i])
+					text += (char)bytes[i];
+			}
+		}
+
+		return text;
+	}
+
+	/*!
+	 * Read the iTunes gapless playback information from the ID3v2 tag at the start of \c inputSource
+	 * @note The input source's offset is restored before returning
+	 * @param inputSource The input source
+	 * @param encoderDelay Receives the number of priming frames
+	 * @param padding Receives the number of remainder frames
+	 * @param frameCount Receives the number of audio frames, or \c 0 if unknown
+	 * @return \c true if an \c iTunSMPB comment was found, \c false otherwise
+	 */
+	bool ReadiTunSMPB(SFB::InputSource& inputSource, SInt64& encoderDelay, SInt64& padding, SInt64& frameCount)
+	{
+		if(!inputSource.SupportsSeeking())
+			return false;
+
+		SInt64 offset = inputSource.GetOffset();
+		if(!inputSource.SeekToOffset(0))
+			return false;
+
+		bool found = false;
+
+		uint8_t header [10];
+		if(10 == inputSource.Read(header, 10) && 'I' == header[0] && 'D' == header[1] && '3' == header[2] && 2 <= header[3] && header[3] <= 4 && !(header[5] & 0x80)) {
+			uint8_t version = header[3];
+			SInt64 tagEnd = 10 + (SInt64)((header[6] << 21) | (header[7] << 14) | (header[8] << 7) | header[9]);
+
+			// Skip the extended header
+			if(2 < version && (header[5] & 0x40)) {
+				uint8_t size [4];
+				if(4 == inputSource.Read(size, 4)) {
+					SInt64 extendedHeaderSize = 4 == version ? ((size[0] << 21) | (size[1] << 14) | (size[2] << 7) | size[3]) : (((uint32_t)size[0] << 24) | (size[1] << 16) | (size[2] << 8) | size[3]) + 4;
+					inputSource.SeekToOffset(10 + extendedHeaderSize);
+				}
+			}
+
+			size_t frameHeaderSize = 2 == version ? 6 : 10;
+			const char *commentFrameID = 2 == version ? "COM" : "COMM";
+			size_t frameIDSize = 2 == version ? 3 : 4;
+
+			uint8_t frameHeader [10];
+			while(!found && inputSource.GetOffset() + (SInt64)frameHeaderSize <= tagEnd && (SInt64)frameHeaderSize == inputSource.Read(frameHeader, (SInt64)frameHeaderSize)) {
+				// Padding
+				if(0 == frameHeader[0])
+					break;
+
+				SInt64 frameSize;
+				if(2 == version)
+					frameSize = (frameHeader[3] << 16) | (frameHeader[4] << 8) | frameHeader[5];
+				else if(3 == version)
+					frameSize = ((uint32_t)frameHeader[4] << 24) | (frameHeader[5] << 16) | (frameHeader[6] << 8) | frameHeader[7];
+				else
+					frameSize = (frameHeader[4] << 21) | (frameHeader[5] << 14) | (frameHeader[6] << 7) | frameHeader[7];
+
+				SInt64 frameEnd = inputSource.GetOffset() + frameSize;
+				if(frameEnd > tagEnd)
+					break;
+
+				// iTunSMPB comments are short, so ignore anything large such as compressed or encrypted frames
+				if(0 == memcmp(frameHeader, commentFrameID, frameIDSize) && 4 < frameSize && frameSize <= 512 && (2 == version || 0 == (frameHeader[9] & (3 == version ? 0xe0 : 0x0f)))) {
+					uint8_t frame [512];
+					if(frameSize == inputSource.Read(frame, frameSize)) {
+						// The description follows the encoding and language and precedes the comment
+						uint8_t encoding = frame[0];
+						size_t terminatorSize = (1 == encoding || 2 == encoding) ? 2 : 1;
+						size_t descriptionEnd = 4;
+						while(descriptionEnd + terminatorSize <= (size_t)frameSize && !(0 == frame[descriptionEnd] && (1 == terminatorSize || 0 == frame[descriptionEnd + 1])))
+							descriptionEnd += terminatorSize;
+
+						std::string description = ConvertID3v2Text(frame + 4, descriptionEnd - 4, encoding);
+						if("iTunSMPB" == description && descriptionEnd + terminatorSize <= (size_t)frameSize) {
+							size_t textStart = descriptionEnd + terminatorSize;
+							std::string text = ConvertID3v2Text(frame + textStart, (size_t)frameSize - textStart, encoding);
+
+							// The fields are hexadecimal: reserved, encoder delay, padding, and the original frame count
+							unsigned long long fields [4];
+							const char *p = text.c_str();
+							int fieldCount = 0;
+							for(; fieldCount < 4; ++fieldCount) {
+								char *end;
+								fields[fieldCount] = strtoull(p, &end, 16);
+								if(end == p)
+									break;
+								p = end;
+							}
+
+							if(4 == fieldCount) {
+								encoderDelay = (SInt64)fields[1];
+								padding = (SInt64)fields[2];
+								frameCount = (SInt64)fields[3];
+								found = true;
+							}
+						}
+					}
+				}
+
+				if(!inputSource.SeekToOffset(frameEnd))
+					break;
+			}
+		}
+
+		if(!inputSource.SeekToOffset(offset)) {
+			LOGGER_ERR("org.sbooth.AudioEngine.Decoder.MPEG", "Unable to restore input source offset");
+			return false;
+		}
+
+		return found;
+	}
+
 #pragma mark Initialization
 
 	void Setupmpg123() __attribute__ ((constructor));
@@ -118,6 +330,23 @@ bool SFB::Audio::MPEGDecoder::HandlesMIMEType(CFStringRef mimeType)
 	return false;
 }
 
+SFB::Audio::Decoder::ProbeResult SFB::Audio::MPEGDecoder::ProbeFileHeader(const uint8_t *bytes, size_t count)
+{
+	// An MPEG audio frame header has an 11-bit sync word and no reserved field values
+	if(4 <= count && 0xff == bytes[0] && 0xe0 == (bytes[1] & 0xe0)) {
+		unsigned version = (bytes[1] >> 3) & 0x3;
+		unsigned layer = (bytes[1] >> 1) & 0x3;
+		unsigned bitrateIndex = (bytes[2] >> 4) & 0xf;
+		unsigned sampleRateIndex = (bytes[2] >> 2) & 0x3;
+
+		if(1 != version && 0 != layer && 0xf != bitrateIndex && 0x3 != sampleRateIndex)
+			return ProbeResult::Match;
+	}
+
+	// mpg123 tolerates junk preceding the first frame, so the file can't be ruled out
+	return ProbeResult::Unknown;
+}
+
 SFB::Audio::Decoder::unique_ptr SFB::Audio::MPEGDecoder::CreateDecoder(InputSource::unique_ptr inputSource)
 {
 	return unique_ptr(new MPEGDecoder(std::move(inputSource)));
@@ -126,7 +355,7 @@ SFB::Audio::Decoder::unique_ptr SFB::Audio::MPEGDecoder::CreateDecoder(InputSour
 #pragma mark Creation and Destruction
 
 SFB::Audio::MPEGDecoder::MPEGDecoder(InputSource::unique_ptr inputSource)
-	: Decoder(std::move(inputSource)), mDecoder(nullptr), mCurrentFrame(0)
+	: Decoder(std::move(inputSource)), mDecoder(nullptr), mCurrentFrame(0), mTotalFrames(-1)
 {}
 
 #pragma mark Functionality
@@ -223,29 +452,58 @@ bool SFB::Audio::MPEGDecoder::_Open(CFErrorRef *error)
 		case 2:		mChannelLayout = ChannelLayout::ChannelLayoutWithTag(kAudioChannelLayoutTag_Stereo);	break;
 	}
 
-	if(MPG123_OK != mpg123_scan(decoder.get())) {
-		if(error) {
-			SFB::CFString description(CFCopyLocalizedString(CFSTR("The file “%@” is not a valid MP3 file."), ""));
-			SFB::CFString failureReason(CFCopyLocalizedString(CFSTR("Not an MP3 file"), ""));
-			SFB::CFString recoverySuggestion(CFCopyLocalizedString(CFSTR("The file's extension may not match the file's type."), ""));
+	// A full scan builds the frame index needed for accurate seeking and length, so reuse a cached index when possible
+	SeekIndexCache::Key key;
+	bool cacheable = SeekIndexCache::CreateKey(*mInputSource, key);
+	if(!cacheable || !LoadSeekIndex(decoder.get(), key, mTotalFrames)) {
+		auto scanStart = std::chrono::steady_clock::now();
 
-			*error = CreateErrorForURL(Decoder::ErrorDomain, Decoder::InputOutputError, description, mInputSource->GetURL(), failureReason, recoverySuggestion);
+		if(MPG123_OK != mpg123_scan(decoder.get())) {
+			if(error) {
+				SFB::CFString description(CFCopyLocalizedString(CFSTR("The file “%@” is not a valid MP3 file."), ""));
+				SFB::CFString failureReason(CFCopyLocalizedString(CFSTR("Not an MP3 file"), ""));
+				SFB::CFString recoverySuggestion(CFCopyLocalizedString(CFSTR("The file's extension may not match the file's type."), ""));
+
+				*error = CreateErrorForURL(Decoder::ErrorDomain, Decoder::InputOutputError, description, mInputSource->GetURL(), failureReason, recoverySuggestion);
+			}
+
+			return false;
 		}
 
-		return false;
+		auto scanTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - scanStart);
+		LOGGER_DEBUG("org.sbooth.AudioEngine.Decoder.MPEG", "Scanned " << mpg123_length(decoder.get()) << " frames in " << scanTime.count() << " ms");
+
+		if(cacheable)
+			StoreSeekIndex(decoder.get(), key);
+	}
+
+	// mpg123 trims the encoder delay and padding recorded in a LAME tag, but not those in an iTunSMPB comment
+	long lameEncoderDelay = -1;
+	if(MPG123_OK != mpg123_getstate(decoder.get(), MPG123_ENC_DELAY, &lameEncoderDelay, nullptr) || -1 == lameEncoderDelay) {
+		SInt64 encoderDelay, padding, frameCount;
+		if(ReadiTunSMPB(*mInputSource, encoderDelay, padding, frameCount)) {
+			SInt64 totalFrames = -1 != mTotalFrames ? mTotalFrames : mpg123_length(decoder.get());
+			if(0 == frameCount)
+				frameCount = totalFrames - encoderDelay - padding;
+
+			SInt64 primingFrames = encoderDelay + kDecoderDelay;
+			if(0 < frameCount && primingFrames + frameCount <= totalFrames) {
+				LOGGER_DEBUG("org.sbooth.AudioEngine.Decoder.MPEG", "Trimming " << primingFrames << " priming frames and " << (totalFrames - primingFrames - frameCount) << " remainder frames using iTunSMPB");
+				SetPrimingAndValidFrames(primingFrames, frameCount);
+			}
+			else
+				LOGGER_NOTICE("org.sbooth.AudioEngine.Decoder.MPEG", "Ignoring iTunSMPB inconsistent with the file's length of " << totalFrames << " frames");
+		}
 	}
 
 	// Allocate the buffer list
-	if(!mBufferList.Allocate(mFormat, framesPerMPEGFrame)) {
+	if(!mStagingBuffer.Allocate(mFormat, framesPerMPEGFrame)) {
 		if(error)
 			*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, ENOMEM, nullptr);
 
 		return false;
 	}
 
-	for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i)
-		mBufferList->mBuffers[i].mDataByteSize = 0;
-
 	mDecoder = std::move(decoder);
 
 	return true;
@@ -254,7 +512,8 @@ bool SFB::Audio::MPEGDecoder::_Open(CFErrorRef *error)
 bool SFB::Audio::MPEGDecoder::_Close(CFErrorRef */*error*/)
 {
 	mDecoder.reset();
-	mBufferList.Deallocate();
+	mStagingBuffer.Deallocate();
+	mTotalFrames = -1;
 
 	return true;
 }
@@ -293,43 +552,27 @@ SFB::CFString SFB::Audio::MPEGDecoder::_GetSourceFormatDescription() const
 
 UInt32 SFB::Audio::MPEGDecoder::_ReadAudio(AudioBufferList *bufferList, UInt32 frameCount)
 {
-	if(bufferList->mNumberBuffers != mFormat.mChannelsPerFrame) {
-		LOGGER_WARNING("org.sbooth.AudioEngine.Decoder.MPEG", "_ReadAudio() called with invalid parameters");
-		return 0;
-	}
+	return (UInt32)_ReadAudioBatch(&bufferList, &frameCount, 1);
+}
 
-	UInt32 framesRead = 0;
+UInt64 SFB::Audio::MPEGDecoder::_ReadAudioBatch(AudioBufferList * const *bufferLists, const UInt32 *frameCounts, size_t count)
+{
+	for(size_t i = 0; i < count; ++i) {
+		if(bufferLists[i]->mNumberBuffers != mFormat.mChannelsPerFrame) {
+			LOGGER_WARNING("org.sbooth.AudioEngine.Decoder.MPEG", "_ReadAudio() called with invalid parameters");
+			return 0;
+		}
+	}
 
-	// Reset output buffer data size
-	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
-		bufferList->mBuffers[i].mDataByteSize = 0;
+	// Frames are deinterleaved directly into the buffers, spanning as many as necessary
+	mStagingBuffer.SetOutput(bufferLists, frameCounts, count);
 
 	for(;;) {
-
-		UInt32	framesRemaining	= frameCount - framesRead;
-		UInt32	framesToSkip	= (UInt32)(bufferList->mBuffers[0].mDataByteSize / sizeof(float));
-		UInt32	framesInBuffer	= (UInt32)(mBufferList->mBuffers[0].mDataByteSize / sizeof(float));
-		UInt32	framesToCopy	= std::min(framesInBuffer, framesRemaining);
-
-		// Copy data from the buffer to output
-		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
-			float *floatBuffer = (float *)bufferList->mBuffers[i].mData;
-			memcpy(floatBuffer + framesToSkip, mBufferList->mBuffers[i].mData, framesToCopy * sizeof(float));
-			bufferList->mBuffers[i].mDataByteSize += framesToCopy * sizeof(float);
-
-			// Move remaining data in buffer to beginning
-			if(framesToCopy != framesInBuffer) {
-				floatBuffer = (float *)mBufferList->mBuffers[i].mData;
-				memmove(floatBuffer, floatBuffer + framesToCopy, (framesInBuffer - framesToCopy) * sizeof(float));
-			}
-
-			mBufferList->mBuffers[i].mDataByteSize -= framesToCopy * sizeof(float);
-		}
-
-		framesRead += framesToCopy;
+		// Copy staged audio to output
+		mStagingBuffer.CopyToOutput();
 
 		// All requested frames were read
-		if(framesRead == frameCount)
+		if(mStagingBuffer.IsOutputFull())
 			break;
 
 		// Read and decode an MPEG frame
@@ -348,20 +591,33 @@ UInt32 SFB::Audio::MPEGDecoder::_ReadAudio(AudioBufferList *bufferList, UInt32 f
 		// The analyzer error about division by zero may be safely ignored, because mChannelsPerFrame is verified > 0 in Open()
 		UInt32 framesDecoded = (UInt32)(bytesDecoded / (sizeof(float) * mFormat.mChannelsPerFrame));
 
-		// Deinterleave the samples
-		// In my experiments adding zero using Accelerate.framework is faster than looping through the buffer and copying each sample
-		float zero = 0;
-		for(UInt32 channel = 0; channel < mFormat.mChannelsPerFrame; ++channel) {
-			float *inputBuffer = (float *)audioData + channel;
-			float *outputBuffer = (float *)mBufferList->mBuffers[channel].mData;
+		// Deinterleave as much of the frame as fits directly into the caller's buffers
+		UInt32 framesOutput = 0;
+		for(;;) {
+			UInt32 framesToOutput = std::min(framesDecoded - framesOutput, mStagingBuffer.GetOutputFramesAvailable());
+			if(0 == framesToOutput)
+				break;
 
-			vDSP_vsadd(inputBuffer, (vDSP_Stride)mFormat.mChannelsPerFrame, &zero, outputBuffer, 1, framesDecoded);
+			DeinterleaveFrames((const float *)audioData, mFormat.mChannelsPerFrame, framesOutput, framesToOutput, mStagingBuffer.GetOutputBuffers(framesToOutput));
+			mStagingBuffer.CommitOutput(framesToOutput);
+			framesOutput += framesToOutput;
+		}
 
-			mBufferList->mBuffers[channel].mNumberChannels	= 1;
-			mBufferList->mBuffers[channel].mDataByteSize	= framesDecoded * sizeof(float);
+		// Stage the remainder
+		UInt32 framesToStage = framesDecoded - framesOutput;
+		if(0 < framesToStage) {
+			AudioBufferList *stagingBuffers = mStagingBuffer.GetWriteBuffers(framesToStage);
+			if(nullptr == stagingBuffers) {
+				LOGGER_ERR("org.sbooth.AudioEngine.Decoder.MPEG", "MPEG frame of " << framesDecoded << " frames exceeds staging capacity");
+				break;
+			}
+
+			DeinterleaveFrames((const float *)audioData, mFormat.mChannelsPerFrame, framesOutput, framesToStage, stagingBuffers);
+			mStagingBuffer.CommitWrite(framesToStage);
 		}
 	}
 
+	UInt64 framesRead = mStagingBuffer.ClearOutput();
 	mCurrentFrame += framesRead;
 
 	return framesRead;
@@ -369,14 +625,20 @@ UInt32 SFB::Audio::MPEGDecoder::_ReadAudio(AudioBufferList *bufferList, UInt32 f
 
 SInt64 SFB::Audio::MPEGDecoder::_GetTotalFrames() const
 {
+	// mpg123 only estimates the length when the index was loaded from the cache instead of scanned
+	if(-1 != mTotalFrames)
+		return mTotalFrames;
+
 	return mpg123_length(mDecoder.get());
 }
 
 SInt64 SFB::Audio::MPEGDecoder::_SeekToFrame(SInt64 frame)
 {
 	frame = mpg123_seek(mDecoder.get(), frame, SEEK_SET);
-	if(0 <= frame)
+	if(0 <= frame) {
 		mCurrentFrame = frame;
+		mStagingBuffer.Reset();
+	}
 
 	return ((0 <= frame) ? mCurrentFrame : -1);
 }
@@ -29,6 +29,8 @@ namespace SFB {
 			static bool HandlesFilesWithExtension(CFStringRef extension);
 			static bool HandlesMIMEType(CFStringRef mimeType);
 
+			static ProbeResult ProbeFileHeader(const uint8_t *bytes, size_t count);
+
 			static Decoder::unique_ptr CreateDecoder(InputSource::unique_ptr inputSource);
 
 			// Creation
@@ -45,6 +47,7 @@ namespace SFB {
 
 			// Attempt to read frameCount frames of audio, returning the actual number of frames read
 			virtual UInt32 _ReadAudio(AudioBufferList *bufferList, UInt32 frameCount);
+			virtual UInt64 _ReadAudioBatch(AudioBufferList * const *bufferLists, const UInt32 *frameCounts, size_t count);
 
 			// Source audio information
 			virtual SInt64 _GetTotalFrames() const;
@@ -58,8 +61,9 @@ namespace SFB {
 
 			// Data members
 			unique_mpg123_ptr	mDecoder;
-			BufferList			mBufferList;
+			StagingBuffer		mStagingBuffer;
 			SInt64				mCurrentFrame;
+			SInt64				mTotalFrames;		// From the cached seek index, or -1 if mpg123 determines the length
 		};
 
 	}
@@ -166,6 +166,14 @@ bool SFB::Audio::MonkeysAudioDecoder::HandlesMIMEType(CFStringRef mimeType)
 	return false;
 }
 
+SFB::Audio::Decoder::ProbeResult SFB::Audio::MonkeysAudioDecoder::ProbeFileHeader(const uint8_t *bytes, size_t count)
+{
+	if(4 > count)
+		return ProbeResult::NoMatch;
+
+	return 0 == memcmp(bytes, "MAC ", 4) ? ProbeResult::Match : ProbeResult::NoMatch;
+}
+
 SFB::Audio::Decoder::unique_ptr SFB::Audio::MonkeysAudioDecoder::CreateDecoder(InputSource::unique_ptr inputSource)
 {
 	return unique_ptr(new MonkeysAudioDecoder(std::move(inputSource)));
@@ -4,7 +4,6 @@
  */
 
 #include <AudioToolbox/AudioFormat.h>
-#include <Accelerate/Accelerate.h>
 
 #include <algorithm>
 
@@ -12,6 +11,7 @@
 #include "CFWrapper.h"
 #include "CFErrorUtilities.h"
 #include "Logger.h"
+#include "SampleKernels.h"
 
 namespace {
 
@@ -104,6 +104,17 @@ bool SFB::Audio::MusepackDecoder::HandlesMIMEType(CFStringRef mimeType)
 	return false;
 }
 
+SFB::Audio::Decoder::ProbeResult SFB::Audio::MusepackDecoder::ProbeFileHeader(const uint8_t *bytes, size_t count)
+{
+	// SV8 streams begin with "MPCK" and SV7 streams with "MP+"
+	if(4 <= count && 0 == memcmp(bytes, "MPCK", 4))
+		return ProbeResult::Match;
+	if(3 <= count && 0 == memcmp(bytes, "MP+", 3))
+		return ProbeResult::Match;
+
+	return ProbeResult::NoMatch;
+}
+
 SFB::Audio::Decoder::unique_ptr SFB::Audio::MusepackDecoder::CreateDecoder(InputSource::unique_ptr inputSource)
 {
 	return unique_ptr(new MusepackDecoder(std::move(inputSource)));
@@ -189,7 +200,7 @@ bool SFB::Audio::MusepackDecoder::_Open(CFErrorRef *error)
 	}
 
 	// Allocate the buffer list
-	if(!mBufferList.Allocate(mFormat, MPC_FRAME_LENGTH)) {
+	if(!mStagingBuffer.Allocate(mFormat, MPC_FRAME_LENGTH)) {
 		if(error)
 			*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, ENOMEM, nullptr);
 
@@ -200,9 +211,6 @@ bool SFB::Audio::MusepackDecoder::_Open(CFErrorRef *error)
 		return false;
 	}
 
-	for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i)
-		mBufferList->mBuffers[i].mDataByteSize = 0;
-
 	return true;
 }
 
@@ -214,7 +222,7 @@ bool SFB::Audio::MusepackDecoder::_Close(CFErrorRef */*error*/)
 	}
 
     mpc_reader_exit_stdio(&mReader);
-	mBufferList.Deallocate();
+	mStagingBuffer.Deallocate();
 
 	return true;
 }
@@ -237,32 +245,9 @@ UInt32 SFB::Audio::MusepackDecoder::_ReadAudio(AudioBufferList *bufferList, UInt
 	MPC_SAMPLE_FORMAT	buffer			[MPC_DECODER_BUFFER_LENGTH];
 	UInt32				framesRead		= 0;
 
-	// Reset output buffer data size
-	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
-		bufferList->mBuffers[i].mDataByteSize = 0;
-
 	for(;;) {
-		UInt32	framesRemaining	= frameCount - framesRead;
-		UInt32	framesToSkip	= (UInt32)(bufferList->mBuffers[0].mDataByteSize / sizeof(float));
-		UInt32	framesInBuffer	= (UInt32)(mBufferList->mBuffers[0].mDataByteSize / sizeof(float));
-		UInt32	framesToCopy	= std::min(framesInBuffer, framesRemaining);
-
-		// Copy data from the buffer to output
-		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
-			float *floatBuffer = (float *)bufferList->mBuffers[i].mData;
-			memcpy(floatBuffer + framesToSkip, mBufferList->mBuffers[i].mData, framesToCopy * sizeof(float));
-			bufferList->mBuffers[i].mDataByteSize += framesToCopy * sizeof(float);
-
-			// Move remaining data in buffer to beginning
-			if(framesToCopy != framesInBuffer) {
-				floatBuffer = (float *)mBufferList->mBuffers[i].mData;
-				memmove(floatBuffer, floatBuffer + framesToCopy, (framesInBuffer - framesToCopy) * sizeof(float));
-			}
-
-			mBufferList->mBuffers[i].mDataByteSize -= framesToCopy * sizeof(float);
-		}
-
-		framesRead += framesToCopy;
+		// Copy staged audio to output
+		framesRead += mStagingBuffer.ReadAudio(bufferList, framesRead, frameCount - framesRead);
 
 		// All requested frames were read
 		if(framesRead == frameCount)
@@ -291,18 +276,22 @@ UInt32 SFB::Audio::MusepackDecoder::_ReadAudio(AudioBufferList *bufferList, UInt
 		float minValue = -1.f;
 		float maxValue = 8388607.f / 8388608.f;
 
-		vDSP_vclip(inputBuffer, 1, &minValue, &maxValue, inputBuffer, 1, frame.samples * mFormat.mChannelsPerFrame);
+		ClipFloatSamples(inputBuffer, inputBuffer, frame.samples * mFormat.mChannelsPerFrame, minValue, maxValue);
+
+		AudioBufferList *stagingBuffers = mStagingBuffer.GetWriteBuffers(frame.samples);
+		if(nullptr == stagingBuffers) {
+			LOGGER_ERR("org.sbooth.AudioEngine.Decoder.Musepack", "Musepack frame of " << frame.samples << " frames exceeds staging capacity");
+			break;
+		}
 
 		// Deinterleave the normalized samples
-		for(UInt32 channel = 0; channel < mFormat.mChannelsPerFrame; ++channel) {
-			float *floatBuffer = (float *)mBufferList->mBuffers[channel].mData;
+		float *channels [mFormat.mChannelsPerFrame];
+		for(UInt32 channel = 0; channel < mFormat.mChannelsPerFrame; ++channel)
+			channels[channel] = (float *)stagingBuffers->mBuffers[channel].mData;
 
-			for(UInt32 sample = channel; sample < frame.samples * mFormat.mChannelsPerFrame; sample += mFormat.mChannelsPerFrame)
-				*floatBuffer++ = inputBuffer[sample];
+		DeinterleaveSamples(inputBuffer, channels, mFormat.mChannelsPerFrame, frame.samples);
 
-			mBufferList->mBuffers[channel].mNumberChannels	= 1;
-			mBufferList->mBuffers[channel].mDataByteSize	= frame.samples * sizeof(float);
-		}
+		mStagingBuffer.CommitWrite(frame.samples);
 #endif /* MPC_FIXED_POINT */
 	}
 
@@ -314,8 +303,10 @@ UInt32 SFB::Audio::MusepackDecoder::_ReadAudio(AudioBufferList *bufferList, UInt
 SInt64 SFB::Audio::MusepackDecoder::_SeekToFrame(SInt64 frame)
 {
 	mpc_status result = mpc_demux_seek_sample(mDemux, (mpc_uint64_t)frame);
-	if(MPC_STATUS_OK == result)
+	if(MPC_STATUS_OK == result) {
 		mCurrentFrame = frame;
+		mStagingBuffer.Reset();
+	}
 
 	return ((MPC_STATUS_OK == result) ? mCurrentFrame : -1);
 }
@@ -29,6 +29,8 @@ namespace SFB {
 			static bool HandlesFilesWithExtension(CFStringRef extension);
 			static bool HandlesMIMEType(CFStringRef mimeType);
 
+			static ProbeResult ProbeFileHeader(const uint8_t *bytes, size_t count);
+
 			static Decoder::unique_ptr CreateDecoder(InputSource::unique_ptr inputSource);
 
 			// Creation and destruction
@@ -59,7 +61,7 @@ namespace SFB {
 			mpc_reader			mReader;
 			mpc_demux			*mDemux;
 
-			BufferList			mBufferList;
+			StagingBuffer		mStagingBuffer;
 
 			SInt64				mTotalFrames;
 			SInt64				mCurrentFrame;
@@ -103,6 +103,11 @@ bool SFB::Audio::OggOpusDecoder::HandlesMIMEType(CFStringRef mimeType)
 	return false;
 }
 
+SFB::Audio::Decoder::ProbeResult SFB::Audio::OggOpusDecoder::ProbeFileHeader(const uint8_t *bytes, size_t count)
+{
+	return ProbeOggStream(bytes, count, "OpusHead", 8);
+}
+
 SFB::Audio::Decoder::unique_ptr SFB::Audio::OggOpusDecoder::CreateDecoder(InputSource::unique_ptr inputSource)
 {
 	return unique_ptr(new OggOpusDecoder(std::move(inputSource)));
@@ -251,5 +256,5 @@ SInt64 SFB::Audio::OggOpusDecoder::_SeekToFrame(SInt64 frame)
 		return -1;
 	}
 
-	return this->GetCurrentFrame();
+	return _GetCurrentFrame();
 }
@@ -4,7 +4,6 @@
  */
 
 #include <AudioToolbox/AudioFormat.h>
-#include <Accelerate/Accelerate.h>
 
 #include <speex/speex.h>
 #include <speex/speex_header.h>
@@ -14,6 +13,7 @@
 #include "CFWrapper.h"
 #include "CFErrorUtilities.h"
 #include "Logger.h"
+#include "SampleKernels.h"
 
 #define MAX_FRAME_SIZE 2000
 #define READ_SIZE_BYTES 4096
@@ -67,6 +67,11 @@ bool SFB::Audio::OggSpeexDecoder::HandlesMIMEType(CFStringRef mimeType)
 	return false;
 }
 
+SFB::Audio::Decoder::ProbeResult SFB::Audio::OggSpeexDecoder::ProbeFileHeader(const uint8_t *bytes, size_t count)
+{
+	return ProbeOggStream(bytes, count, "Speex   ", 8);
+}
+
 SFB::Audio::Decoder::unique_ptr SFB::Audio::OggSpeexDecoder::CreateDecoder(InputSource::unique_ptr inputSource)
 {
 	return unique_ptr(new OggSpeexDecoder(std::move(inputSource)));
@@ -291,7 +296,8 @@ bool SFB::Audio::OggSpeexDecoder::_Open(CFErrorRef *error)
 	spx_int32_t speexFrameSize = 0;
 	speex_decoder_ctl(mSpeexDecoder, SPEEX_GET_FRAME_SIZE, &speexFrameSize);
 
-	if(!mBufferList.Allocate(mFormat, (UInt32)speexFrameSize)) {
+	// Every frame in an Ogg packet is decoded at once
+	if(!mStagingBuffer.Allocate(mFormat, (UInt32)(speexFrameSize * mSpeexFramesPerOggPacket))) {
 		if(error)
 			*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, ENOMEM, nullptr);
 
@@ -305,15 +311,12 @@ bool SFB::Audio::OggSpeexDecoder::_Open(CFErrorRef *error)
 		return false;
 	}
 
-	for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i)
-		mBufferList->mBuffers[i].mDataByteSize = 0;
-
 	return true;
 }
 
 bool SFB::Audio::OggSpeexDecoder::_Close(CFErrorRef */*error*/)
 {
-	mBufferList.Deallocate();
+	mStagingBuffer.Deallocate();
 
 	// Speex cleanup
 	speex_stereo_state_destroy(mSpeexStereoState);
@@ -346,33 +349,9 @@ UInt32 SFB::Audio::OggSpeexDecoder::_ReadAudio(AudioBufferList *bufferList, UInt
 
 	UInt32 framesRead = 0;
 
-	// Reset output buffer data size
-	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
-		bufferList->mBuffers[i].mDataByteSize = 0;
-
 	for(;;) {
-
-		UInt32	framesRemaining	= frameCount - framesRead;
-		UInt32	framesToSkip	= (UInt32)(bufferList->mBuffers[0].mDataByteSize / sizeof(float));
-		UInt32	framesInBuffer	= (UInt32)(mBufferList->mBuffers[0].mDataByteSize / sizeof(float));
-		UInt32	framesToCopy	= std::min(framesInBuffer, framesRemaining);
-
-		// Copy data from the buffer to output
-		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
-			float *floatBuffer = (float *)bufferList->mBuffers[i].mData;
-			memcpy(floatBuffer + framesToSkip, mBufferList->mBuffers[i].mData, framesToCopy * sizeof(float));
-			bufferList->mBuffers[i].mDataByteSize += framesToCopy * sizeof(float);
-
-			// Move remaining data in buffer to beginning
-			if(framesToCopy != framesInBuffer) {
-				floatBuffer = (float *)mBufferList->mBuffers[i].mData;
-				memmove(floatBuffer, floatBuffer + framesToCopy, (framesInBuffer - framesToCopy) * sizeof(float));
-			}
-
-			mBufferList->mBuffers[i].mDataByteSize -= framesToCopy * sizeof(float);
-		}
-
-		framesRead += framesToCopy;
+		// Copy staged audio to output
+		framesRead += mStagingBuffer.ReadAudio(bufferList, framesRead, frameCount - framesRead);
 
 		// All requested frames were read
 		if(framesRead == frameCount)
@@ -443,24 +422,29 @@ UInt32 SFB::Audio::OggSpeexDecoder::_ReadAudio(AudioBufferList *bufferList, UInt
 								break;
 							}
 
-							// Normalize the values
-							float maxSampleValue = 1u << 15;
-							vDSP_vsdiv(buffer, 1, &maxSampleValue, buffer, 1, (vDSP_Length)speexFrameSize);
-
-							// Copy the frames from the decoding buffer to the output buffer, skipping over any frames already decoded
-							framesInBuffer = mBufferList->mBuffers[0].mDataByteSize / sizeof(float);
-							memcpy((float *)mBufferList->mBuffers[0].mData + framesInBuffer, buffer, (size_t)speexFrameSize * sizeof(float));
-							mBufferList->mBuffers[0].mDataByteSize += (size_t)speexFrameSize * sizeof(float);
-
 							// Process stereo channel, if present
-							if(2 == mFormat.mChannelsPerFrame) {
+							// The stereo decoder expands the mono frame into interleaved stereo
+							if(2 == mFormat.mChannelsPerFrame)
 								speex_decode_stereo(buffer, speexFrameSize, mSpeexStereoState);
-								vDSP_vsdiv(buffer + speexFrameSize, 1, &maxSampleValue, buffer + speexFrameSize, 1, (vDSP_Length)speexFrameSize);
 
-								memcpy((float *)mBufferList->mBuffers[1].mData + framesInBuffer, buffer + speexFrameSize, (size_t)speexFrameSize * sizeof(float));
-								mBufferList->mBuffers[1].mDataByteSize += (size_t)speexFrameSize * sizeof(float);
+							// Normalize the values
+							ScaleFloatSamples(buffer, buffer, (size_t)speexFrameSize * mFormat.mChannelsPerFrame, 1.f / (1u << 15));
+
+							// Append the frames from the decoding buffer to the staged audio
+							AudioBufferList *stagingBuffers = mStagingBuffer.GetWriteBuffers((UInt32)speexFrameSize);
+							if(nullptr == stagingBuffers) {
+								LOGGER_ERR("org.sbooth.AudioEngine.Decoder.OggSpeex", "Ogg Speex decoding error: Speex frame exceeds staging capacity");
+								break;
 							}
 
+							float *channels [mFormat.mChannelsPerFrame];
+							for(UInt32 channel = 0; channel < mFormat.mChannelsPerFrame; ++channel)
+								channels[channel] = (float *)stagingBuffers->mBuffers[channel].mData;
+
+							DeinterleaveSamples(buffer, channels, mFormat.mChannelsPerFrame, (size_t)speexFrameSize);
+
+							mStagingBuffer.CommitWrite((UInt32)speexFrameSize);
+
 							// Packet processing finished
 							--packetsDesired;
 						}
@@ -31,6 +31,8 @@ namespace SFB {
 			static bool HandlesFilesWithExtension(CFStringRef extension);
 			static bool HandlesMIMEType(CFStringRef mimeType);
 
+			static ProbeResult ProbeFileHeader(const uint8_t *bytes, size_t count);
+
 			static Decoder::unique_ptr CreateDecoder(InputSource::unique_ptr inputSource);
 
 			// Creation and destruction
@@ -54,7 +56,7 @@ namespace SFB {
 			inline virtual SInt64 _GetCurrentFrame() const			{ return mCurrentFrame; }
 
 			// Data members
-			BufferList			mBufferList;
+			StagingBuffer		mStagingBuffer;
 			SInt64				mCurrentFrame;
 			SInt64				mTotalFrames;
 
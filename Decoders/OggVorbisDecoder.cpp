@@ -104,6 +104,11 @@ bool SFB::Audio::OggVorbisDecoder::HandlesMIMEType(CFStringRef mimeType)
 	return false;
 }
 
+SFB::Audio::Decoder::ProbeResult SFB::Audio::OggVorbisDecoder::ProbeFileHeader(const uint8_t *bytes, size_t count)
+{
+	return ProbeOggStream(bytes, count, "\x01" "vorbis", 7);
+}
+
 SFB::Audio::Decoder::unique_ptr SFB::Audio::OggVorbisDecoder::CreateDecoder(InputSource::unique_ptr inputSource)
 {
 	return unique_ptr(new OggVorbisDecoder(std::move(inputSource)));
@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SeekIndexCache.h"
+#include "CFWrapper.h"
+#include "Logger.h"
+
+namespace {
+
+	// The number of bytes hashed at the start and end of each file
+	constexpr SInt64 kHashedRegionSize = 64 * 1024;
+
+	constexpr uint32_t kIndexFileMagic		= 'SFBi';
+	constexpr uint32_t kIndexFileVersion	= 1;
+
+	// The header preceding the index in each cache file
+	struct IndexFileHeader
+	{
+		uint32_t							mMagic;
+		uint32_t							mVersion;
+		uint32_t							mType;
+		uint32_t							mReserved;
+		SFB::Audio::SeekIndexCache::Key		mKey;
+		uint64_t							mCount;
+		uint64_t							mChecksum;
+	};
+
+	// The default limit on the total size of the cache directory
+	constexpr uint64_t kDefaultMaximumSize = 32 * 1024 * 1024;
+
+	std::atomic_bool	sEnabled(true);
+	std::atomic_ullong	sMaximumSize(kDefaultMaximumSize);
+	std::mutex			sDirectoryMutex;
+	std::string			sDirectory;
+
+	// 64-bit FNV-1a
+	constexpr uint64_t kFNVOffsetBasis	= 0xcbf29ce484222325ull;
+	constexpr uint64_t kFNVPrime		= 0x100000001b3ull;
+
+	uint64_t HashBytes(const void *bytes, size_t count, uint64_t hash = kFNVOffsetBasis)
+	{
+		auto p = static_cast<const uint8_t *>(bytes);
+		for(size_t i = 0; i < count; ++i) {
+			hash ^= p[i];
+			hash *= kFNVPrime;
+		}
+		return hash;
+	}
+
+	bool HashRegion(SFB::InputSource& inputSource, SInt64 offset, SInt64 length, std::vector<uint8_t>& buffer, uint64_t& hash)
+	{
+		if(!inputSource.SeekToOffset(offset))
+			return false;
+
+		buffer.resize((size_t)length);
+		if(length != inputSource.Read(buffer.data(), length))
+			return false;
+
+		hash = HashBytes(buffer.data(), buffer.size(), hash);
+		return true;
+	}
+
+	std::string GetDefaultDirectory()
+	{
+		std::string directory;
+
+#if defined(_CS_DARWIN_USER_CACHE_DIR)
+		char buf [PATH_MAX];
+		size_t length = confstr(_CS_DARWIN_USER_CACHE_DIR, buf, sizeof(buf));
+		if(0 < length && length <= sizeof(buf))
+			directory = buf;
+#endif
+
+		if(directory.empty()) {
+			const char *tmpdir = getenv("TMPDIR");
+			directory = tmpdir ? tmpdir : "/tmp";
+		}
+
+		if('/' != directory.back())
+			directory += '/';
+
+		return directory + "org.sbooth.AudioEngine/SeekIndexes";
+	}
+
+	std::string GetDirectory()
+	{
+		std::lock_guard<std::mutex> lock(sDirectoryMutex);
+		if(sDirectory.empty())
+			sDirectory = GetDefaultDirectory();
+		return sDirectory;
+	}
+
+	// Create directory and any missing parents
+	bool CreateDirectory(const std::string& directory)
+	{
+		for(size_t pos = directory.find('/', 1); ; pos = directory.find('/', pos + 1)) {
+			std::string component = directory.substr(0, pos);
+			if(-1 == mkdir(component.c_str(), 0755) && EEXIST != errno)
+				return false;
+			if(std::string::npos == pos)
+				return true;
+		}
+	}
+
+	std::string GetIndexPath(const std::string& directory, const SFB::Audio::SeekIndexCache::Key& key, uint32_t type)
+	{
+		uint64_t hash = HashBytes(&key, sizeof(key));
+
+		char name [64];
+		snprintf(name, sizeof(name), "/%016llx-%08x.index", (unsigned long long)hash, (unsigned int)type);
+
+		return directory + name;
+	}
+
+	bool KeysMatch(const SFB::Audio::SeekIndexCache::Key& lhs, const SFB::Audio::SeekIndexCache::Key& rhs)
+	{
+		return lhs.mFileSize == rhs.mFileSize && lhs.mModificationTime == rhs.mModificationTime && lhs.mContentHash == rhs.mContentHash;
+	}
+
+	// Remove the least recently used indexes in directory until their total size is at most maximumSize
+	// Loading an index updates its modification time, so the modification time is the time of last use
+	void Trim(const std::string& directory, uint64_t maximumSize)
+	{
+		struct Entry
+		{
+			std::string		mPath;
+			uint64_t		mSize;
+			struct timespec	mLastUsed;
+		};
+
+		auto dir = std::unique_ptr<DIR, int (*)(DIR *)>(opendir(directory.c_str()), closedir);
+		if(!dir)
+			return;
+
+		std::vector<Entry> entries;
+		uint64_t totalSize = 0;
+
+		const std::string suffix = ".index";
+		while(struct dirent *dirent = readdir(dir.get())) {
+			std::string name = dirent->d_name;
+			if(name.size() <= suffix.size() || 0 != name.compare(name.size() - suffix.size(), suffix.size(), suffix))
+				continue;
+
+			std::string path = directory + "/" + name;
+			struct stat s;
+			if(-1 == stat(path.c_str(), &s) || !S_ISREG(s.st_mode))
+				continue;
+
+#if defined(__APPLE__)
+			entries.push_back({ path, (uint64_t)s.st_size, s.st_mtimespec });
+#else
+			entries.push_back({ path, (uint64_t)s.st_size, s.st_mtim });
+#endif
+			totalSize += (uint64_t)s.st_size;
+		}
+
+		if(totalSize <= maximumSize)
+			return;
+
+		std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+			return lhs.mLastUsed.tv_sec < rhs.mLastUsed.tv_sec || (lhs.mLastUsed.tv_sec == rhs.mLastUsed.tv_sec && lhs.mLastUsed.tv_nsec < rhs.mLastUsed.tv_nsec);
+		});
+
+		for(const auto& entry : entries) {
+			if(totalSize <= maximumSize)
+				break;
+
+			// Another process may have removed the index already
+			if(0 == unlink(entry.mPath.c_str()) || ENOENT == errno) {
+				LOGGER_DEBUG("org.sbooth.AudioEngine.SeekIndexCache", "Removed seek index " << entry.mPath.c_str());
+				totalSize -= entry.mSize;
+			}
+		}
+	}
+
+	bool WriteAll(int fd, const void *bytes, size_t count)
+	{
+		auto p = static_cast<const uint8_t *>(bytes);
+		while(0 < count) {
+			ssize_t written = write(fd, p, count);
+			if(-1 == written) {
+				if(EINTR == errno)
+					continue;
+				return false;
+			}
+			p += written;
+			count -= (size_t)written;
+		}
+		return true;
+	}
+
+}
+
+#pragma mark Keys
+
+bool SFB::Audio::SeekIndexCache::CreateKey(InputSource& inputSource, Key& key)
+{
+	// Hashing reads up to 128 KiB, which is wasted if the key won't be used
+	if(!IsEnabled())
+		return false;
+
+	CFURLRef url = inputSource.GetURL();
+	if(nullptr == url || !inputSource.IsOpen() || !inputSource.SupportsSeeking())
+		return false;
+
+	SFB::CFString scheme(CFURLCopyScheme(url));
+	if(!scheme || kCFCompareEqualTo != CFStringCompare(scheme, CFSTR("file"), kCFCompareCaseInsensitive))
+		return false;
+
+	UInt8 path [PATH_MAX];
+	if(!CFURLGetFileSystemRepresentation(url, FALSE, path, PATH_MAX))
+		return false;
+
+	struct stat s;
+	if(-1 == stat((const char *)path, &s))
+		return false;
+
+	SInt64 length = inputSource.GetLength();
+	if(length != s.st_size)
+		return false;
+
+	memset(&key, 0, sizeof(key));
+	key.mFileSize = (uint64_t)s.st_size;
+#if defined(__APPLE__)
+	key.mModificationTime = (int64_t)s.st_mtimespec.tv_sec * 1000000000 + s.st_mtimespec.tv_nsec;
+#else
+	key.mModificationTime = (int64_t)s.st_mtim.tv_sec * 1000000000 + s.st_mtim.tv_nsec;
+#endif
+
+	SInt64 offset = inputSource.GetOffset();
+
+	std::vector<uint8_t> buffer;
+	uint64_t hash = kFNVOffsetBasis;
+
+	SInt64 headLength = std::min(length, kHashedRegionSize);
+	SInt64 tailLength = std::min(length - headLength, kHashedRegionSize);
+
+	bool success = HashRegion(inputSource, 0, headLength, buffer, hash);
+	if(success && 0 < tailLength)
+		success = HashRegion(inputSource, length - tailLength, tailLength, buffer, hash);
+
+	if(!inputSource.SeekToOffset(offset)) {
+		LOGGER_ERR("org.sbooth.AudioEngine.SeekIndexCache", "Unable to restore input source offset");
+		return false;
+	}
+
+	key.mContentHash = hash;
+
+	return success;
+}
+
+#pragma mark Configuration
+
+bool SFB::Audio::SeekIndexCache::IsEnabled()
+{
+	return sEnabled.load(std::memory_order_relaxed);
+}
+
+void SFB::Audio::SeekIndexCache::SetEnabled(bool enabled)
+{
+	sEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool SFB::Audio::SeekIndexCache::SetDirectory(CFURLRef url)
+{
+	std::string directory;
+
+	if(url) {
+		UInt8 path [PATH_MAX];
+		if(!CFURLGetFileSystemRepresentation(url, TRUE, path, PATH_MAX))
+			return false;
+		directory = (const char *)path;
+	}
+	else
+		directory = GetDefaultDirectory();
+
+	std::lock_guard<std::mutex> lock(sDirectoryMutex);
+	sDirectory = directory;
+
+	return true;
+}
+
+uint64_t SFB::Audio::SeekIndexCache::GetMaximumSize()
+{
+	return sMaximumSize.load(std::memory_order_relaxed);
+}
+
+void SFB::Audio::SeekIndexCache::SetMaximumSize(uint64_t bytes)
+{
+	sMaximumSize.store(bytes, std::memory_order_relaxed);
+}
+
+#pragma mark Loading and Storing
+
+bool SFB::Audio::SeekIndexCache::Load(const Key& key, uint32_t type, std::vector<int64_t>& index)
+{
+	if(!IsEnabled())
+		return false;
+
+	std::string path = GetIndexPath(GetDirectory(), key, type);
+
+	auto file = std::unique_ptr<std::FILE, int (*)(std::FILE *)>(std::fopen(path.c_str(), "r"), std::fclose);
+	if(!file)
+		return false;
+
+	IndexFileHeader header;
+	if(1 != std::fread(&header, sizeof(header), 1, file.get()))
+		return false;
+
+	if(kIndexFileMagic != header.mMagic || kIndexFileVersion != header.mVersion || type != header.mType || !KeysMatch(key, header.mKey)) {
+		LOGGER_NOTICE("org.sbooth.AudioEngine.SeekIndexCache", "Ignoring stale seek index " << path.c_str());
+		return false;
+	}
+
+	// An index can't meaningfully have more entries than the file has bytes
+	if(header.mCount > key.mFileSize)
+		return false;
+
+	std::vector<int64_t> entries((size_t)header.mCount);
+	if(header.mCount != std::fread(entries.data(), sizeof(int64_t), entries.size(), file.get()))
+		return false;
+
+	if(header.mChecksum != HashBytes(entries.data(), entries.size() * sizeof(int64_t))) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.SeekIndexCache", "Ignoring corrupt seek index " << path.c_str());
+		return false;
+	}
+
+	// Mark the index as recently used
+	if(-1 == futimens(fileno(file.get()), nullptr))
+		LOGGER_INFO("org.sbooth.AudioEngine.SeekIndexCache", "Unable to update modification time of " << path.c_str() << ": " << strerror(errno));
+
+	index = std::move(entries);
+	return true;
+}
+
+bool SFB::Audio::SeekIndexCache::Store(const Key& key, uint32_t type, const std::vector<int64_t>& index)
+{
+	if(!IsEnabled())
+		return false;
+
+	std::string directory = GetDirectory();
+	if(!CreateDirectory(directory)) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.SeekIndexCache", "Unable to create directory " << directory.c_str() << ": " << strerror(errno));
+		return false;
+	}
+
+	IndexFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.mMagic		= kIndexFileMagic;
+	header.mVersion		= kIndexFileVersion;
+	header.mType		= type;
+	header.mKey			= key;
+	header.mCount		= index.size();
+	header.mChecksum	= HashBytes(index.data(), index.size() * sizeof(int64_t));
+
+	// Write to a temporary file and rename it so readers never see a partial index
+	std::string path = GetIndexPath(directory, key, type);
+	std::string temporaryPath = path + ".XXXXXX";
+
+	int fd = mkstemp(&temporaryPath[0]);
+	if(-1 == fd) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.SeekIndexCache", "Unable to create " << temporaryPath.c_str() << ": " << strerror(errno));
+		return false;
+	}
+
+	bool success = WriteAll(fd, &header, sizeof(header)) && WriteAll(fd, index.data(), index.size() * sizeof(int64_t));
+	success = (0 == close(fd)) && success;
+	success = success && (0 == rename(temporaryPath.c_str(), path.c_str()));
+
+	if(!success) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.SeekIndexCache", "Unable to write seek index " << path.c_str() << ": " << strerror(errno));
+		unlink(temporaryPath.c_str());
+		return false;
+	}
+
+	uint64_t maximumSize = GetMaximumSize();
+	if(0 < maximumSize)
+		Trim(directory, maximumSize);
+
+	return true;
+}
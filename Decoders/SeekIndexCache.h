@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#pragma once
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <cstdint>
+#include <vector>
+
+#include "InputSource.h"
+
+/*! @file SeekIndexCache.h @brief A persistent cache of decoder seek indexes */
+
+/*! @brief \c SFBAudioEngine's encompassing namespace */
+namespace SFB {
+
+	/*! @brief %Audio functionality */
+	namespace Audio {
+
+		/*!
+		 * @brief A persistent, per-file cache of seek indexes
+		 *
+		 * Decoders that must scan a file to seek accurately may store the results of the scan here
+		 * and reuse them the next time the file is opened.  Each index is an opaque array of 64-bit
+		 * integers interpreted only by the decoder that stored it.
+		 *
+		 * Entries are identified by a Key derived from the file's size, modification time, and a hash
+		 * of its first and last 64 KiB, so a modified file never matches a stale index.  Only
+		 * seekable sources with \c file URLs can be cached.
+		 *
+		 * By default indexes are stored in \c org.sbooth.AudioEngine/SeekIndexes in the per-user cache
+		 * directory.  When the indexes in the directory exceed the maximum size the least recently used
+		 * are removed.  All methods are thread safe.
+		 */
+		class SeekIndexCache
+		{
+		public:
+
+			/*! @brief Identifies the file a seek index belongs to */
+			struct Key
+			{
+				uint64_t	mFileSize;				/*!< The size of the file in bytes */
+				int64_t		mModificationTime;		/*!< The file's modification time in nanoseconds since the epoch */
+				uint64_t	mContentHash;			/*!< A hash of the file's first and last 64 KiB */
+			};
+
+			/*!
+			 * @brief Create the key for the file underlying \c inputSource
+			 * @note The input source's offset is restored before returning
+			 * @param inputSource An open \c InputSource
+			 * @param key A \c Key to receive the result
+			 * @return \c true on success, \c false if the cache is disabled or \c inputSource can't be cached
+			 */
+			static bool CreateKey(InputSource& inputSource, Key& key);
+
+
+			/*! @brief Determine whether seek indexes are read from and written to the cache */
+			static bool IsEnabled();
+
+			/*! @brief Set whether seek indexes are read from and written to the cache */
+			static void SetEnabled(bool enabled);
+
+			/*!
+			 * @brief Set the directory in which seek indexes are stored
+			 * @param url The URL of the directory, or \c nullptr to use the default directory
+			 * @return \c true on success, \c false otherwise
+			 */
+			static bool SetDirectory(CFURLRef url);
+
+			/*! @brief Get the maximum total size of the stored seek indexes in bytes */
+			static uint64_t GetMaximumSize();
+
+			/*!
+			 * @brief Set the maximum total size of the stored seek indexes
+			 * @note The limit is enforced the next time an index is stored
+			 * @param bytes The maximum size in bytes, or \c 0 for no limit
+			 */
+			static void SetMaximumSize(uint64_t bytes);
+
+
+			/*!
+			 * @brief Retrieve a seek index from the cache
+			 * @param key The key of the file
+			 * @param type The kind of index, normally the decoder's source format ID
+			 * @param index A vector to receive the index
+			 * @return \c true on success, \c false if no valid index exists
+			 */
+			static bool Load(const Key& key, uint32_t type, std::vector<int64_t>& index);
+
+			/*!
+			 * @brief Store a seek index in the cache, replacing any existing index
+			 * @param key The key of the file
+			 * @param type The kind of index, normally the decoder's source format ID
+			 * @param index The index to store
+			 * @return \c true on success, \c false otherwise
+			 */
+			static bool Store(const Key& key, uint32_t type, const std::vector<int64_t>& index);
+
+			/*! @cond */
+
+			/*! @internal This class is non-constructible */
+			SeekIndexCache() = delete;
+
+			/*! @endcond */
+		};
+
+	}
+}
@@ -75,6 +75,14 @@ bool SFB::Audio::TrueAudioDecoder::HandlesMIMEType(CFStringRef mimeType)
 	return false;
 }
 
+SFB::Audio::Decoder::ProbeResult SFB::Audio::TrueAudioDecoder::ProbeFileHeader(const uint8_t *bytes, size_t count)
+{
+	if(4 > count)
+		return ProbeResult::NoMatch;
+
+	return 0 == memcmp(bytes, "TTA1", 4) ? ProbeResult::Match : ProbeResult::NoMatch;
+}
+
 SFB::Audio::Decoder::unique_ptr SFB::Audio::TrueAudioDecoder::CreateDecoder(InputSource::unique_ptr inputSource)
 {
 	return unique_ptr(new TrueAudioDecoder(std::move(inputSource)));
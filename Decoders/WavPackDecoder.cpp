@@ -9,6 +9,7 @@
 #include "CFWrapper.h"
 #include "CFErrorUtilities.h"
 #include "Logger.h"
+#include "SampleKernels.h"
 
 #define BUFFER_SIZE_FRAMES 2048
 
@@ -147,6 +148,14 @@ bool SFB::Audio::WavPackDecoder::HandlesMIMEType(CFStringRef mimeType)
 	return false;
 }
 
+SFB::Audio::Decoder::ProbeResult SFB::Audio::WavPackDecoder::ProbeFileHeader(const uint8_t *bytes, size_t count)
+{
+	if(4 > count)
+		return ProbeResult::NoMatch;
+
+	return 0 == memcmp(bytes, "wvpk", 4) ? ProbeResult::Match : ProbeResult::NoMatch;
+}
+
 SFB::Audio::Decoder::unique_ptr SFB::Audio::WavPackDecoder::CreateDecoder(InputSource::unique_ptr inputSource)
 {
 	return unique_ptr(new WavPackDecoder(std::move(inputSource)));
@@ -294,51 +303,34 @@ UInt32 SFB::Audio::WavPackDecoder::_ReadAudio(AudioBufferList *bufferList, UInt3
 		// The samples returned are handled differently based on the file's mode
 		int mode = WavpackGetMode(mWPC.get());
 
-		// Floating point files require no special handling other than deinterleaving
-		if(MODE_FLOAT & mode) {
-			float *inputBuffer = (float *)mBuffer.get();
-
-			// Deinterleave the samples
-			for(UInt32 channel = 0; channel < mFormat.mChannelsPerFrame; ++channel) {
-				float *floatBuffer = (float *)bufferList->mBuffers[channel].mData;
+		// Deinterleave the samples following any frames already read
+		int32_t *channels [mFormat.mChannelsPerFrame];
+		for(UInt32 channel = 0; channel < mFormat.mChannelsPerFrame; ++channel)
+			channels[channel] = (int32_t *)bufferList->mBuffers[channel].mData + totalFramesRead;
 
-				for(UInt32 sample = channel; sample < samplesRead * mFormat.mChannelsPerFrame; sample += mFormat.mChannelsPerFrame)
-					*floatBuffer++ = inputBuffer[sample];
+		// The 32-bit float and integer samples are deinterleaved bit for bit
+		DeinterleaveSamples(mBuffer.get(), channels, mFormat.mChannelsPerFrame, samplesRead);
 
-				bufferList->mBuffers[channel].mNumberChannels	= 1;
-				bufferList->mBuffers[channel].mDataByteSize		= samplesRead * sizeof(float);
-			}
-		}
+		// Floating point files require no special handling other than deinterleaving
 		// Lossless files will be handed off as integers
-		else if(MODE_LOSSLESS & mode) {
+		if(!(MODE_FLOAT & mode) && (MODE_LOSSLESS & mode)) {
 			// WavPack hands us 32-bit signed ints with the samples low-aligned; shift them to high alignment
 			UInt32 shift = (UInt32)(8 * (sizeof(int32_t) - (size_t)WavpackGetBytesPerSample(mWPC.get())));
 
-			// Deinterleave the 32-bit samples and shift to high-alignment
-			for(UInt32 channel = 0; channel < mFormat.mChannelsPerFrame; ++channel) {
-				int32_t *shiftedBuffer = (int32_t *)bufferList->mBuffers[channel].mData;
-
-				for(UInt32 sample = channel; sample < samplesRead * mFormat.mChannelsPerFrame; sample += mFormat.mChannelsPerFrame)
-					*shiftedBuffer++ = mBuffer[sample] << shift;
-
-				bufferList->mBuffers[channel].mNumberChannels	= 1;
-				bufferList->mBuffers[channel].mDataByteSize		= samplesRead * sizeof(int32_t);
-			}
+			for(UInt32 channel = 0; channel < mFormat.mChannelsPerFrame; ++channel)
+				ShiftInt32Samples(channels[channel], channels[channel], samplesRead, shift);
 		}
 		// Convert lossy files to float
-		else {
+		else if(!(MODE_FLOAT & mode)) {
 			float scaleFactor = (1 << ((WavpackGetBytesPerSample(mWPC.get()) * 8) - 1));
 
-			// Deinterleave the 32-bit samples and convert to float
-			for(UInt32 channel = 0; channel < mFormat.mChannelsPerFrame; ++channel) {
-				float *floatBuffer = (float *)bufferList->mBuffers[channel].mData;
-
-				for(UInt32 sample = channel; sample < samplesRead * mFormat.mChannelsPerFrame; sample += mFormat.mChannelsPerFrame)
-					*floatBuffer++ = mBuffer[sample] / scaleFactor;
+			for(UInt32 channel = 0; channel < mFormat.mChannelsPerFrame; ++channel)
+				ConvertInt32ToFloat(channels[channel], (float *)channels[channel], samplesRead, 1.f / scaleFactor);
+		}
 
-				bufferList->mBuffers[channel].mNumberChannels	= 1;
-				bufferList->mBuffers[channel].mDataByteSize		= samplesRead * sizeof(float);
-			}
+		for(UInt32 channel = 0; channel < mFormat.mChannelsPerFrame; ++channel) {
+			bufferList->mBuffers[channel].mNumberChannels	= 1;
+			bufferList->mBuffers[channel].mDataByteSize		= (totalFramesRead + samplesRead) * sizeof(int32_t);
 		}
 
 		totalFramesRead += samplesRead;
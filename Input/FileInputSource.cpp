@@ -3,19 +3,41 @@
  * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
  */
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
 #include <fcntl.h>
 #include <unistd.h>
 
 #include "FileInputSource.h"
+#include "Logger.h"
+#include "VirtualMemory.h"
+
+namespace {
+
+	// The size and alignment of reads from the file
+	constexpr SInt64 kBlockSize = 256 * 1024;
+
+	// The number of blocks requested ahead of a sequential reader
+	constexpr SInt64 kReadAheadBlocks = 2;
+
+}
 
 #pragma mark Creation and Destruction
 
-SFB::FileInputSource::FileInputSource(CFURLRef url)
-	: InputSource(url), mFile(nullptr, nullptr)
+SFB::FileInputSource::FileInputSource(CFURLRef url, bool bypassFileCache)
+	: InputSource(url), mFileDescriptor(-1), mBypassFileCache(bypassFileCache), mBuffer(nullptr, nullptr), mBufferOffset(0), mBufferLength(0), mOffset(0), mSequentialOffset(0)
 {
 	memset(&mFilestats, 0, sizeof(mFilestats));
 }
 
+SFB::FileInputSource::~FileInputSource()
+{
+	if(-1 != mFileDescriptor)
+		close(mFileDescriptor);
+}
+
 bool SFB::FileInputSource::_Open(CFErrorRef *error)
 {
 	UInt8 buf [PATH_MAX];
@@ -26,22 +48,64 @@ bool SFB::FileInputSource::_Open(CFErrorRef *error)
 		return false;
 	}
 
-	mFile = unique_FILE_ptr(std::fopen((const char *)buf, "r"), std::fclose);
-	if(!mFile) {
+	int flags = O_RDONLY;
+#if defined(O_DIRECT)
+	if(mBypassFileCache)
+		flags |= O_DIRECT;
+#endif
+
+	mFileDescriptor = open((const char *)buf, flags);
+#if defined(O_DIRECT)
+	// Not all file systems support direct I/O
+	if(-1 == mFileDescriptor && mBypassFileCache && EINVAL == errno) {
+		LOGGER_INFO("org.sbooth.AudioEngine.InputSource.File", "Direct I/O unavailable for " << (const char *)buf);
+		mFileDescriptor = open((const char *)buf, O_RDONLY);
+	}
+#endif
+
+	if(-1 == mFileDescriptor) {
 		if(error)
 			*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, errno, nullptr);
 		return false;
 	}
 
-	if(-1 == stat((const char *)buf, &mFilestats)) {
+	if(-1 == fstat(mFileDescriptor, &mFilestats)) {
 		if(error)
 			*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, errno, nullptr);
 
-		mFile.reset();
+		close(mFileDescriptor);
+		mFileDescriptor = -1;
 
 		return false;
 	}
 
+	mBuffer = unique_pages_ptr((uint8_t *)AllocatePages((size_t)kBlockSize), [](uint8_t *pages) {
+		DeallocatePages(pages, (size_t)kBlockSize);
+	});
+
+	if(!mBuffer) {
+		if(error)
+			*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, ENOMEM, nullptr);
+
+		close(mFileDescriptor);
+		mFileDescriptor = -1;
+
+		return false;
+	}
+
+#if __APPLE__
+	if(mBypassFileCache && -1 == fcntl(mFileDescriptor, F_NOCACHE, 1))
+		LOGGER_INFO("org.sbooth.AudioEngine.InputSource.File", "fcntl(F_NOCACHE) failed: " << strerror(errno));
+#else
+	if(!mBypassFileCache)
+		posix_fadvise(mFileDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	mBufferOffset = 0;
+	mBufferLength = 0;
+	mOffset = 0;
+	mSequentialOffset = 0;
+
 	return true;
 }
 
@@ -50,7 +114,130 @@ bool SFB::FileInputSource::_Close(CFErrorRef *error)
 #pragma unused(error)
 
 	memset(&mFilestats, 0, sizeof(mFilestats));
-	mFile.reset();
+
+	if(-1 != mFileDescriptor) {
+		close(mFileDescriptor);
+		mFileDescriptor = -1;
+	}
+
+	mBuffer.reset();
+	mBufferLength = 0;
 
 	return true;
 }
+
+SInt64 SFB::FileInputSource::_Read(void *buffer, SInt64 byteCount)
+{
+	auto dest = static_cast<uint8_t *>(buffer);
+	SInt64 bytesRead = 0;
+
+	while(bytesRead < byteCount) {
+		// Copy buffered bytes
+		if(mBufferOffset <= mOffset && mOffset < mBufferOffset + (SInt64)mBufferLength) {
+			auto bytesToCopy = std::min(byteCount - bytesRead, mBufferOffset + (SInt64)mBufferLength - mOffset);
+			memcpy(dest + bytesRead, mBuffer.get() + (mOffset - mBufferOffset), (size_t)bytesToCopy);
+			bytesRead += bytesToCopy;
+			mOffset += bytesToCopy;
+			continue;
+		}
+
+		// Read whole blocks directly into the caller's buffer; direct I/O requires an aligned destination
+		SInt64 bytesRemaining = byteCount - bytesRead;
+		if(!mBypassFileCache && 0 == mOffset % kBlockSize && kBlockSize <= bytesRemaining) {
+			bool sequential = mOffset == mSequentialOffset;
+			auto result = ReadAtOffset(dest + bytesRead, (size_t)((bytesRemaining / kBlockSize) * kBlockSize), mOffset);
+			if(0 >= result)
+				break;
+
+			bytesRead += result;
+			mOffset += result;
+			mSequentialOffset = mOffset;
+
+			if(sequential)
+				ReadAhead(mOffset);
+			continue;
+		}
+
+		if(!FillBuffer())
+			break;
+	}
+
+	return bytesRead;
+}
+
+bool SFB::FileInputSource::_AtEOF() const
+{
+	if(mOffset < mFilestats.st_size)
+		return false;
+
+	// The size captured when the file was opened is stale if the file has grown since
+	struct stat filestats;
+	if(-1 == fstat(mFileDescriptor, &filestats)) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.InputSource.File", "fstat failed: " << strerror(errno));
+		return true;
+	}
+
+	mFilestats = filestats;
+	return mOffset >= mFilestats.st_size;
+}
+
+bool SFB::FileInputSource::_SeekToOffset(SInt64 offset)
+{
+	mOffset = offset;
+	return true;
+}
+
+bool SFB::FileInputSource::FillBuffer()
+{
+	SInt64 blockOffset = (mOffset / kBlockSize) * kBlockSize;
+	bool sequential = blockOffset == mSequentialOffset;
+
+	auto result = ReadAtOffset(mBuffer.get(), (size_t)kBlockSize, blockOffset);
+	if(0 >= result) {
+		mBufferLength = 0;
+		return false;
+	}
+
+	mBufferOffset = blockOffset;
+	mBufferLength = (size_t)result;
+	mSequentialOffset = blockOffset + result;
+
+	// Random access, such as parsing metadata or seeking, doesn't benefit from read-ahead
+	if(sequential)
+		ReadAhead(mSequentialOffset);
+
+	return mOffset < mSequentialOffset;
+}
+
+SInt64 SFB::FileInputSource::ReadAtOffset(void *buffer, size_t byteCount, SInt64 offset)
+{
+	for(;;) {
+		auto result = pread(mFileDescriptor, buffer, byteCount, (off_t)offset);
+		if(-1 == result && EINTR == errno)
+			continue;
+
+		if(-1 == result)
+			LOGGER_ERR("org.sbooth.AudioEngine.InputSource.File", "pread failed for " << byteCount << " bytes at offset " << offset << ": " << strerror(errno));
+
+		return (SInt64)result;
+	}
+}
+
+void SFB::FileInputSource::ReadAhead(SInt64 offset)
+{
+	if(mBypassFileCache || offset >= mFilestats.st_size)
+		return;
+
+	SInt64 byteCount = std::min(kReadAheadBlocks * kBlockSize, mFilestats.st_size - offset);
+
+	// The reads are started asynchronously so the kernel fetches the blocks while the codec works
+#if __APPLE__
+	struct radvisory advisory = {
+		.ra_offset = (off_t)offset,
+		.ra_count = (int)byteCount
+	};
+	fcntl(mFileDescriptor, F_RDADVISE, &advisory);
+#else
+	posix_fadvise(mFileDescriptor, (off_t)offset, (off_t)byteCount, POSIX_FADV_WILLNEED);
+#endif
+}
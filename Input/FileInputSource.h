@@ -5,7 +5,7 @@
 
 #pragma once
 
-#include <cstdio>
+#include <functional>
 #include <memory>
 #include <sys/stat.h>
 
@@ -13,13 +13,18 @@
 
 namespace SFB {
 
+	// ========================================
+	// InputSource serving bytes from a file using large, block-aligned reads
+	// Small reads are served from a reusable buffer, and the kernel is asked to read ahead while the file is read sequentially
+	// ========================================
 	class FileInputSource : public InputSource
 	{
 
 	public:
 
 		// Creation
-		explicit FileInputSource(CFURLRef url);
+		explicit FileInputSource(CFURLRef url, bool bypassFileCache = false);
+		virtual ~FileInputSource();
 
 	private:
 
@@ -28,21 +33,34 @@ namespace SFB {
 		virtual bool _Close(CFErrorRef *error);
 
 		// Functionality
-		virtual SInt64 _Read(void *buffer, SInt64 byteCount)	{ return (SInt64)::fread(buffer, 1, (size_t)byteCount, mFile.get()); }
-		inline virtual bool _AtEOF() const						{ return ::feof(mFile.get()); }
+		virtual SInt64 _Read(void *buffer, SInt64 byteCount);
+		virtual bool _AtEOF() const;
 
-		inline virtual SInt64 _GetOffset() const				{ return ::ftello(mFile.get()); }
+		inline virtual SInt64 _GetOffset() const				{ return mOffset; }
 		inline virtual SInt64 _GetLength() const				{ return mFilestats.st_size; }
 
 		// Seeking support
 		inline virtual bool _SupportsSeeking() const			{ return true; }
-		virtual bool _SeekToOffset(SInt64 offset)				{ return (0 == ::fseeko(mFile.get(), offset, SEEK_SET)); }
+		virtual bool _SeekToOffset(SInt64 offset);
 
-		using unique_FILE_ptr = std::unique_ptr<std::FILE, std::function<int(std::FILE *)>>;
+		// Read the block containing mOffset into mBuffer
+		bool FillBuffer();
+		// Read from the file at offset, retrying interrupted reads
+		SInt64 ReadAtOffset(void *buffer, size_t byteCount, SInt64 offset);
+		// Ask the kernel to start reading the blocks following offset
+		void ReadAhead(SInt64 offset);
+
+		using unique_pages_ptr = std::unique_ptr<uint8_t, std::function<void(uint8_t *)>>;
 
 		// Data members
-		struct stat						mFilestats;
-		unique_FILE_ptr					mFile;
+		mutable struct stat				mFilestats;				// Refreshed when the offset reaches the end, since the file may still be growing
+		int								mFileDescriptor;
+		bool							mBypassFileCache;
+		unique_pages_ptr				mBuffer;
+		SInt64							mBufferOffset;			// The file offset of the first byte in mBuffer
+		size_t							mBufferLength;			// The number of valid bytes in mBuffer
+		SInt64							mOffset;				// The current offset
+		SInt64							mSequentialOffset;		// The offset following the most recent read from the file
 	};
 
 }
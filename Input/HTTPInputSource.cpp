@@ -3,6 +3,10 @@
  * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
  */
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
 #include "HTTPInputSource.h"
 #include "Logger.h"
 
@@ -19,6 +23,67 @@ namespace {
 		inputSource->HandleNetworkEvent(stream, type);
 	}
 
+	// The size of each cached range of bytes
+	constexpr SInt64 kBlockSize = 64 * 1024;
+
+	// The maximum number of cached blocks
+	constexpr size_t kMaximumCachedBlocks = 64;
+
+	// Request sizes double while the resource is read sequentially
+	constexpr SInt64 kMinimumRequestSize = 4 * kBlockSize;
+	constexpr SInt64 kMaximumRequestSize = 32 * kBlockSize;
+
+	// Reading this far ahead on the current response is cheaper than another round trip
+	constexpr SInt64 kMaximumForwardSkip = 4 * kBlockSize;
+
+	/*!
+	 * Parse the last decimal integer in a header value, such as the length in "bytes 0-99/1000"
+	 * @return The value, or \c -1 if none was found
+	 */
+	SInt64 ParseLength(CFStringRef value)
+	{
+		char buf [128];
+		if(nullptr == value || !CFStringGetCString(value, buf, sizeof(buf), kCFStringEncodingASCII))
+			return -1;
+
+		const char *digits = strrchr(buf, '/');
+		digits = digits ? digits + 1 : buf;
+
+		char *end = nullptr;
+		long long length = strtoll(digits, &end, 10);
+		if(end == digits || 0 > length)
+			return -1;
+
+		return (SInt64)length;
+	}
+
+	/*!
+	 * Parse the byte positions in a Content-Range header value, such as 0 and 99 in "bytes 0-99/1000"
+	 * @return \c true if both positions were found
+	 */
+	bool ParseRange(CFStringRef value, SInt64& firstBytePosition, SInt64& lastBytePosition)
+	{
+		char buf [128];
+		if(nullptr == value || !CFStringGetCString(value, buf, sizeof(buf), kCFStringEncodingASCII))
+			return false;
+
+		const char *digits = buf + strcspn(buf, "0123456789*");
+
+		char *end = nullptr;
+		long long first = strtoll(digits, &end, 10);
+		if(end == digits || '-' != *end)
+			return false;
+
+		digits = end + 1;
+		long long last = strtoll(digits, &end, 10);
+		if(end == digits || last < first)
+			return false;
+
+		firstBytePosition = (SInt64)first;
+		lastBytePosition = (SInt64)last;
+		return true;
+	}
+
 }
 
 
@@ -26,11 +91,165 @@ namespace {
 
 
 SFB::HTTPInputSource::HTTPInputSource(CFURLRef url)
-	: InputSource(url), mRequest(nullptr), mReadStream(nullptr), mResponseHeaders(nullptr), mEOSReached(false), mOffset(-1), mDesiredOffset(0)
+	: InputSource(url), mRequest(nullptr), mReadStream(nullptr), mResponseHeaders(nullptr), mResponseStatusCode(0), mStreamErrorOccurred(false), mStreamOffset(-1), mStreamEnd(-1), mRequestSize(kMinimumRequestSize), mRequestCount(0), mLength(-1), mOffset(0)
 {}
 
 bool SFB::HTTPInputSource::_Open(CFErrorRef *error)
 {
+	mLength = -1;
+	mOffset = 0;
+	mRequestSize = kMinimumRequestSize;
+	mRequestCount = 0;
+
+	// The first request determines the length and prefetches the start of the resource, which decoders always read
+	return OpenStream(0, error);
+}
+
+bool SFB::HTTPInputSource::_Close(CFErrorRef */*error*/)
+{
+	CloseStream();
+
+	mResponseHeaders = nullptr;
+	mBlocks.clear();
+
+	mLength = -1;
+	mOffset = 0;
+
+	return true;
+}
+
+SInt64 SFB::HTTPInputSource::_Read(void *buffer, SInt64 byteCount)
+{
+	auto dest = static_cast<uint8_t *>(buffer);
+	SInt64 bytesRead = 0;
+
+	while(bytesRead < byteCount && !_AtEOF()) {
+		const Block *block = GetBlock(mOffset / kBlockSize);
+		SInt64 blockOffset = mOffset % kBlockSize;
+		if(nullptr == block || blockOffset >= (SInt64)block->mData.size())
+			break;
+
+		auto bytesToCopy = std::min(byteCount - bytesRead, (SInt64)block->mData.size() - blockOffset);
+		memcpy(dest + bytesRead, block->mData.data() + blockOffset, (size_t)bytesToCopy);
+
+		bytesRead += bytesToCopy;
+		mOffset += bytesToCopy;
+	}
+
+	return bytesRead;
+}
+
+bool SFB::HTTPInputSource::_SeekToOffset(SInt64 offset)
+{
+	if(-1 != mLength && offset > mLength)
+		return false;
+
+	// Bytes are fetched when read, so there is nothing else to do
+	mOffset = offset;
+	return true;
+}
+
+CFStringRef SFB::HTTPInputSource::CopyContentMIMEType() const
+{
+	if(!IsOpen() || !mResponseHeaders)
+		return nullptr;
+
+	return reinterpret_cast<CFStringRef>(CFDictionaryGetValue(mResponseHeaders, CFSTR("Content-Type")));
+}
+
+#pragma mark Block Cache
+
+const SFB::HTTPInputSource::Block * SFB::HTTPInputSource::GetBlock(SInt64 index)
+{
+	for(auto iter = mBlocks.begin(); iter != mBlocks.end(); ++iter) {
+		if(iter->mIndex == index) {
+			mBlocks.splice(mBlocks.begin(), mBlocks, iter);
+			return &mBlocks.front();
+		}
+	}
+
+	return FetchBlock(index);
+}
+
+const SFB::HTTPInputSource::Block * SFB::HTTPInputSource::FetchBlock(SInt64 index)
+{
+	SInt64 offset = index * kBlockSize;
+
+	// Continue the current response if it will reach the block soon; a response that isn't a range
+	// is always continued since another request would start at the beginning as well
+	bool continueResponse = mReadStream && mStreamOffset <= offset && (-1 == mStreamEnd || (offset < mStreamEnd && offset - mStreamOffset <= kMaximumForwardSkip));
+	if(!continueResponse) {
+		if(-1 != mStreamEnd && offset == mStreamEnd)
+			mRequestSize = std::min(2 * mRequestSize, kMaximumRequestSize);
+		else
+			mRequestSize = kMinimumRequestSize;
+
+		if(!OpenStream(offset, nullptr) || !mReadStream)
+			return nullptr;
+	}
+
+	// Read and cache blocks until the requested one is reached
+	for(;;) {
+		Block block = { mStreamOffset / kBlockSize, std::vector<uint8_t>((size_t)kBlockSize) };
+
+		SInt64 bytesExpected = -1 != mStreamEnd ? std::min(kBlockSize, mStreamEnd - mStreamOffset) : kBlockSize;
+		SInt64 bytesRead = 0;
+		while(bytesRead < bytesExpected) {
+			CFIndex result = CFReadStreamRead(mReadStream, block.mData.data() + bytesRead, (CFIndex)(bytesExpected - bytesRead));
+			if(0 > result) {
+				SFB::CFError error(CFReadStreamCopyError(mReadStream));
+				LOGGER_ERR("org.sbooth.AudioEngine.InputSource.HTTP", "CFReadStreamRead failed: " << error);
+				CloseStream();
+				return nullptr;
+			}
+			else if(0 == result)
+				break;
+
+			bytesRead += result;
+		}
+
+		mStreamOffset += bytesRead;
+
+		if(bytesRead < bytesExpected) {
+			// A response that isn't a range ends with the resource
+			if(-1 == mStreamEnd && (-1 == mLength || mLength > mStreamOffset))
+				mLength = mStreamOffset;
+			// Otherwise the partial block can't be distinguished from the end of the resource
+			else if(-1 == mLength || mStreamOffset < mLength) {
+				LOGGER_WARNING("org.sbooth.AudioEngine.InputSource.HTTP", "Response ended " << (mStreamEnd - mStreamOffset) << " bytes early");
+				CloseStream();
+				return nullptr;
+			}
+		}
+
+		if(0 == bytesRead)
+			return nullptr;
+
+		block.mData.resize((size_t)bytesRead);
+		const Block *cachedBlock = CacheBlock(std::move(block));
+
+		if(cachedBlock->mIndex == index)
+			return cachedBlock;
+		// The resource ended before the requested block
+		else if(cachedBlock->mIndex > index || bytesRead < kBlockSize)
+			return nullptr;
+	}
+}
+
+const SFB::HTTPInputSource::Block * SFB::HTTPInputSource::CacheBlock(Block&& block)
+{
+	mBlocks.push_front(std::move(block));
+	if(mBlocks.size() > kMaximumCachedBlocks)
+		mBlocks.pop_back();
+	return &mBlocks.front();
+}
+
+#pragma mark Requests
+
+bool SFB::HTTPInputSource::OpenStream(SInt64 offset, CFErrorRef *error)
+{
+	CloseStream();
+
 	// Set up the HTTP request
 	mRequest = CFHTTPMessageCreateRequest(kCFAllocatorDefault, CFSTR("GET"), GetURL(), kCFHTTPVersion1_1);
 	if(!mRequest) {
@@ -41,11 +260,13 @@ bool SFB::HTTPInputSource::_Open(CFErrorRef *error)
 
 	CFHTTPMessageSetHeaderFieldValue(mRequest, CFSTR("User-Agent"), CFSTR("SFBAudioEngine"));
 
-	// Seek support
-	if(0 < mDesiredOffset) {
-		SFB::CFString byteRange(nullptr, CFSTR("bytes=%lld-"), mDesiredOffset);
-		CFHTTPMessageSetHeaderFieldValue(mRequest, CFSTR("Range"), byteRange);
-	}
+	// Bounded ranges allow the connection to be reused once the response is complete
+	SInt64 end = offset + mRequestSize;
+	if(-1 != mLength)
+		end = std::min(end, mLength);
+
+	SFB::CFString byteRange(nullptr, CFSTR("bytes=%lld-%lld"), offset, end - 1);
+	CFHTTPMessageSetHeaderFieldValue(mRequest, CFSTR("Range"), byteRange);
 
 	mReadStream = CFReadStreamCreateForHTTPRequest(kCFAllocatorDefault, mRequest);
 	if(!mReadStream) {
@@ -54,6 +275,9 @@ bool SFB::HTTPInputSource::_Open(CFErrorRef *error)
 		return false;
 	}
 
+	CFReadStreamSetProperty(mReadStream, kCFStreamPropertyHTTPAttemptPersistentConnection, kCFBooleanTrue);
+	CFReadStreamSetProperty(mReadStream, kCFStreamPropertyHTTPShouldAutoredirect, kCFBooleanTrue);
+
 	// Start the HTTP connection
 	CFStreamClientContext myContext = {
 		.version = 0,
@@ -64,99 +288,126 @@ bool SFB::HTTPInputSource::_Open(CFErrorRef *error)
 	};
 
 	CFOptionFlags clientFlags = kCFStreamEventOpenCompleted | kCFStreamEventHasBytesAvailable | kCFStreamEventErrorOccurred | kCFStreamEventEndEncountered;
-    if(!CFReadStreamSetClient(mReadStream, clientFlags, myCFReadStreamClientCallBack, &myContext)) {
+	if(!CFReadStreamSetClient(mReadStream, clientFlags, myCFReadStreamClientCallBack, &myContext)) {
 		if(error)
 			*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, ENOMEM, nullptr);
+		CloseStream();
 		return false;
 	}
 
 	CFReadStreamScheduleWithRunLoop(mReadStream, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
 
+	mResponseHeaders = nullptr;
+
 	if(!CFReadStreamOpen(mReadStream)) {
 		if(error)
 			*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, ENOMEM, nullptr);
+		CloseStream();
 		return false;
 	}
 
-	while(nullptr == mResponseHeaders)
-		CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0, true);
-
-	return true;
-}
-
-bool SFB::HTTPInputSource::_Close(CFErrorRef */*error*/)
-{
-	mRequest = nullptr;
-	mReadStream = nullptr;
-	mResponseHeaders = nullptr;
+	++mRequestCount;
 
-	mOffset = -1;
-	mDesiredOffset = 0;
+	while(nullptr == mResponseHeaders && !mStreamErrorOccurred)
+		CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0.1, true);
 
-	return true;
-}
+	// The body is read synchronously, so callbacks are no longer needed
+	CFReadStreamSetClient(mReadStream, kCFStreamEventNone, nullptr, nullptr);
+	CFReadStreamUnscheduleFromRunLoop(mReadStream, CFRunLoopGetCurrent(), kCFRunLoopDefaultMode);
 
-SInt64 SFB::HTTPInputSource::_Read(void *buffer, SInt64 byteCount)
-{
-	CFStreamStatus status = CFReadStreamGetStatus(mReadStream);
+	if(mStreamErrorOccurred) {
+		if(error)
+			*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, EIO, nullptr);
+		CloseStream();
+		return false;
+	}
 
-	if(kCFStreamStatusAtEnd == status)
-		return 0;
-	else if(kCFStreamStatusNotOpen == status || kCFStreamStatusClosed == status || kCFStreamStatusError == status)
-		return -1;
+	CFStringRef contentRange = reinterpret_cast<CFStringRef>(CFDictionaryGetValue(mResponseHeaders, CFSTR("Content-Range")));
 
-	CFIndex bytesRead = CFReadStreamRead(mReadStream, (UInt8 *)buffer, (CFIndex)byteCount);
+	switch(mResponseStatusCode) {
+		// The requested range, or a part of it
+		case 206:
+		{
+			if(-1 == mLength)
+				mLength = ParseLength(contentRange);
+
+			// Blocks are indexed by offset, so the range must start where requested and may end early only
+			// at a block boundary or the end of the resource
+			SInt64 first, last;
+			if(!ParseRange(contentRange, first, last) || first != offset || (0 != (last + 1) % kBlockSize && last + 1 != mLength)) {
+				LOGGER_ERR("org.sbooth.AudioEngine.InputSource.HTTP", "Content-Range doesn't match requested range " << offset << "-" << (end - 1));
+				if(error)
+					*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, EIO, nullptr);
+				CloseStream();
+				return false;
+			}
 
-	mOffset += bytesRead;
+			mStreamOffset = first;
+			mStreamEnd = last + 1;
+			break;
+		}
 
-	return bytesRead;
-}
+		// The entire resource, if the server doesn't support ranges
+		case 200:
+			mStreamOffset = 0;
+			mStreamEnd = -1;
+			if(-1 == mLength)
+				mLength = ParseLength(reinterpret_cast<CFStringRef>(CFDictionaryGetValue(mResponseHeaders, CFSTR("Content-Length"))));
+			break;
 
-SInt64 SFB::HTTPInputSource::_GetLength() const
-{
-	if(!mResponseHeaders)
-		return -1;
+		// The range starts at or beyond the end of the resource
+		case 416:
+			if(-1 == mLength)
+				mLength = ParseLength(contentRange);
+			if(-1 == mLength)
+				mLength = offset;
+			CloseStream();
+			break;
 
-	SInt64 contentLength = -1;
+		default:
+			LOGGER_ERR("org.sbooth.AudioEngine.InputSource.HTTP", "Unexpected HTTP status " << mResponseStatusCode << " for range " << offset << "-" << (end - 1));
+			if(error)
+				*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, EIO, nullptr);
+			CloseStream();
+			return false;
+	}
 
-	// FIXME: 64-bit lengths aren't handled correctly
-	CFStringRef contentLengthString = reinterpret_cast<CFStringRef>(CFDictionaryGetValue(mResponseHeaders, CFSTR("Content-Length")));
-	if(contentLengthString)
-		contentLength = CFStringGetIntValue(contentLengthString);
+	LOGGER_DEBUG("org.sbooth.AudioEngine.InputSource.HTTP", "Request " << mRequestCount << " for range " << offset << "-" << (end - 1) << ": HTTP " << mResponseStatusCode);
 
-	return contentLength;
+	return true;
 }
 
-bool SFB::HTTPInputSource::_SeekToOffset(SInt64 offset)
+void SFB::HTTPInputSource::CloseStream()
 {
-	if(!_Close(nullptr))
-		return false;
-
-	mDesiredOffset = offset;
-	return _Open(nullptr);
-}
+	if(mReadStream)
+		CFReadStreamClose(mReadStream);
 
-CFStringRef SFB::HTTPInputSource::CopyContentMIMEType() const
-{
-	if(!IsOpen() || !mResponseHeaders)
-		return nullptr;
+	mRequest = nullptr;
+	mReadStream = nullptr;
 
-	return reinterpret_cast<CFStringRef>(CFDictionaryGetValue(mResponseHeaders, CFSTR("Content-Type")));
+	mResponseStatusCode = 0;
+	mStreamErrorOccurred = false;
+	mStreamOffset = -1;
+	mStreamEnd = -1;
 }
 
 void SFB::HTTPInputSource::HandleNetworkEvent(CFReadStreamRef stream, CFStreamEventType type)
 {
 	switch(type) {
 		case kCFStreamEventOpenCompleted:
-			mOffset = mDesiredOffset;
 			break;
 
 		case kCFStreamEventHasBytesAvailable:
+		case kCFStreamEventEndEncountered:
 			if(nullptr == mResponseHeaders) {
 				SFB::CFType responseHeader(CFReadStreamCopyProperty(stream, kCFStreamPropertyHTTPResponseHeader));
 				if(responseHeader) {
 					mResponseHeaders = CFHTTPMessageCopyAllHeaderFields((CFHTTPMessageRef)responseHeader.Object());
+					mResponseStatusCode = CFHTTPMessageGetResponseStatusCode((CFHTTPMessageRef)responseHeader.Object());
 				}
+				// A response without headers can't be used
+				else if(kCFStreamEventEndEncountered == type)
+					mStreamErrorOccurred = true;
 			}
 			break;
 
@@ -165,11 +416,8 @@ void SFB::HTTPInputSource::HandleNetworkEvent(CFReadStreamRef stream, CFStreamEv
 			SFB::CFError error(CFReadStreamCopyError(stream));
 			if(error)
 				LOGGER_ERR("org.sbooth.AudioEngine.InputSource.HTTP", "Error: " << error);
+			mStreamErrorOccurred = true;
 			break;
 		}
-
-		case kCFStreamEventEndEncountered:
-			mEOSReached = true;
-			break;
 	}
 }
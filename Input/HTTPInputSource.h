@@ -5,6 +5,9 @@
 
 #pragma once
 
+#include <list>
+#include <vector>
+
 #include <CoreFoundation/CoreFoundation.h>
 
 #if TARGET_OS_IPHONE
@@ -17,6 +20,11 @@
 
 namespace SFB {
 
+	// ========================================
+	// InputSource serving bytes from an HTTP server
+	// Bytes are fetched in blocks using range requests over persistent connections and cached, so seeking
+	// within recently read ranges doesn't require another request
+	// ========================================
 	class HTTPInputSource : public InputSource
 	{
 
@@ -25,6 +33,9 @@ namespace SFB {
 		// Creation
 		explicit HTTPInputSource(CFURLRef url);
 
+		// The number of HTTP requests made since opening
+		inline uint64_t GetRequestCount() const					{ return mRequestCount; }
+
 	private:
 
 		// Bytestream access
@@ -33,10 +44,10 @@ namespace SFB {
 
 		// Functionality
 		virtual SInt64 _Read(void *buffer, SInt64 byteCount);
-		inline virtual bool _AtEOF()	const					{ return mEOSReached; }
+		inline virtual bool _AtEOF()	const					{ return -1 != mLength && mOffset >= mLength; }
 
 		inline virtual SInt64 _GetOffset() const				{ return mOffset; }
-		virtual SInt64 _GetLength() const;
+		inline virtual SInt64 _GetLength() const				{ return mLength; }
 
 		// Seeking support
 		inline virtual bool _SupportsSeeking() const			{ return true; }
@@ -44,13 +55,39 @@ namespace SFB {
 
 		CFStringRef CopyContentMIMEType() const;
 
+		// A cached range of bytes
+		struct Block
+		{
+			SInt64					mIndex;		// The offset of the block divided by the block size
+			std::vector<uint8_t>	mData;		// Shorter than the block size only at the end of input
+		};
+
+		// Get the block with the specified index from the cache, fetching it if necessary
+		const Block * GetBlock(SInt64 index);
+		// Read blocks from the current response until the block with the specified index is read
+		const Block * FetchBlock(SInt64 index);
+		// Add a block to the cache, evicting the least recently used block if the cache is full
+		const Block * CacheBlock(Block&& block);
+
+		// Start a request for the bytes at offset
+		bool OpenStream(SInt64 offset, CFErrorRef *error);
+		void CloseStream();
+
 		// Data members
 		SFB::CFHTTPMessage				mRequest;
 		SFB::CFReadStream				mReadStream;
 		SFB::CFDictionary				mResponseHeaders;
-		bool							mEOSReached;
+		CFIndex							mResponseStatusCode;
+		bool							mStreamErrorOccurred;
+		SInt64							mStreamOffset;			// The offset of the next byte from mReadStream
+		SInt64							mStreamEnd;				// The offset following the last byte requested, or -1 if open-ended
+		SInt64							mRequestSize;			// The number of bytes to request next; grows during sequential access
+		uint64_t						mRequestCount;
+
+		std::list<Block>				mBlocks;				// Most recently used first
+
+		SInt64							mLength;				// The length of the resource, or -1 if unknown
 		SInt64							mOffset;
-		SInt64							mDesiredOffset;
 
 	public:
 
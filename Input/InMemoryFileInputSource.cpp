@@ -82,6 +82,18 @@ SInt64 SFB::InMemoryFileInputSource::_Read(void *buffer, SInt64 byteCount)
 	return byteCount;
 }
 
+SInt64 SFB::InMemoryFileInputSource::_Borrow(const void **bytes, SInt64 byteCount)
+{
+	ptrdiff_t remaining = (mMemory.get() + mFilestats.st_size) - mCurrentPosition;
+
+	if(byteCount > remaining)
+		byteCount = remaining;
+
+	*bytes = mCurrentPosition;
+	mCurrentPosition += byteCount;
+	return byteCount;
+}
+
 bool SFB::InMemoryFileInputSource::_SeekToOffset(SInt64 offset)
 {
 	if(offset > mFilestats.st_size)
@@ -42,6 +42,10 @@ namespace SFB {
 		inline virtual bool _SupportsSeeking() const			{ return true; }
 		virtual bool _SeekToOffset(SInt64 offset);
 
+		// Borrowing support
+		inline virtual bool _SupportsBorrowing() const			{ return true; }
+		virtual SInt64 _Borrow(const void **bytes, SInt64 byteCount);
+
 		// Data members
 		struct stat						mFilestats;
 		std::unique_ptr<int8_t []>		mMemory;
@@ -19,6 +19,11 @@ const CFStringRef SFB::InputSource::ErrorDomain = CFSTR("org.sbooth.AudioEngine.
 #pragma mark Static Methods
 
 SFB::InputSource::unique_ptr SFB::InputSource::CreateForURL(CFURLRef url, int flags, CFErrorRef *error)
+{
+	return CreateForURL(url, flags, MemoryMapAccessHints(), error);
+}
+
+SFB::InputSource::unique_ptr SFB::InputSource::CreateForURL(CFURLRef url, int flags, const MemoryMapAccessHints& hints, CFErrorRef *error)
 {
 	if(nullptr == url)
 		return nullptr;
@@ -33,11 +38,11 @@ SFB::InputSource::unique_ptr SFB::InputSource::CreateForURL(CFURLRef url, int fl
 
 	if(kCFCompareEqualTo == CFStringCompare(CFSTR("file"), scheme, kCFCompareCaseInsensitive)) {
 		if(InputSource::MemoryMapFiles & flags)
-			return unique_ptr(new MemoryMappedFileInputSource(url));
+			return unique_ptr(new MemoryMappedFileInputSource(url, hints));
 		else if(InputSource::LoadFilesInMemory & flags)
 			return unique_ptr(new InMemoryFileInputSource(url));
 		else
-			return unique_ptr(new FileInputSource(url));
+			return unique_ptr(new FileInputSource(url, InputSource::BypassFileCache & flags));
 	}
 	else if(kCFCompareEqualTo == CFStringCompare(CFSTR("http"), scheme, kCFCompareCaseInsensitive))
 		return unique_ptr(new HTTPInputSource(url));
@@ -62,10 +67,8 @@ SFB::InputSource::InputSource()
 {}
 
 SFB::InputSource::InputSource(CFURLRef url)
-	: mURL((CFURLRef)CFRetain(url)), mIsOpen(false)
-{
-	assert(nullptr != url);
-}
+	: mURL(url ? (CFURLRef)CFRetain(url) : nullptr), mIsOpen(false)
+{}
 
 bool SFB::InputSource::Open(CFErrorRef *error)
 {
@@ -103,6 +106,26 @@ SInt64 SFB::InputSource::Read(void *buffer, SInt64 byteCount)
 	return _Read(buffer, byteCount);
 }
 
+bool SFB::InputSource::SupportsBorrowing() const
+{
+	if(!IsOpen()) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.InputSource", "SupportsBorrowing() called on an InputSource that hasn't been opened");
+		return false;
+	}
+
+	return _SupportsBorrowing();
+}
+
+SInt64 SFB::InputSource::Borrow(const void **bytes, SInt64 byteCount)
+{
+	if(!IsOpen() || nullptr == bytes || 0 > byteCount) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.InputSource", "Borrow() called on an InputSource that hasn't been opened");
+		return -1;
+	}
+
+	return _Borrow(bytes, byteCount);
+}
+
 bool SFB::InputSource::AtEOF() const
 {
 	if(!IsOpen()) {
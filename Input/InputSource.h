@@ -34,7 +34,31 @@ namespace SFB {
 		/*! Flags used in \c InputSource::CreateForURL */
 		enum InputSourceFlags {
 			MemoryMapFiles			= 1 << 0,	/*!< Files should be mapped in memory using \c mmap() */
-			LoadFilesInMemory		= 1 << 1	/*!< Files should be fully loaded in memory */
+			LoadFilesInMemory		= 1 << 1,	/*!< Files should be fully loaded in memory */
+			BypassFileCache			= 1 << 2	/*!< Files should be read without populating the kernel's file cache (\c F_NOCACHE or \c O_DIRECT) */
+		};
+
+
+		/*! @brief The expected pattern of access to a memory-mapped file */
+		enum class MemoryAccessPattern {
+			Normal,				/*!< No particular pattern */
+			Sequential,			/*!< Mostly sequential, as during playback */
+			Random				/*!< Random, with no benefit from read-ahead */
+		};
+
+		/*!
+		 * @brief Hints describing how a memory-mapped file will be accessed
+		 *
+		 * The hints are passed to \c madvise() so the kernel can read the file ahead of the decoder
+		 * instead of faulting each page in on demand, and so resident memory remains bounded when
+		 * playing large files.  The default values suit playback.
+		 */
+		struct MemoryMapAccessHints
+		{
+			MemoryAccessPattern		mAccessPattern		= MemoryAccessPattern::Sequential;	/*!< The expected access pattern for the whole file */
+			size_t					mReadAheadBytes		= 2 * 1024 * 1024;					/*!< The size of the window following the read position requested with \c MADV_WILLNEED, or \c 0 */
+			size_t					mReleaseBehindBytes	= 0;								/*!< The amount preceding the read position kept resident, with older pages released using \c MADV_DONTNEED, or \c 0 to keep everything */
+			size_t					mPrefetchBytes		= 1024 * 1024;						/*!< The amount at the start of the file faulted in on a background queue when opened, or \c 0 */
 		};
 
 
@@ -55,6 +79,17 @@ namespace SFB {
 		 */
 		static unique_ptr CreateForURL(CFURLRef url, int flags = 0, CFErrorRef *error = nullptr);
 
+		/*!
+		 * Create a new \c InputSource for the given URL
+		 * @param url The URL
+		 * @param flags Optional flags affecting how \c url is handled
+		 * @param hints The access hints used if \c url is a file mapped in memory
+		 * @param error An optional pointer to a \c CFErrorRef to receive error information
+		 * @return An \c InputSource for the specified URL, or \c nullptr on failure
+		 * @see InputSourceFlags
+		 */
+		static unique_ptr CreateForURL(CFURLRef url, int flags, const MemoryMapAccessHints& hints, CFErrorRef *error = nullptr);
+
 		/*!
 		 * Create a new \c InputSource for the given byte buffer
 		 * @param bytes A pointer to the desired byte buffer
@@ -216,6 +251,23 @@ namespace SFB {
 		}
 
 
+		/*! @brief Query whether this \c InputSource can lend its bytes without copying them */
+		bool SupportsBorrowing() const;
+
+		/*!
+		 * @brief Borrow bytes from the input without copying them
+		 *
+		 * This is equivalent to \c Read() except the bytes are used in place instead of being copied
+		 * to a buffer.  The bytes are read-only and remain valid until the input is closed.
+		 * @note This is only supported by memory-backed inputs
+		 * @param bytes Receives a pointer to the bytes at the current offset
+		 * @param byteCount The maximum number of bytes to borrow
+		 * @return The number of bytes borrowed, or \c -1 on error
+		 * @see SupportsBorrowing()
+		 */
+		SInt64 Borrow(const void **bytes, SInt64 byteCount);
+
+
 		/*! @brief Determine whether the end of input has been reached */
 		bool AtEOF() const;
 
@@ -244,7 +296,7 @@ namespace SFB {
 		/*! @brief Create a new \c InputSource and initialize \c InputSource::mURL to \c nullptr */
 		InputSource();
 
-		/*! @brief Create a new \c InputSource and initialize \c InputSource::mURL to \c url */
+		/*! @brief Create a new \c InputSource and initialize \c InputSource::mURL to \c url, which may be \c nullptr */
 		explicit InputSource(CFURLRef url);
 
 	private:
@@ -261,6 +313,10 @@ namespace SFB {
 		virtual bool _SupportsSeeking() const					{ return false; }
 		virtual bool _SeekToOffset(SInt64 /*offset*/)			{ return false; }
 
+		// Optional borrowing support
+		virtual bool _SupportsBorrowing() const					{ return false; }
+		virtual SInt64 _Borrow(const void ** /*bytes*/, SInt64 /*byteCount*/)	{ return -1; }
+
 		// Data members
 		SFB::CFURL mURL;	/*!< @brief The location of the bytes to be read */
 		bool mIsOpen;		/*!< @brief Indicates if input is open */
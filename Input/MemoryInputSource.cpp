@@ -57,6 +57,18 @@ SInt64 SFB::MemoryInputSource::_Read(void *buffer, SInt64 byteCount)
 	return byteCount;
 }
 
+SInt64 SFB::MemoryInputSource::_Borrow(const void **bytes, SInt64 byteCount)
+{
+	ptrdiff_t remaining = (mMemory.get() + mByteCount) - mCurrentPosition;
+
+	if(byteCount > remaining)
+		byteCount = remaining;
+
+	*bytes = mCurrentPosition;
+	mCurrentPosition += byteCount;
+	return byteCount;
+}
+
 bool SFB::MemoryInputSource::_SeekToOffset(SInt64 offset)
 {
 	if(offset > mByteCount)
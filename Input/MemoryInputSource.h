@@ -39,6 +39,10 @@ namespace SFB {
 		inline virtual bool _SupportsSeeking() const			{ return true; }
 		virtual bool _SeekToOffset(SInt64 offset);
 
+		// Borrowing support
+		inline virtual bool _SupportsBorrowing() const			{ return true; }
+		virtual SInt64 _Borrow(const void **bytes, SInt64 byteCount);
+
 		using unique_mem_ptr = std::unique_ptr<int8_t, void (*)(int8_t *)>;
 
 		// Data members
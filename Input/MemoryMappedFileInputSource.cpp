@@ -3,16 +3,30 @@
  * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
  */
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <dispatch/dispatch.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
 
 #include "MemoryMappedFileInputSource.h"
+#include "Logger.h"
+#include "VirtualMemory.h"
+
+namespace {
+
+	// Pages behind the read position are released in batches of at least this size
+	constexpr SInt64 kReleaseGranularity = 1024 * 1024;
+
+}
 
 #pragma mark Creation and Destruction
 
-SFB::MemoryMappedFileInputSource::MemoryMappedFileInputSource(CFURLRef url)
-	: InputSource(url), mMemory(nullptr), mCurrentPosition(nullptr)
+SFB::MemoryMappedFileInputSource::MemoryMappedFileInputSource(CFURLRef url, const MemoryMapAccessHints& hints)
+	: InputSource(url), mMemory(nullptr), mCurrentPosition(nullptr), mHints(hints), mReadAheadOffset(0), mReleasedOffset(0)
 {
 	memset(&mFilestats, 0, sizeof(mFilestats));
 }
@@ -49,16 +63,30 @@ bool SFB::MemoryMappedFileInputSource::_Open(CFErrorRef *error)
 
 	// Map the file to memory
 	size_t map_size = (size_t)mFilestats.st_size;
-	mMemory = unique_mappedmem_ptr((int8_t *)mmap(0, map_size, PROT_READ, MAP_FILE | MAP_SHARED, ::fileno(file.get()), 0), std::bind(munmap, std::placeholders::_1, map_size));
+	void *memory = mmap(0, map_size, PROT_READ, MAP_FILE | MAP_SHARED, ::fileno(file.get()), 0);
 
-	if(MAP_FAILED == mMemory.get()) {
+	if(MAP_FAILED == memory) {
 		if(error)
 			*error = CFErrorCreate(kCFAllocatorDefault, kCFErrorDomainPOSIX, errno, nullptr);
 		return false;
 	}
 
+	mMemory = shared_mappedmem_ptr((int8_t *)memory, std::bind(munmap, std::placeholders::_1, map_size));
 	mCurrentPosition = mMemory.get();
 
+	switch(mHints.mAccessPattern) {
+		case MemoryAccessPattern::Normal:											break;
+		case MemoryAccessPattern::Sequential:	Advise(0, mFilestats.st_size, MADV_SEQUENTIAL);	break;
+		case MemoryAccessPattern::Random:		Advise(0, mFilestats.st_size, MADV_RANDOM);		break;
+	}
+
+	// Fault in the beginning of the file in the background so the first audio isn't delayed by page faults
+	mReadAheadOffset = std::min((SInt64)mHints.mPrefetchBytes, (SInt64)mFilestats.st_size);
+	if(0 < mReadAheadOffset)
+		Prefault(mReadAheadOffset);
+
+	mReleasedOffset = 0;
+
 	return true;
 }
 
@@ -66,9 +94,16 @@ bool SFB::MemoryMappedFileInputSource::_Close(CFErrorRef *error)
 {
 #pragma unused(error)
 
+	// The mapping is released once the prefault block, if any, has finished
+	if(mPrefaultCancelled)
+		mPrefaultCancelled->store(true);
+	mPrefaultCancelled.reset();
+
 	memset(&mFilestats, 0, sizeof(mFilestats));
 	mMemory.reset();
 	mCurrentPosition = nullptr;
+	mReadAheadOffset = 0;
+	mReleasedOffset = 0;
 
 	return true;
 }
@@ -82,6 +117,20 @@ SInt64 SFB::MemoryMappedFileInputSource::_Read(void *buffer, SInt64 byteCount)
 
 	memcpy(buffer, mCurrentPosition, (size_t)byteCount);
 	mCurrentPosition += byteCount;
+	UpdateAccessHints();
+	return byteCount;
+}
+
+SInt64 SFB::MemoryMappedFileInputSource::_Borrow(const void **bytes, SInt64 byteCount)
+{
+	ptrdiff_t remaining = (mMemory.get() + mFilestats.st_size) - mCurrentPosition;
+
+	if(byteCount > remaining)
+		byteCount = remaining;
+
+	*bytes = mCurrentPosition;
+	mCurrentPosition += byteCount;
+	UpdateAccessHints();
 	return byteCount;
 }
 
@@ -90,6 +139,60 @@ bool SFB::MemoryMappedFileInputSource::_SeekToOffset(SInt64 offset)
 	if(offset > mFilestats.st_size)
 		return false;
 
+	// Read-ahead and release restart from the new position after seeking backward
+	SInt64 pageSize = (SInt64)GetPageSize();
+	if(offset < _GetOffset()) {
+		mReadAheadOffset = 0;
+		mReleasedOffset = std::min(mReleasedOffset, (std::max(offset - (SInt64)mHints.mReleaseBehindBytes, (SInt64)0) / pageSize) * pageSize);
+	}
+
 	mCurrentPosition = mMemory.get() + offset;
+	UpdateAccessHints();
 	return true;
 }
+
+void SFB::MemoryMappedFileInputSource::UpdateAccessHints()
+{
+	SInt64 offset = _GetOffset();
+	SInt64 length = mFilestats.st_size;
+	SInt64 pageSize = (SInt64)GetPageSize();
+
+	// Request the next window once half of the current one has been consumed
+	if(0 < mHints.mReadAheadBytes && mReadAheadOffset < length && offset + (SInt64)mHints.mReadAheadBytes / 2 >= mReadAheadOffset) {
+		SInt64 start = (std::max(offset, mReadAheadOffset) / pageSize) * pageSize;
+		SInt64 end = std::min(offset + (SInt64)mHints.mReadAheadBytes, length);
+		if(start < end)
+			Advise(start, end - start, MADV_WILLNEED);
+		mReadAheadOffset = end;
+	}
+
+	// Release pages that won't be needed again to cap resident memory
+	if(0 < mHints.mReleaseBehindBytes && offset - (SInt64)mHints.mReleaseBehindBytes >= mReleasedOffset + kReleaseGranularity) {
+		SInt64 end = ((offset - (SInt64)mHints.mReleaseBehindBytes) / pageSize) * pageSize;
+		Advise(mReleasedOffset, end - mReleasedOffset, MADV_DONTNEED);
+		mReleasedOffset = end;
+	}
+}
+
+void SFB::MemoryMappedFileInputSource::Advise(SInt64 offset, SInt64 length, int advice) const
+{
+	if(-1 == madvise(mMemory.get() + offset, (size_t)length, advice))
+		LOGGER_INFO("org.sbooth.AudioEngine.InputSource.MemoryMappedFile", "madvise(" << advice << ") failed for " << length << " bytes at offset " << offset << ": " << strerror(errno));
+}
+
+void SFB::MemoryMappedFileInputSource::Prefault(SInt64 length)
+{
+	// MADV_WILLNEED only starts reading; touching the pages maps them too, so the decoder takes no faults
+	Advise(0, length, MADV_WILLNEED);
+
+	auto memory = mMemory;
+	auto cancelled = std::make_shared<std::atomic_bool>(false);
+	mPrefaultCancelled = cancelled;
+
+	size_t pageSize = GetPageSize();
+	dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+		volatile int8_t sink = 0;
+		for(size_t offset = 0; offset < (size_t)length && !cancelled->load(); offset += pageSize)
+			sink = memory.get()[offset];
+	});
+}
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <sys/stat.h>
 
@@ -21,7 +22,10 @@ namespace SFB {
 	public:
 
 		// Creation
-		explicit MemoryMappedFileInputSource(CFURLRef url);
+		explicit MemoryMappedFileInputSource(CFURLRef url, const MemoryMapAccessHints& hints = MemoryMapAccessHints());
+
+		// The hints used by this input source
+		inline const MemoryMapAccessHints& GetAccessHints() const	{ return mHints; }
 
 	private:
 
@@ -40,12 +44,28 @@ namespace SFB {
 		inline virtual bool _SupportsSeeking() const			{ return true; }
 		virtual bool _SeekToOffset(SInt64 offset);
 
-		using unique_mappedmem_ptr = std::unique_ptr<int8_t, std::function<int(int8_t *)>>;
+		// Borrowing support
+		inline virtual bool _SupportsBorrowing() const			{ return true; }
+		virtual SInt64 _Borrow(const void **bytes, SInt64 byteCount);
+
+		// Advise the kernel of upcoming and completed accesses following a change in the read position
+		void UpdateAccessHints();
+		void Advise(SInt64 offset, SInt64 length, int advice) const;
+
+		// Touch each page of the first length bytes on a background queue
+		void Prefault(SInt64 length);
+
+		// Shared with the prefault block, which may outlive the input source
+		using shared_mappedmem_ptr = std::shared_ptr<int8_t>;
 
 		// Data members
 		struct stat						mFilestats;
-		unique_mappedmem_ptr			mMemory;
+		shared_mappedmem_ptr			mMemory;
 		int8_t							*mCurrentPosition;
+		MemoryMapAccessHints			mHints;
+		std::shared_ptr<std::atomic_bool>	mPrefaultCancelled;
+		SInt64							mReadAheadOffset;		// The end of the most recent MADV_WILLNEED window
+		SInt64							mReleasedOffset;		// The end of the most recent MADV_DONTNEED region
 	};
 
 }
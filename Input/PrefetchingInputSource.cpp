@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <pthread.h>
+
+#include "PrefetchingInputSource.h"
+#include "Logger.h"
+
+namespace {
+
+	// The maximum number of bytes requested from the wrapped input source at once
+	constexpr size_t kIOChunkSize = 64 * 1024;
+
+}
+
+#pragma mark Creation and Destruction
+
+SFB::PrefetchingInputSource::PrefetchingInputSource(InputSource::unique_ptr inputSource, size_t windowSize)
+	: InputSource(inputSource->GetURL()), mInputSource(std::move(inputSource)), mLength(0), mSupportsSeeking(false), mWindow(std::max(windowSize, (size_t)1)), mWindowHead(0), mWindowCount(0), mOffset(0), mGeneration(0), mEndOfInput(false), mStopIOThread(false), mHitCount(0), mMissCount(0), mStallCount(0)
+{}
+
+SFB::PrefetchingInputSource::~PrefetchingInputSource()
+{
+	StopIOThread();
+}
+
+bool SFB::PrefetchingInputSource::_Open(CFErrorRef *error)
+{
+	if(!mInputSource->IsOpen() && !mInputSource->Open(error))
+		return false;
+
+	// These are cached so the wrapped input source is only used by the I/O thread
+	mLength = mInputSource->GetLength();
+	mSupportsSeeking = mInputSource->SupportsSeeking();
+
+	mWindowHead = 0;
+	mWindowCount = 0;
+	mOffset = mInputSource->GetOffset();
+	mEndOfInput = false;
+	mStopIOThread = false;
+
+	mIOThread = std::thread(&PrefetchingInputSource::IOThreadEntry, this);
+
+	return true;
+}
+
+bool SFB::PrefetchingInputSource::_Close(CFErrorRef *error)
+{
+	StopIOThread();
+	return mInputSource->Close(error);
+}
+
+SInt64 SFB::PrefetchingInputSource::_Read(void *buffer, SInt64 byteCount)
+{
+	auto dest = static_cast<uint8_t *>(buffer);
+	SInt64 bytesRead = 0;
+	bool stalled = false;
+
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	while(bytesRead < byteCount) {
+		if(0 < mWindowCount) {
+			// Copy from the ring buffer in at most two pieces
+			auto bytesToCopy = (size_t)std::min((SInt64)mWindowCount, byteCount - bytesRead);
+			auto n1 = std::min(bytesToCopy, mWindow.size() - mWindowHead);
+			memcpy(dest + bytesRead, mWindow.data() + mWindowHead, n1);
+			if(n1 < bytesToCopy)
+				memcpy(dest + bytesRead + n1, mWindow.data(), bytesToCopy - n1);
+
+			mWindowHead = (mWindowHead + bytesToCopy) % mWindow.size();
+			mWindowCount -= bytesToCopy;
+			mOffset += (SInt64)bytesToCopy;
+			bytesRead += (SInt64)bytesToCopy;
+
+			// There is now room for the I/O thread to read further ahead
+			mCondition.notify_all();
+			continue;
+		}
+
+		if(mEndOfInput)
+			break;
+
+		stalled = true;
+		mCondition.wait(lock, [this] { return 0 < mWindowCount || mEndOfInput; });
+	}
+
+	lock.unlock();
+
+	if(stalled)
+		mStallCount.fetch_add(1, std::memory_order_relaxed);
+	else if(0 < bytesRead)
+		mHitCount.fetch_add(1, std::memory_order_relaxed);
+
+	return bytesRead;
+}
+
+bool SFB::PrefetchingInputSource::_AtEOF() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mEndOfInput && 0 == mWindowCount;
+}
+
+SInt64 SFB::PrefetchingInputSource::_GetOffset() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mOffset;
+}
+
+bool SFB::PrefetchingInputSource::_SeekToOffset(SInt64 offset)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	// Discard the skipped bytes when seeking forward within the window
+	if(mOffset <= offset && offset <= mOffset + (SInt64)mWindowCount) {
+		auto bytesToSkip = (size_t)(offset - mOffset);
+		mWindowHead = (mWindowHead + bytesToSkip) % mWindow.size();
+		mWindowCount -= bytesToSkip;
+		mOffset = offset;
+		mCondition.notify_all();
+		return true;
+	}
+
+	if(!mSupportsSeeking)
+		return false;
+
+	// Restart read-ahead at the new offset; anything the I/O thread is reading now is discarded
+	mMissCount.fetch_add(1, std::memory_order_relaxed);
+
+	++mGeneration;
+	mWindowHead = 0;
+	mWindowCount = 0;
+	mOffset = offset;
+	mEndOfInput = false;
+	mCondition.notify_all();
+
+	return true;
+}
+
+#pragma mark I/O Thread
+
+void SFB::PrefetchingInputSource::IOThreadEntry()
+{
+	pthread_setname_np("org.sbooth.AudioEngine.InputSource.Prefetch");
+
+	std::vector<uint8_t> chunk(std::min(kIOChunkSize, mWindow.size()));
+
+	// The offset of mInputSource, which only this thread uses
+	SInt64 inputOffset = mInputSource->GetOffset();
+
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	for(;;) {
+		mCondition.wait(lock, [this] { return mStopIOThread || (!mEndOfInput && mWindowCount < mWindow.size()); });
+		if(mStopIOThread)
+			break;
+
+		uint64_t generation = mGeneration;
+		SInt64 readOffset = mOffset + (SInt64)mWindowCount;
+		auto bytesToRead = std::min(chunk.size(), mWindow.size() - mWindowCount);
+
+		// Read without holding the lock so the window can be consumed meanwhile
+		lock.unlock();
+
+		SInt64 bytesRead = -1;
+		if(readOffset == inputOffset || mInputSource->SeekToOffset(readOffset)) {
+			inputOffset = readOffset;
+			bytesRead = mInputSource->Read(chunk.data(), (SInt64)bytesToRead);
+			if(0 < bytesRead)
+				inputOffset += bytesRead;
+		}
+		else
+			LOGGER_ERR("org.sbooth.AudioEngine.InputSource.Prefetch", "Unable to seek to offset " << readOffset);
+
+		lock.lock();
+
+		// A seek outside the window restarted read-ahead while reading
+		if(generation != mGeneration)
+			continue;
+
+		if(0 < bytesRead) {
+			// Append to the ring buffer in at most two pieces
+			auto tail = (mWindowHead + mWindowCount) % mWindow.size();
+			auto n1 = std::min((size_t)bytesRead, mWindow.size() - tail);
+			memcpy(mWindow.data() + tail, chunk.data(), n1);
+			if(n1 < (size_t)bytesRead)
+				memcpy(mWindow.data(), chunk.data() + n1, (size_t)bytesRead - n1);
+
+			mWindowCount += (size_t)bytesRead;
+		}
+		else
+			mEndOfInput = true;
+
+		mCondition.notify_all();
+	}
+}
+
+void SFB::PrefetchingInputSource::StopIOThread()
+{
+	if(!mIOThread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopIOThread = true;
+		mCondition.notify_all();
+	}
+
+	mIOThread.join();
+}
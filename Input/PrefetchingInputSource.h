@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "InputSource.h"
+
+/*! @file PrefetchingInputSource.h @brief An \c InputSource reading ahead of another on a background thread */
+
+/*! @brief \c SFBAudioEngine's encompassing namespace */
+namespace SFB {
+
+	/*!
+	 * @brief An \c InputSource that reads ahead of another on a background thread
+	 *
+	 * A window of bytes following the current offset is filled from the wrapped input source on a
+	 * dedicated I/O thread and reads are served from memory, so slow storage such as network volumes
+	 * or HTTP streams doesn't stall decoding.  Seeking within the window discards the skipped bytes;
+	 * seeking elsewhere restarts read-ahead at the new offset.
+	 *
+	 * The wrapped input source must not be used directly while this input source is open.
+	 */
+	class PrefetchingInputSource : public InputSource
+	{
+
+	public:
+
+		/*! @brief The default size of the read-ahead window in bytes */
+		static constexpr size_t kDefaultWindowSize = 1024 * 1024;
+
+		/*!
+		 * @brief Create a new \c PrefetchingInputSource
+		 * @param inputSource The input source to read ahead of
+		 * @param windowSize The number of bytes to read ahead of the current offset
+		 */
+		explicit PrefetchingInputSource(InputSource::unique_ptr inputSource, size_t windowSize = kDefaultWindowSize);
+
+		/*! @brief Destroy this \c PrefetchingInputSource, stopping the I/O thread */
+		virtual ~PrefetchingInputSource();
+
+
+		/*! @brief Get the input source being read ahead of */
+		inline InputSource& GetInputSource() const				{ return *mInputSource; }
+
+
+		// ========================================
+		/*! @name Statistics */
+		//@{
+
+		/*! @brief Get the number of reads served entirely from prefetched bytes */
+		inline uint64_t GetHitCount() const						{ return mHitCount.load(std::memory_order_relaxed); }
+
+		/*! @brief Get the number of seeks outside the window, each of which restarted read-ahead */
+		inline uint64_t GetMissCount() const					{ return mMissCount.load(std::memory_order_relaxed); }
+
+		/*! @brief Get the number of reads that waited for the I/O thread */
+		inline uint64_t GetStallCount() const					{ return mStallCount.load(std::memory_order_relaxed); }
+
+		//@}
+
+	private:
+
+		// Bytestream access
+		virtual bool _Open(CFErrorRef *error);
+		virtual bool _Close(CFErrorRef *error);
+
+		// Functionality
+		virtual SInt64 _Read(void *buffer, SInt64 byteCount);
+		virtual bool _AtEOF() const;
+
+		virtual SInt64 _GetOffset() const;
+		inline virtual SInt64 _GetLength() const				{ return mLength; }
+
+		// Seeking support
+		inline virtual bool _SupportsSeeking() const			{ return mSupportsSeeking; }
+		virtual bool _SeekToOffset(SInt64 offset);
+
+		// Fill the window from mInputSource until stopped
+		void IOThreadEntry();
+		void StopIOThread();
+
+		// Data members
+		InputSource::unique_ptr			mInputSource;
+		SInt64							mLength;
+		bool							mSupportsSeeking;
+
+		std::vector<uint8_t>			mWindow;				// A ring buffer of bytes following mOffset
+		size_t							mWindowHead;			// The index in mWindow of the byte at mOffset
+		size_t							mWindowCount;			// The number of prefetched bytes in mWindow
+		SInt64							mOffset;				// The current offset
+		uint64_t						mGeneration;			// Incremented whenever read-ahead restarts
+		bool							mEndOfInput;			// The I/O thread reached the end of input or failed
+		bool							mStopIOThread;
+
+		mutable std::mutex				mMutex;
+		std::condition_variable			mCondition;
+		std::thread						mIOThread;
+
+		std::atomic<uint64_t>			mHitCount;
+		std::atomic<uint64_t>			mMissCount;
+		std::atomic<uint64_t>			mStallCount;
+	};
+
+}
@@ -8,9 +8,12 @@
 #include <mach/thread_act.h>
 #include <mach/mach_error.h>
 #include <mach/sync_policy.h>
+#include <mach/mach_time.h>
 #include <stdexcept>
 #include <new>
 #include <algorithm>
+#include <mutex>
+#include <condition_variable>
 
 #include "AudioPlayer.h"
 #include "CoreAudioOutput.h"
@@ -18,13 +21,19 @@
 #include "CFErrorUtilities.h"
 #include "Logger.h"
 #include "CreateStringForOSType.h"
+#include "RealTimeSafety.h"
 
 // ========================================
 // Macros
 // ========================================
 #define RING_BUFFER_CAPACITY_FRAMES				16384
 #define RING_BUFFER_WRITE_CHUNK_SIZE_FRAMES		2048
+#define DECODE_AHEAD_TRACK_COUNT				0
+#define DECODE_AHEAD_CAPACITY_FRAMES			65536
 #define DECODER_THREAD_IMPORTANCE				6
+#define RENDER_EVENT_QUEUE_CAPACITY				256
+#define RENDER_EVENT_POLL_INTERVAL_MSEC			250
+#define THREAD_WAIT_TIMEOUT_SECONDS				5
 
 namespace {
 
@@ -56,6 +65,14 @@ namespace {
 		eDecoderStateDataFlagStopDecoding		= 1u << 4
 	};
 
+	enum eSeekPhases : size_t {
+		eSeekPhaseRequested						= 0,
+		eSeekPhaseMuteAcknowledged				= 1,
+		eSeekPhaseDecoderSeekCompleted			= 2,
+		eSeekPhaseFirstWrite					= 3,
+		eSeekPhaseFirstRender					= 4
+	};
+
 	enum eAudioPlayerFlags : unsigned int {
 		eAudioPlayerFlagMuteOutput				= 1u << 0,
 		eAudioPlayerFlagFormatMismatch			= 1u << 1,
@@ -70,6 +87,62 @@ namespace {
 }
 
 
+// ========================================
+// Queued decoders and the audio decoded ahead for them
+// ========================================
+class SFB::Audio::Player::QueuedDecoder
+{
+
+public:
+
+	explicit QueuedDecoder(std::unique_ptr<Decoder> decoder)
+		: mDecoder(std::move(decoder)), mIsScheduled(false), mCancel(false), mFramesStaged(0), mSampleRate(0), mIsComplete(false), mStagingReadOffset(0)
+	{}
+
+	QueuedDecoder(const QueuedDecoder& rhs) = delete;
+	QueuedDecoder& operator=(const QueuedDecoder& rhs) = delete;
+
+	// The decode-ahead worker must be finished before these are called
+	inline UInt32 GetFramesRemaining() const
+	{
+		return mFramesStaged.load() - mStagingReadOffset;
+	}
+
+	UInt32 ReadStagedAudio(AudioBufferList *bufferList, UInt32 frameCount)
+	{
+		UInt32 framesToRead = std::min(frameCount, GetFramesRemaining());
+		if(0 == framesToRead)
+			return 0;
+
+		const auto& format = mStagingBuffer.GetFormat();
+		size_t byteOffset = format.FrameCountToByteCount(mStagingReadOffset);
+		size_t byteCount = format.FrameCountToByteCount(framesToRead);
+		for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex) {
+			memcpy(bufferList->mBuffers[bufferIndex].mData, (uint8_t *)mStagingBuffer->mBuffers[bufferIndex].mData + byteOffset, byteCount);
+			bufferList->mBuffers[bufferIndex].mDataByteSize = (UInt32)byteCount;
+		}
+
+		mStagingReadOffset += framesToRead;
+
+		return framesToRead;
+	}
+
+	std::unique_ptr<Decoder>	mDecoder;
+
+	bool						mIsScheduled;		// Protected by mQueueMutex
+	std::atomic_bool			mCancel;
+
+	std::mutex					mMutex;				// Held by the decode-ahead worker
+	BufferList					mStagingBuffer;		// In the decoder's format
+
+	std::atomic_uint			mFramesStaged;
+	std::atomic<Float64>		mSampleRate;
+	std::atomic_bool			mIsComplete;
+
+	UInt32						mStagingReadOffset;	// Only accessed by the decoder thread
+
+};
+
 // ========================================
 // State data for decoders that are decoding and/or rendering
 // ========================================
@@ -78,14 +151,15 @@ class SFB::Audio::Player::DecoderStateData
 
 public:
 
-	explicit DecoderStateData(std::unique_ptr<Decoder> decoder)
+	explicit DecoderStateData(std::unique_ptr<Decoder> decoder, std::shared_ptr<QueuedDecoder> stagedAudio = nullptr)
 		: DecoderStateData()
 	{
 		assert(nullptr != decoder);
 
 		mDecoder = std::move(decoder);
+		mStagedAudio = std::move(stagedAudio);
 
-		mFramesRendered.store(mDecoder->GetCurrentFrame());
+		mFramesRendered.store(GetCurrentFrame());
 
 		// NB: The decoder may return an estimate of the total frames
 		mTotalFrames = mDecoder->GetTotalFrames();
@@ -102,10 +176,38 @@ public:
 	UInt32 ReadAudio(UInt32 frameCount)
 	{
 		mBufferList.Reset();
-		return mDecoder->ReadAudio(mBufferList, std::min(frameCount, mBufferList.GetCapacityFrames()));
+		return ReadAudio(mBufferList, std::min(frameCount, mBufferList.GetCapacityFrames()));
+	}
+
+	UInt32 ReadAudio(AudioBufferList *bufferList, UInt32 frameCount)
+	{
+		// Audio decoded ahead precedes the decoder's current position
+		if(mStagedAudio) {
+			UInt32 framesRead = mStagedAudio->ReadStagedAudio(bufferList, frameCount);
+			if(0 == mStagedAudio->GetFramesRemaining())
+				mStagedAudio.reset();
+			if(framesRead)
+				return framesRead;
+		}
+
+		return mDecoder->ReadAudio(bufferList, frameCount);
+	}
+
+	SInt64 GetCurrentFrame() const
+	{
+		SInt64 currentFrame = mDecoder->GetCurrentFrame();
+		if(-1 != currentFrame && mStagedAudio)
+			currentFrame -= mStagedAudio->GetFramesRemaining();
+		return currentFrame;
+	}
+
+	void DiscardStagedAudio()
+	{
+		mStagedAudio.reset();
 	}
 
 	std::unique_ptr<Decoder>	mDecoder;
+	std::shared_ptr<QueuedDecoder>	mStagedAudio;
 
 	BufferList					mBufferList;
 
@@ -118,16 +220,94 @@ public:
 
 	std::atomic_uint			mFlags;
 
+	std::atomic_uint			mRenderEventsPending;	// The collector must not delete this object while events refer to it
+
 private:
 
 	DecoderStateData()
-		: mDecoder(nullptr), mTimeStamp(0), mTotalFrames(0), mFramesRendered(0), mFrameToSeek(-1), mFlags(0)
+		: mDecoder(nullptr), mStagedAudio(nullptr), mTimeStamp(0), mTotalFrames(0), mFramesRendered(0), mFrameToSeek(-1), mFlags(0), mRenderEventsPending(0)
 	{}
 
 };
 
+// ========================================
+// State data for taps
+// ========================================
+class SFB::Audio::Player::Tap
+{
+
+public:
+
+	Tap(TapBlock block, int reader, BroadcastRingBuffer::OverrunPolicy policy)
+		: mBlock(Block_copy(block)), mReader(reader), mPolicy(policy), mQueue(nullptr), mDrainPending(false), mBufferNeedsAllocation(true), mDiscontinuity(false)
+	{
+		mQueue = dispatch_queue_create("org.sbooth.AudioEngine.Player.Tap", DISPATCH_QUEUE_SERIAL);
+		if(nullptr == mQueue)
+			throw std::runtime_error("Unable to create the dispatch queue");
+	}
+
+	~Tap()
+	{
+		dispatch_release(mQueue);
+		Block_release(mBlock);
+	}
+
+	Tap(const Tap& rhs) = delete;
+	Tap& operator=(const Tap& rhs) = delete;
+
+	TapBlock							mBlock;
+	int									mReader;			// -1 once the tap is removed
+	BroadcastRingBuffer::OverrunPolicy	mPolicy;
+
+	dispatch_queue_t					mQueue;
+	std::atomic_bool					mDrainPending;
+
+	std::mutex							mMutex;				// Held while reading from the tap ring buffer and while it is reallocated, never while the block runs
+	bool								mBufferNeedsAllocation;		// Protected by mMutex
+
+	// Used only on mQueue
+	BufferList							mBufferList;
+	bool								mDiscontinuity;
+
+};
+
+// ========================================
+// Events posted by the rendering thread
+// ========================================
+struct SFB::Audio::Player::RenderEvent
+{
+	enum class Type : uint32_t {
+		RingBufferReadFailed,
+		InsufficientAudio,
+		RenderingStarted,
+		RenderingFinished
+	};
+
+	Type				mType;
+	UInt32				mFramesRequested;
+	UInt32				mFramesRead;
+	DecoderStateData	*mDecoderState;
+
+	// Each active decoder has at most one RenderingStarted and one RenderingFinished event outstanding,
+	// so reserving room for that many guarantees lifecycle events are never dropped
+	static const size_t kReservedCount = 2 * kActiveDecoderArraySize;
+
+	inline bool IsLifecycleEvent() const		{ return Type::RenderingStarted == mType || Type::RenderingFinished == mType; }
+};
+
 namespace {
 
+	// ========================================
+	// Convert a host time interval to seconds
+	CFTimeInterval ConvertHostTimeToSeconds(uint64_t hostTime)
+	{
+		static mach_timebase_info_data_t sTimebaseInfo = {0, 0};
+		if(0 == sTimebaseInfo.denom)
+			mach_timebase_info(&sTimebaseInfo);
+
+		return (CFTimeInterval)hostTime * sTimebaseInfo.numer / sTimebaseInfo.denom / NSEC_PER_SEC;
+	}
+
 	// ========================================
 	// Set the calling thread's timesharing and importance
 	bool setThreadPolicy(integer_t importance)
@@ -199,7 +379,7 @@ namespace {
 #pragma mark Creation/Destruction
 
 SFB::Audio::Player::Player()
-	: mRingBuffer(new RingBuffer), mRingBufferCapacity(RING_BUFFER_CAPACITY_FRAMES), mRingBufferWriteChunkSize(RING_BUFFER_WRITE_CHUNK_SIZE_FRAMES), mFlags(0), mQueue(nullptr), mFramesDecoded(0), mFramesRendered(0), mOutput(new CoreAudioOutput), mDecoderErrorBlock(nullptr), mFormatMismatchBlock(nullptr), mErrorBlock(nullptr)
+	: mRingBuffer(new RingBuffer), mRingBufferCapacity(RING_BUFFER_CAPACITY_FRAMES), mRingBufferWriteChunkSize(RING_BUFFER_WRITE_CHUNK_SIZE_FRAMES), mTapRingBuffer(new BroadcastRingBuffer), mTapSource(nullptr), mFlags(0), mQueue(nullptr), mRenderingThreadWaiters(0), mDecodeAheadQueue(nullptr), mDecodeAheadTrackCount(DECODE_AHEAD_TRACK_COUNT), mDecodeAheadCapacity(DECODE_AHEAD_CAPACITY_FRAMES), mRenderEventQueue(new SFB::RingBuffer), mRenderEventsDropped(0), mInsufficientAudioQueued(false), mInsufficientAudioCoalesced(0), mEventQueue(nullptr), mEventQueueSource(nullptr), mEventQueueTimer(nullptr), mFramesDecoded(0), mFramesRendered(0), mSeekCount(0), mSeekLatencyTotal(0), mSeekLatencyMaximum(0), mUnderrunCount(0), mSilenceFramesInserted(0), mMinimumFramesBuffered(UINT64_MAX), mDecoderWakeups(0), mChunksDecoded(0), mChunkDecodeTimeTotal(0), mOutput(new CoreAudioOutput), mDecoderErrorBlock(nullptr), mFormatMismatchBlock(nullptr), mErrorBlock(nullptr)
 {
 	memset(&mDecoderEventBlocks, 0, sizeof(mDecoderEventBlocks));
 	memset(&mRenderEventBlocks, 0, sizeof(mRenderEventBlocks));
@@ -209,12 +389,49 @@ SFB::Audio::Player::Player()
 	for(UInt32 bufferIndex = 0; bufferIndex < kActiveDecoderArraySize; ++bufferIndex)
 		mActiveDecoders[bufferIndex].store(nullptr);
 
+	for(size_t phase = 0; phase < kSeekPhaseCount; ++phase) {
+		mSeekTimestamps[phase].store(0);
+		mLastSeekTimestamps[phase].store(0);
+	}
+
 	mQueue = dispatch_queue_create("org.sbooth.AudioEngine.Player", DISPATCH_QUEUE_SERIAL);
 	if(nullptr == mQueue) {
 		LOGGER_CRIT("org.sbooth.AudioEngine.Player", "dispatch_queue_create failed");
 		throw std::runtime_error("Unable to create the dispatch queue");
 	}
 
+	mDecodeAheadQueue = dispatch_queue_create("org.sbooth.AudioEngine.Player.DecodeAhead", DISPATCH_QUEUE_CONCURRENT);
+	if(nullptr == mDecodeAheadQueue) {
+		LOGGER_CRIT("org.sbooth.AudioEngine.Player", "dispatch_queue_create failed");
+		throw std::runtime_error("Unable to create the dispatch queue");
+	}
+
+	// ========================================
+	// Setup tap notification
+	// Decoding coalesces notifications, and each tap is drained on its own queue
+	mTapSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0, mQueue);
+	if(nullptr == mTapSource) {
+		LOGGER_CRIT("org.sbooth.AudioEngine.Player", "dispatch_source_create failed");
+		throw std::runtime_error("Unable to create the dispatch source");
+	}
+
+	dispatch_source_set_event_handler(mTapSource, ^{
+		std::lock_guard<std::mutex> lock(mQueueMutex);
+		for(const auto& tap : mTaps) {
+			// A drain is already scheduled that will pick up this audio
+			if(tap->mDrainPending.exchange(true))
+				continue;
+
+			std::shared_ptr<Tap> pendingTap = tap;
+			dispatch_async(tap->mQueue, ^{
+				pendingTap->mDrainPending.store(false);
+				DrainTap(*pendingTap);
+			});
+		}
+	});
+
+	dispatch_resume(mTapSource);
+
 	// ========================================
 	// Launch the decoding thread
 	try {
@@ -227,6 +444,47 @@ SFB::Audio::Player::Player()
 		throw;
 	}
 
+	// ========================================
+	// Setup the rendering thread's event queue
+	// The rendering thread signals a source after posting an event, since merging data never blocks
+	// A slow timer, armed only while output is running, polls as a fallback
+	if(!mRenderEventQueue->Allocate(RENDER_EVENT_QUEUE_CAPACITY * sizeof(RenderEvent))) {
+		LOGGER_CRIT("org.sbooth.AudioEngine.Player", "Unable to allocate render event queue");
+		throw std::bad_alloc();
+	}
+
+	mEventQueue = dispatch_queue_create("org.sbooth.AudioEngine.Player.Events", DISPATCH_QUEUE_SERIAL);
+	if(nullptr == mEventQueue) {
+		LOGGER_CRIT("org.sbooth.AudioEngine.Player", "dispatch_queue_create failed");
+		throw std::runtime_error("Unable to create the dispatch queue");
+	}
+
+	mEventQueueSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_OR, 0, 0, mEventQueue);
+	if(nullptr == mEventQueueSource) {
+		LOGGER_CRIT("org.sbooth.AudioEngine.Player", "dispatch_source_create failed");
+		throw std::runtime_error("Unable to create the dispatch source");
+	}
+
+	dispatch_source_set_event_handler(mEventQueueSource, ^{
+		ProcessRenderEvents();
+	});
+
+	dispatch_resume(mEventQueueSource);
+
+	mEventQueueTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, mEventQueue);
+	if(nullptr == mEventQueueTimer) {
+		LOGGER_CRIT("org.sbooth.AudioEngine.Player", "dispatch_source_create failed");
+		throw std::runtime_error("Unable to create the dispatch source");
+	}
+
+	// The timer is disarmed until output starts
+	dispatch_source_set_timer(mEventQueueTimer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+	dispatch_source_set_event_handler(mEventQueueTimer, ^{
+		ProcessRenderEvents();
+	});
+
+	dispatch_resume(mEventQueueTimer);
+
 	// ========================================
 	// Setup the collector
 	mCollector = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(QOS_CLASS_BACKGROUND, 0));
@@ -244,6 +502,9 @@ SFB::Audio::Player::Player()
 			if(!(eDecoderStateDataFlagDecodingFinished & flags) || !(eDecoderStateDataFlagRenderingFinished & flags))
 				continue;
 
+			if(decoderState->mRenderEventsPending.load())
+				continue;
+
 			bool swapSucceeded = mActiveDecoders[bufferIndex].compare_exchange_strong(decoderState, nullptr);
 
 			if(swapSucceeded) {
@@ -290,6 +551,47 @@ SFB::Audio::Player::~Player()
 	dispatch_release(mCollector);
 	mCollector = nullptr;
 
+	// Stop processing events and wait for any in progress to complete
+	dispatch_source_cancel(mEventQueueSource);
+	dispatch_release(mEventQueueSource);
+	mEventQueueSource = nullptr;
+
+	dispatch_source_cancel(mEventQueueTimer);
+	dispatch_release(mEventQueueTimer);
+	mEventQueueTimer = nullptr;
+
+	dispatch_sync(mEventQueue, ^{});
+	dispatch_release(mEventQueue);
+	mEventQueue = nullptr;
+
+	// Cancel decoding ahead and wait for the workers to finish
+	ClearQueuedDecoders();
+	dispatch_barrier_sync(mDecodeAheadQueue, ^{});
+	dispatch_release(mDecodeAheadQueue);
+	mDecodeAheadQueue = nullptr;
+
+	// Stop tap notifications and wait for any scheduled drains to complete
+	dispatch_source_cancel(mTapSource);
+	dispatch_release(mTapSource);
+	mTapSource = nullptr;
+
+	dispatch_sync(mQueue, ^{});
+
+	std::vector<std::shared_ptr<Tap>> taps;
+	{
+		std::lock_guard<std::mutex> lock(mQueueMutex);
+		taps.swap(mTaps);
+		for(const auto& tap : taps) {
+			std::lock_guard<std::mutex> tapLock(tap->mMutex);
+			mTapRingBuffer->RemoveReader(tap->mReader);
+			tap->mReader = -1;
+		}
+	}
+
+	// The blocks may call into the player so no lock may be held
+	for(const auto& tap : taps)
+		dispatch_sync(tap->mQueue, ^{});
+
 	dispatch_release(mQueue);
 	mQueue = nullptr;
 
@@ -350,44 +652,37 @@ bool SFB::Audio::Player::Play()
 		return true;
 
 	// We don't want to start output in the middle of a buffer modification
-	__block bool result = false;
-	dispatch_sync(mQueue, ^{
-		result = mOutput->Start();
-	});
-
-	return result;
+	std::lock_guard<std::mutex> lock(mQueueMutex);
+	return StartOutput();
 }
 
 bool SFB::Audio::Player::Pause()
 {
 	if(mOutput->IsRunning())
-		return mOutput->Stop();
+		return StopOutput();
 
 	return true;
 }
 
 bool SFB::Audio::Player::Stop()
 {
-	__block bool result = true;
-	dispatch_sync(mQueue, ^{
-		if(mOutput->IsRunning())
-			mOutput->Stop();
+	std::lock_guard<std::mutex> lock(mQueueMutex);
 
-		StopActiveDecoders();
+	if(mOutput->IsRunning())
+		StopOutput();
 
-		if(!mOutput->Reset()) {
-			result = false;
-			return;
-		}
+	StopActiveDecoders();
 
-		// Reset the ring buffer
-		mFramesDecoded.store(0);
-		mFramesRendered.store(0);
+	if(!mOutput->Reset())
+		return false;
 
-		mFlags.fetch_or(eAudioPlayerFlagRingBufferNeedsReset);
-	});
+	// Reset the ring buffer
+	mFramesDecoded.store(0);
+	mFramesRendered.store(0);
 
-	return result;
+	mFlags.fetch_or(eAudioPlayerFlagRingBufferNeedsReset);
+
+	return true;
 }
 
 SFB::Audio::Player::PlayerState SFB::Audio::Player::GetPlayerState() const
@@ -523,6 +818,68 @@ void SFB::Audio::Player::SetUnsupportedFormatBlock(ErrorBlock block)
 		mErrorBlock = Block_copy(block);
 }
 
+#pragma mark Taps
+
+int SFB::Audio::Player::AddTap(TapBlock block, BroadcastRingBuffer::OverrunPolicy policy)
+{
+	if(!block)
+		return -1;
+
+	std::lock_guard<std::mutex> lock(mQueueMutex);
+
+	int reader = mTapRingBuffer->AddReader(policy);
+	if(-1 == reader) {
+		LOGGER_ERR("org.sbooth.AudioEngine.Player", "Unable to add tap: " << BroadcastRingBuffer::kMaximumReaders << " taps already exist");
+		return -1;
+	}
+
+	std::shared_ptr<Tap> tap;
+	try {
+		tap = std::make_shared<Tap>(block, reader, policy);
+	}
+
+	catch(const std::exception& e) {
+		LOGGER_ERR("org.sbooth.AudioEngine.Player", "Unable to create tap: " << e.what());
+		mTapRingBuffer->RemoveReader(reader);
+		return -1;
+	}
+
+	// The tap's buffer is allocated by its first drain
+	mTaps.push_back(tap);
+	return reader;
+}
+
+bool SFB::Audio::Player::RemoveTap(int tap)
+{
+	std::shared_ptr<Tap> removedTap;
+	{
+		std::lock_guard<std::mutex> lock(mQueueMutex);
+
+		auto iter = std::find_if(std::begin(mTaps), std::end(mTaps), [tap](const std::shared_ptr<Tap>& t) {
+			return t->mReader == tap;
+		});
+
+		if(iter == std::end(mTaps))
+			return false;
+
+		removedTap = *iter;
+		mTaps.erase(iter);
+
+		// Wait for any read from the tap ring buffer in progress
+		std::lock_guard<std::mutex> tapLock(removedTap->mMutex);
+		mTapRingBuffer->RemoveReader(tap);
+		removedTap->mReader = -1;
+	}
+
+	// Wait for any invocation of the block in progress; the block may call into the player so no lock may be held
+	dispatch_sync(removedTap->mQueue, ^{});
+
+	// A blocking tap may have been holding back decoding
+	mDecoderSemaphore.Signal();
+
+	return true;
+}
+
 #pragma mark Playback Properties
 
 bool SFB::Audio::Player::GetCurrentFrame(SInt64& currentFrame) const
@@ -693,6 +1050,11 @@ bool SFB::Audio::Player::SeekToFrame(SInt64 frame)
 	if(0 > frame || frame >= currentDecoderState->mTotalFrames)
 		return false;
 
+	// Start timing the seek; the request timestamp is stored last so the other phases can't be attributed to an earlier seek
+	for(size_t phase = eSeekPhaseMuteAcknowledged; phase < kSeekPhaseCount; ++phase)
+		mSeekTimestamps[phase].store(0);
+	mSeekTimestamps[eSeekPhaseRequested].store(mach_absolute_time());
+
 	currentDecoderState->mFrameToSeek.store(frame);
 
 	// Force a flush of the ring buffer to prevent audible seek artifacts
@@ -714,6 +1076,42 @@ bool SFB::Audio::Player::SupportsSeeking() const
 	return currentDecoderState->mDecoder->SupportsSeeking();
 }
 
+#pragma mark Seek Statistics
+
+bool SFB::Audio::Player::GetSeekStatistics(SeekStatistics& statistics) const
+{
+	auto seekCount = mSeekCount.load();
+	if(0 == seekCount)
+		return false;
+
+	statistics.mSeekCount		= seekCount;
+	statistics.mAverageLatency	= ConvertHostTimeToSeconds(mSeekLatencyTotal.load()) / seekCount;
+	statistics.mMaximumLatency	= ConvertHostTimeToSeconds(mSeekLatencyMaximum.load());
+
+	auto requested = mLastSeekTimestamps[eSeekPhaseRequested].load();
+	auto elapsed = [&](size_t phase) {
+		auto timestamp = mLastSeekTimestamps[phase].load();
+		return timestamp >= requested ? ConvertHostTimeToSeconds(timestamp - requested) : 0;
+	};
+
+	statistics.mMuteAcknowledged		= elapsed(eSeekPhaseMuteAcknowledged);
+	statistics.mDecoderSeekCompleted	= elapsed(eSeekPhaseDecoderSeekCompleted);
+	statistics.mFirstWrite				= elapsed(eSeekPhaseFirstWrite);
+	statistics.mFirstRender				= elapsed(eSeekPhaseFirstRender);
+
+	return true;
+}
+
+void SFB::Audio::Player::ResetSeekStatistics()
+{
+	mSeekCount.store(0);
+	mSeekLatencyTotal.store(0);
+	mSeekLatencyMaximum.store(0);
+
+	for(size_t phase = 0; phase < kSeekPhaseCount; ++phase)
+		mLastSeekTimestamps[phase].store(0);
+}
+
 #pragma mark Playlist Management
 
 bool SFB::Audio::Player::Play(CFURLRef url)
@@ -777,23 +1175,24 @@ bool SFB::Audio::Player::Enqueue(Decoder::unique_ptr& decoder)
 	//     from underneath them
 	// In practice, the only time I've seen this happen is when using GuardMalloc, presumably because the
 	// normal execution time of Enqueue() isn't sufficient to lead to this condition.
-	__block bool result = true;
-	dispatch_sync(mQueue, ^{
-		// If there are no decoders in the queue, set up for playback
-		if(nullptr == GetCurrentDecoderState() && mDecoderQueue.empty()) {
-			if(!SetupOutputAndRingBufferForDecoder(*decoder)) {
-				result = false;
-				return;
-			}
-		}
+	std::lock_guard<std::mutex> lock(mQueueMutex);
 
-		// Take ownership of the decoder and add it to the queue
-		mDecoderQueue.push_back(std::move(decoder));
+	// If there are no decoders in the queue, set up for playback
+	if(nullptr == GetCurrentDecoderState() && mDecoderQueue.empty()) {
+		if(!SetupOutputAndRingBufferForDecoder(*decoder))
+			return false;
+	}
 
-		mDecoderSemaphore.Signal();
-	});
+	// Take ownership of the decoder and add it to the queue
+	mDecoderQueue.push_back(std::make_shared<QueuedDecoder>(std::move(decoder)));
 
-	return result;
+	// Decoding ahead is pointless for a decoder that will be used immediately
+	if(nullptr != GetCurrentDecoderState())
+		ScheduleDecodeAhead();
+
+	mDecoderSemaphore.Signal();
+
+	return true;
 }
 
 bool SFB::Audio::Player::SkipToNextTrack()
@@ -805,15 +1204,10 @@ bool SFB::Audio::Player::SkipToNextTrack()
 
 	LOGGER_INFO("org.sbooth.AudioEngine.Player", "Skipping \"" << currentDecoderState->mDecoder->GetURL() << "\"");
 
-	if(mOutput->IsRunning()) {
-		mFlags.fetch_or(eAudioPlayerFlagRequestMute);
-
-		// The rendering thread will clear eAudioPlayerFlagRequestMute when the current render cycle completes
-		while(eAudioPlayerFlagRequestMute & mFlags.load())
-			mSemaphore.TimedWait(dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC / 10));
+	if(!MuteOutput()) {
+		LOGGER_ERR("org.sbooth.AudioEngine.Player", "Timed out waiting for the rendering thread to mute output");
+		return false;
 	}
-	else
-		mFlags.fetch_or(eAudioPlayerFlagMuteOutput);
 
 	currentDecoderState->mFlags.fetch_or(eDecoderStateDataFlagStopDecoding);
 
@@ -821,8 +1215,19 @@ bool SFB::Audio::Player::SkipToNextTrack()
 	mDecoderSemaphore.Signal();
 
 	// Wait for decoding to finish or a SIGSEGV could occur if the collector collects an active decoder
-	while(!(eDecoderStateDataFlagDecodingFinished & currentDecoderState->mFlags.load()))
-		mSemaphore.TimedWait(dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC / 10));
+	{
+		std::unique_lock<std::mutex> lock(mDecoderMutex);
+		bool decodingFinished = mDecodingFinished.wait_for(lock, std::chrono::seconds(THREAD_WAIT_TIMEOUT_SECONDS), [currentDecoderState] {
+			return eDecoderStateDataFlagDecodingFinished & currentDecoderState->mFlags.load();
+		});
+
+		// The decoder will stop once its pending read returns, and is collected after the rendering thread plays out its audio
+		if(!decodingFinished) {
+			LOGGER_ERR("org.sbooth.AudioEngine.Player", "Timed out waiting for \"" << currentDecoderState->mDecoder->GetURL() << "\" to stop decoding");
+			mFlags.fetch_and(~eAudioPlayerFlagMuteOutput);
+			return false;
+		}
+	}
 
 	currentDecoderState->mFlags.fetch_or(eDecoderStateDataFlagRenderingFinished);
 
@@ -836,9 +1241,10 @@ bool SFB::Audio::Player::SkipToNextTrack()
 
 bool SFB::Audio::Player::ClearQueuedDecoders()
 {
-	dispatch_sync(mQueue, ^{
-		mDecoderQueue.clear();
-	});
+	std::lock_guard<std::mutex> lock(mQueueMutex);
+	for(const auto& queuedDecoder : mDecoderQueue)
+		queuedDecoder->mCancel.store(true);
+	mDecoderQueue.clear();
 
 	return true;
 }
@@ -867,6 +1273,156 @@ bool SFB::Audio::Player::SetRingBufferWriteChunkSize(uint32_t chunkSize)
 	return true;
 }
 
+#pragma mark Buffer Health
+
+void SFB::Audio::Player::GetBufferHealth(BufferHealth& health) const
+{
+	health.mUnderrunCount			= mUnderrunCount.load();
+	health.mSilenceFramesInserted	= mSilenceFramesInserted.load();
+	health.mDecoderWakeups			= mDecoderWakeups.load();
+	health.mChunksDecoded			= mChunksDecoded.load();
+
+	auto chunkDecodeTimeTotal = mChunkDecodeTimeTotal.load();
+	health.mAverageChunkDecodeTime	= health.mChunksDecoded ? ConvertHostTimeToSeconds(chunkDecodeTimeTotal) / health.mChunksDecoded : 0;
+
+	auto minimumFramesBuffered = mMinimumFramesBuffered.load();
+	health.mMinimumFramesBuffered	= UINT64_MAX == minimumFramesBuffered ? 0 : minimumFramesBuffered;
+	health.mFramesBuffered			= mRingBuffer->GetFramesAvailableToRead();
+
+	auto sampleRate = mRingBuffer->GetFormat().mSampleRate;
+	health.mMinimumHeadroom			= sampleRate ? 1000.0 * health.mMinimumFramesBuffered / sampleRate : 0;
+	health.mHeadroom				= sampleRate ? 1000.0 * health.mFramesBuffered / sampleRate : 0;
+}
+
+void SFB::Audio::Player::ResetBufferHealth()
+{
+	mUnderrunCount.store(0);
+	mSilenceFramesInserted.store(0);
+	mMinimumFramesBuffered.store(UINT64_MAX);
+	mDecoderWakeups.store(0);
+	mChunksDecoded.store(0);
+	mChunkDecodeTimeTotal.store(0);
+}
+
+#pragma mark Decode Ahead
+
+bool SFB::Audio::Player::SetDecodeAheadTrackCount(uint32_t trackCount)
+{
+	LOGGER_INFO("org.sbooth.AudioEngine.Player", "Setting decode-ahead track count to " << trackCount);
+
+	mDecodeAheadTrackCount.store(trackCount);
+
+	std::lock_guard<std::mutex> lock(mQueueMutex);
+	if(nullptr != GetCurrentDecoderState())
+		ScheduleDecodeAhead();
+
+	return true;
+}
+
+bool SFB::Audio::Player::SetDecodeAheadCapacity(uint32_t capacityFrames)
+{
+	if(0 == capacityFrames)
+		return false;
+
+	LOGGER_INFO("org.sbooth.AudioEngine.Player", "Setting decode-ahead capacity to " << capacityFrames);
+
+	mDecodeAheadCapacity.store(capacityFrames);
+	return true;
+}
+
+std::vector<SFB::Audio::Player::DecodeAheadStatus> SFB::Audio::Player::GetDecodeAheadStatus() const
+{
+	std::vector<DecodeAheadStatus> status;
+
+	std::lock_guard<std::mutex> lock(mQueueMutex);
+	for(const auto& queuedDecoder : mDecoderQueue) {
+		CFURLRef url = queuedDecoder->mDecoder->GetURL();
+		UInt32 framesStaged = queuedDecoder->mFramesStaged.load();
+		Float64 sampleRate = queuedDecoder->mSampleRate.load();
+
+		status.push_back({
+			SFB::CFURL(url ? (CFURLRef)CFRetain(url) : nullptr),
+			framesStaged,
+			sampleRate ? framesStaged / sampleRate : 0,
+			queuedDecoder->mIsComplete.load()
+		});
+	}
+
+	return status;
+}
+
+void SFB::Audio::Player::ScheduleDecodeAhead()
+{
+	// This method must be called with mQueueMutex held
+	size_t trackCount = std::min((size_t)mDecodeAheadTrackCount.load(), mDecoderQueue.size());
+	for(size_t i = 0; i < trackCount; ++i) {
+		const auto& queuedDecoder = mDecoderQueue[i];
+		if(queuedDecoder->mIsScheduled)
+			continue;
+
+		queuedDecoder->mIsScheduled = true;
+
+		std::shared_ptr<QueuedDecoder> pendingDecoder = queuedDecoder;
+		dispatch_async(mDecodeAheadQueue, ^{
+			DecodeAhead(*pendingDecoder);
+		});
+	}
+}
+
+void SFB::Audio::Player::DecodeAhead(QueuedDecoder& queuedDecoder)
+{
+	// The decoder thread takes the lock before using the decoder
+	std::lock_guard<std::mutex> lock(queuedDecoder.mMutex);
+
+	if(queuedDecoder.mCancel.load() || !queuedDecoder.mDecoder)
+		return;
+
+	auto& decoder = *queuedDecoder.mDecoder;
+
+	// Errors are reported when the decoder thread opens the decoder
+	if(!decoder.IsOpen() && !decoder.Open())
+		return;
+
+	const auto& format = decoder.GetFormat();
+	UInt32 capacityFrames = mDecodeAheadCapacity;
+	UInt32 chunkSize = std::min((UInt32)mRingBufferWriteChunkSize, capacityFrames);
+
+	if(!queuedDecoder.mStagingBuffer.Allocate(format, capacityFrames)) {
+		LOGGER_ERR("org.sbooth.AudioEngine.Player", "Unable to allocate decode-ahead buffer");
+		return;
+	}
+
+	// Allocate an alias to the staging buffer, which will point to the current write position
+	auto& stagingBuffer = queuedDecoder.mStagingBuffer;
+	AudioBufferList *stagingBufferAlias = (AudioBufferList *)alloca(offsetof(AudioBufferList, mBuffers) + (sizeof(AudioBuffer) * stagingBuffer->mNumberBuffers));
+	stagingBufferAlias->mNumberBuffers = stagingBuffer->mNumberBuffers;
+
+	queuedDecoder.mSampleRate.store(format.mSampleRate);
+
+	LOGGER_DEBUG("org.sbooth.AudioEngine.Player", "Decoding ahead for \"" << decoder.GetURL() << "\"");
+
+	// Decode in chunks so cancellation is prompt once the decoder thread needs the decoder
+	UInt32 framesStaged = 0;
+	while(!queuedDecoder.mCancel.load() && framesStaged < capacityFrames) {
+		UInt32 framesToRead = std::min(chunkSize, capacityFrames - framesStaged);
+		size_t byteOffset = format.FrameCountToByteCount(framesStaged);
+		for(UInt32 bufferIndex = 0; bufferIndex < stagingBufferAlias->mNumberBuffers; ++bufferIndex) {
+			stagingBufferAlias->mBuffers[bufferIndex].mData				= (uint8_t *)stagingBuffer->mBuffers[bufferIndex].mData + byteOffset;
+			stagingBufferAlias->mBuffers[bufferIndex].mDataByteSize		= (UInt32)format.FrameCountToByteCount(framesToRead);
+			stagingBufferAlias->mBuffers[bufferIndex].mNumberChannels	= stagingBuffer->mBuffers[bufferIndex].mNumberChannels;
+		}
+
+		UInt32 framesRead = decoder.ReadAudio(stagingBufferAlias, framesToRead);
+		if(0 == framesRead) {
+			queuedDecoder.mIsComplete.store(true);
+			break;
+		}
+
+		framesStaged += framesRead;
+		queuedDecoder.mFramesStaged.store(framesStaged);
+	}
+}
+
 #pragma mark Thread Entry Points
 
 void * SFB::Audio::Player::DecoderThreadEntry()
@@ -886,14 +1442,34 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 
 		// ========================================
 		// Lock the queue and remove the head element that contains the next decoder to use
-		__block Decoder::unique_ptr decoder;
-		dispatch_sync(mQueue, ^{
+		std::shared_ptr<QueuedDecoder> queuedDecoder;
+		{
+			std::lock_guard<std::mutex> lock(mQueueMutex);
 			if(!mDecoderQueue.empty()) {
 				auto iter = std::begin(mDecoderQueue);
-				decoder = std::move(*iter);
+				queuedDecoder = *iter;
 				mDecoderQueue.erase(iter);
+
+				// Start decoding ahead for the decoders that are now next in line
+				ScheduleDecodeAhead();
 			}
-		});
+		}
+
+		// ========================================
+		// Take the decoder and any audio decoded ahead
+		Decoder::unique_ptr decoder;
+		if(queuedDecoder) {
+			// Stop decoding ahead and wait for the current chunk to finish
+			queuedDecoder->mCancel.store(true);
+			std::lock_guard<std::mutex> lock(queuedDecoder->mMutex);
+
+			decoder = std::move(queuedDecoder->mDecoder);
+
+			if(queuedDecoder->GetFramesRemaining())
+				LOGGER_DEBUG("org.sbooth.AudioEngine.Player", "Using " << queuedDecoder->GetFramesRemaining() << " frames decoded ahead");
+			else
+				queuedDecoder.reset();
+		}
 
 		// ========================================
 		// Open the decoder if necessary
@@ -911,7 +1487,7 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 		// Create the decoder state
 		if(decoder) {
 			if(mOutput->SupportsFormat(decoder->GetFormat())) {
-				decoderState = new DecoderStateData(std::move(decoder));
+				decoderState = new DecoderStateData(std::move(decoder), std::move(queuedDecoder));
 				decoderState->mTimeStamp = decoderCounter++;
 			}
 			else {
@@ -962,25 +1538,24 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 			// If the formats don't match, the decoder can't be used with the current ring buffer format
 			if(!formatsMatch) {
 				// Ensure output is muted before performing operations that aren't thread safe
-				if(mOutput->IsRunning()) {
-					mFlags.fetch_or(eAudioPlayerFlagFormatMismatch);
+				mFlags.fetch_or(eAudioPlayerFlagFormatMismatch);
 
-					// Wait for the currently rendering decoder to finish
-					// The rendering thread will clear eAudioPlayerFlagFormatMismatch when the current render cycle completes
-					while(eAudioPlayerFlagFormatMismatch & mFlags.load())
-						mSemaphore.TimedWait(dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC / 100));
-				}
+				// Wait for the currently rendering decoder to finish
+				// The rendering thread will clear eAudioPlayerFlagFormatMismatch once the current decoder's audio has been rendered
+				while(!WaitForRenderingThread(eAudioPlayerFlagFormatMismatch))
+					LOGGER_WARNING("org.sbooth.AudioEngine.Player", "Timed out waiting for the rendering thread to finish the current decoder");
 
 				if(mFormatMismatchBlock)
 					mFormatMismatchBlock(outputFormat, nextFormat);
 
 				// Adjust the formats
-				dispatch_sync(mQueue, ^{
+				{
+					std::lock_guard<std::mutex> lock(mQueueMutex);
 					if(!SetupOutputAndRingBufferForDecoder(*decoderState->mDecoder)) {
 						delete decoderState;
 						decoderState = nullptr;
 					}
-				});
+				}
 
 				// Clear the mute flag that was set in the rendering thread so output will resume
 				mFlags.fetch_and(~eAudioPlayerFlagMuteOutput);
@@ -1106,15 +1681,12 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 						mFlags.fetch_and(~eAudioPlayerFlagRingBufferNeedsReset);
 
 						// Ensure output is muted before performing operations that aren't thread safe
-						if(mOutput->IsRunning()) {
-							mFlags.fetch_or(eAudioPlayerFlagRequestMute);
-
-							// The rendering thread will clear eAudioPlayerFlagRequestMute when the current render cycle completes
-							while(eAudioPlayerFlagRequestMute & mFlags.load())
-								mSemaphore.TimedWait(dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC / 100));
+						// If the rendering thread doesn't respond the reset is retried after the next wakeup
+						if(!MuteOutput()) {
+							LOGGER_ERR("org.sbooth.AudioEngine.Player", "Timed out waiting for the rendering thread to mute output");
+							mFlags.fetch_or(eAudioPlayerFlagRingBufferNeedsReset);
+							break;
 						}
-						else
-							mFlags.fetch_or(eAudioPlayerFlagMuteOutput);
 
 						// Reset the converter to flush any buffers
 						if(audioConverter) {
@@ -1133,6 +1705,10 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 					// Determine how many frames are available in the ring buffer
 					size_t framesAvailableToWrite = mRingBuffer->GetFramesAvailableToWrite();
 
+					// Blocking taps hold back decoding until they have consumed their audio
+					if(mTapRingBuffer->GetReaderCount())
+						framesAvailableToWrite = std::min(framesAvailableToWrite, mTapRingBuffer->GetFramesAvailableToWrite());
+
 					// Force writes to the ring buffer to be at least mRingBufferWriteChunkSize
 					if(mRingBufferWriteChunkSize <= framesAvailableToWrite) {
 
@@ -1143,15 +1719,17 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 							LOGGER_DEBUG("org.sbooth.AudioEngine.Player", "Seeking to frame " << frameToSeek);
 
 							// Ensure output is muted before performing operations that aren't thread safe
-							if(mOutput->IsRunning()) {
-								mFlags.fetch_or(eAudioPlayerFlagRequestMute);
-
-								// The rendering thread will clear eAudioPlayerFlagRequestMute when the current render cycle completes
-								while(eAudioPlayerFlagRequestMute & mFlags.load())
-									mSemaphore.TimedWait(dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC / 100));
+							// If the rendering thread doesn't respond the seek remains pending and is retried after the next wakeup
+							if(!MuteOutput()) {
+								LOGGER_ERR("org.sbooth.AudioEngine.Player", "Timed out waiting for the rendering thread to mute output");
+								break;
 							}
-							else
-								mFlags.fetch_or(eAudioPlayerFlagMuteOutput);
+
+							if(mSeekTimestamps[eSeekPhaseRequested].load())
+								mSeekTimestamps[eSeekPhaseMuteAcknowledged].store(mach_absolute_time());
+
+							// Audio decoded ahead is no longer contiguous with the decoder's position
+							decoderState->DiscardStagedAudio();
 
 							SInt64 newFrame = decoderState->mDecoder->SeekToFrame(frameToSeek);
 
@@ -1177,13 +1755,19 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 								// Reset the ring buffer and output
 								mRingBuffer->Reset();
 								mOutput->Reset();
+
+								if(mSeekTimestamps[eSeekPhaseRequested].load())
+									mSeekTimestamps[eSeekPhaseDecoderSeekCompleted].store(mach_absolute_time());
 							}
+							// A failed seek is not timed
+							else
+								mSeekTimestamps[eSeekPhaseRequested].store(0);
 
 							// Clear the mute flag
 							mFlags.fetch_and(~eAudioPlayerFlagMuteOutput);
 						}
 
-						SInt64 startingFrameNumber = decoderState->mDecoder->GetCurrentFrame();
+						SInt64 startingFrameNumber = decoderState->GetCurrentFrame();
 
 						if(-1 == startingFrameNumber) {
 							LOGGER_ERR("org.sbooth.AudioEngine.Player", "Unable to determine starting frame number");
@@ -1198,23 +1782,41 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 							decoderState->mFlags.fetch_or(eDecoderStateDataFlagDecodingStarted);
 						}
 
+						uint64_t chunkStartTime = mach_absolute_time();
+
 						// Read the input chunk, converting from the decoder's format to the AUGraph's format
 						UInt32 framesDecoded = mRingBufferWriteChunkSize;
 
+						// If the ring buffer has enough contiguous space for an entire chunk, decode directly into it
+						auto writeVector = mRingBuffer->GetWriteVector();
+						size_t contiguousFramesAvailable = mRingBuffer->GetFormat().ByteCountToFrameCount(writeVector.first->mBuffers[0].mDataByteSize);
+						bool decodeInPlace = mRingBufferWriteChunkSize <= contiguousFramesAvailable;
+
+						AudioBufferList *decodedAudio = nullptr;
+
 						if(audioConverter) {
-							auto result = AudioConverterFillComplexBuffer(audioConverter, myAudioConverterComplexInputDataProc, decoderState, &framesDecoded, bufferList, nullptr);
+							decodedAudio = decodeInPlace ? writeVector.first : (AudioBufferList *)bufferList;
+
+							auto result = AudioConverterFillComplexBuffer(audioConverter, myAudioConverterComplexInputDataProc, decoderState, &framesDecoded, decodedAudio, nullptr);
 							if(noErr != result)
 								LOGGER_ERR("org.sbooth.AudioEngine.Player", "AudioConverterFillComplexBuffer failed: " << result);
 						}
 						else {
-							framesDecoded = decoderState->ReadAudio(framesDecoded);
+							if(decodeInPlace) {
+								decodedAudio = writeVector.first;
+								framesDecoded = decoderState->ReadAudio(decodedAudio, framesDecoded);
+							}
+							else {
+								decodedAudio = decoderState->mBufferList;
+								framesDecoded = decoderState->ReadAudio(framesDecoded);
+							}
 
 							// Bit swap if required
 							auto outputFormat = mOutput->GetFormat();
 							if(outputFormat.IsDSD() && (kAudioFormatFlagIsBigEndian & outputFormat.mFormatFlags) != (kAudioFormatFlagIsBigEndian & decoderState->mDecoder->GetFormat().mFormatFlags)) {
-								for(UInt32 i = 0; i < decoderState->mBufferList->mNumberBuffers; ++i) {
-									uint8_t *buf = (uint8_t *)decoderState->mBufferList->mBuffers[i].mData;
-									auto bufsize = decoderState->mBufferList->mBuffers[i].mDataByteSize;
+								for(UInt32 i = 0; i < decodedAudio->mNumberBuffers; ++i) {
+									uint8_t *buf = (uint8_t *)decodedAudio->mBuffers[i].mData;
+									auto bufsize = decodedAudio->mBuffers[i].mDataByteSize;
 
 									while(bufsize--) {
 										*buf = sBitReverseTable256[*buf];
@@ -1226,11 +1828,32 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 
 						// Store the decoded audio
 						if(0 != framesDecoded) {
-							UInt32 framesWritten = (UInt32)mRingBuffer->WriteAudio(audioConverter ? bufferList : decoderState->mBufferList, framesDecoded);
-							if(framesWritten != framesDecoded)
-								LOGGER_ERR("org.sbooth.AudioEngine.Player", "RingBuffer::Store failed");
+							// Copy the audio for the taps before it is published to the rendering thread
+							if(mTapRingBuffer->GetReaderCount()) {
+								if(mTapRingBuffer->WriteAudio(decodedAudio, framesDecoded) != framesDecoded)
+									LOGGER_WARNING("org.sbooth.AudioEngine.Player", "BroadcastRingBuffer::WriteAudio failed");
+								dispatch_source_merge_data(mTapSource, 1);
+							}
+
+							// The first write after a seek must be timestamped before the audio is visible to the rendering thread
+							if(mSeekTimestamps[eSeekPhaseDecoderSeekCompleted].load() && !mSeekTimestamps[eSeekPhaseFirstWrite].load())
+								mSeekTimestamps[eSeekPhaseFirstWrite].store(mach_absolute_time());
+
+							UInt32 framesWritten = framesDecoded;
+
+							// Audio decoded in place only needs to be published
+							if(decodeInPlace)
+								mRingBuffer->WriteAdvance(framesDecoded);
+							else {
+								framesWritten = (UInt32)mRingBuffer->WriteAudio(decodedAudio, framesDecoded);
+								if(framesWritten != framesDecoded)
+									LOGGER_ERR("org.sbooth.AudioEngine.Player", "RingBuffer::Store failed");
+							}
 
 							mFramesDecoded.fetch_add(framesWritten);
+
+							mChunksDecoded.fetch_add(1);
+							mChunkDecodeTimeTotal.fetch_add(mach_absolute_time() - chunkStartTime);
 						}
 
 						// If no frames were returned, this is the end of stream
@@ -1251,6 +1874,8 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 							decoderState->mFlags.fetch_or(eDecoderStateDataFlagDecodingFinished);
 							decoderState = nullptr;
 
+							NotifyDecodingFinished();
+
 							break;
 						}
 					}
@@ -1265,15 +1890,15 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 
 					if(!mOutput->IsRunning()) {
 						// We don't want to start output in the middle of a buffer modification
-						dispatch_sync(mQueue, ^{
-							if(!mOutput->Start())
-								LOGGER_ERR("org.sbooth.AudioEngine.Player", "Unable to start output");
-						});
+						std::lock_guard<std::mutex> lock(mQueueMutex);
+						if(!StartOutput())
+							LOGGER_ERR("org.sbooth.AudioEngine.Player", "Unable to start output");
 					}
 				}
 
 				// Wait for the audio rendering thread to signal us that it could use more data, or for the timeout to happen
-				mDecoderSemaphore.TimedWait(dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC));
+				mDecoderSemaphore.TimedWait(dispatch_time(DISPATCH_TIME_NOW, THREAD_WAIT_TIMEOUT_SECONDS * NSEC_PER_SEC));
+				mDecoderWakeups.fetch_add(1);
 			}
 
 			// ========================================
@@ -1283,9 +1908,8 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 				decoderState->mFlags.fetch_or(eDecoderStateDataFlagDecodingFinished);
 				decoderState = nullptr;
 
-				// If eAudioPlayerFlagMuteOutput is set SkipToNextTrack() is waiting for this decoder to finish
-				if(eAudioPlayerFlagMuteOutput & mFlags.load())
-					mSemaphore.Signal();
+				// SkipToNextTrack() may be waiting for this decoder to finish
+				NotifyDecodingFinished();
 			}
 
 			if(audioConverter) {
@@ -1297,7 +1921,8 @@ void * SFB::Audio::Player::DecoderThreadEntry()
 		}
 
 		// Wait for another thread to wake us, or for the timeout to happen
-		mDecoderSemaphore.TimedWait(dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC));
+		mDecoderSemaphore.TimedWait(dispatch_time(DISPATCH_TIME_NOW, THREAD_WAIT_TIMEOUT_SECONDS * NSEC_PER_SEC));
+		mDecoderWakeups.fetch_add(1);
 	}
 
 	LOGGER_INFO("org.sbooth.AudioEngine.Player", "Decoding thread terminating");
@@ -1328,6 +1953,17 @@ SFB::Audio::Player::DecoderStateData * SFB::Audio::Player::GetCurrentDecoderStat
 	return result;
 }
 
+bool SFB::Audio::Player::IsDecoding() const
+{
+	for(UInt32 bufferIndex = 0; bufferIndex < kActiveDecoderArraySize; ++bufferIndex) {
+		DecoderStateData *decoderState = mActiveDecoders[bufferIndex].load();
+		if(nullptr != decoderState && !(eDecoderStateDataFlagDecodingFinished & decoderState->mFlags.load()))
+			return true;
+	}
+
+	return false;
+}
+
 SFB::Audio::Player::DecoderStateData * SFB::Audio::Player::GetDecoderStateStartingAfterTimeStamp(SInt64 timeStamp) const
 {
 	DecoderStateData *result = nullptr;
@@ -1376,6 +2012,90 @@ void SFB::Audio::Player::StopActiveDecoders()
 	}
 }
 
+bool SFB::Audio::Player::MuteOutput()
+{
+	// The rendering thread will clear eAudioPlayerFlagRequestMute when the current render cycle completes
+	mFlags.fetch_or(eAudioPlayerFlagRequestMute);
+	if(WaitForRenderingThread(eAudioPlayerFlagRequestMute))
+		return true;
+
+	// Withdraw the request; if the rendering thread acknowledged it in the meantime output is muted anyway
+	mFlags.fetch_and(~eAudioPlayerFlagRequestMute);
+	return eAudioPlayerFlagMuteOutput & mFlags.load();
+}
+
+bool SFB::Audio::Player::WaitForRenderingThread(unsigned int flag)
+{
+	// Whichever thread stops output acknowledges pending requests afterward, so a request made
+	// before this check is never missed
+	if(!mOutput->IsRunning())
+		AcknowledgeRenderingThreadRequests();
+
+	mRenderingThreadWaiters.fetch_add(1);
+
+	// The rendering thread signals once per waiter when it clears a flag, so this normally returns after one render cycle
+	auto deadline = dispatch_time(DISPATCH_TIME_NOW, THREAD_WAIT_TIMEOUT_SECONDS * NSEC_PER_SEC);
+	while(flag & mFlags.load()) {
+		if(!mRenderingThreadSemaphore.TimedWait(deadline))
+			break;
+	}
+
+	mRenderingThreadWaiters.fetch_sub(1);
+
+	return !(flag & mFlags.load());
+}
+
+void SFB::Audio::Player::AcknowledgeRenderingThreadRequests()
+{
+	// This method must only be called when no render cycle is in progress
+	if((eAudioPlayerFlagRequestMute | eAudioPlayerFlagFormatMismatch) & mFlags.load()) {
+		mFlags.fetch_or(eAudioPlayerFlagMuteOutput);
+		mFlags.fetch_and(~(eAudioPlayerFlagRequestMute | eAudioPlayerFlagFormatMismatch));
+
+		SignalRenderingThreadWaiters();
+	}
+}
+
+bool SFB::Audio::Player::StartOutput()
+{
+	if(!mOutput->Start())
+		return false;
+
+	// Poll for render events missed by the event source while render cycles run
+	dispatch_source_set_timer(mEventQueueTimer, dispatch_time(DISPATCH_TIME_NOW, RENDER_EVENT_POLL_INTERVAL_MSEC * NSEC_PER_MSEC), RENDER_EVENT_POLL_INTERVAL_MSEC * NSEC_PER_MSEC, RENDER_EVENT_POLL_INTERVAL_MSEC * NSEC_PER_MSEC / 2);
+
+	return true;
+}
+
+bool SFB::Audio::Player::StopOutput()
+{
+	if(!mOutput->Stop())
+		return false;
+
+	// No further render cycles will run to post events, so stop polling and process any still queued
+	dispatch_source_set_timer(mEventQueueTimer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+	dispatch_source_merge_data(mEventQueueSource, 1);
+
+	// No further render cycles will run to acknowledge requests made before output stopped
+	AcknowledgeRenderingThreadRequests();
+
+	return true;
+}
+
+void SFB::Audio::Player::SignalRenderingThreadWaiters()
+{
+	// Semaphores may be signaled from the rendering thread; surplus signals only cause waiters to recheck their flags
+	for(auto waiters = mRenderingThreadWaiters.load(); waiters > 0; --waiters)
+		mRenderingThreadSemaphore.Signal();
+}
+
+void SFB::Audio::Player::NotifyDecodingFinished()
+{
+	// Taking the lock ensures a waiter can't miss the notification between testing its condition and waiting
+	std::lock_guard<std::mutex> lock(mDecoderMutex);
+	mDecodingFinished.notify_all();
+}
+
 bool SFB::Audio::Player::SetupOutputAndRingBufferForDecoder(Decoder& decoder)
 {
 	// Open the decoder if necessary
@@ -1411,14 +2131,76 @@ bool SFB::Audio::Player::SetupOutputAndRingBufferForDecoder(Decoder& decoder)
 		return false;
 
 	// Allocate enough space in the ring buffer for the new format
-	if(!mRingBuffer->Allocate(mOutput->GetFormat(), mRingBufferCapacity)) {
+	// Mirrored memory allows the decoder to always write directly into the ring buffer, but isn't available for all formats
+	if(!mRingBuffer->Allocate(mOutput->GetFormat(), mRingBufferCapacity, RingBuffer::MirrorMemory) && !mRingBuffer->Allocate(mOutput->GetFormat(), mRingBufferCapacity)) {
 		LOGGER_ERR("org.sbooth.AudioEngine.Player", "Unable to allocate ring buffer");
 		return false;
 	}
 
+	// Taps read from the tap ring buffer with their locks held, so lock each tap while it is reallocated
+	// The locks are never held while a tap's block runs, so this doesn't wait on the blocks
+	std::vector<std::unique_lock<std::mutex>> tapLocks;
+	for(const auto& tap : mTaps)
+		tapLocks.emplace_back(tap->mMutex);
+
+	if(!mTapRingBuffer->Allocate(mOutput->GetFormat(), mRingBufferCapacity)) {
+		LOGGER_ERR("org.sbooth.AudioEngine.Player", "Unable to allocate tap ring buffer");
+		return false;
+	}
+
+	// Each tap's buffer may be in use by its block, so it is reallocated by the tap's next drain
+	for(const auto& tap : mTaps)
+		tap->mBufferNeedsAllocation = true;
+
 	return true;
 }
 
+void SFB::Audio::Player::DrainTap(Tap& tap)
+{
+	for(;;) {
+		UInt32 framesRead;
+
+		// Copy the audio under the lock, but invoke the block without it so the block may call into the player
+		{
+			std::lock_guard<std::mutex> lock(tap.mMutex);
+
+			if(-1 == tap.mReader || !mTapRingBuffer->GetCapacityFrames())
+				break;
+
+			if(tap.mBufferNeedsAllocation) {
+				if(!tap.mBufferList.Allocate(mTapRingBuffer->GetFormat(), mRingBufferWriteChunkSize)) {
+					LOGGER_ERR("org.sbooth.AudioEngine.Player", "Unable to allocate tap buffer");
+					break;
+				}
+
+				tap.mBufferNeedsAllocation = false;
+			}
+
+			tap.mBufferList.Reset();
+
+			bool overrun = false;
+			framesRead = (UInt32)mTapRingBuffer->ReadAudio(tap.mReader, tap.mBufferList, tap.mBufferList.GetCapacityFrames(), &overrun);
+
+			// Flag the discontinuity for the next invocation of the block
+			if(overrun) {
+				LOGGER_INFO("org.sbooth.AudioEngine.Player", "Tap " << tap.mReader << " overrun; " << mTapRingBuffer->GetFramesDropped(tap.mReader) << " total frames dropped");
+				tap.mDiscontinuity = true;
+				continue;
+			}
+		}
+
+		if(0 == framesRead)
+			break;
+
+		tap.mBlock(tap.mBufferList, framesRead, tap.mDiscontinuity);
+		tap.mDiscontinuity = false;
+	}
+
+	// Space was freed for decoding
+	if(BroadcastRingBuffer::OverrunPolicy::Block == tap.mPolicy)
+		mDecoderSemaphore.Signal();
+}
+
 SFB::Audio::Output& SFB::Audio::Player::GetOutput() const
 {
 	return *mOutput;
@@ -1448,6 +2230,8 @@ bool SFB::Audio::Player::SetOutput(Output::unique_ptr output)
 
 bool SFB::Audio::Player::ProvideAudio(AudioBufferList *bufferList, UInt32 frameCount)
 {
+	RealTimeScope realTimeScope;
+
 	// ========================================
 	// Pre-rendering actions
 
@@ -1460,17 +2244,28 @@ bool SFB::Audio::Player::ProvideAudio(AudioBufferList *bufferList, UInt32 frameC
 		mFlags.fetch_or(eAudioPlayerFlagMuteOutput);
 		mFlags.fetch_and(~eAudioPlayerFlagRequestMute);
 
-		mSemaphore.Signal();
+		SignalRenderingThreadWaiters();
 	}
 
 
 	// ========================================
 	// Rendering
 	size_t framesAvailableToRead = mRingBuffer->GetFramesAvailableToRead();
+	bool isMuted = eAudioPlayerFlagMuteOutput & mFlags.load();
+
+	// A shortfall is only an underrun if more audio is on the way
+	bool isDecoding = !isMuted && IsDecoding();
+	if(isDecoding && framesAvailableToRead < mMinimumFramesBuffered.load())
+		mMinimumFramesBuffered.store(framesAvailableToRead);
 
 	// Output silence if muted or the ring buffer is empty
 	auto outputFormat = mOutput->GetFormat();
-	if(eAudioPlayerFlagMuteOutput & mFlags.load() || 0 == framesAvailableToRead) {
+	if(isMuted || 0 == framesAvailableToRead) {
+		if(isDecoding) {
+			mUnderrunCount.fetch_add(1);
+			mSilenceFramesInserted.fetch_add(frameCount);
+		}
+
 		size_t byteCountToZero = outputFormat.FrameCountToByteCount(frameCount);
 		for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex) {
 			memset(bufferList->mBuffers[bufferIndex].mData, outputFormat.IsDSD() ? 0xF : 0, byteCountToZero);
@@ -1484,17 +2279,43 @@ bool SFB::Audio::Player::ProvideAudio(AudioBufferList *bufferList, UInt32 frameC
 	size_t framesToRead = std::min((UInt32)framesAvailableToRead, frameCount);
 	UInt32 framesRead = (UInt32)mRingBuffer->ReadAudio(bufferList, framesToRead);
 	if(framesRead != framesToRead) {
-		LOGGER_ERR("org.sbooth.AudioEngine.Player", "RingBuffer::ReadAudio failed: Requested " << framesToRead << " frames, got " << framesRead);
+		PostRenderEvent({ RenderEvent::Type::RingBufferReadFailed, (UInt32)framesToRead, framesRead, nullptr });
 		return false;
 	}
 
 	mFramesRendered.fetch_add(framesRead);
 
+	// Complete the seek in progress, if any
+	if(mSeekTimestamps[eSeekPhaseFirstWrite].load() && !mSeekTimestamps[eSeekPhaseFirstRender].load()) {
+		uint64_t now = mach_absolute_time();
+		mSeekTimestamps[eSeekPhaseFirstRender].store(now);
+
+		uint64_t requested = mSeekTimestamps[eSeekPhaseRequested].load();
+		if(requested && now >= requested) {
+			for(size_t phase = 0; phase < kSeekPhaseCount; ++phase)
+				mLastSeekTimestamps[phase].store(mSeekTimestamps[phase].load());
+
+			uint64_t latency = now - requested;
+			mSeekCount.fetch_add(1);
+			mSeekLatencyTotal.fetch_add(latency);
+			if(latency > mSeekLatencyMaximum.load())
+				mSeekLatencyMaximum.store(latency);
+		}
+	}
+
 	// If the ring buffer didn't contain as many frames as were requested, fill the remainder with silence
 	if(framesRead != frameCount) {
-		LOGGER_WARNING("org.sbooth.AudioEngine.Player", "Insufficient audio in ring buffer: " << framesRead << " frames available, " << frameCount << " requested");
+		// An underrun usually spans many render cycles, so cycles are counted while an earlier event awaits processing
+		if(mInsufficientAudioQueued.exchange(true))
+			mInsufficientAudioCoalesced.fetch_add(1);
+		else if(!PostRenderEvent({ RenderEvent::Type::InsufficientAudio, frameCount, framesRead, nullptr }))
+			mInsufficientAudioQueued.store(false);
 
 		size_t framesOfSilence = frameCount - framesRead;
+		if(isDecoding) {
+			mUnderrunCount.fetch_add(1);
+			mSilenceFramesInserted.fetch_add(framesOfSilence);
+		}
 		size_t byteCountToSkip = outputFormat.FrameCountToByteCount(framesRead);
 		size_t byteCountToZero = outputFormat.FrameCountToByteCount(framesOfSilence);
 		for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex) {
@@ -1534,21 +2355,16 @@ bool SFB::Audio::Player::ProvideAudio(AudioBufferList *bufferList, UInt32 frameC
 		SInt64 decoderFramesRemaining = (-1 == decoderState->mTotalFrames ? framesRead : decoderState->mTotalFrames - decoderState->mFramesRendered);
 		SInt64 framesFromThisDecoder = std::min(decoderFramesRemaining, (SInt64)framesRead);
 
-		if(!(eDecoderStateDataFlagRenderingStarted & decoderState->mFlags.load())) {
-			// Call the rendering started block
-			if(mDecoderEventBlocks[2])
-				mDecoderEventBlocks[2](*decoderState->mDecoder);
+		// The flags are only set once the events are queued, so the callbacks can't be lost
+		if(!(eDecoderStateDataFlagRenderingStarted & decoderState->mFlags.load()) && PostRenderEvent({ RenderEvent::Type::RenderingStarted, 0, 0, decoderState }))
 			decoderState->mFlags.fetch_or(eDecoderStateDataFlagRenderingStarted);
-		}
 
 		decoderState->mFramesRendered.fetch_add(framesFromThisDecoder);
 
 		if((eDecoderStateDataFlagDecodingFinished & decoderState->mFlags.load()) && decoderState->mFramesRendered == decoderState->mTotalFrames/* && !(eDecoderStateDataFlagRenderingFinished & decoderState->mFlags.load())*/) {
-			// Call the rendering finished block
-			if(mDecoderEventBlocks[3])
-				mDecoderEventBlocks[3](*decoderState->mDecoder);
-
-			decoderState->mFlags.fetch_or(eDecoderStateDataFlagRenderingFinished);
+			// The event must be posted before the flag is set so the collector won't delete decoderState
+			if(PostRenderEvent({ RenderEvent::Type::RenderingFinished, 0, 0, decoderState }))
+				decoderState->mFlags.fetch_or(eDecoderStateDataFlagRenderingFinished);
 			decoderState = nullptr;
 		}
 
@@ -1565,12 +2381,79 @@ bool SFB::Audio::Player::ProvideAudio(AudioBufferList *bufferList, UInt32 frameC
 		if(eAudioPlayerFlagFormatMismatch & mFlags.load()) {
 			mFlags.fetch_or(eAudioPlayerFlagMuteOutput);
 			mFlags.fetch_and(~eAudioPlayerFlagFormatMismatch);
-			mSemaphore.Signal();
+			SignalRenderingThreadWaiters();
 		}
 		// Calling ASIOStop() from within a callback causes a crash, at least with exaSound's ASIO driver
-		else
-			mOutput->RequestStop();
+		else if(mOutput->RequestStop())
+			AcknowledgeRenderingThreadRequests();
+	}
+
+	return true;
+}
+
+#pragma mark Render Events
+
+bool SFB::Audio::Player::PostRenderEvent(const RenderEvent& event)
+{
+	// Events are written whole so the event queue never sees a partial event
+	// Diagnostic events may not use the space reserved for lifecycle events
+	size_t bytesRequired = sizeof(RenderEvent);
+	if(!event.IsLifecycleEvent())
+		bytesRequired += RenderEvent::kReservedCount * sizeof(RenderEvent);
+
+	if(bytesRequired > mRenderEventQueue->GetBytesAvailableToWrite()) {
+		mRenderEventsDropped.fetch_add(1);
+		return false;
 	}
 
+	if(event.mDecoderState)
+		event.mDecoderState->mRenderEventsPending.fetch_add(1);
+
+	mRenderEventQueue->Write(&event, sizeof(RenderEvent));
+
+	// Merging data doesn't block, and signals while the event queue is busy are coalesced
+	dispatch_source_merge_data(mEventQueueSource, 1);
+
 	return true;
 }
+
+void SFB::Audio::Player::ProcessRenderEvents()
+{
+	auto eventsDropped = mRenderEventsDropped.exchange(0);
+	if(eventsDropped)
+		LOGGER_WARNING("org.sbooth.AudioEngine.Player", "Render event queue full; " << eventsDropped << " events dropped");
+
+	RenderEvent event;
+	while(sizeof(RenderEvent) == mRenderEventQueue->Read(&event, sizeof(RenderEvent))) {
+		switch(event.mType) {
+			case RenderEvent::Type::RingBufferReadFailed:
+				LOGGER_ERR("org.sbooth.AudioEngine.Player", "RingBuffer::ReadAudio failed: Requested " << event.mFramesRequested << " frames, got " << event.mFramesRead);
+				break;
+
+			case RenderEvent::Type::InsufficientAudio:
+			{
+				mInsufficientAudioQueued.store(false);
+				auto coalesced = mInsufficientAudioCoalesced.exchange(0);
+				LOGGER_WARNING("org.sbooth.AudioEngine.Player", "Insufficient audio in ring buffer: " << event.mFramesRead << " frames available, " << event.mFramesRequested << " requested" << (coalesced ? " (" + std::to_string(coalesced) + " later render cycles also short)" : std::string()));
+				break;
+			}
+
+			case RenderEvent::Type::RenderingStarted:
+				if(mDecoderEventBlocks[2])
+					mDecoderEventBlocks[2](*event.mDecoderState->mDecoder);
+				break;
+
+			case RenderEvent::Type::RenderingFinished:
+				if(mDecoderEventBlocks[3])
+					mDecoderEventBlocks[3](*event.mDecoderState->mDecoder);
+				break;
+		}
+
+		if(event.mDecoderState)
+			event.mDecoderState->mRenderEventsPending.fetch_sub(1);
+	}
+
+	auto violations = TakeRealTimeViolations();
+	if(violations.mAllocations || violations.mLocks)
+		LOGGER_ERR("org.sbooth.AudioEngine.Player", "Real-time thread violations: " << violations.mAllocations << " allocations, " << violations.mLocks << " mutex locks");
+}
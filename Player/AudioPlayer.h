@@ -10,6 +10,8 @@
 #include <memory>
 #include <atomic>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <vector>
 #include <utility>
 
@@ -18,7 +20,10 @@
 #include "AudioOutput.h"
 #include "AudioDecoder.h"
 #include "AudioRingBuffer.h"
+#include "AudioBroadcastRingBuffer.h"
 #include "AudioChannelLayout.h"
+#include "CFWrapper.h"
+#include "RingBuffer.h"
 #include "Semaphore.h"
 
 /*! @file AudioPlayer.h @brief Audio playback functionality */
@@ -54,10 +59,15 @@ namespace SFB {
 		 *  5. Pre- and post- audio rendering
 		 *  6. %Audio format mismatches preventing gapless playback
 		 *
+		 * Additionally, taps added with AddTap() receive a copy of the decoded audio on their own queues.
+		 *
 		 * The decoding callbacks will be performed from the decoding thread.  Although not a real time thread,
 		 * lengthy operations should be avoided to prevent audio glitching resulting from gaps in the ring buffer.
 		 *
-		 * The rendering callbacks will be performed from the realtime rendering thread.  Execution of this thread must not be blocked!
+		 * The rendering started and finished callbacks are performed from a serial event queue fed by the realtime rendering thread,
+		 * so they run shortly after the corresponding event.  Diagnostics from the rendering thread are logged from the same queue.
+		 *
+		 * The pre- and post- rendering callbacks will be performed from the realtime rendering thread.  Execution of this thread must not be blocked!
 		 * Examples of prohibited actions that could cause problems:
 		 *  - Memory allocation
 		 *  - Objective-C messaging
@@ -68,6 +78,9 @@ namespace SFB {
 			/*! @brief The length of the array containing active audio decoders */
 			static const size_t kActiveDecoderArraySize = 8;
 
+			/*! @brief The number of timed phases in a seek */
+			static const size_t kSeekPhaseCount = 5;
+
 		public:
 			// ========================================
 			/*! @name Block callback types */
@@ -106,6 +119,14 @@ namespace SFB {
 			 */
 			using ErrorBlock = void (^)(CFErrorRef error);
 
+			/*!
+			 * @brief A block called with audio for a tap
+			 * @param data The audio data
+			 * @param frameCount The number of frames in \c data
+			 * @param discontinuity \c true if audio was lost between the previous invocation and \c data
+			 */
+			using TapBlock = void (^)(const AudioBufferList *data, UInt32 frameCount, bool discontinuity);
+
 			//@}
 
 
@@ -239,14 +260,14 @@ namespace SFB {
 
 			/*!
 			 * @brief Set the block to be invoked when a \c Decoder starts rendering
-			 * @note This block is invoked from the real-time rendering thread before the first audio frame is rendered
+			 * @note This block is invoked from the player's event queue after the rendering thread renders the first audio frame
 			 * @param block The block to invoke when rendering starts
 			 */
 			void SetRenderingStartedBlock(DecoderEventBlock block);
 
 			/*!
 			 * @brief Set the block to be invoked when a \c Decoder finishes rendering
-			 * @note This block is invoked from the real-time rendering thread after the last audio frame has been rendered
+			 * @note This block is invoked from the player's event queue after the rendering thread renders the last audio frame
 			 * @param block The block to invoke when rendering finishes
 			 */
 			void SetRenderingFinishedBlock(DecoderEventBlock block);
@@ -291,6 +312,35 @@ namespace SFB {
 			//@}
 
 
+			// ========================================
+			/*! @name Taps */
+			//@{
+
+			/*!
+			 * @brief Add a tap receiving a copy of all decoded audio
+			 *
+			 * Taps allow analysis such as metering or visualization without work on the real-time rendering thread.
+			 * Each tap has its own cursor in a shared broadcast ring buffer and is paced independently.
+			 * @note The block is invoked on a private serial queue
+			 * @note Taps receive audio in the ring buffer's format as it is decoded, which precedes rendering by up to the ring buffer's capacity
+			 * @note A tap using \c BroadcastRingBuffer::OverrunPolicy::Block holds back decoding until it has consumed its audio
+			 * @param block The block to invoke with decoded audio
+			 * @param policy How to handle the tap falling behind the decoder
+			 * @return The tap's identifier, or \c -1 on error
+			 */
+			int AddTap(TapBlock block, BroadcastRingBuffer::OverrunPolicy policy = BroadcastRingBuffer::OverrunPolicy::Drop);
+
+			/*!
+			 * @brief Remove a tap
+			 * @note The tap's block will not be invoked after this method returns, so this method must not be called from the block
+			 * @param tap The tap's identifier
+			 * @return \c true on success, \c false otherwise
+			 */
+			bool RemoveTap(int tap);
+
+			//@}
+
+
 			// ========================================
 			/*!
 			 * @name Playback Properties
@@ -352,6 +402,39 @@ namespace SFB {
 			//@}
 
 
+			// ========================================
+			/*!
+			 * @name Seek Statistics
+			 * A seek is complete when the first audio from the new position is rendered.
+			 * If output is paused the latency includes the time until playback resumes.
+			 */
+			//@{
+
+			/*! @brief Seek latency measurements */
+			struct SeekStatistics {
+				UInt64			mSeekCount;				/*!< The number of completed seeks */
+				CFTimeInterval	mAverageLatency;		/*!< The mean time from request to first render, in seconds */
+				CFTimeInterval	mMaximumLatency;		/*!< The longest time from request to first render, in seconds */
+
+				CFTimeInterval	mMuteAcknowledged;		/*!< For the most recent seek, when the rendering thread muted output, in seconds after the request */
+				CFTimeInterval	mDecoderSeekCompleted;	/*!< For the most recent seek, when the decoder seeked and the ring buffer was reset, in seconds after the request */
+				CFTimeInterval	mFirstWrite;			/*!< For the most recent seek, when audio from the new position was written to the ring buffer, in seconds after the request */
+				CFTimeInterval	mFirstRender;			/*!< For the most recent seek, when audio from the new position was rendered, in seconds after the request */
+			};
+
+			/*!
+			 * @brief Get seek latency measurements
+			 * @param statistics The measurements
+			 * @return \c true if at least one seek has completed, \c false otherwise
+			 */
+			bool GetSeekStatistics(SeekStatistics& statistics) const;
+
+			/*! @brief Reset seek latency measurements */
+			void ResetSeekStatistics();
+
+			//@}
+
+
 			// ========================================
 			/*! @name Playlist Management */
 			//@{
@@ -457,6 +540,86 @@ namespace SFB {
 			//@}
 
 
+			// ========================================
+			/*!
+			 * @name Buffer Health
+			 * An underrun is a render cycle that received less audio than requested while a \c Decoder was still decoding.
+			 * The minimum fill level is sampled at the start of each unmuted render cycle under the same condition.
+			 */
+			//@{
+
+			/*! @brief Ring buffer and decoding health measurements */
+			struct BufferHealth {
+				UInt64			mUnderrunCount;				/*!< The number of underruns */
+				UInt64			mSilenceFramesInserted;		/*!< The number of frames of silence rendered due to underruns */
+				UInt64			mMinimumFramesBuffered;		/*!< The lowest ring buffer fill level observed, in frames */
+				double			mMinimumHeadroom;			/*!< The lowest ring buffer fill level observed, in milliseconds */
+				UInt64			mFramesBuffered;			/*!< The current ring buffer fill level, in frames */
+				double			mHeadroom;					/*!< The current ring buffer fill level, in milliseconds */
+				UInt64			mDecoderWakeups;			/*!< The number of times the decoding thread woke */
+				UInt64			mChunksDecoded;				/*!< The number of chunks written to the ring buffer */
+				CFTimeInterval	mAverageChunkDecodeTime;	/*!< The mean time to decode and write one chunk, in seconds */
+			};
+
+			/*!
+			 * @brief Get a snapshot of the buffer health measurements
+			 * @note The counters are updated independently, so a snapshot taken during playback may be slightly inconsistent
+			 * @param health The measurements
+			 */
+			void GetBufferHealth(BufferHealth& health) const;
+
+			/*! @brief Reset the buffer health measurements */
+			void ResetBufferHealth();
+
+			//@}
+
+
+			// ========================================
+			/*!
+			 * @name Decode Ahead
+			 * Queued decoders are opened and partially decoded concurrently so slow sources are ready before they are needed.
+			 * The audio decoded ahead is consumed before decoding resumes, so audio reaches the ring buffer in order.
+			 * Decoding ahead is disabled by default.
+			 */
+			//@{
+
+			/*! @brief The decode-ahead state of a queued \c Decoder */
+			struct DecodeAheadStatus {
+				SFB::CFURL		mURL;				/*!< The URL of the \c Decoder */
+				UInt32			mFramesStaged;		/*!< The number of frames decoded ahead */
+				CFTimeInterval	mTimeStaged;		/*!< The duration of the audio decoded ahead, in seconds */
+				bool			mIsComplete;		/*!< Whether the entire stream was decoded ahead */
+			};
+
+			/*! @brief Get the maximum number of queued decoders decoded ahead, \c 0 by default */
+			inline uint32_t GetDecodeAheadTrackCount() const	{ return mDecodeAheadTrackCount; }
+
+			/*!
+			 * @brief Set the maximum number of queued decoders decoded ahead
+			 * @param trackCount The desired number of decoders, or \c 0 to disable decoding ahead
+			 * @return \c true on success, \c false otherwise
+			 */
+			bool SetDecodeAheadTrackCount(uint32_t trackCount);
+
+
+			/*! @brief Get the number of frames decoded ahead for each queued decoder */
+			inline uint32_t GetDecodeAheadCapacity() const		{ return mDecodeAheadCapacity; }
+
+			/*!
+			 * @brief Set the number of frames decoded ahead for each queued decoder
+			 * @note The capacity is measured in the decoder's frames, before any sample rate conversion
+			 * @param capacityFrames The desired number of frames
+			 * @return \c true on success, \c false otherwise
+			 */
+			bool SetDecodeAheadCapacity(uint32_t capacityFrames);
+
+
+			/*! @brief Get the decode-ahead state of the queued decoders, in playback order */
+			std::vector<DecodeAheadStatus> GetDecodeAheadStatus() const;
+
+			//@}
+
+
 			/*! @cond */
 
 			/*! @internal This class is exposed so it can be used inside C callbacks */
@@ -485,31 +648,89 @@ namespace SFB {
 
 			DecoderStateData * GetCurrentDecoderState() const;
 			DecoderStateData * GetDecoderStateStartingAfterTimeStamp(SInt64 timeStamp) const;
+			bool IsDecoding() const;
 
 			bool SetupOutputAndRingBufferForDecoder(Decoder& decoder);
 
+			// ========================================
+			// Thread synchronization
+			bool MuteOutput();
+			bool WaitForRenderingThread(unsigned int flag);
+			void AcknowledgeRenderingThreadRequests();
+			void SignalRenderingThreadWaiters();
+			bool StartOutput();
+			bool StopOutput();
+			void NotifyDecodingFinished();
+
+			class QueuedDecoder;
+			void ScheduleDecodeAhead();
+			void DecodeAhead(QueuedDecoder& queuedDecoder);
+
+			class Tap;
+			void DrainTap(Tap& tap);
+
+			struct RenderEvent;
+			bool PostRenderEvent(const RenderEvent& event);
+			void ProcessRenderEvents();
+
 			// ========================================
 			// Data Members
 			RingBuffer::unique_ptr					mRingBuffer;
 			std::atomic_uint						mRingBufferCapacity;
 			std::atomic_uint						mRingBufferWriteChunkSize;
 
+			BroadcastRingBuffer::unique_ptr			mTapRingBuffer;
+			std::vector<std::shared_ptr<Tap>>		mTaps;				// Protected by mQueueMutex
+			dispatch_source_t						mTapSource;
+
 			std::atomic_uint						mFlags;
 
-			std::vector<Decoder::unique_ptr>		mDecoderQueue;
+			std::vector<std::shared_ptr<QueuedDecoder>>	mDecoderQueue;		// Protected by mQueueMutex
 			std::atomic<DecoderStateData *>			mActiveDecoders [kActiveDecoderArraySize];
 
-			dispatch_queue_t						mQueue;
-			Semaphore								mSemaphore;
+			mutable std::mutex						mQueueMutex;		// Serializes queue access and output setup
+			dispatch_queue_t						mQueue;				// Target queue for tap notifications
+
+			Semaphore								mRenderingThreadSemaphore;	// Signaled by the rendering thread when it clears a flag
+			std::atomic_uint						mRenderingThreadWaiters;
 
 			std::thread								mDecoderThread;
 			Semaphore								mDecoderSemaphore;
+			std::mutex								mDecoderMutex;
+			std::condition_variable					mDecodingFinished;		// Notified by the decoding thread when a decoder finishes
 
 			dispatch_source_t						mCollector;
 
+			dispatch_queue_t						mDecodeAheadQueue;
+			std::atomic_uint						mDecodeAheadTrackCount;
+			std::atomic_uint						mDecodeAheadCapacity;
+
+			SFB::RingBuffer::unique_ptr				mRenderEventQueue;		// Fixed-size events written by the rendering thread
+			std::atomic_ullong						mRenderEventsDropped;
+			std::atomic_bool						mInsufficientAudioQueued;	// Whether an InsufficientAudio event awaits processing
+			std::atomic_ullong						mInsufficientAudioCoalesced;	// Render cycles short of audio while one was queued
+			dispatch_queue_t						mEventQueue;
+			dispatch_source_t						mEventQueueSource;		// Signaled by the rendering thread after posting an event
+			dispatch_source_t						mEventQueueTimer;		// Polls as a fallback while output is running
+
 			std::atomic_llong						mFramesDecoded;
 			std::atomic_llong						mFramesRendered;
 
+			// Host times of the phases of the seek in progress and the most recent completed seek
+			std::atomic_ullong						mSeekTimestamps [kSeekPhaseCount];
+			std::atomic_ullong						mLastSeekTimestamps [kSeekPhaseCount];
+			std::atomic_ullong						mSeekCount;
+			std::atomic_ullong						mSeekLatencyTotal;		// In host time
+			std::atomic_ullong						mSeekLatencyMaximum;	// In host time
+
+			// Buffer health counters
+			std::atomic_ullong						mUnderrunCount;
+			std::atomic_ullong						mSilenceFramesInserted;
+			std::atomic_ullong						mMinimumFramesBuffered;
+			std::atomic_ullong						mDecoderWakeups;
+			std::atomic_ullong						mChunksDecoded;
+			std::atomic_ullong						mChunkDecodeTimeTotal;	// In host time
+
 			Output::unique_ptr						mOutput;
 
 			// ========================================
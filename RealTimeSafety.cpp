@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include "RealTimeSafety.h"
+
+#if DEBUG && __APPLE__
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <pthread.h>
+
+// Invoked by libmalloc for every allocation and deallocation when set (see <malloc/malloc.h> in libmalloc)
+typedef void (malloc_logger_t)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t num_hot_frames_to_skip);
+extern "C" malloc_logger_t *malloc_logger;
+
+namespace {
+
+	// The thread-specific value is non-null on real-time threads
+	// pthread_getspecific() is used instead of thread_local since the latter may allocate on first access
+	pthread_key_t sRealTimeKey;
+	std::atomic_bool sIsKeyCreated(false);
+	std::atomic_bool sIsEnabled(false);
+
+	std::atomic<uint64_t> sAllocationCount(0);
+	std::atomic<uint64_t> sLockCount(0);
+
+	// Serializes enabling and disabling detection
+	std::mutex sDetectionMutex;
+	bool sIsMallocLoggerInstalled = false;
+	malloc_logger_t *sPreviousMallocLogger = nullptr;
+
+	inline bool IsMarkedRealTime()
+	{
+		return sIsKeyCreated.load(std::memory_order_acquire) && nullptr != pthread_getspecific(sRealTimeKey);
+	}
+
+	inline bool IsRealTimeThread()
+	{
+		return sIsEnabled.load(std::memory_order_acquire) && nullptr != pthread_getspecific(sRealTimeKey);
+	}
+
+	void MallocLogger(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t num_hot_frames_to_skip)
+	{
+		if(IsRealTimeThread())
+			sAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+		if(sPreviousMallocLogger)
+			sPreviousMallocLogger(type, arg1, arg2, arg3, result, num_hot_frames_to_skip + 1);
+	}
+
+#if SFB_DETECT_REAL_TIME_MUTEX_LOCKS
+	// The interposition applies to the whole process for as long as the image is loaded,
+	// so it is compiled in only on request and counts nothing while detection is disabled
+	// Calls to pthread_mutex_lock() from within this image aren't interposed
+	int InterposedMutexLock(pthread_mutex_t *mutex)
+	{
+		if(IsRealTimeThread())
+			sLockCount.fetch_add(1, std::memory_order_relaxed);
+
+		return pthread_mutex_lock(mutex);
+	}
+
+	struct Interposer {
+		const void *mReplacement;
+		const void *mReplacee;
+	};
+
+	__attribute__ ((used)) const Interposer sInterposers [] __attribute__ ((section("__DATA,__interpose"))) = {
+		{ (const void *)&InterposedMutexLock, (const void *)&pthread_mutex_lock }
+	};
+#endif
+
+	// Installs nothing unless detection is requested through the environment
+	__attribute__ ((constructor)) void EnableDetectionFromEnvironment()
+	{
+		if(getenv("SFB_DETECT_REAL_TIME_VIOLATIONS"))
+			SFB::EnableRealTimeViolationDetection();
+	}
+
+}
+
+SFB::RealTimeScope::RealTimeScope()
+	: mWasRealTime(IsMarkedRealTime())
+{
+	if(!mWasRealTime && sIsEnabled.load(std::memory_order_acquire))
+		pthread_setspecific(sRealTimeKey, (const void *)1);
+}
+
+SFB::RealTimeScope::~RealTimeScope()
+{
+	// Clear the mark even if detection was disabled while the scope existed
+	if(!mWasRealTime && sIsKeyCreated.load(std::memory_order_acquire))
+		pthread_setspecific(sRealTimeKey, nullptr);
+}
+
+SFB::RealTimeViolations SFB::TakeRealTimeViolations()
+{
+	return { sAllocationCount.exchange(0, std::memory_order_relaxed), sLockCount.exchange(0, std::memory_order_relaxed) };
+}
+
+bool SFB::EnableRealTimeViolationDetection()
+{
+	std::lock_guard<std::mutex> lock(sDetectionMutex);
+
+	if(sIsEnabled.load())
+		return true;
+
+	// The key is never deleted since a RealTimeScope may still reference it
+	if(!sIsKeyCreated.load()) {
+		if(0 != pthread_key_create(&sRealTimeKey, nullptr))
+			return false;
+		sIsKeyCreated.store(true, std::memory_order_release);
+	}
+
+	if(!sIsMallocLoggerInstalled) {
+		sPreviousMallocLogger = malloc_logger;
+		malloc_logger = MallocLogger;
+		sIsMallocLoggerInstalled = true;
+	}
+
+	sIsEnabled.store(true, std::memory_order_release);
+	return true;
+}
+
+void SFB::DisableRealTimeViolationDetection()
+{
+	std::lock_guard<std::mutex> lock(sDetectionMutex);
+
+	if(!sIsEnabled.load())
+		return;
+
+	sIsEnabled.store(false, std::memory_order_release);
+
+	// If another logger was installed on top of this one it forwards here, so leave this one in place;
+	// it counts nothing while detection is disabled
+	if(malloc_logger == MallocLogger) {
+		malloc_logger = sPreviousMallocLogger;
+		sIsMallocLoggerInstalled = false;
+	}
+
+	sAllocationCount.store(0, std::memory_order_relaxed);
+	sLockCount.store(0, std::memory_order_relaxed);
+}
+
+#else
+
+SFB::RealTimeScope::RealTimeScope()
+	: mWasRealTime(false)
+{}
+
+SFB::RealTimeScope::~RealTimeScope()
+{
+	(void)mWasRealTime;
+}
+
+SFB::RealTimeViolations SFB::TakeRealTimeViolations()
+{
+	return { 0, 0 };
+}
+
+bool SFB::EnableRealTimeViolationDetection()
+{
+	return false;
+}
+
+void SFB::DisableRealTimeViolationDetection()
+{}
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/*! @file RealTimeSafety.h @brief Detection of operations unsafe for real-time threads */
+
+/*! @brief \c SFBAudioEngine's encompassing namespace */
+namespace SFB {
+
+	/*!
+	 * @brief Marks the calling thread as real-time for the lifetime of the object
+	 *
+	 * When detection is enabled in debug builds, memory allocations and deallocations (via \c malloc_logger)
+	 * made while a \c RealTimeScope exists on the calling thread are counted.  If the library is built with
+	 * \c SFB_DETECT_REAL_TIME_MUTEX_LOCKS defined to \c 1, mutex locks (via an interposed \c pthread_mutex_lock)
+	 * are counted as well.  Detection itself neither allocates nor locks.  In release builds this class does nothing.
+	 * @note Mutex detection requires the library to be loaded at launch so \c dyld applies the interposition
+	 * @see EnableRealTimeViolationDetection()
+	 */
+	class RealTimeScope
+	{
+	public:
+		/*! @brief Mark the calling thread as real-time */
+		RealTimeScope();
+
+		/*! @brief Restore the calling thread's previous state */
+		~RealTimeScope();
+
+		/*! @cond */
+
+		/*! @internal This class is non-copyable */
+		RealTimeScope(const RealTimeScope& rhs) = delete;
+
+		/*! @internal This class is non-assignable */
+		RealTimeScope& operator=(const RealTimeScope& rhs) = delete;
+
+		/*! @endcond */
+
+	private:
+		bool mWasRealTime; /*!< Whether the thread was already marked real-time */
+	};
+
+	/*! @brief Operations detected within a \c RealTimeScope */
+	struct RealTimeViolations {
+		uint64_t mAllocations;	/*!< The number of memory allocations and deallocations */
+		uint64_t mLocks;		/*!< The number of mutex locks */
+	};
+
+	/*!
+	 * @brief Get and reset the counts of operations detected within a \c RealTimeScope
+	 * @note The counts are always zero in release builds
+	 */
+	RealTimeViolations TakeRealTimeViolations();
+
+	/*!
+	 * @brief Start counting operations made within a \c RealTimeScope
+	 *
+	 * Detection is disabled by default.  It is also enabled when the library is loaded if the
+	 * \c SFB_DETECT_REAL_TIME_VIOLATIONS environment variable is set.
+	 * @note Detection installs a process-wide \c malloc_logger, so it is intended only for debugging
+	 * @return \c true if detection is enabled, \c false otherwise or in release builds
+	 */
+	bool EnableRealTimeViolationDetection();
+
+	/*! @brief Stop counting operations and remove the \c malloc_logger installed by \c EnableRealTimeViolationDetection() */
+	void DisableRealTimeViolationDetection();
+
+}
@@ -4,34 +4,18 @@
  */
 
 #include "RingBuffer.h"
+#include "RingBufferUtilities.h"
+#include "VirtualMemory.h"
 
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
 
-namespace {
-
-	/*!
-	 * Return the smallest power of two value greater than \c x
-	 * @param x A value in the range [2..2147483648]
-	 * @return The smallest power of two greater than \c x
-	 *
-	 */
-	__attribute__ ((const)) inline uint32_t NextPowerOfTwo(uint32_t x)
-	{
-#if 0
-		assert(x > 1);
-		assert(x <= ((UINT32_MAX / 2) + 1));
-#endif
-
-		return 1 << (32 - __builtin_clz(x - 1));
-	}
-
-}
-
 #pragma mark Creation and Destruction
 
 SFB::RingBuffer::RingBuffer()
-	: mBuffer(nullptr), mCapacityBytes(0), mCapacityBytesMask(0), mWritePointer(0), mReadPointer(0)
+	: mBuffer(nullptr), mCapacityBytes(0), mCapacityBytesMask(0), mIsMirrored(false), mIsPageAllocated(false), mIsLocked(false), mWritePointer(0), mReadPointer(0)
 {}
 
 SFB::RingBuffer::~RingBuffer()
@@ -39,28 +23,65 @@ SFB::RingBuffer::~RingBuffer()
 	Deallocate();
 }
 
+void * SFB::RingBuffer::operator new(size_t size)
+{
+	return AllocateAligned(size, alignof(SFB::RingBuffer));
+}
+
+void SFB::RingBuffer::operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
 #pragma mark Buffer Management
 
-bool SFB::RingBuffer::Allocate(size_t capacityBytes)
+bool SFB::RingBuffer::Allocate(size_t capacityBytes, int flags)
 {
+	if(2 > capacityBytes || capacityBytes > (SIZE_MAX / 2) + 1)
+		return false;
+
 	Deallocate();
 
 	// Round up to the next power of two
-	capacityBytes = NextPowerOfTwo((uint32_t)capacityBytes);
+	capacityBytes = (size_t)NextPowerOfTwo(capacityBytes);
+
+	// Mirrored memory and huge or locked pages are mapped in whole pages
+	bool pageAllocated = (MirrorMemory | PreferHugePages | LockInMemory) & flags;
+	if(pageAllocated)
+		capacityBytes = std::max(capacityBytes, GetPageSize());
 
 	mCapacityBytes = capacityBytes;
 	mCapacityBytesMask = capacityBytes - 1;
 
-	try {
-		mBuffer = new uint8_t [mCapacityBytes];
+	// Huge pages can't be mirrored
+	if(MirrorMemory & flags) {
+		mBuffer = (uint8_t *)AllocateMirroredMemory(mCapacityBytes);
+		if(nullptr == mBuffer)
+			return false;
+		mIsMirrored = true;
+	}
+	else if(pageAllocated) {
+		mBuffer = (uint8_t *)AllocatePages(mCapacityBytes, PreferHugePages & flags);
+		if(nullptr == mBuffer)
+			return false;
+		mIsPageAllocated = true;
 	}
+	else {
+		try {
+			mBuffer = new uint8_t [mCapacityBytes];
+		}
 
-	catch(const std::exception& e) {
-		return false;
+		catch(const std::exception& e) {
+			return false;
+		}
 	}
 
-	mReadPointer = 0;
-	mWritePointer = 0;
+	// Locking is best effort; mirrored pages only need to be locked once
+	if(LockInMemory & flags)
+		mIsLocked = SFB::LockMemory(mBuffer, mCapacityBytes);
+
+	mReadPointer.store(0, std::memory_order_relaxed);
+	mWritePointer.store(0, std::memory_order_relaxed);
 
 	return true;
 }
@@ -68,22 +89,34 @@ bool SFB::RingBuffer::Allocate(size_t capacityBytes)
 void SFB::RingBuffer::Deallocate()
 {
 	if(mBuffer) {
-		delete [] mBuffer;
+		if(mIsLocked)
+			UnlockMemory(mBuffer, mCapacityBytes);
+
+		if(mIsMirrored)
+			DeallocateMirroredMemory(mBuffer, mCapacityBytes);
+		else if(mIsPageAllocated)
+			DeallocatePages(mBuffer, mCapacityBytes);
+		else
+			delete [] mBuffer;
+
 		mBuffer = nullptr;
+		mIsMirrored = false;
+		mIsPageAllocated = false;
+		mIsLocked = false;
 	}
 }
 
 
 void SFB::RingBuffer::Reset()
 {
-	mReadPointer = 0;
-	mWritePointer = 0;
+	mReadPointer.store(0, std::memory_order_relaxed);
+	mWritePointer.store(0, std::memory_order_relaxed);
 }
 
 size_t SFB::RingBuffer::GetBytesAvailableToRead() const
 {
-	auto w = mWritePointer;
-	auto r = mReadPointer;
+	auto w = mWritePointer.load(std::memory_order_acquire);
+	auto r = mReadPointer.load(std::memory_order_acquire);
 
 	if(w > r)
 		return w - r;
@@ -93,8 +126,8 @@ size_t SFB::RingBuffer::GetBytesAvailableToRead() const
 
 size_t SFB::RingBuffer::GetBytesAvailableToWrite() const
 {
-	auto w = mWritePointer;
-	auto r = mReadPointer;
+	auto w = mWritePointer.load(std::memory_order_acquire);
+	auto r = mReadPointer.load(std::memory_order_acquire);
 
 	if(w > r)
 		return ((r - w + mCapacityBytes) & mCapacityBytesMask) - 1;
@@ -109,16 +142,21 @@ size_t SFB::RingBuffer::Read(void *destinationBuffer, size_t byteCount)
 	if(nullptr == destinationBuffer || 0 == byteCount)
 		return 0;
 
+	// The acquire load of the write pointer in GetBytesAvailableToRead() ensures the data is visible
 	auto bytesAvailable = GetBytesAvailableToRead();
 	if(0 == bytesAvailable)
 		return 0;
 
+	// Only the reader modifies the read pointer
+	auto readPointer = mReadPointer.load(std::memory_order_relaxed);
+
 	auto bytesToRead = std::min(bytesAvailable, byteCount);
-	auto cnt2 = mReadPointer + bytesToRead;
+	auto cnt2 = readPointer + bytesToRead;
 
+	// Mirrored memory is contiguous past the end of the buffer
 	size_t n1, n2;
-	if(cnt2 > mCapacityBytes) {
-		n1 = mCapacityBytes - mReadPointer;
+	if(cnt2 > mCapacityBytes && !mIsMirrored) {
+		n1 = mCapacityBytes - readPointer;
 		n2 = cnt2 & mCapacityBytesMask;
 	}
 	else {
@@ -126,14 +164,17 @@ size_t SFB::RingBuffer::Read(void *destinationBuffer, size_t byteCount)
 		n2 = 0;
 	}
 
-	memcpy(destinationBuffer, mBuffer + mReadPointer, n1);
-	mReadPointer = (mReadPointer + n1) & mCapacityBytesMask;
+	memcpy(destinationBuffer, mBuffer + readPointer, n1);
+	readPointer = (readPointer + n1) & mCapacityBytesMask;
 
 	if(n2) {
-		memcpy((uint8_t *)destinationBuffer + n1, mBuffer + mReadPointer, n2);
-		mReadPointer = (mReadPointer + n2) & mCapacityBytesMask;
+		memcpy((uint8_t *)destinationBuffer + n1, mBuffer + readPointer, n2);
+		readPointer = (readPointer + n2) & mCapacityBytesMask;
 	}
 
+	// Publish the space only after the data has been consumed
+	mReadPointer.store(readPointer, std::memory_order_release);
+
 	return bytesToRead;
 }
 
@@ -146,14 +187,15 @@ size_t SFB::RingBuffer::Peek(void *destinationBuffer, size_t byteCount) const
 	if(0 == bytesAvailable)
 		return 0;
 
-	auto readPointer = mReadPointer;
+	auto readPointer = mReadPointer.load(std::memory_order_relaxed);
 
 	auto bytesToRead = std::min(bytesAvailable, byteCount);
 	auto cnt2 = readPointer + bytesToRead;
 
+	// Mirrored memory is contiguous past the end of the buffer
 	size_t n1, n2;
-	if(cnt2 > mCapacityBytes) {
-		n1 = mCapacityBytes - mReadPointer;
+	if(cnt2 > mCapacityBytes && !mIsMirrored) {
+		n1 = mCapacityBytes - readPointer;
 		n2 = cnt2 & mCapacityBytesMask;
 	}
 	else {
@@ -175,16 +217,21 @@ size_t SFB::RingBuffer::Write(const void *sourceBuffer, size_t byteCount)
 	if(nullptr == sourceBuffer || 0 == byteCount)
 		return 0;
 
+	// The acquire load of the read pointer in GetBytesAvailableToWrite() ensures the reader is finished with the space
 	auto bytesAvailable = GetBytesAvailableToWrite();
 	if(0 == bytesAvailable)
 		return 0;
 
+	// Only the writer modifies the write pointer
+	auto writePointer = mWritePointer.load(std::memory_order_relaxed);
+
 	auto bytesToWrite = std::min(bytesAvailable, byteCount);
-	auto cnt2 = mWritePointer + bytesToWrite;
+	auto cnt2 = writePointer + bytesToWrite;
 
+	// Mirrored memory is contiguous past the end of the buffer
 	size_t n1, n2;
-	if(cnt2 > mCapacityBytes) {
-		n1 = mCapacityBytes - mWritePointer;
+	if(cnt2 > mCapacityBytes && !mIsMirrored) {
+		n1 = mCapacityBytes - writePointer;
 		n2 = cnt2 & mCapacityBytesMask;
 	}
 	else {
@@ -192,31 +239,36 @@ size_t SFB::RingBuffer::Write(const void *sourceBuffer, size_t byteCount)
 		n2 = 0;
 	}
 
-	memcpy(mBuffer + mWritePointer, sourceBuffer, n1);
-	mWritePointer = (mWritePointer + n1) & mCapacityBytesMask;
+	memcpy(mBuffer + writePointer, sourceBuffer, n1);
+	writePointer = (writePointer + n1) & mCapacityBytesMask;
 
 	if(n2) {
-		memcpy(mBuffer + mWritePointer, (int8_t *)sourceBuffer + n1, n2);
-		mWritePointer = (mWritePointer + n2) & mCapacityBytesMask;
+		memcpy(mBuffer + writePointer, (int8_t *)sourceBuffer + n1, n2);
+		writePointer = (writePointer + n2) & mCapacityBytesMask;
 	}
 
+	// Publish the data only after it has been copied
+	mWritePointer.store(writePointer, std::memory_order_release);
+
 	return bytesToWrite;
 }
 
 void SFB::RingBuffer::ReadAdvance(size_t byteCount)
 {
-	mReadPointer = (mReadPointer + byteCount) & mCapacityBytesMask;
+	auto readPointer = mReadPointer.load(std::memory_order_relaxed);
+	mReadPointer.store((readPointer + byteCount) & mCapacityBytesMask, std::memory_order_release);
 }
 
 void SFB::RingBuffer::WriteAdvance(size_t byteCount)
 {
-	mWritePointer = (mWritePointer + byteCount) & mCapacityBytesMask;;
+	auto writePointer = mWritePointer.load(std::memory_order_relaxed);
+	mWritePointer.store((writePointer + byteCount) & mCapacityBytesMask, std::memory_order_release);
 }
 
 SFB::RingBuffer::BufferPair SFB::RingBuffer::GetReadVector() const
 {
-	auto w = mWritePointer;
-	auto r = mReadPointer;
+	auto w = mWritePointer.load(std::memory_order_acquire);
+	auto r = mReadPointer.load(std::memory_order_relaxed);
 
 	size_t free_cnt;
 	if(w > r)
@@ -226,18 +278,16 @@ SFB::RingBuffer::BufferPair SFB::RingBuffer::GetReadVector() const
 
 	auto cnt2 = r + free_cnt;
 
-	if(cnt2 > mCapacityBytes)
-		return { { mBuffer + r, mCapacityBytes - r }, { mBuffer, cnt2 & mCapacityBytes } };
+	if(cnt2 > mCapacityBytes && !mIsMirrored)
+		return { { mBuffer + r, mCapacityBytes - r }, { mBuffer, cnt2 & mCapacityBytesMask } };
 	else
 		return { { mBuffer + r, free_cnt }, {} };
-
-	return {};
 }
 
 SFB::RingBuffer::BufferPair SFB::RingBuffer::GetWriteVector() const
 {
-	auto w = mWritePointer;
-	auto r = mReadPointer;
+	auto w = mWritePointer.load(std::memory_order_relaxed);
+	auto r = mReadPointer.load(std::memory_order_acquire);
 
 	size_t free_cnt;
 	if(w > r)
@@ -249,10 +299,8 @@ SFB::RingBuffer::BufferPair SFB::RingBuffer::GetWriteVector() const
 
 	auto cnt2 = w + free_cnt;
 
-	if(cnt2 > mCapacityBytes)
-		return { { mBuffer + w, mCapacityBytes - w }, { mBuffer, cnt2 & mCapacityBytes } };
+	if(cnt2 > mCapacityBytes && !mIsMirrored)
+		return { { mBuffer + w, mCapacityBytes - w }, { mBuffer, cnt2 & mCapacityBytesMask } };
 	else
 		return { { mBuffer + w, free_cnt }, {} };
-
-	return {};
 }
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 
 /*! @file RingBuffer.h @brief A generic ring buffer */
@@ -18,6 +19,11 @@ namespace SFB {
 	 * This class is thread safe when used from one reader thread
 	 * and one writer thread (single producer, single consumer model).
 	 *
+	 * The read and write pointers are published with release semantics and
+	 * observed with acquire semantics, so data copied into the buffer is visible
+	 * to the other thread before the pointer that exposes it.  Each pointer
+	 * occupies its own cache line to avoid false sharing between the threads.
+	 *
 	 * The read and write routines are based on JACK's ringbuffer implementation
 	 */
 	class RingBuffer
@@ -30,6 +36,13 @@ namespace SFB {
 		/*! @brief A \c std::unique_ptr for \c RingBuffer objects */
 		using unique_ptr = std::unique_ptr<RingBuffer>;
 
+		/*! @brief Flags used in \c RingBuffer::Allocate */
+		enum AllocationFlags {
+			MirrorMemory			= 1 << 0,	/*!< Map the buffer twice back to back so reads and writes never wrap */
+			PreferHugePages			= 1 << 1,	/*!< Back the buffer with huge pages if possible (ignored for mirrored buffers) */
+			LockInMemory			= 1 << 2	/*!< Lock the buffer in physical memory so accesses never page fault */
+		};
+
 		/*!
 		 * @brief Create a new \c RingBuffer
 		 * @note Allocate() must be called before the object may be used.
@@ -47,6 +60,12 @@ namespace SFB {
 		/*! @internal This class is non-assignable */
 		RingBuffer& operator=(const RingBuffer& rhs) = delete;
 
+		/*! @internal Allocate with the alignment of the cache-line aligned members, which operator new only guarantees from C++17 */
+		static void * operator new(size_t size);
+
+		/*! @internal Release memory allocated with this class's operator new */
+		static void operator delete(void *ptr) noexcept;
+
 		/*! @endcond */
 
 		//@}
@@ -59,10 +78,14 @@ namespace SFB {
 		/*!
 		 * @brief Allocate space for data.
 		 * @note This method is not thread safe.
-		 * @param byteCount The desired capacity, in bytes
+		 * @note When any flags are specified the capacity is rounded up to at least the page size
+		 * @note \c LockInMemory is best effort; use IsLocked() to determine whether it succeeded
+		 * @param byteCount The desired capacity, in bytes, in the range [2..2^63]
+		 * @param flags Optional flags affecting how the memory is allocated
 		 * @return \c true on success, \c false on error
+		 * @see AllocationFlags
 		 */
-		bool Allocate(size_t byteCount);
+		bool Allocate(size_t byteCount, int flags = 0);
 
 		/*!
 		 * @brief Free the resources used by this \c RingBuffer
@@ -81,6 +104,15 @@ namespace SFB {
 		/*! @brief Get the capacity of this RingBuffer in bytes */
 		inline size_t GetCapacityBytes() const						{ return mCapacityBytes; }
 
+		/*!
+		 * @brief Query whether this \c RingBuffer uses mirrored memory
+		 * @note When mirrored, the read and write vectors always consist of a single contiguous \c Buffer
+		 */
+		inline bool IsMirrored() const								{ return mIsMirrored; }
+
+		/*! @brief Query whether this \c RingBuffer is locked in physical memory */
+		inline bool IsLocked() const								{ return mIsLocked; }
+
 		/*! @brief  Get the number of bytes available for reading */
 		size_t GetBytesAvailableToRead() const;
 
@@ -157,13 +189,20 @@ namespace SFB {
 
 	private:
 
+		/*! @brief The assumed size of a cache line, in bytes */
+		static constexpr size_t kCacheLineSize = 64;
+
 		uint8_t				*mBuffer;				/*!< The memory buffer holding the data */
 
 		size_t				mCapacityBytes;			/*!< The capacity of \c mBuffer in bytes */
 		size_t				mCapacityBytesMask;		/*!< The capacity of \c mBuffer in bytes minus one */
 
-		volatile size_t		mWritePointer;			/*!< The offset into \c mBuffer of the read location */
-		volatile size_t		mReadPointer;			/*!< The offset into \c mBuffer of the write location */
+		bool				mIsMirrored;			/*!< Whether \c mBuffer is followed by a mirror of itself */
+		bool				mIsPageAllocated;		/*!< Whether \c mBuffer was allocated with \c AllocatePages() */
+		bool				mIsLocked;				/*!< Whether \c mBuffer is locked in physical memory */
+
+		alignas(kCacheLineSize) std::atomic_size_t	mWritePointer;		/*!< The offset into \c mBuffer of the write location */
+		alignas(kCacheLineSize) std::atomic_size_t	mReadPointer;		/*!< The offset into \c mBuffer of the read location */
 	};
 
 }
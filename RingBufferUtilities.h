@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#pragma once
+
+#include <CoreAudio/CoreAudioTypes.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+/*! @file RingBufferUtilities.h @brief Utility functions shared by the ring buffer implementations */
+
+/*! @brief \c SFBAudioEngine's encompassing namespace */
+namespace SFB {
+
+	/*!
+	 * @brief Return the smallest power of two value greater than \c x
+	 * @param x A value in the range [2..9223372036854775808]
+	 * @return The smallest power of two greater than \c x
+	 */
+	__attribute__ ((const)) inline uint64_t NextPowerOfTwo(uint64_t x)
+	{
+		return 1ull << (64 - __builtin_clzll(x - 1));
+	}
+
+	/*!
+	 * @brief Allocate memory with the specified alignment
+	 * @param size The number of bytes to allocate
+	 * @param alignment The alignment, a power of two multiple of \c sizeof(void *)
+	 * @return A pointer to the memory, which must be released with \c free()
+	 * @throws std::bad_alloc
+	 */
+	inline void * AllocateAligned(size_t size, size_t alignment)
+	{
+		void *ptr = nullptr;
+		if(posix_memalign(&ptr, alignment, size))
+			throw std::bad_alloc();
+		return ptr;
+	}
+
+	/*! @brief %Audio functionality */
+	namespace Audio {
+
+		/*!
+		 * @brief Copy non-interleaved audio from \c bufferList to \c buffers
+		 * @param buffers The destination buffers
+		 * @param destOffset The byte offset in \c buffers to begin writing
+		 * @param bufferList The source buffers
+		 * @param srcOffset The byte offset in \c bufferList to begin reading
+		 * @param byteCount The number of bytes per non-interleaved buffer to read and write
+		 */
+		inline void StoreABL(uint8_t **buffers, size_t destOffset, const AudioBufferList *bufferList, size_t srcOffset, size_t byteCount)
+		{
+			for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex)
+				memcpy(buffers[bufferIndex] + destOffset, (uint8_t *)bufferList->mBuffers[bufferIndex].mData + srcOffset, byteCount);
+		}
+
+		/*!
+		 * @brief Copy non-interleaved audio from \c buffers to \c bufferList
+		 * @param bufferList The destination buffers
+		 * @param destOffset The byte offset in \c bufferList to begin writing
+		 * @param buffers The source buffers
+		 * @param srcOffset The byte offset in \c buffers to begin reading
+		 * @param byteCount The number of bytes per non-interleaved buffer to read and write
+		 */
+		inline void FetchABL(AudioBufferList *bufferList, size_t destOffset, const uint8_t **buffers, size_t srcOffset, size_t byteCount)
+		{
+			for(UInt32 bufferIndex = 0; bufferIndex < bufferList->mNumberBuffers; ++bufferIndex)
+				memcpy((uint8_t *)bufferList->mBuffers[bufferIndex].mData + destOffset, buffers[bufferIndex] + srcOffset, byteCount);
+		}
+
+	}
+}
@@ -0,0 +1,1327 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if __x86_64__
+# include <immintrin.h>
+# if __APPLE__
+#  include <sys/sysctl.h>
+# endif
+#elif __aarch64__ && __ARM_NEON
+# include <arm_neon.h>
+#endif
+
+#include "SampleKernels.h"
+#include "Logger.h"
+
+namespace {
+
+	using SFB::Audio::SampleKernelInstructionSet;
+
+	// The largest value representable as both a float and an int32_t
+	const float kInt32MaximumFloat = 2147483520.f;
+
+	// The kernels that have specialized implementations
+	struct KernelTable
+	{
+		SampleKernelInstructionSet mInstructionSet;
+
+		void (*mDeinterleaveFloat)(const float *src, float * const *dest, uint32_t channelCount, size_t frameCount);
+		void (*mDeinterleaveInt32)(const int32_t *src, int32_t * const *dest, uint32_t channelCount, size_t frameCount);
+		void (*mInterleaveFloat)(const float * const *src, float *dest, uint32_t channelCount, size_t frameCount);
+		void (*mInterleaveInt32)(const int32_t * const *src, int32_t *dest, uint32_t channelCount, size_t frameCount);
+
+		void (*mConvertInt16ToFloat)(const int16_t *src, float *dest, size_t count, float scale);
+		void (*mConvertInt32ToFloat)(const int32_t *src, float *dest, size_t count, float scale);
+		void (*mConvertFloatToInt16)(const float *src, int16_t *dest, size_t count, float scale);
+		void (*mConvertFloatToInt32)(const float *src, int32_t *dest, size_t count, float scale);
+		void (*mConvertFloatToDouble)(const float *src, double *dest, size_t count);
+		void (*mConvertDoubleToFloat)(const double *src, float *dest, size_t count);
+
+		void (*mShiftInt32)(const int32_t *src, int32_t *dest, size_t count, uint32_t shift);
+		void (*mConvertInt32ToInt16)(const int32_t *src, int16_t *dest, size_t count, uint32_t shift);
+
+		void (*mScaleFloat)(const float *src, float *dest, size_t count, float scale);
+		void (*mClipFloat)(const float *src, float *dest, size_t count, float minValue, float maxValue);
+	};
+
+#pragma mark Scalar Kernels
+
+	template <typename T, uint32_t C>
+	void DeinterleaveScalar(const T *src, T * const *dest, size_t frameCount)
+	{
+		// Copy the channel pointers so the compiler knows the stores don't modify them
+		T *channels [C];
+		for(uint32_t channel = 0; channel < C; ++channel)
+			channels[channel] = dest[channel];
+
+		for(size_t frame = 0; frame < frameCount; ++frame) {
+			for(uint32_t channel = 0; channel < C; ++channel)
+				channels[channel][frame] = *src++;
+		}
+	}
+
+	template <typename T>
+	void DeinterleaveScalar(const T *src, T * const *dest, uint32_t channelCount, size_t frameCount)
+	{
+		switch(channelCount) {
+			case 1:		memmove(dest[0], src, frameCount * sizeof(T));			break;
+			case 2:		DeinterleaveScalar<T, 2>(src, dest, frameCount);		break;
+			case 3:		DeinterleaveScalar<T, 3>(src, dest, frameCount);		break;
+			case 4:		DeinterleaveScalar<T, 4>(src, dest, frameCount);		break;
+			case 5:		DeinterleaveScalar<T, 5>(src, dest, frameCount);		break;
+			case 6:		DeinterleaveScalar<T, 6>(src, dest, frameCount);		break;
+			case 7:		DeinterleaveScalar<T, 7>(src, dest, frameCount);		break;
+			case 8:		DeinterleaveScalar<T, 8>(src, dest, frameCount);		break;
+
+			default:
+				for(uint32_t channel = 0; channel < channelCount; ++channel) {
+					T *output = dest[channel];
+					for(size_t frame = 0; frame < frameCount; ++frame)
+						output[frame] = src[(frame * channelCount) + channel];
+				}
+				break;
+		}
+	}
+
+	template <typename T, uint32_t C>
+	void InterleaveScalar(const T * const *src, T *dest, size_t frameCount)
+	{
+		const T *channels [C];
+		for(uint32_t channel = 0; channel < C; ++channel)
+			channels[channel] = src[channel];
+
+		for(size_t frame = 0; frame < frameCount; ++frame) {
+			for(uint32_t channel = 0; channel < C; ++channel)
+				*dest++ = channels[channel][frame];
+		}
+	}
+
+	template <typename T>
+	void InterleaveScalar(const T * const *src, T *dest, uint32_t channelCount, size_t frameCount)
+	{
+		switch(channelCount) {
+			case 1:		memmove(dest, src[0], frameCount * sizeof(T));			break;
+			case 2:		InterleaveScalar<T, 2>(src, dest, frameCount);			break;
+			case 3:		InterleaveScalar<T, 3>(src, dest, frameCount);			break;
+			case 4:		InterleaveScalar<T, 4>(src, dest, frameCount);			break;
+			case 5:		InterleaveScalar<T, 5>(src, dest, frameCount);			break;
+			case 6:		InterleaveScalar<T, 6>(src, dest, frameCount);			break;
+			case 7:		InterleaveScalar<T, 7>(src, dest, frameCount);			break;
+			case 8:		InterleaveScalar<T, 8>(src, dest, frameCount);			break;
+
+			default:
+				for(uint32_t channel = 0; channel < channelCount; ++channel) {
+					const T *input = src[channel];
+					for(size_t frame = 0; frame < frameCount; ++frame)
+						dest[(frame * channelCount) + channel] = input[frame];
+				}
+				break;
+		}
+	}
+
+	void ConvertInt16ToFloatScalar(const int16_t *src, float *dest, size_t count, float scale)
+	{
+		for(size_t i = 0; i < count; ++i)
+			dest[i] = (float)src[i] * scale;
+	}
+
+	void ConvertInt32ToFloatScalar(const int32_t *src, float *dest, size_t count, float scale)
+	{
+		for(size_t i = 0; i < count; ++i)
+			dest[i] = (float)src[i] * scale;
+	}
+
+	void ConvertFloatToInt16Scalar(const float *src, int16_t *dest, size_t count, float scale)
+	{
+		// NaN converts to silence
+		for(size_t i = 0; i < count; ++i) {
+			float sample = src[i] * scale;
+			dest[i] = std::isnan(sample) ? 0 : (int16_t)lrintf(std::min(std::max(sample, -32768.f), 32767.f));
+		}
+	}
+
+	void ConvertFloatToInt32Scalar(const float *src, int32_t *dest, size_t count, float scale)
+	{
+		// NaN converts to silence
+		for(size_t i = 0; i < count; ++i) {
+			float sample = src[i] * scale;
+			dest[i] = std::isnan(sample) ? 0 : (int32_t)lrintf(std::min(std::max(sample, -2147483648.f), kInt32MaximumFloat));
+		}
+	}
+
+	void ConvertFloatToDoubleScalar(const float *src, double *dest, size_t count)
+	{
+		for(size_t i = 0; i < count; ++i)
+			dest[i] = (double)src[i];
+	}
+
+	void ConvertDoubleToFloatScalar(const double *src, float *dest, size_t count)
+	{
+		for(size_t i = 0; i < count; ++i)
+			dest[i] = (float)src[i];
+	}
+
+	void ShiftInt32Scalar(const int32_t *src, int32_t *dest, size_t count, uint32_t shift)
+	{
+		for(size_t i = 0; i < count; ++i)
+			dest[i] = (int32_t)((uint32_t)src[i] << shift);
+	}
+
+	void ConvertInt32ToInt16Scalar(const int32_t *src, int16_t *dest, size_t count, uint32_t shift)
+	{
+		for(size_t i = 0; i < count; ++i)
+			dest[i] = (int16_t)std::min(std::max((int32_t)((uint32_t)src[i] << shift), (int32_t)INT16_MIN), (int32_t)INT16_MAX);
+	}
+
+	void ScaleFloatScalar(const float *src, float *dest, size_t count, float scale)
+	{
+		for(size_t i = 0; i < count; ++i)
+			dest[i] = src[i] * scale;
+	}
+
+	void ClipFloatScalar(const float *src, float *dest, size_t count, float minValue, float maxValue)
+	{
+		// NaN clips as silence
+		for(size_t i = 0; i < count; ++i)
+			dest[i] = std::min(std::max(std::isnan(src[i]) ? 0.f : src[i], minValue), maxValue);
+	}
+
+	KernelTable MakeScalarKernelTable()
+	{
+		KernelTable table;
+
+		table.mInstructionSet		= SampleKernelInstructionSet::Scalar;
+
+		table.mDeinterleaveFloat	= DeinterleaveScalar<float>;
+		table.mDeinterleaveInt32	= DeinterleaveScalar<int32_t>;
+		table.mInterleaveFloat		= InterleaveScalar<float>;
+		table.mInterleaveInt32		= InterleaveScalar<int32_t>;
+
+		table.mConvertInt16ToFloat	= ConvertInt16ToFloatScalar;
+		table.mConvertInt32ToFloat	= ConvertInt32ToFloatScalar;
+		table.mConvertFloatToInt16	= ConvertFloatToInt16Scalar;
+		table.mConvertFloatToInt32	= ConvertFloatToInt32Scalar;
+		table.mConvertFloatToDouble	= ConvertFloatToDoubleScalar;
+		table.mConvertDoubleToFloat	= ConvertDoubleToFloatScalar;
+
+		table.mShiftInt32			= ShiftInt32Scalar;
+		table.mConvertInt32ToInt16	= ConvertInt32ToInt16Scalar;
+
+		table.mScaleFloat			= ScaleFloatScalar;
+		table.mClipFloat			= ClipFloatScalar;
+
+		return table;
+	}
+
+#if __x86_64__
+
+#pragma mark SSE2 Kernels
+
+	// SSE2 is part of the x86-64 baseline so these need no target attribute
+
+	template <typename T>
+	void DeinterleaveSSE2(const T *src, T * const *dest, uint32_t channelCount, size_t frameCount)
+	{
+		static_assert(4 == sizeof(T), "Only 32-bit samples are supported");
+
+		size_t frame = 0;
+		auto input = (const float *)src;
+
+		if(2 == channelCount) {
+			auto left = (float *)dest[0], right = (float *)dest[1];
+			for(; frame + 4 <= frameCount; frame += 4, input += 8) {
+				__m128 a = _mm_loadu_ps(input);
+				__m128 b = _mm_loadu_ps(input + 4);
+				_mm_storeu_ps(left + frame, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_storeu_ps(right + frame, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+			}
+		}
+		else if(4 == channelCount) {
+			float *output [4] = { (float *)dest[0], (float *)dest[1], (float *)dest[2], (float *)dest[3] };
+			for(; frame + 4 <= frameCount; frame += 4, input += 16) {
+				__m128 a = _mm_loadu_ps(input);
+				__m128 b = _mm_loadu_ps(input + 4);
+				__m128 c = _mm_loadu_ps(input + 8);
+				__m128 d = _mm_loadu_ps(input + 12);
+				_MM_TRANSPOSE4_PS(a, b, c, d);
+				_mm_storeu_ps(output[0] + frame, a);
+				_mm_storeu_ps(output[1] + frame, b);
+				_mm_storeu_ps(output[2] + frame, c);
+				_mm_storeu_ps(output[3] + frame, d);
+			}
+		}
+
+		if(frame == frameCount)
+			return;
+
+		// Handle the remaining frames and unspecialized channel counts
+		T *remainder [channelCount];
+		for(uint32_t channel = 0; channel < channelCount; ++channel)
+			remainder[channel] = dest[channel] + frame;
+		DeinterleaveScalar(src + (frame * channelCount), remainder, channelCount, frameCount - frame);
+	}
+
+	template <typename T>
+	void InterleaveSSE2(const T * const *src, T *dest, uint32_t channelCount, size_t frameCount)
+	{
+		static_assert(4 == sizeof(T), "Only 32-bit samples are supported");
+
+		size_t frame = 0;
+		auto output = (float *)dest;
+
+		if(2 == channelCount) {
+			auto left = (const float *)src[0], right = (const float *)src[1];
+			for(; frame + 4 <= frameCount; frame += 4, output += 8) {
+				__m128 l = _mm_loadu_ps(left + frame);
+				__m128 r = _mm_loadu_ps(right + frame);
+				_mm_storeu_ps(output, _mm_unpacklo_ps(l, r));
+				_mm_storeu_ps(output + 4, _mm_unpackhi_ps(l, r));
+			}
+		}
+		else if(4 == channelCount) {
+			const float *input [4] = { (const float *)src[0], (const float *)src[1], (const float *)src[2], (const float *)src[3] };
+			for(; frame + 4 <= frameCount; frame += 4, output += 16) {
+				__m128 a = _mm_loadu_ps(input[0] + frame);
+				__m128 b = _mm_loadu_ps(input[1] + frame);
+				__m128 c = _mm_loadu_ps(input[2] + frame);
+				__m128 d = _mm_loadu_ps(input[3] + frame);
+				_MM_TRANSPOSE4_PS(a, b, c, d);
+				_mm_storeu_ps(output, a);
+				_mm_storeu_ps(output + 4, b);
+				_mm_storeu_ps(output + 8, c);
+				_mm_storeu_ps(output + 12, d);
+			}
+		}
+
+		if(frame == frameCount)
+			return;
+
+		const T *remainder [channelCount];
+		for(uint32_t channel = 0; channel < channelCount; ++channel)
+			remainder[channel] = src[channel] + frame;
+		InterleaveScalar(remainder, dest + (frame * channelCount), channelCount, frameCount - frame);
+	}
+
+	void ConvertInt16ToFloatSSE2(const int16_t *src, float *dest, size_t count, float scale)
+	{
+		__m128 s = _mm_set1_ps(scale);
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8) {
+			__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+			// Sign extend by placing each sample in the high half of a 32-bit lane
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+			_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), s));
+			_mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), s));
+		}
+		ConvertInt16ToFloatScalar(src + i, dest + i, count - i, scale);
+	}
+
+	void ConvertInt32ToFloatSSE2(const int32_t *src, float *dest, size_t count, float scale)
+	{
+		__m128 s = _mm_set1_ps(scale);
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4)
+			_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(src + i))), s));
+		ConvertInt32ToFloatScalar(src + i, dest + i, count - i, scale);
+	}
+
+	void ConvertFloatToInt16SSE2(const float *src, int16_t *dest, size_t count, float scale)
+	{
+		__m128 s = _mm_set1_ps(scale);
+		__m128 minValue = _mm_set1_ps(-32768.f);
+		__m128 maxValue = _mm_set1_ps(32767.f);
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8) {
+			__m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), s);
+			__m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), s);
+			// Zero NaN lanes, which would otherwise clamp to the minimum
+			a = _mm_min_ps(_mm_max_ps(_mm_and_ps(a, _mm_cmpord_ps(a, a)), minValue), maxValue);
+			b = _mm_min_ps(_mm_max_ps(_mm_and_ps(b, _mm_cmpord_ps(b, b)), minValue), maxValue);
+			_mm_storeu_si128((__m128i *)(dest + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+		}
+		ConvertFloatToInt16Scalar(src + i, dest + i, count - i, scale);
+	}
+
+	void ConvertFloatToInt32SSE2(const float *src, int32_t *dest, size_t count, float scale)
+	{
+		__m128 s = _mm_set1_ps(scale);
+		__m128 minValue = _mm_set1_ps(-2147483648.f);
+		__m128 maxValue = _mm_set1_ps(kInt32MaximumFloat);
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4) {
+			__m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), s);
+			a = _mm_min_ps(_mm_max_ps(_mm_and_ps(a, _mm_cmpord_ps(a, a)), minValue), maxValue);
+			_mm_storeu_si128((__m128i *)(dest + i), _mm_cvtps_epi32(a));
+		}
+		ConvertFloatToInt32Scalar(src + i, dest + i, count - i, scale);
+	}
+
+	void ConvertFloatToDoubleSSE2(const float *src, double *dest, size_t count)
+	{
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4) {
+			__m128 x = _mm_loadu_ps(src + i);
+			_mm_storeu_pd(dest + i, _mm_cvtps_pd(x));
+			_mm_storeu_pd(dest + i + 2, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+		}
+		ConvertFloatToDoubleScalar(src + i, dest + i, count - i);
+	}
+
+	void ConvertDoubleToFloatSSE2(const double *src, float *dest, size_t count)
+	{
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4) {
+			__m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+			__m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+			_mm_storeu_ps(dest + i, _mm_movelh_ps(lo, hi));
+		}
+		ConvertDoubleToFloatScalar(src + i, dest + i, count - i);
+	}
+
+	void ShiftInt32SSE2(const int32_t *src, int32_t *dest, size_t count, uint32_t shift)
+	{
+		__m128i n = _mm_cvtsi32_si128((int)shift);
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4)
+			_mm_storeu_si128((__m128i *)(dest + i), _mm_sll_epi32(_mm_loadu_si128((const __m128i *)(src + i)), n));
+		ShiftInt32Scalar(src + i, dest + i, count - i, shift);
+	}
+
+	void ConvertInt32ToInt16SSE2(const int32_t *src, int16_t *dest, size_t count, uint32_t shift)
+	{
+		__m128i n = _mm_cvtsi32_si128((int)shift);
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8) {
+			__m128i a = _mm_sll_epi32(_mm_loadu_si128((const __m128i *)(src + i)), n);
+			__m128i b = _mm_sll_epi32(_mm_loadu_si128((const __m128i *)(src + i + 4)), n);
+			_mm_storeu_si128((__m128i *)(dest + i), _mm_packs_epi32(a, b));
+		}
+		ConvertInt32ToInt16Scalar(src + i, dest + i, count - i, shift);
+	}
+
+	void ScaleFloatSSE2(const float *src, float *dest, size_t count, float scale)
+	{
+		__m128 s = _mm_set1_ps(scale);
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4)
+			_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_loadu_ps(src + i), s));
+		ScaleFloatScalar(src + i, dest + i, count - i, scale);
+	}
+
+	void ClipFloatSSE2(const float *src, float *dest, size_t count, float minValue, float maxValue)
+	{
+		__m128 lo = _mm_set1_ps(minValue);
+		__m128 hi = _mm_set1_ps(maxValue);
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4) {
+			__m128 a = _mm_loadu_ps(src + i);
+			// Zero NaN lanes, which would otherwise clip to the minimum
+			_mm_storeu_ps(dest + i, _mm_min_ps(_mm_max_ps(_mm_and_ps(a, _mm_cmpord_ps(a, a)), lo), hi));
+		}
+		ClipFloatScalar(src + i, dest + i, count - i, minValue, maxValue);
+	}
+
+	KernelTable MakeSSE2KernelTable()
+	{
+		auto table = MakeScalarKernelTable();
+
+		table.mInstructionSet		= SampleKernelInstructionSet::SSE2;
+
+		table.mDeinterleaveFloat	= DeinterleaveSSE2<float>;
+		table.mDeinterleaveInt32	= DeinterleaveSSE2<int32_t>;
+		table.mInterleaveFloat		= InterleaveSSE2<float>;
+		table.mInterleaveInt32		= InterleaveSSE2<int32_t>;
+
+		table.mConvertInt16ToFloat	= ConvertInt16ToFloatSSE2;
+		table.mConvertInt32ToFloat	= ConvertInt32ToFloatSSE2;
+		table.mConvertFloatToInt16	= ConvertFloatToInt16SSE2;
+		table.mConvertFloatToInt32	= ConvertFloatToInt32SSE2;
+		table.mConvertFloatToDouble	= ConvertFloatToDoubleSSE2;
+		table.mConvertDoubleToFloat	= ConvertDoubleToFloatSSE2;
+
+		table.mShiftInt32			= ShiftInt32SSE2;
+		table.mConvertInt32ToInt16	= ConvertInt32ToInt16SSE2;
+
+		table.mScaleFloat			= ScaleFloatSSE2;
+		table.mClipFloat			= ClipFloatSSE2;
+
+		return table;
+	}
+
+#pragma mark AVX2 Kernels
+
+	template <typename T>
+	__attribute__ ((target("avx2"))) void DeinterleaveAVX2(const T *src, T * const *dest, uint32_t channelCount, size_t frameCount)
+	{
+		static_assert(4 == sizeof(T), "Only 32-bit samples are supported");
+
+		if(2 != channelCount)
+			return DeinterleaveSSE2(src, dest, channelCount, frameCount);
+
+		size_t frame = 0;
+		auto input = (const float *)src;
+		auto left = (float *)dest[0], right = (float *)dest[1];
+		for(; frame + 8 <= frameCount; frame += 8, input += 16) {
+			__m256 a = _mm256_loadu_ps(input);
+			__m256 b = _mm256_loadu_ps(input + 8);
+			// The shuffles operate within 128-bit lanes, leaving the 64-bit halves out of order
+			__m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			__m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			_mm256_storeu_ps(left + frame, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0))));
+			_mm256_storeu_ps(right + frame, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0))));
+		}
+
+		T *remainder [2] = { dest[0] + frame, dest[1] + frame };
+		DeinterleaveSSE2(src + (frame * 2), remainder, 2, frameCount - frame);
+	}
+
+	template <typename T>
+	__attribute__ ((target("avx2"))) void InterleaveAVX2(const T * const *src, T *dest, uint32_t channelCount, size_t frameCount)
+	{
+		static_assert(4 == sizeof(T), "Only 32-bit samples are supported");
+
+		if(2 != channelCount)
+			return InterleaveSSE2(src, dest, channelCount, frameCount);
+
+		size_t frame = 0;
+		auto output = (float *)dest;
+		auto left = (const float *)src[0], right = (const float *)src[1];
+		for(; frame + 8 <= frameCount; frame += 8, output += 16) {
+			__m256 l = _mm256_loadu_ps(left + frame);
+			__m256 r = _mm256_loadu_ps(right + frame);
+			__m256 lo = _mm256_unpacklo_ps(l, r);
+			__m256 hi = _mm256_unpackhi_ps(l, r);
+			_mm256_storeu_ps(output, _mm256_permute2f128_ps(lo, hi, 0x20));
+			_mm256_storeu_ps(output + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+		}
+
+		const T *remainder [2] = { src[0] + frame, src[1] + frame };
+		InterleaveSSE2(remainder, dest + (frame * 2), 2, frameCount - frame);
+	}
+
+	__attribute__ ((target("avx2"))) void ConvertInt16ToFloatAVX2(const int16_t *src, float *dest, size_t count, float scale)
+	{
+		__m256 s = _mm256_set1_ps(scale);
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8) {
+			__m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+			_mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), s));
+		}
+		ConvertInt16ToFloatScalar(src + i, dest + i, count - i, scale);
+	}
+
+	__attribute__ ((target("avx2"))) void ConvertInt32ToFloatAVX2(const int32_t *src, float *dest, size_t count, float scale)
+	{
+		__m256 s = _mm256_set1_ps(scale);
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8)
+			_mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)(src + i))), s));
+		ConvertInt32ToFloatScalar(src + i, dest + i, count - i, scale);
+	}
+
+	__attribute__ ((target("avx2"))) void ConvertFloatToInt16AVX2(const float *src, int16_t *dest, size_t count, float scale)
+	{
+		__m256 s = _mm256_set1_ps(scale);
+		__m256 minValue = _mm256_set1_ps(-32768.f);
+		__m256 maxValue = _mm256_set1_ps(32767.f);
+		size_t i = 0;
+		for(; i + 16 <= count; i += 16) {
+			__m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i), s);
+			__m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), s);
+			// Zero NaN lanes, which would otherwise clamp to the minimum
+			a = _mm256_min_ps(_mm256_max_ps(_mm256_and_ps(a, _mm256_cmp_ps(a, a, _CMP_ORD_Q)), minValue), maxValue);
+			b = _mm256_min_ps(_mm256_max_ps(_mm256_and_ps(b, _mm256_cmp_ps(b, b, _CMP_ORD_Q)), minValue), maxValue);
+			// The pack operates within 128-bit lanes
+			__m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+			_mm256_storeu_si256((__m256i *)(dest + i), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+		}
+		ConvertFloatToInt16Scalar(src + i, dest + i, count - i, scale);
+	}
+
+	__attribute__ ((target("avx2"))) void ConvertFloatToInt32AVX2(const float *src, int32_t *dest, size_t count, float scale)
+	{
+		__m256 s = _mm256_set1_ps(scale);
+		__m256 minValue = _mm256_set1_ps(-2147483648.f);
+		__m256 maxValue = _mm256_set1_ps(kInt32MaximumFloat);
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8) {
+			__m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i), s);
+			a = _mm256_min_ps(_mm256_max_ps(_mm256_and_ps(a, _mm256_cmp_ps(a, a, _CMP_ORD_Q)), minValue), maxValue);
+			_mm256_storeu_si256((__m256i *)(dest + i), _mm256_cvtps_epi32(a));
+		}
+		ConvertFloatToInt32Scalar(src + i, dest + i, count - i, scale);
+	}
+
+	__attribute__ ((target("avx2"))) void ConvertFloatToDoubleAVX2(const float *src, double *dest, size_t count)
+	{
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4)
+			_mm256_storeu_pd(dest + i, _mm256_cvtps_pd(_mm_loadu_ps(src + i)));
+		ConvertFloatToDoubleScalar(src + i, dest + i, count - i);
+	}
+
+	__attribute__ ((target("avx2"))) void ConvertDoubleToFloatAVX2(const double *src, float *dest, size_t count)
+	{
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4)
+			_mm_storeu_ps(dest + i, _mm256_cvtpd_ps(_mm256_loadu_pd(src + i)));
+		ConvertDoubleToFloatScalar(src + i, dest + i, count - i);
+	}
+
+	__attribute__ ((target("avx2"))) void ShiftInt32AVX2(const int32_t *src, int32_t *dest, size_t count, uint32_t shift)
+	{
+		__m128i n = _mm_cvtsi32_si128((int)shift);
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8)
+			_mm256_storeu_si256((__m256i *)(dest + i), _mm256_sll_epi32(_mm256_loadu_si256((const __m256i *)(src + i)), n));
+		ShiftInt32Scalar(src + i, dest + i, count - i, shift);
+	}
+
+	__attribute__ ((target("avx2"))) void ConvertInt32ToInt16AVX2(const int32_t *src, int16_t *dest, size_t count, uint32_t shift)
+	{
+		__m128i n = _mm_cvtsi32_si128((int)shift);
+		size_t i = 0;
+		for(; i + 16 <= count; i += 16) {
+			__m256i a = _mm256_sll_epi32(_mm256_loadu_si256((const __m256i *)(src + i)), n);
+			__m256i b = _mm256_sll_epi32(_mm256_loadu_si256((const __m256i *)(src + i + 8)), n);
+			_mm256_storeu_si256((__m256i *)(dest + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0)));
+		}
+		ConvertInt32ToInt16Scalar(src + i, dest + i, count - i, shift);
+	}
+
+	__attribute__ ((target("avx2"))) void ScaleFloatAVX2(const float *src, float *dest, size_t count, float scale)
+	{
+		__m256 s = _mm256_set1_ps(scale);
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8)
+			_mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), s));
+		ScaleFloatScalar(src + i, dest + i, count - i, scale);
+	}
+
+	__attribute__ ((target("avx2"))) void ClipFloatAVX2(const float *src, float *dest, size_t count, float minValue, float maxValue)
+	{
+		__m256 lo = _mm256_set1_ps(minValue);
+		__m256 hi = _mm256_set1_ps(maxValue);
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8) {
+			__m256 a = _mm256_loadu_ps(src + i);
+			// Zero NaN lanes, which would otherwise clip to the minimum
+			_mm256_storeu_ps(dest + i, _mm256_min_ps(_mm256_max_ps(_mm256_and_ps(a, _mm256_cmp_ps(a, a, _CMP_ORD_Q)), lo), hi));
+		}
+		ClipFloatScalar(src + i, dest + i, count - i, minValue, maxValue);
+	}
+
+	KernelTable MakeAVX2KernelTable()
+	{
+		auto table = MakeSSE2KernelTable();
+
+		table.mInstructionSet		= SampleKernelInstructionSet::AVX2;
+
+		table.mDeinterleaveFloat	= DeinterleaveAVX2<float>;
+		table.mDeinterleaveInt32	= DeinterleaveAVX2<int32_t>;
+		table.mInterleaveFloat		= InterleaveAVX2<float>;
+		table.mInterleaveInt32		= InterleaveAVX2<int32_t>;
+
+		table.mConvertInt16ToFloat	= ConvertInt16ToFloatAVX2;
+		table.mConvertInt32ToFloat	= ConvertInt32ToFloatAVX2;
+		table.mConvertFloatToInt16	= ConvertFloatToInt16AVX2;
+		table.mConvertFloatToInt32	= ConvertFloatToInt32AVX2;
+		table.mConvertFloatToDouble	= ConvertFloatToDoubleAVX2;
+		table.mConvertDoubleToFloat	= ConvertDoubleToFloatAVX2;
+
+		table.mShiftInt32			= ShiftInt32AVX2;
+		table.mConvertInt32ToInt16	= ConvertInt32ToInt16AVX2;
+
+		table.mScaleFloat			= ScaleFloatAVX2;
+		table.mClipFloat			= ClipFloatAVX2;
+
+		return table;
+	}
+
+#pragma mark AVX-512 Kernels
+
+	template <typename T>
+	__attribute__ ((target("avx512f"))) void DeinterleaveAVX512(const T *src, T * const *dest, uint32_t channelCount, size_t frameCount)
+	{
+		static_assert(4 == sizeof(T), "Only 32-bit samples are supported");
+
+		if(2 != channelCount)
+			return DeinterleaveSSE2(src, dest, channelCount, frameCount);
+
+		const __m512i leftIndexes = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+		const __m512i rightIndexes = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+
+		size_t frame = 0;
+		auto input = (const float *)src;
+		auto left = (float *)dest[0], right = (float *)dest[1];
+		for(; frame + 16 <= frameCount; frame += 16, input += 32) {
+			__m512 a = _mm512_loadu_ps(input);
+			__m512 b = _mm512_loadu_ps(input + 16);
+			_mm512_storeu_ps(left + frame, _mm512_permutex2var_ps(a, leftIndexes, b));
+			_mm512_storeu_ps(right + frame, _mm512_permutex2var_ps(a, rightIndexes, b));
+		}
+
+		T *remainder [2] = { dest[0] + frame, dest[1] + frame };
+		DeinterleaveSSE2(src + (frame * 2), remainder, 2, frameCount - frame);
+	}
+
+	template <typename T>
+	__attribute__ ((target("avx512f"))) void InterleaveAVX512(const T * const *src, T *dest, uint32_t channelCount, size_t frameCount)
+	{
+		static_assert(4 == sizeof(T), "Only 32-bit samples are supported");
+
+		if(2 != channelCount)
+			return InterleaveSSE2(src, dest, channelCount, frameCount);
+
+		const __m512i lowIndexes = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+		const __m512i highIndexes = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+
+		size_t frame = 0;
+		auto output = (float *)dest;
+		auto left = (const float *)src[0], right = (const float *)src[1];
+		for(; frame + 16 <= frameCount; frame += 16, output += 32) {
+			__m512 l = _mm512_loadu_ps(left + frame);
+			__m512 r = _mm512_loadu_ps(right + frame);
+			_mm512_storeu_ps(output, _mm512_permutex2var_ps(l, lowIndexes, r));
+			_mm512_storeu_ps(output + 16, _mm512_permutex2var_ps(l, highIndexes, r));
+		}
+
+		const T *remainder [2] = { src[0] + frame, src[1] + frame };
+		InterleaveSSE2(remainder, dest + (frame * 2), 2, frameCount - frame);
+	}
+
+	__attribute__ ((target("avx512f"))) void ConvertInt16ToFloatAVX512(const int16_t *src, float *dest, size_t count, float scale)
+	{
+		__m512 s = _mm512_set1_ps(scale);
+		size_t i = 0;
+		for(; i + 16 <= count; i += 16) {
+			__m512i x = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *)(src + i)));
+			_mm512_storeu_ps(dest + i, _mm512_mul_ps(_mm512_cvtepi32_ps(x), s));
+		}
+		ConvertInt16ToFloatScalar(src + i, dest + i, count - i, scale);
+	}
+
+	__attribute__ ((target("avx512f"))) void ConvertInt32ToFloatAVX512(const int32_t *src, float *dest, size_t count, float scale)
+	{
+		__m512 s = _mm512_set1_ps(scale);
+		size_t i = 0;
+		for(; i + 16 <= count; i += 16)
+			_mm512_storeu_ps(dest + i, _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_loadu_si512(src + i)), s));
+		ConvertInt32ToFloatScalar(src + i, dest + i, count - i, scale);
+	}
+
+	__attribute__ ((target("avx512f"))) void ConvertFloatToInt16AVX512(const float *src, int16_t *dest, size_t count, float scale)
+	{
+		__m512 s = _mm512_set1_ps(scale);
+		__m512 minValue = _mm512_set1_ps(-32768.f);
+		__m512 maxValue = _mm512_set1_ps(32767.f);
+		size_t i = 0;
+		for(; i + 16 <= count; i += 16) {
+			__m512 a = _mm512_mul_ps(_mm512_loadu_ps(src + i), s);
+			// Zero NaN lanes, which would otherwise clamp to the minimum
+			a = _mm512_min_ps(_mm512_max_ps(_mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a, a, _CMP_ORD_Q), a), minValue), maxValue);
+			_mm256_storeu_si256((__m256i *)(dest + i), _mm512_cvtsepi32_epi16(_mm512_cvtps_epi32(a)));
+		}
+		ConvertFloatToInt16Scalar(src + i, dest + i, count - i, scale);
+	}
+
+	__attribute__ ((target("avx512f"))) void ConvertFloatToInt32AVX512(const float *src, int32_t *dest, size_t count, float scale)
+	{
+		__m512 s = _mm512_set1_ps(scale);
+		__m512 minValue = _mm512_set1_ps(-2147483648.f);
+		__m512 maxValue = _mm512_set1_ps(kInt32MaximumFloat);
+		size_t i = 0;
+		for(; i + 16 <= count; i += 16) {
+			__m512 a = _mm512_mul_ps(_mm512_loadu_ps(src + i), s);
+			a = _mm512_min_ps(_mm512_max_ps(_mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a, a, _CMP_ORD_Q), a), minValue), maxValue);
+			_mm512_storeu_si512(dest + i, _mm512_cvtps_epi32(a));
+		}
+		ConvertFloatToInt32Scalar(src + i, dest + i, count - i, scale);
+	}
+
+	__attribute__ ((target("avx512f"))) void ConvertFloatToDoubleAVX512(const float *src, double *dest, size_t count)
+	{
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8)
+			_mm512_storeu_pd(dest + i, _mm512_cvtps_pd(_mm256_loadu_ps(src + i)));
+		ConvertFloatToDoubleScalar(src + i, dest + i, count - i);
+	}
+
+	__attribute__ ((target("avx512f"))) void ConvertDoubleToFloatAVX512(const double *src, float *dest, size_t count)
+	{
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8)
+			_mm256_storeu_ps(dest + i, _mm512_cvtpd_ps(_mm512_loadu_pd(src + i)));
+		ConvertDoubleToFloatScalar(src + i, dest + i, count - i);
+	}
+
+	__attribute__ ((target("avx512f"))) void ShiftInt32AVX512(const int32_t *src, int32_t *dest, size_t count, uint32_t shift)
+	{
+		__m128i n = _mm_cvtsi32_si128((int)shift);
+		size_t i = 0;
+		for(; i + 16 <= count; i += 16)
+			_mm512_storeu_si512(dest + i, _mm512_sll_epi32(_mm512_loadu_si512(src + i), n));
+		ShiftInt32Scalar(src + i, dest + i, count - i, shift);
+	}
+
+	__attribute__ ((target("avx512f"))) void ConvertInt32ToInt16AVX512(const int32_t *src, int16_t *dest, size_t count, uint32_t shift)
+	{
+		__m128i n = _mm_cvtsi32_si128((int)shift);
+		size_t i = 0;
+		for(; i + 16 <= count; i += 16)
+			_mm256_storeu_si256((__m256i *)(dest + i), _mm512_cvtsepi32_epi16(_mm512_sll_epi32(_mm512_loadu_si512(src + i), n)));
+		ConvertInt32ToInt16Scalar(src + i, dest + i, count - i, shift);
+	}
+
+	__attribute__ ((target("avx512f"))) void ScaleFloatAVX512(const float *src, float *dest, size_t count, float scale)
+	{
+		__m512 s = _mm512_set1_ps(scale);
+		size_t i = 0;
+		for(; i + 16 <= count; i += 16)
+			_mm512_storeu_ps(dest + i, _mm512_mul_ps(_mm512_loadu_ps(src + i), s));
+		ScaleFloatScalar(src + i, dest + i, count - i, scale);
+	}
+
+	__attribute__ ((target("avx512f"))) void ClipFloatAVX512(const float *src, float *dest, size_t count, float minValue, float maxValue)
+	{
+		__m512 lo = _mm512_set1_ps(minValue);
+		__m512 hi = _mm512_set1_ps(maxValue);
+		size_t i = 0;
+		for(; i + 16 <= count; i += 16) {
+			__m512 a = _mm512_loadu_ps(src + i);
+			// Zero NaN lanes, which would otherwise clip to the minimum
+			_mm512_storeu_ps(dest + i, _mm512_min_ps(_mm512_max_ps(_mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a, a, _CMP_ORD_Q), a), lo), hi));
+		}
+		ClipFloatScalar(src + i, dest + i, count - i, minValue, maxValue);
+	}
+
+	KernelTable MakeAVX512KernelTable()
+	{
+		auto table = MakeAVX2KernelTable();
+
+		table.mInstructionSet		= SampleKernelInstructionSet::AVX512;
+
+		table.mDeinterleaveFloat	= DeinterleaveAVX512<float>;
+		table.mDeinterleaveInt32	= DeinterleaveAVX512<int32_t>;
+		table.mInterleaveFloat		= InterleaveAVX512<float>;
+		table.mInterleaveInt32		= InterleaveAVX512<int32_t>;
+
+		table.mConvertInt16ToFloat	= ConvertInt16ToFloatAVX512;
+		table.mConvertInt32ToFloat	= ConvertInt32ToFloatAVX512;
+		table.mConvertFloatToInt16	= ConvertFloatToInt16AVX512;
+		table.mConvertFloatToInt32	= ConvertFloatToInt32AVX512;
+		table.mConvertFloatToDouble	= ConvertFloatToDoubleAVX512;
+		table.mConvertDoubleToFloat	= ConvertDoubleToFloatAVX512;
+
+		table.mShiftInt32			= ShiftInt32AVX512;
+		table.mConvertInt32ToInt16	= ConvertInt32ToInt16AVX512;
+
+		table.mScaleFloat			= ScaleFloatAVX512;
+		table.mClipFloat			= ClipFloatAVX512;
+
+		return table;
+	}
+
+	bool ProcessorSupports(SampleKernelInstructionSet instructionSet)
+	{
+		switch(instructionSet) {
+			case SampleKernelInstructionSet::Scalar:
+			case SampleKernelInstructionSet::SSE2:
+				return true;
+
+#if __APPLE__
+			// The kernel reports features only if the OS saves the corresponding register state
+			case SampleKernelInstructionSet::AVX2:
+			case SampleKernelInstructionSet::AVX512:
+			{
+				const char *name = SampleKernelInstructionSet::AVX2 == instructionSet ? "hw.optional.avx2_0" : "hw.optional.avx512f";
+				int value = 0;
+				size_t size = sizeof(value);
+				return 0 == sysctlbyname(name, &value, &size, nullptr, 0) && value;
+			}
+#else
+			case SampleKernelInstructionSet::AVX2:
+				return __builtin_cpu_supports("avx2");
+			case SampleKernelInstructionSet::AVX512:
+				return __builtin_cpu_supports("avx512f");
+#endif
+
+			default:
+				return false;
+		}
+	}
+
+#elif __aarch64__ && __ARM_NEON
+
+#pragma mark NEON Kernels
+
+	template <typename T>
+	void DeinterleaveNEON(const T *src, T * const *dest, uint32_t channelCount, size_t frameCount)
+	{
+		static_assert(4 == sizeof(T), "Only 32-bit samples are supported");
+
+		size_t frame = 0;
+		auto input = (const uint32_t *)src;
+
+		switch(channelCount) {
+			case 2:
+			{
+				uint32_t *output [2] = { (uint32_t *)dest[0], (uint32_t *)dest[1] };
+				for(; frame + 4 <= frameCount; frame += 4, input += 8) {
+					uint32x4x2_t x = vld2q_u32(input);
+					vst1q_u32(output[0] + frame, x.val[0]);
+					vst1q_u32(output[1] + frame, x.val[1]);
+				}
+				break;
+			}
+
+			case 3:
+			{
+				uint32_t *output [3] = { (uint32_t *)dest[0], (uint32_t *)dest[1], (uint32_t *)dest[2] };
+				for(; frame + 4 <= frameCount; frame += 4, input += 12) {
+					uint32x4x3_t x = vld3q_u32(input);
+					vst1q_u32(output[0] + frame, x.val[0]);
+					vst1q_u32(output[1] + frame, x.val[1]);
+					vst1q_u32(output[2] + frame, x.val[2]);
+				}
+				break;
+			}
+
+			case 4:
+			{
+				uint32_t *output [4] = { (uint32_t *)dest[0], (uint32_t *)dest[1], (uint32_t *)dest[2], (uint32_t *)dest[3] };
+				for(; frame + 4 <= frameCount; frame += 4, input += 16) {
+					uint32x4x4_t x = vld4q_u32(input);
+					vst1q_u32(output[0] + frame, x.val[0]);
+					vst1q_u32(output[1] + frame, x.val[1]);
+					vst1q_u32(output[2] + frame, x.val[2]);
+					vst1q_u32(output[3] + frame, x.val[3]);
+				}
+				break;
+			}
+		}
+
+		if(frame == frameCount)
+			return;
+
+		// Handle the remaining frames and unspecialized channel counts
+		T *remainder [channelCount];
+		for(uint32_t channel = 0; channel < channelCount; ++channel)
+			remainder[channel] = dest[channel] + frame;
+		DeinterleaveScalar(src + (frame * channelCount), remainder, channelCount, frameCount - frame);
+	}
+
+	template <typename T>
+	void InterleaveNEON(const T * const *src, T *dest, uint32_t channelCount, size_t frameCount)
+	{
+		static_assert(4 == sizeof(T), "Only 32-bit samples are supported");
+
+		size_t frame = 0;
+		auto output = (uint32_t *)dest;
+
+		switch(channelCount) {
+			case 2:
+			{
+				const uint32_t *input [2] = { (const uint32_t *)src[0], (const uint32_t *)src[1] };
+				for(; frame + 4 <= frameCount; frame += 4, output += 8) {
+					uint32x4x2_t x = { { vld1q_u32(input[0] + frame), vld1q_u32(input[1] + frame) } };
+					vst2q_u32(output, x);
+				}
+				break;
+			}
+
+			case 3:
+			{
+				const uint32_t *input [3] = { (const uint32_t *)src[0], (const uint32_t *)src[1], (const uint32_t *)src[2] };
+				for(; frame + 4 <= frameCount; frame += 4, output += 12) {
+					uint32x4x3_t x = { { vld1q_u32(input[0] + frame), vld1q_u32(input[1] + frame), vld1q_u32(input[2] + frame) } };
+					vst3q_u32(output, x);
+				}
+				break;
+			}
+
+			case 4:
+			{
+				const uint32_t *input [4] = { (const uint32_t *)src[0], (const uint32_t *)src[1], (const uint32_t *)src[2], (const uint32_t *)src[3] };
+				for(; frame + 4 <= frameCount; frame += 4, output += 16) {
+					uint32x4x4_t x = { { vld1q_u32(input[0] + frame), vld1q_u32(input[1] + frame), vld1q_u32(input[2] + frame), vld1q_u32(input[3] + frame) } };
+					vst4q_u32(output, x);
+				}
+				break;
+			}
+		}
+
+		if(frame == frameCount)
+			return;
+
+		const T *remainder [channelCount];
+		for(uint32_t channel = 0; channel < channelCount; ++channel)
+			remainder[channel] = src[channel] + frame;
+		InterleaveScalar(remainder, dest + (frame * channelCount), channelCount, frameCount - frame);
+	}
+
+	void ConvertInt16ToFloatNEON(const int16_t *src, float *dest, size_t count, float scale)
+	{
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8) {
+			int16x8_t x = vld1q_s16(src + i);
+			vst1q_f32(dest + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), scale));
+			vst1q_f32(dest + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_high_s16(x)), scale));
+		}
+		ConvertInt16ToFloatScalar(src + i, dest + i, count - i, scale);
+	}
+
+	void ConvertInt32ToFloatNEON(const int32_t *src, float *dest, size_t count, float scale)
+	{
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4)
+			vst1q_f32(dest + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src + i)), scale));
+		ConvertInt32ToFloatScalar(src + i, dest + i, count - i, scale);
+	}
+
+	void ConvertFloatToInt16NEON(const float *src, int16_t *dest, size_t count, float scale)
+	{
+		float32x4_t minValue = vdupq_n_f32(-32768.f);
+		float32x4_t maxValue = vdupq_n_f32(32767.f);
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8) {
+			float32x4_t a = vmulq_n_f32(vld1q_f32(src + i), scale);
+			float32x4_t b = vmulq_n_f32(vld1q_f32(src + i + 4), scale);
+			// Zero NaN lanes
+			a = vminq_f32(vmaxq_f32(vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vceqq_f32(a, a))), minValue), maxValue);
+			b = vminq_f32(vmaxq_f32(vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(b), vceqq_f32(b, b))), minValue), maxValue);
+			vst1q_s16(dest + i, vqmovn_high_s32(vqmovn_s32(vcvtnq_s32_f32(a)), vcvtnq_s32_f32(b)));
+		}
+		ConvertFloatToInt16Scalar(src + i, dest + i, count - i, scale);
+	}
+
+	void ConvertFloatToInt32NEON(const float *src, int32_t *dest, size_t count, float scale)
+	{
+		float32x4_t minValue = vdupq_n_f32(-2147483648.f);
+		float32x4_t maxValue = vdupq_n_f32(kInt32MaximumFloat);
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4) {
+			float32x4_t a = vmulq_n_f32(vld1q_f32(src + i), scale);
+			a = vminq_f32(vmaxq_f32(vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vceqq_f32(a, a))), minValue), maxValue);
+			vst1q_s32(dest + i, vcvtnq_s32_f32(a));
+		}
+		ConvertFloatToInt32Scalar(src + i, dest + i, count - i, scale);
+	}
+
+	void ConvertFloatToDoubleNEON(const float *src, double *dest, size_t count)
+	{
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4) {
+			float32x4_t x = vld1q_f32(src + i);
+			vst1q_f64(dest + i, vcvt_f64_f32(vget_low_f32(x)));
+			vst1q_f64(dest + i + 2, vcvt_high_f64_f32(x));
+		}
+		ConvertFloatToDoubleScalar(src + i, dest + i, count - i);
+	}
+
+	void ConvertDoubleToFloatNEON(const double *src, float *dest, size_t count)
+	{
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4)
+			vst1q_f32(dest + i, vcvt_high_f32_f64(vcvt_f32_f64(vld1q_f64(src + i)), vld1q_f64(src + i + 2)));
+		ConvertDoubleToFloatScalar(src + i, dest + i, count - i);
+	}
+
+	void ShiftInt32NEON(const int32_t *src, int32_t *dest, size_t count, uint32_t shift)
+	{
+		int32x4_t n = vdupq_n_s32((int32_t)shift);
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4)
+			vst1q_s32(dest + i, vshlq_s32(vld1q_s32(src + i), n));
+		ShiftInt32Scalar(src + i, dest + i, count - i, shift);
+	}
+
+	void ConvertInt32ToInt16NEON(const int32_t *src, int16_t *dest, size_t count, uint32_t shift)
+	{
+		int32x4_t n = vdupq_n_s32((int32_t)shift);
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8) {
+			int32x4_t a = vshlq_s32(vld1q_s32(src + i), n);
+			int32x4_t b = vshlq_s32(vld1q_s32(src + i + 4), n);
+			vst1q_s16(dest + i, vqmovn_high_s32(vqmovn_s32(a), b));
+		}
+		ConvertInt32ToInt16Scalar(src + i, dest + i, count - i, shift);
+	}
+
+	void ScaleFloatNEON(const float *src, float *dest, size_t count, float scale)
+	{
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4)
+			vst1q_f32(dest + i, vmulq_n_f32(vld1q_f32(src + i), scale));
+		ScaleFloatScalar(src + i, dest + i, count - i, scale);
+	}
+
+	void ClipFloatNEON(const float *src, float *dest, size_t count, float minValue, float maxValue)
+	{
+		float32x4_t lo = vdupq_n_f32(minValue);
+		float32x4_t hi = vdupq_n_f32(maxValue);
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4) {
+			float32x4_t a = vld1q_f32(src + i);
+			// Zero NaN lanes
+			vst1q_f32(dest + i, vminq_f32(vmaxq_f32(vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vceqq_f32(a, a))), lo), hi));
+		}
+		ClipFloatScalar(src + i, dest + i, count - i, minValue, maxValue);
+	}
+
+	KernelTable MakeNEONKernelTable()
+	{
+		auto table = MakeScalarKernelTable();
+
+		table.mInstructionSet		= SampleKernelInstructionSet::NEON;
+
+		table.mDeinterleaveFloat	= DeinterleaveNEON<float>;
+		table.mDeinterleaveInt32	= DeinterleaveNEON<int32_t>;
+		table.mInterleaveFloat		= InterleaveNEON<float>;
+		table.mInterleaveInt32		= InterleaveNEON<int32_t>;
+
+		table.mConvertInt16ToFloat	= ConvertInt16ToFloatNEON;
+		table.mConvertInt32ToFloat	= ConvertInt32ToFloatNEON;
+		table.mConvertFloatToInt16	= ConvertFloatToInt16NEON;
+		table.mConvertFloatToInt32	= ConvertFloatToInt32NEON;
+		table.mConvertFloatToDouble	= ConvertFloatToDoubleNEON;
+		table.mConvertDoubleToFloat	= ConvertDoubleToFloatNEON;
+
+		table.mShiftInt32			= ShiftInt32NEON;
+		table.mConvertInt32ToInt16	= ConvertInt32ToInt16NEON;
+
+		table.mScaleFloat			= ScaleFloatNEON;
+		table.mClipFloat			= ClipFloatNEON;
+
+		return table;
+	}
+
+	bool ProcessorSupports(SampleKernelInstructionSet instructionSet)
+	{
+		// Advanced SIMD is part of the ARMv8 baseline
+		return SampleKernelInstructionSet::Scalar == instructionSet || SampleKernelInstructionSet::NEON == instructionSet;
+	}
+
+#else
+
+	bool ProcessorSupports(SampleKernelInstructionSet instructionSet)
+	{
+		return SampleKernelInstructionSet::Scalar == instructionSet;
+	}
+
+#endif
+
+#pragma mark Dispatch
+
+	// Returns the kernels for instructionSet, which must be supported by the processor
+	const KernelTable * GetKernelTable(SampleKernelInstructionSet instructionSet)
+	{
+		switch(instructionSet) {
+#if __x86_64__
+			case SampleKernelInstructionSet::SSE2:		{ static const KernelTable sTable = MakeSSE2KernelTable();		return &sTable; }
+			case SampleKernelInstructionSet::AVX2:		{ static const KernelTable sTable = MakeAVX2KernelTable();		return &sTable; }
+			case SampleKernelInstructionSet::AVX512:	{ static const KernelTable sTable = MakeAVX512KernelTable();	return &sTable; }
+#elif __aarch64__ && __ARM_NEON
+			case SampleKernelInstructionSet::NEON:		{ static const KernelTable sTable = MakeNEONKernelTable();		return &sTable; }
+#endif
+			default:									{ static const KernelTable sTable = MakeScalarKernelTable();	return &sTable; }
+		}
+	}
+
+	// The kernels in use, selected on first use
+	std::atomic<const KernelTable *> sKernels = ATOMIC_VAR_INIT(nullptr);
+
+	const KernelTable& Kernels()
+	{
+		auto kernels = sKernels.load(std::memory_order_acquire);
+		if(kernels)
+			return *kernels;
+
+		// Select the best supported instruction set
+		const SampleKernelInstructionSet preferredInstructionSets [] = {
+			SampleKernelInstructionSet::AVX512,
+			SampleKernelInstructionSet::AVX2,
+			SampleKernelInstructionSet::SSE2,
+			SampleKernelInstructionSet::NEON,
+			SampleKernelInstructionSet::Scalar
+		};
+
+		for(auto instructionSet : preferredInstructionSets) {
+			if(ProcessorSupports(instructionSet)) {
+				kernels = GetKernelTable(instructionSet);
+				break;
+			}
+		}
+
+		// Another thread may have selected the same kernels in the meantime, which is harmless
+		sKernels.store(kernels, std::memory_order_release);
+
+		return *kernels;
+	}
+
+}
+
+#pragma mark Instruction Sets
+
+SFB::Audio::SampleKernelInstructionSet SFB::Audio::GetSampleKernelInstructionSet()
+{
+	return Kernels().mInstructionSet;
+}
+
+bool SFB::Audio::SetSampleKernelInstructionSet(SampleKernelInstructionSet instructionSet)
+{
+	if(!ProcessorSupports(instructionSet)) {
+		LOGGER_NOTICE("org.sbooth.AudioEngine.SampleKernels", "Instruction set " << (int)instructionSet << " is not supported by this processor");
+		return false;
+	}
+
+	sKernels.store(GetKernelTable(instructionSet), std::memory_order_release);
+	return true;
+}
+
+#pragma mark Interleaving
+
+void SFB::Audio::DeinterleaveSamples(const float *src, float * const *dest, uint32_t channelCount, size_t frameCount)
+{
+	Kernels().mDeinterleaveFloat(src, dest, channelCount, frameCount);
+}
+
+void SFB::Audio::DeinterleaveSamples(const double *src, double * const *dest, uint32_t channelCount, size_t frameCount)
+{
+	DeinterleaveScalar(src, dest, channelCount, frameCount);
+}
+
+void SFB::Audio::DeinterleaveSamples(const int32_t *src, int32_t * const *dest, uint32_t channelCount, size_t frameCount)
+{
+	Kernels().mDeinterleaveInt32(src, dest, channelCount, frameCount);
+}
+
+void SFB::Audio::DeinterleaveSamples(const int16_t *src, int16_t * const *dest, uint32_t channelCount, size_t frameCount)
+{
+	DeinterleaveScalar(src, dest, channelCount, frameCount);
+}
+
+void SFB::Audio::DeinterleaveSamples(const uint8_t *src, uint8_t * const *dest, uint32_t channelCount, size_t frameCount)
+{
+	DeinterleaveScalar(src, dest, channelCount, frameCount);
+}
+
+void SFB::Audio::InterleaveSamples(const float * const *src, float *dest, uint32_t channelCount, size_t frameCount)
+{
+	Kernels().mInterleaveFloat(src, dest, channelCount, frameCount);
+}
+
+void SFB::Audio::InterleaveSamples(const double * const *src, double *dest, uint32_t channelCount, size_t frameCount)
+{
+	InterleaveScalar(src, dest, channelCount, frameCount);
+}
+
+void SFB::Audio::InterleaveSamples(const int32_t * const *src, int32_t *dest, uint32_t channelCount, size_t frameCount)
+{
+	Kernels().mInterleaveInt32(src, dest, channelCount, frameCount);
+}
+
+void SFB::Audio::InterleaveSamples(const int16_t * const *src, int16_t *dest, uint32_t channelCount, size_t frameCount)
+{
+	InterleaveScalar(src, dest, channelCount, frameCount);
+}
+
+void SFB::Audio::InterleaveSamples(const uint8_t * const *src, uint8_t *dest, uint32_t channelCount, size_t frameCount)
+{
+	InterleaveScalar(src, dest, channelCount, frameCount);
+}
+
+#pragma mark Format Conversion
+
+void SFB::Audio::ConvertInt16ToFloat(const int16_t *src, float *dest, size_t count, float scale)
+{
+	Kernels().mConvertInt16ToFloat(src, dest, count, scale);
+}
+
+void SFB::Audio::ConvertInt24ToFloat(const uint8_t *src, float *dest, size_t count, float scale)
+{
+	for(size_t i = 0; i < count; ++i, src += 3) {
+		// Place the sample in the high 24 bits and sign extend with an arithmetic shift
+#if __BIG_ENDIAN__
+		auto value = (int32_t)(((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 8));
+#else
+		auto value = (int32_t)(((uint32_t)src[2] << 24) | ((uint32_t)src[1] << 16) | ((uint32_t)src[0] << 8));
+#endif
+		dest[i] = (float)(value >> 8) * scale;
+	}
+}
+
+void SFB::Audio::ConvertInt32ToFloat(const int32_t *src, float *dest, size_t count, float scale)
+{
+	Kernels().mConvertInt32ToFloat(src, dest, count, scale);
+}
+
+void SFB::Audio::ConvertFloatToInt16(const float *src, int16_t *dest, size_t count, float scale)
+{
+	Kernels().mConvertFloatToInt16(src, dest, count, scale);
+}
+
+void SFB::Audio::ConvertFloatToInt32(const float *src, int32_t *dest, size_t count, float scale)
+{
+	Kernels().mConvertFloatToInt32(src, dest, count, scale);
+}
+
+void SFB::Audio::ConvertFloatToDouble(const float *src, double *dest, size_t count)
+{
+	Kernels().mConvertFloatToDouble(src, dest, count);
+}
+
+void SFB::Audio::ConvertDoubleToFloat(const double *src, float *dest, size_t count)
+{
+	Kernels().mConvertDoubleToFloat(src, dest, count);
+}
+
+void SFB::Audio::ShiftInt32Samples(const int32_t *src, int32_t *dest, size_t count, uint32_t shift)
+{
+	Kernels().mShiftInt32(src, dest, count, shift);
+}
+
+void SFB::Audio::ConvertInt32ToInt8(const int32_t *src, int8_t *dest, size_t count, uint32_t shift)
+{
+	for(size_t i = 0; i < count; ++i)
+		dest[i] = (int8_t)std::min(std::max((int32_t)((uint32_t)src[i] << shift), (int32_t)INT8_MIN), (int32_t)INT8_MAX);
+}
+
+void SFB::Audio::ConvertInt32ToInt16(const int32_t *src, int16_t *dest, size_t count, uint32_t shift)
+{
+	Kernels().mConvertInt32ToInt16(src, dest, count, shift);
+}
+
+void SFB::Audio::ConvertInt32ToInt24(const int32_t *src, uint8_t *dest, size_t count, uint32_t shift)
+{
+	for(size_t i = 0; i < count; ++i) {
+		auto value = (uint32_t)src[i] << shift;
+#if __BIG_ENDIAN__
+		*dest++ = (uint8_t)((value >> 16) & 0xff);
+		*dest++ = (uint8_t)((value >> 8) & 0xff);
+		*dest++ = (uint8_t)(value & 0xff);
+#else
+		*dest++ = (uint8_t)(value & 0xff);
+		*dest++ = (uint8_t)((value >> 8) & 0xff);
+		*dest++ = (uint8_t)((value >> 16) & 0xff);
+#endif
+	}
+}
+
+void SFB::Audio::ScaleFloatSamples(const float *src, float *dest, size_t count, float scale)
+{
+	Kernels().mScaleFloat(src, dest, count, scale);
+}
+
+void SFB::Audio::ClipFloatSamples(const float *src, float *dest, size_t count, float minValue, float maxValue)
+{
+	Kernels().mClipFloat(src, dest, count, minValue, maxValue);
+}
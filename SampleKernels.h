@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*! @file SampleKernels.h @brief Sample interleaving and format conversion kernels */
+
+/*! @brief \c SFBAudioEngine's encompassing namespace */
+namespace SFB {
+
+	/*! @brief %Audio functionality */
+	namespace Audio {
+
+		/*!
+		 * @brief The instruction sets used by the sample kernels
+		 *
+		 * The best instruction set supported by the processor is selected the first time a kernel is
+		 * called.  Kernels without a specialized implementation for the selected instruction set use
+		 * the next best one available.
+		 */
+		enum class SampleKernelInstructionSet {
+			Scalar,		/*!< Portable C++ */
+			SSE2,		/*!< x86-64 SSE2 */
+			AVX2,		/*!< x86-64 AVX2 */
+			AVX512,		/*!< x86-64 AVX-512 Foundation */
+			NEON		/*!< ARMv8 Advanced SIMD */
+		};
+
+		/*! @brief Get the instruction set used by the sample kernels */
+		SampleKernelInstructionSet GetSampleKernelInstructionSet();
+
+		/*!
+		 * @brief Set the instruction set used by the sample kernels
+		 * @note This is intended for testing and benchmarking
+		 * @param instructionSet The desired instruction set
+		 * @return \c true on success, \c false if \c instructionSet isn't supported by the processor
+		 */
+		bool SetSampleKernelInstructionSet(SampleKernelInstructionSet instructionSet);
+
+
+		// ========================================
+		/*!
+		 * @name Interleaving
+		 * Specialized implementations exist for 2 through 8 channels
+		 */
+		//@{
+
+		/*!
+		 * @brief Deinterleave samples
+		 * @param src The interleaved samples
+		 * @param dest An array of \c channelCount pointers to receive the samples for each channel
+		 * @param channelCount The number of channels in \c src
+		 * @param frameCount The number of frames to deinterleave
+		 */
+		void DeinterleaveSamples(const float *src, float * const *dest, uint32_t channelCount, size_t frameCount);
+
+		/*! @brief Deinterleave samples */
+		void DeinterleaveSamples(const double *src, double * const *dest, uint32_t channelCount, size_t frameCount);
+
+		/*! @brief Deinterleave samples */
+		void DeinterleaveSamples(const int32_t *src, int32_t * const *dest, uint32_t channelCount, size_t frameCount);
+
+		/*! @brief Deinterleave samples */
+		void DeinterleaveSamples(const int16_t *src, int16_t * const *dest, uint32_t channelCount, size_t frameCount);
+
+		/*! @brief Deinterleave samples */
+		void DeinterleaveSamples(const uint8_t *src, uint8_t * const *dest, uint32_t channelCount, size_t frameCount);
+
+		/*!
+		 * @brief Interleave samples
+		 * @param src An array of \c channelCount pointers to the samples for each channel
+		 * @param dest A buffer to receive the interleaved samples
+		 * @param channelCount The number of channels in \c src
+		 * @param frameCount The number of frames to interleave
+		 */
+		void InterleaveSamples(const float * const *src, float *dest, uint32_t channelCount, size_t frameCount);
+
+		/*! @brief Interleave samples */
+		void InterleaveSamples(const double * const *src, double *dest, uint32_t channelCount, size_t frameCount);
+
+		/*! @brief Interleave samples */
+		void InterleaveSamples(const int32_t * const *src, int32_t *dest, uint32_t channelCount, size_t frameCount);
+
+		/*! @brief Interleave samples */
+		void InterleaveSamples(const int16_t * const *src, int16_t *dest, uint32_t channelCount, size_t frameCount);
+
+		/*! @brief Interleave samples */
+		void InterleaveSamples(const uint8_t * const *src, uint8_t *dest, uint32_t channelCount, size_t frameCount);
+
+		//@}
+
+
+		// ========================================
+		/*!
+		 * @name Format conversion
+		 * Unless noted otherwise \c src and \c dest may be the same buffer but must not otherwise overlap
+		 */
+		//@{
+
+		/*!
+		 * @brief Convert 16-bit integer samples to float
+		 * @note \c src and \c dest must not overlap
+		 * @param src The samples to convert
+		 * @param dest A buffer to receive the converted samples
+		 * @param count The number of samples to convert
+		 * @param scale The value by which each converted sample is multiplied, normally \c 1 / 32768
+		 */
+		void ConvertInt16ToFloat(const int16_t *src, float *dest, size_t count, float scale);
+
+		/*!
+		 * @brief Convert packed native-endian 24-bit integer samples to float
+		 * @note \c src and \c dest must not overlap
+		 */
+		void ConvertInt24ToFloat(const uint8_t *src, float *dest, size_t count, float scale);
+
+		/*! @brief Convert 32-bit integer samples to float */
+		void ConvertInt32ToFloat(const int32_t *src, float *dest, size_t count, float scale);
+
+		/*!
+		 * @brief Convert float samples to 16-bit integers
+		 * @note Scaled samples are rounded to the nearest integer and clipped to the range of \c int16_t, and NaN converts to \c 0
+		 * @param src The samples to convert
+		 * @param dest A buffer to receive the converted samples
+		 * @param count The number of samples to convert
+		 * @param scale The value by which each sample is multiplied before conversion, normally \c 32768
+		 */
+		void ConvertFloatToInt16(const float *src, int16_t *dest, size_t count, float scale);
+
+		/*!
+		 * @brief Convert float samples to 32-bit integers
+		 * @note Scaled samples are rounded to the nearest integer and clipped to the range of \c int32_t, and NaN converts to \c 0
+		 */
+		void ConvertFloatToInt32(const float *src, int32_t *dest, size_t count, float scale);
+
+		/*!
+		 * @brief Convert float samples to double
+		 * @note \c src and \c dest must not overlap
+		 */
+		void ConvertFloatToDouble(const float *src, double *dest, size_t count);
+
+		/*! @brief Convert double samples to float */
+		void ConvertDoubleToFloat(const double *src, float *dest, size_t count);
+
+
+		/*!
+		 * @brief Shift 32-bit integer samples left, for example to convert low-aligned samples to high-aligned
+		 * @param src The samples to shift
+		 * @param dest A buffer to receive the shifted samples
+		 * @param count The number of samples to shift
+		 * @param shift The number of bits to shift each sample
+		 */
+		void ShiftInt32Samples(const int32_t *src, int32_t *dest, size_t count, uint32_t shift);
+
+		/*! @brief Shift 32-bit integer samples left and narrow them to 8 bits with saturation */
+		void ConvertInt32ToInt8(const int32_t *src, int8_t *dest, size_t count, uint32_t shift);
+
+		/*! @brief Shift 32-bit integer samples left and narrow them to 16 bits with saturation */
+		void ConvertInt32ToInt16(const int32_t *src, int16_t *dest, size_t count, uint32_t shift);
+
+		/*!
+		 * @brief Shift 32-bit integer samples left and pack the low 24 bits in native byte order
+		 * @note \c src and \c dest must not overlap
+		 */
+		void ConvertInt32ToInt24(const int32_t *src, uint8_t *dest, size_t count, uint32_t shift);
+
+
+		/*! @brief Multiply float samples by \c scale */
+		void ScaleFloatSamples(const float *src, float *dest, size_t count, float scale);
+
+		/*!
+		 * @brief Clip float samples to the range [\c minValue, \c maxValue]
+		 * @note NaN is treated as \c 0 before clipping
+		 */
+		void ClipFloatSamples(const float *src, float *dest, size_t count, float minValue, float maxValue);
+
+		//@}
+
+	}
+}
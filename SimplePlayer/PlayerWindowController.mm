@@ -49,12 +49,12 @@ enum ePlayerFlags : unsigned int {
 
 		_playerFlags = 0;
 
-		// This will be called from the realtime rendering thread and as such MUST NOT BLOCK!!
+		// This will be called from the player's event queue
 		_player->SetRenderingStartedBlock(^(const SFB::Audio::Decoder& /*decoder*/){
 			self->_playerFlags.fetch_or(ePlayerFlagRenderingStarted);
 		});
 
-		// This will be called from the realtime rendering thread and as such MUST NOT BLOCK!!
+		// This will be called from the player's event queue
 		_player->SetRenderingFinishedBlock(^(const SFB::Audio::Decoder& /*decoder*/){
 			self->_playerFlags.fetch_or(ePlayerFlagRenderingFinished);
 		});
@@ -65,7 +65,7 @@ enum ePlayerFlags : unsigned int {
 
 		dispatch_source_set_event_handler(_timer, ^{
 
-			// To avoid blocking the realtime rendering thread, flags are set in the callbacks and subsequently handled here
+			// Flags are set in the callbacks and subsequently handled here
 			auto flags = self->_playerFlags.load();
 
 			if(ePlayerFlagRenderingStarted & flags) {
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#if __APPLE__
+# include <mach/mach.h>
+# include <mach/mach_error.h>
+#endif
+
+#include "VirtualMemory.h"
+#include "Logger.h"
+
+namespace {
+
+	// The number of times to retry the mirrored mapping if another thread claims the address range
+	const int kMirroredMemoryAttempts = 3;
+
+}
+
+size_t SFB::GetPageSize()
+{
+	static const size_t sPageSize = (size_t)sysconf(_SC_PAGESIZE);
+	return sPageSize;
+}
+
+size_t SFB::RoundUpToPageSize(size_t byteCount)
+{
+	auto pageSize = GetPageSize();
+	return ((byteCount + pageSize - 1) / pageSize) * pageSize;
+}
+
+void * SFB::AllocatePages(size_t byteCount, bool useHugePages)
+{
+	if(0 == byteCount || byteCount % GetPageSize()) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.VirtualMemory", "AllocatePages() called with invalid parameters");
+		return nullptr;
+	}
+
+	void *memory = MAP_FAILED;
+
+	if(useHugePages && 0 == byteCount % kHugePageSize) {
+#if __APPLE__ && defined(VM_FLAGS_SUPERPAGE_SIZE_2MB)
+		memory = mmap(nullptr, byteCount, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+#elif __linux__ && defined(MAP_HUGETLB)
+		memory = mmap(nullptr, byteCount, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
+#endif
+		if(MAP_FAILED == memory)
+			LOGGER_INFO("org.sbooth.AudioEngine.VirtualMemory", "Huge pages unavailable for " << byteCount << " bytes: " << strerror(errno));
+	}
+
+	if(MAP_FAILED == memory) {
+		memory = mmap(nullptr, byteCount, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+		if(MAP_FAILED == memory) {
+			LOGGER_ERR("org.sbooth.AudioEngine.VirtualMemory", "mmap failed: " << strerror(errno));
+			return nullptr;
+		}
+
+#if __linux__ && defined(MADV_HUGEPAGE)
+		// Fall back to transparent huge pages
+		if(useHugePages && -1 == madvise(memory, byteCount, MADV_HUGEPAGE))
+			LOGGER_INFO("org.sbooth.AudioEngine.VirtualMemory", "madvise(MADV_HUGEPAGE) failed: " << strerror(errno));
+#endif
+	}
+
+	return memory;
+}
+
+void SFB::DeallocatePages(void *memory, size_t byteCount)
+{
+	if(nullptr == memory)
+		return;
+
+	if(-1 == munmap(memory, byteCount))
+		LOGGER_ERR("org.sbooth.AudioEngine.VirtualMemory", "munmap failed: " << strerror(errno));
+}
+
+bool SFB::LockMemory(void *memory, size_t byteCount)
+{
+	if(nullptr == memory || 0 == byteCount)
+		return false;
+
+	if(-1 == mlock(memory, byteCount)) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.VirtualMemory", "mlock failed for " << byteCount << " bytes: " << strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+void SFB::UnlockMemory(void *memory, size_t byteCount)
+{
+	if(nullptr == memory || 0 == byteCount)
+		return;
+
+	if(-1 == munlock(memory, byteCount))
+		LOGGER_WARNING("org.sbooth.AudioEngine.VirtualMemory", "munlock failed: " << strerror(errno));
+}
+
+#if __APPLE__
+
+void * SFB::AllocateMirroredMemory(size_t byteCount)
+{
+	if(0 == byteCount || byteCount % GetPageSize()) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.VirtualMemory", "AllocateMirroredMemory() called with invalid parameters");
+		return nullptr;
+	}
+
+	for(int attempt = 0; attempt < kMirroredMemoryAttempts; ++attempt) {
+		// Reserve the full range so the mirror can be placed directly after the original pages
+		vm_address_t address;
+		kern_return_t result = vm_allocate(mach_task_self(), &address, byteCount * 2, VM_FLAGS_ANYWHERE);
+		if(KERN_SUCCESS != result) {
+			LOGGER_ERR("org.sbooth.AudioEngine.VirtualMemory", "vm_allocate failed: " << mach_error_string(result));
+			return nullptr;
+		}
+
+		// Release the second half and map the first half into it
+		result = vm_deallocate(mach_task_self(), address + byteCount, byteCount);
+		if(KERN_SUCCESS != result) {
+			LOGGER_ERR("org.sbooth.AudioEngine.VirtualMemory", "vm_deallocate failed: " << mach_error_string(result));
+			vm_deallocate(mach_task_self(), address, byteCount);
+			return nullptr;
+		}
+
+		vm_address_t mirrorAddress = address + byteCount;
+		vm_prot_t currentProtection, maxProtection;
+		result = vm_remap(mach_task_self(), &mirrorAddress, byteCount, 0, VM_FLAGS_FIXED, mach_task_self(), address, false, &currentProtection, &maxProtection, VM_INHERIT_DEFAULT);
+
+		if(KERN_SUCCESS == result && mirrorAddress == address + byteCount)
+			return (void *)address;
+
+		// Another thread may have claimed the second half in the meantime
+		if(KERN_SUCCESS == result)
+			vm_deallocate(mach_task_self(), mirrorAddress, byteCount);
+		vm_deallocate(mach_task_self(), address, byteCount);
+	}
+
+	LOGGER_ERR("org.sbooth.AudioEngine.VirtualMemory", "Unable to create mirrored mapping of " << byteCount << " bytes");
+
+	return nullptr;
+}
+
+void SFB::DeallocateMirroredMemory(void *memory, size_t byteCount)
+{
+	if(nullptr == memory)
+		return;
+
+	kern_return_t result = vm_deallocate(mach_task_self(), (vm_address_t)memory, byteCount * 2);
+	if(KERN_SUCCESS != result)
+		LOGGER_ERR("org.sbooth.AudioEngine.VirtualMemory", "vm_deallocate failed: " << mach_error_string(result));
+}
+
+#elif __linux__
+
+void * SFB::AllocateMirroredMemory(size_t byteCount)
+{
+	if(0 == byteCount || byteCount % GetPageSize()) {
+		LOGGER_WARNING("org.sbooth.AudioEngine.VirtualMemory", "AllocateMirroredMemory() called with invalid parameters");
+		return nullptr;
+	}
+
+	// An anonymous file provides the physical pages shared by both mappings
+	int fd = memfd_create("org.sbooth.AudioEngine.RingBuffer", MFD_CLOEXEC);
+	if(-1 == fd) {
+		LOGGER_ERR("org.sbooth.AudioEngine.VirtualMemory", "memfd_create failed: " << strerror(errno));
+		return nullptr;
+	}
+
+	if(-1 == ftruncate(fd, (off_t)byteCount)) {
+		LOGGER_ERR("org.sbooth.AudioEngine.VirtualMemory", "ftruncate failed: " << strerror(errno));
+		close(fd);
+		return nullptr;
+	}
+
+	// Reserve the full range, then map the file over each half
+	auto address = (uint8_t *)mmap(nullptr, byteCount * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(MAP_FAILED == address) {
+		LOGGER_ERR("org.sbooth.AudioEngine.VirtualMemory", "mmap failed: " << strerror(errno));
+		close(fd);
+		return nullptr;
+	}
+
+	if(MAP_FAILED == mmap(address, byteCount, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) || MAP_FAILED == mmap(address + byteCount, byteCount, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0)) {
+		LOGGER_ERR("org.sbooth.AudioEngine.VirtualMemory", "mmap failed: " << strerror(errno));
+		munmap(address, byteCount * 2);
+		close(fd);
+		return nullptr;
+	}
+
+	// The mappings keep the pages alive
+	close(fd);
+
+	return address;
+}
+
+void SFB::DeallocateMirroredMemory(void *memory, size_t byteCount)
+{
+	if(nullptr == memory)
+		return;
+
+	if(-1 == munmap(memory, byteCount * 2))
+		LOGGER_ERR("org.sbooth.AudioEngine.VirtualMemory", "munmap failed: " << strerror(errno));
+}
+
+#else
+
+void * SFB::AllocateMirroredMemory(size_t /*byteCount*/)
+{
+	LOGGER_NOTICE("org.sbooth.AudioEngine.VirtualMemory", "Mirrored memory is not supported on this platform");
+	return nullptr;
+}
+
+void SFB::DeallocateMirroredMemory(void */*memory*/, size_t /*byteCount*/)
+{}
+
+#endif
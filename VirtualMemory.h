@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2018 Stephen F. Booth <me@sbooth.org>
+ * See https://github.com/sbooth/SFBAudioEngine/blob/master/LICENSE.txt for license information
+ */
+
+#pragma once
+
+#include <cstddef>
+
+/*! @file VirtualMemory.h @brief Virtual memory utilities */
+
+/*! @brief \c SFBAudioEngine's encompassing namespace */
+namespace SFB {
+
+	/*! @brief Get the size of a virtual memory page in bytes */
+	size_t GetPageSize();
+
+	/*! @brief Round \c byteCount up to a multiple of the virtual memory page size */
+	size_t RoundUpToPageSize(size_t byteCount);
+
+	/*! @brief The size of a huge page in bytes */
+	constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+
+	/*!
+	 * @brief Allocate zeroed, page-aligned virtual memory
+	 *
+	 * If huge pages are requested and \c byteCount is a multiple of the huge page size the
+	 * memory is explicitly backed by huge pages (\c VM_FLAGS_SUPERPAGE_SIZE_2MB on macOS,
+	 * \c MAP_HUGETLB on Linux).  If that fails the memory is allocated normally and, where
+	 * supported, marked as eligible for transparent huge pages.
+	 * @param byteCount The size of the region; must be a multiple of the page size
+	 * @param useHugePages Whether to request huge pages
+	 * @return The address of the region, or \c nullptr on failure
+	 */
+	void * AllocatePages(size_t byteCount, bool useHugePages = false);
+
+	/*!
+	 * @brief Deallocate a region allocated with AllocatePages()
+	 * @param memory The address of the region
+	 * @param byteCount The value of \c byteCount passed to AllocatePages()
+	 */
+	void DeallocatePages(void *memory, size_t byteCount);
+
+
+	/*!
+	 * @brief Lock a region of memory into physical memory so it is never paged out
+	 * @param memory The address of the region
+	 * @param byteCount The size of the region in bytes
+	 * @return \c true on success, \c false otherwise
+	 */
+	bool LockMemory(void *memory, size_t byteCount);
+
+	/*!
+	 * @brief Unlock a region of memory locked with LockMemory()
+	 * @param memory The address of the region
+	 * @param byteCount The size of the region in bytes
+	 */
+	void UnlockMemory(void *memory, size_t byteCount);
+
+
+	/*!
+	 * @brief Allocate a mirrored region of virtual memory
+	 *
+	 * The returned region is \c 2 * \c byteCount bytes long.  The second half maps the same
+	 * physical pages as the first half, so any access of up to \c byteCount bytes starting in the
+	 * first half is contiguous even if it extends past the end of the first half.
+	 * @param byteCount The size of the region to mirror; must be a multiple of the page size
+	 * @return The address of the region, or \c nullptr on failure
+	 */
+	void * AllocateMirroredMemory(size_t byteCount);
+
+	/*!
+	 * @brief Deallocate a region allocated with AllocateMirroredMemory()
+	 * @param memory The address of the region
+	 * @param byteCount The value of \c byteCount passed to AllocateMirroredMemory()
+	 */
+	void DeallocateMirroredMemory(void *memory, size_t byteCount);
+
+}